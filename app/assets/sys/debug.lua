@@ -9,20 +9,23 @@ local ui = sys.gui;
 local green_color = ui.color("1b1c1bff")
 local purple_color = ui.color("bc30d1FA")
 local red_color = ui.color("f58142FA")
+local idle_color = ui.color("a1ab80FA")
+local shadow_color = ui.color("000000FF")
+local button_color = ui.color("71ab80FA")
 local start_time = sys.time()
 
 function render_stats(startX, startY)
     local time = sys.time()
     local delta = time - start_time
     start_time = time
-    local mouse = sys.input.mouse()
+    local mouse_x, mouse_y = sys.input.mouse_position()
     local fps = math.floor(1 / delta)
     local color
 
-    if (mouse.x > startX and mouse.x < startX + 300 and mouse.y > startY and mouse.y < startY + 200) then
-        color = mouse.is_down(0) and red_color or purple_color
+    if (mouse_x > startX and mouse_x < startX + 300 and mouse_y > startY and mouse_y < startY + 200) then
+        color = sys.input.button_down(0) and red_color or purple_color
     else
-        color = ui.color("a1ab80FA")
+        color = idle_color
     end
 
     ui.draw_rect(startX, startY, 300, 200, color)
@@ -33,7 +36,7 @@ function render_stats(startX, startY)
     y = y + 25
     ui.draw_text("Frame delta: " .. fps, startX + 10, y, 20, green_color)
     y = y + 25
-    ui.draw_text("Mouse: " .. mouse.x .. ", " .. mouse.y, startX + 10, y, 20, green_color)
+    ui.draw_text("Mouse: " .. mouse_x .. ", " .. mouse_y, startX + 10, y, 20, green_color)
 
     frame_count = frame_count + 1
 end
@@ -43,7 +46,7 @@ end
 
 ---- This is the update function that is called every frame
 function button(config, on_click)
-    local mouse = sys.input.mouse()
+    local mouse_x, mouse_y = sys.input.mouse_position()
     local x = config.x
     local y = config.y
     local width = sys.gui.text_width(config.text, config.text_size) + 20
@@ -54,16 +57,16 @@ function button(config, on_click)
     local text_x = x + (width / 2) - (text_width / 2)
     local text_y = y + (height / 2) - (text_size / 2)
 
-    local is_hovering = mouse.x > x and mouse.x < x + width and mouse.y > y and mouse.y < y + height
+    local is_hovering = mouse_x > x and mouse_x < x + width and mouse_y > y and mouse_y < y + height
 
     if (is_hovering) then
-        if (mouse.is_pressed(0)) then
+        if (sys.input.button_pressed(0)) then
             on_click()
         end
         --     Draw offset box for hover
-        ui.draw_rect(x - 5, y - 5, width + 10, height + 10, ui.color("000000FF"))
+        ui.draw_rect(x - 5, y - 5, width + 10, height + 10, shadow_color)
     else
-        color = ui.color("71ab80FA")
+        color = button_color
     end
     ui.draw_rect(x, y, width, height, color)
     ui.draw_text(text, text_x, text_y, text_size)
@@ -121,64 +121,27 @@ keys = {
     KEY_MENU = 348
 }
 
-local keyState = {}
+-- The queries read the kernel's per frame input snapshot, so every script sees the same transitions for the whole
+-- frame and nothing is allocated.
 
--- Check if a key is pressed based on transition. Can take multiple keys as arguments.
+-- Check if a key was pressed this frame. Can take multiple keys as arguments.
 function is_pressed(...)
-    local keysPressed = { ... }
-    local keyPressed = false
-
-    for _, key in ipairs(keysPressed) do
-        local currentState = sys.input.key(key).is_down
-        if currentState then
-            if not keyState[key] then
-                -- Key was not pressed before, but is now - a fresh press
-                keyPressed = true
-            end
-        end
-        keyState[key] = currentState  -- Update the state for the next check
-    end
-
-    return keyPressed
+    return sys.input.pressed(...)
 end
 
--- Check if a key is released based on transition. Can take multiple keys as arguments.
+-- Check if a key was released this frame. Can take multiple keys as arguments.
 function is_released(...)
-    local keysReleased = { ... }
-    local keyReleased = false
-
-    for _, key in ipairs(keysReleased) do
-        local currentState = sys.input.key(key).is_down
-        if not currentState then
-            if keyState[key] then
-                -- Key was pressed before, but is not now - a fresh release
-                keyReleased = true
-            end
-        end
-        keyState[key] = currentState  -- Update the state for the next check
-    end
-
-    return keyReleased
+    return sys.input.released(...)
 end
 
 -- Check if a key is down. Can take multiple keys as arguments.
 function is_down(...)
-    local keysDown = { ... }
-    for _, key in ipairs(keysDown) do
-        if sys.input.key(key).is_down then
-            return true
-        end
-    end
+    return sys.input.down(...)
 end
 
 -- Check if a key is up. Can take multiple keys as arguments.
 function is_up(...)
-    local keysUp = { ... }
-    for _, key in ipairs(keysUp) do
-        if not sys.input.key(key).is_down then
-            return true
-        end
-    end
+    return sys.input.up(...)
 end
 
 
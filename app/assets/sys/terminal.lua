@@ -4,6 +4,18 @@ sys.import("sys/input")
 -- Terminal class definition
 Terminal = {}
 
+-- Colors are packed integers, parse them once instead of every frame.
+local colors = {
+    frame = sys.gui.color("474747FF"),
+    border = sys.gui.color("363534ff"),
+    background = sys.gui.color("1b1c1bff"),
+    shadow = sys.gui.color("000000ff"),
+    input = sys.gui.color("FFFFFFFF"),
+    text = sys.gui.color("FaFaFaFF"),
+    title = sys.gui.color("FFFFFFFF"),
+    version = sys.gui.color("03a83aff"),
+}
+
 
 --- Initializes properties for the Terminal.
 -- This is a local function and is not meant to be called externally.
@@ -15,7 +27,6 @@ local function _initializeProperties(self, config)
         commands = {},
         history = {},
         history_index = 1,
-        input = " "
     }
     self.text = {
         x = 0,
@@ -34,9 +45,9 @@ local function _initializeProperties(self, config)
         cursor_blink = true,
     }
     self.cursor_visible = true
-    self.cursor_position = 0
     self.last_blink_time = sys.time()
-    self.buffer = {}
+    -- The scrollback and the input line live in a native buffer, it only redraws the rows that changed.
+    self.buffer = sys.terminal.new()
     self.last_key_time = {}
     self.key_repeat_initial_delay = 0.66
     self.is_key_repeating = false
@@ -90,12 +101,11 @@ end
 --- Resets the command state after execution.
 -- This is a local function and is not meant to be called externally.
 local function _resetCommandState(self)
-    self.internal.input = ">"
-    self.cursor_position = 2
+    self.buffer:set_input("")
 end
 
 function Terminal:clear()
-    self.text.value = ""
+    self.buffer:clear()
 end
 
 
@@ -120,7 +130,7 @@ function Terminal:execute_command(command)
         end
 
     else
-        self.text.value = self.text.value .. "\nUnknown command: " .. cmd
+        self.buffer:print("Unknown command: " .. tostring(cmd))
 
     end
     -- store the command in the history
@@ -145,7 +155,7 @@ function Terminal:dump()
 end
 
 function Terminal:print(text)
-    self.text.value = self.text.value .. "\n" .. text
+    self.buffer:print(tostring(text))
 end
 
 --- Handles key input for the Terminal.
@@ -159,7 +169,7 @@ local function _handleKeyInput(self)
     local function handleKeyRepeat(key, action)
         -- Calls the first action immediately when the key is pressed.
         -- stores that time in last_key_time
-        if sys.input.key(key).is_pressed then
+        if sys.input.pressed(key) then
             if not self.last_key_time[key] then
                 self.last_key_time[key] = sys.time()
                 self.is_key_repeating = true -- Key repeat starts
@@ -167,7 +177,7 @@ local function _handleKeyInput(self)
             end
         end
         -- starts a timer to call the action again after the initial delay
-        if sys.input.key(key).is_down then
+        if sys.input.down(key) then
             if not self.key_repeat_rate[key] then
                 self.key_repeat_rate[key] = self.key_repeat_initial_delay
             end
@@ -177,104 +187,68 @@ local function _handleKeyInput(self)
             end
         end
         -- resets the key repeat rate when the key is released
-        if sys.input.key(key).is_released then
+        if sys.input.released(key) then
             self.key_repeat_rate[key] = self.key_repeat_initial_delay
             self.last_key_time[key] = nil
             self.is_key_repeating = false -- Key repeat stops
         end
     end
 
-    for i = 32, 126 do
-        if (sys.input.key(i).is_pressed) then
-            local char = string.char(i)
-            -- Check for Shift key state; assume sys.input.key() can check it
-            -- You might need to adjust this based on your actual input handling system
-            local isShiftPressed = sys.input.key(keys.KEY_LEFT_SHIFT).is_down or sys.input.key(keys.KEY_SHIFT_RIGHT).is_down
-            if not isShiftPressed then
-                char = string.lower(char)
-            end
-            local beforeCursor = string.sub(self.internal.input, 1, self.cursor_position)
-            local afterCursor = string.sub(self.internal.input, self.cursor_position + 1)
-            self.internal.input = beforeCursor .. char .. afterCursor
-            self.cursor_position = self.cursor_position + 1
-        end
+    local buffer = self.buffer
+
+    -- Typed characters come from the frame's text entry events, they already respect shift and the keyboard layout.
+    local typed = sys.input.text()
+    if #typed > 0 then
+        buffer:insert(typed)
     end
 
-    local isControlPressed = sys.input.key(keys.KEY_LEFT_CONTROL).is_down or sys.input.key(keys.KEY_RIGHT_CONTROL).is_down
+    local isControlPressed = sys.input.down(keys.KEY_LEFT_CONTROL, keys.KEY_RIGHT_CONTROL)
 
     -- Handle Enter key
     handleKeyRepeat(keys.KEY_ENTER, function()
-        if #self.internal.input > 0 then
-            local command = self.internal.input
+        local command = buffer:input()
+        if #command > 0 then
             self:execute_command(command)
-            --self.text.value = self.text.value .. "\n" .. command
-            self.internal.input = ""
-            self.cursor_position = 0
+            buffer:set_input("")
         end
     end)
-    -- Check for Control key state
 
-    -- Handle right arrow with Control for jumping to the next space
+    -- Handle right arrow, with Control it jumps to the next word
     handleKeyRepeat(keys.KEY_RIGHT, function()
         if isControlPressed then
-            local foundPos = string.find(self.internal.input, " ", self.cursor_position + 1)
-            if foundPos then
-                self.cursor_position = foundPos
-            else
-                self.cursor_position = #self.internal.input -- Move to end if no space found
-            end
+            buffer:move_word(1)
         else
-            if self.cursor_position < #self.internal.input then
-                self.cursor_position = self.cursor_position + 1
-            end
+            buffer:move(1)
         end
     end)
 
-    -- Handle left arrow with Control for jumping to the previous space
+    -- Handle left arrow, with Control it jumps to the previous word
     handleKeyRepeat(keys.KEY_LEFT, function()
         if isControlPressed then
-            local startPos = self.cursor_position - 1
-            local foundPos = startPos > 0 and string.find(string.reverse(self.internal.input:sub(1, startPos)), " ") or nil
-            if foundPos then
-                self.cursor_position = startPos - foundPos + 1
-            else
-                self.cursor_position = 0 -- Move to start if no space found
-            end
+            buffer:move_word(-1)
         else
-            if self.cursor_position > 0 then
-                self.cursor_position = self.cursor_position - 1
-            end
+            buffer:move(-1)
         end
     end)
 
     -- Handle backspace
     handleKeyRepeat(keys.KEY_BACKSPACE, function()
-        if self.cursor_position >= 1 then
-            local start = string.sub(self.internal.input, 1, self.cursor_position - 1)
-            local finish = string.sub(self.internal.input, self.cursor_position + 1, #self.internal.input)
-            self.internal.input = start .. finish
-            self.cursor_position = self.cursor_position - 1
-        end
+        buffer:backspace()
     end)
 
     -- Handle delete
     handleKeyRepeat(keys.KEY_DELETE, function()
-        if self.cursor_position < #self.internal.input then
-            -- Modified this line to ensure we're not at the end
-            local start = string.sub(self.internal.input, 1, self.cursor_position)
-            local finish = string.sub(self.internal.input, self.cursor_position + 2)  -- Skip the character to the right of the cursor
-            self.internal.input = start .. finish
-        end
+        buffer:delete()
     end)
 
     -- Handle home
     handleKeyRepeat(keys.KEY_HOME, function()
-        self.cursor_position = 0
+        buffer:move_home()
     end)
 
     -- Handle end
     handleKeyRepeat(keys.KEY_END, function()
-        self.cursor_position = #self.internal.input + 1
+        buffer:move_end()
     end)
 
     -- Handle up arrow (previous command in history)
@@ -282,8 +256,7 @@ local function _handleKeyInput(self)
         print(self.internal.history_index)
         if self.internal.history_index > 1 then
             self.internal.history_index = self.internal.history_index - 1
-            self.internal.input = self.internal.history[self.internal.history_index]
-            self.cursor_position = #self.internal.input
+            buffer:set_input(self.internal.history[self.internal.history_index])
         end
     end)
 
@@ -291,12 +264,45 @@ local function _handleKeyInput(self)
     handleKeyRepeat(keys.KEY_DOWN, function()
         if self.internal.history_index < #self.internal.history then
             self.internal.history_index = self.internal.history_index + 1
-            self.internal.input = self.internal.history[self.internal.history_index]
-            self.cursor_position = #self.internal.input
+            buffer:set_input(self.internal.history[self.internal.history_index])
         end
     end)
 
+    -- The wheel scrolls through the scrollback, up shows older lines.
+    local wheel = sys.input.wheel()
+    if wheel ~= 0 then
+        buffer:scroll(wheel)
+    end
+
+end
+
+-- The terminal is drawn with retained nodes. They are created once and set every frame, the kernel only redraws the
+-- ones whose values changed, so an idle terminal costs nothing to draw.
+local function _createNodes(self)
+    local gui = sys.gui
+    self.nodes = {
+        frame = gui.node(),
+        border = gui.node(),
+        background = gui.node(),
+        shadow = gui.node(),
+        overlay = gui.node(),
+        title = gui.node(),
+        version = gui.node(),
+        input = gui.node(),
+        cursor = gui.node(),
+    }
+end
 
+-- The buffer creates its row nodes on top of the others, raises everything drawn above the lines back over them.
+local function _raiseOverlay(self)
+    local gui = sys.gui
+    local nodes = self.nodes
+    gui.node_raise(nodes.shadow)
+    gui.node_raise(nodes.overlay)
+    gui.node_raise(nodes.title)
+    gui.node_raise(nodes.version)
+    gui.node_raise(nodes.input)
+    gui.node_raise(nodes.cursor)
 end
 
 -- Renders the header of the Terminal.
@@ -307,9 +313,10 @@ local function _renderHeader(self)
     local y = math.floor(size.height - (size.height / 3)) + 10
     local width = size.width
     local height = size.height / 3
-    sys.gui.draw_rect(x, y - 12, width, height, sys.gui.color("474747FF"))
-    sys.gui.draw_rect(x + 10, y + 10, width - 20, height - 20, sys.gui.color("363534ff"))
-    sys.gui.draw_rect(x + 10, y + 40, width - 20, height - 50, sys.gui.color("1b1c1bff"))
+    local nodes = self.nodes
+    sys.gui.node_rect(nodes.frame, x, y - 12, width, height, colors.frame)
+    sys.gui.node_rect(nodes.border, x + 10, y + 10, width - 20, height - 20, colors.border)
+    sys.gui.node_rect(nodes.background, x + 10, y + 40, width - 20, height - 50, colors.background)
 end
 
 --- Renders the current input of the Terminal.
@@ -324,8 +331,8 @@ local function _renderCursor(self)
     local text_y = y + height - text_size
 
     -- Calculate the width of the text up to the cursor's position
-    local input_upto_cursor = string.sub(self.internal.input, 1, self.cursor_position)
-    local width_upto_cursor = sys.gui.text_width(input_upto_cursor, text_size)
+    local input = self.buffer:input()
+    local width_upto_cursor = sys.gui.text_width(input, text_size, self.buffer:cursor())
 
     local cursor_x = text_x + width_upto_cursor
     local cursor_y = text_y - text_size + 7
@@ -333,11 +340,10 @@ local function _renderCursor(self)
     local cursor_height = self.cursor.height
     local cursor_color = self.cursor.color
 
-    sys.gui.draw_text(self.internal.input, text_x, text_y, text_size, sys.gui.color("FFFFFFFF"))
-
-    if self.cursor.cursor_blink then
-        sys.gui.draw_rect(cursor_x, cursor_y, cursor_width, cursor_height, cursor_color)
-    end
+    local nodes = self.nodes
+    sys.gui.node_text(nodes.input, input, text_x, text_y, text_size, colors.input)
+    sys.gui.node_rect(nodes.cursor, cursor_x, cursor_y, cursor_width, cursor_height, cursor_color)
+    sys.gui.node_visible(nodes.cursor, self.cursor.cursor_blink)
 end
 
 local function _renderBuffer(self)
@@ -348,31 +354,22 @@ local function _renderBuffer(self)
     local text_x = x + 20
     local cursor_base_y = y + height - 30  -- Calculate based on the cursor's relative position
     local text_size = 20
-    
-    local lines = {}
-    for line in self.text.value:gmatch("([^\n]*)\n?") do
-        table.insert(lines, line)
-    end
 
-    -- Ensure the text buffer starts right above the cursor and moves up
-    local buffer_start_y = cursor_base_y - #lines * text_size
-    for i, line in ipairs(lines) do
-        -- Calculate Y position for each line, starting from buffer_start_y
-        local line_y = buffer_start_y + (i - 1) * text_size
-        -- Don't render if the line is outside the visible area
-        if line_y > y then
-            sys.gui.draw_text(line, text_x, line_y, text_size, sys.gui.color("FaFaFaFF"))
-        end
-        -- Adjust drawing to ensure it's within the visible area
+    -- The newest line's baseline sits one row above the input, older lines stack up to the bottom of the header.
+    local top = y + 40
+    local bottom = cursor_base_y - text_size * 0.75
+    if self.buffer:draw(text_x, top, size.width - 40, bottom - top, text_size, colors.text) then
+        _raiseOverlay(self)
     end
+    local nodes = self.nodes
 
     local width = size.width
     -- draws shadow for the header
-    sys.gui.draw_rect(x + 15, y + 5, width - 25, 40, sys.gui.color("000000ff"))
+    sys.gui.node_rect(nodes.shadow, x + 15, y + 5, width - 25, 40, colors.shadow)
     -- draw the overlay
-    sys.gui.draw_rect(x + 10, y + 5, width - 25, 35, sys.gui.color("1b1c1bff"))
-    sys.gui.draw_text("Terminus", x + 20, y + 30, 30, sys.gui.color("FFFFFFFF"))
-    sys.gui.draw_text("v" .. self.internal.version, sys.gui.text_width("Terminus", 20) + 25, y + 40, 12, sys.gui.color("03a83aff"))
+    sys.gui.node_rect(nodes.overlay, x + 10, y + 5, width - 25, 35, colors.background)
+    sys.gui.node_text(nodes.title, "Terminus", x + 20, y + 30, 30, colors.title)
+    sys.gui.node_text(nodes.version, "v" .. self.internal.version, sys.gui.text_width("Terminus", 20) + 25, y + 40, 12, colors.version)
 end
 
 
@@ -392,6 +389,9 @@ end
 
 --- Redraws the Terminal.
 function Terminal:redraw()
+    if self.nodes == nil then
+        _createNodes(self)
+    end
     _handleKeyInput(self)
     _renderHeader(self)
     _renderBuffer(self)
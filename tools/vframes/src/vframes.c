@@ -0,0 +1,114 @@
+/**
+ * Runs a script with the headless gui for a number of frames, reports the frame times and writes the last frame as a
+ * PPM image. Given a golden image the frame is compared against it instead, so gui changes can be checked on machines
+ * without a GPU.
+ *
+ *   vframes <root> <script> <frames> <output.ppm> [golden.ppm]   the script path is relative to the root
+ *
+ * The output image is always written, with a golden image the exit code is 1 when any pixel differs. Only built with
+ * VOS_HEADLESS.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "kernel/vproc.h"
+#include "core/vevent.h"
+#include "core/vgui_headless.h"
+#include "filesystem/vfs.h"
+#include "platform/platform.h"
+
+#define VFRAMES_WIDTH 1600
+#define VFRAMES_HEIGHT 900
+
+static int usage() {
+    fprintf(stderr, "usage: vframes <root> <script> <frames> <output.ppm> [golden.ppm]\n");
+    return 2;
+}
+
+// Compares the framebuffer with a PPM image, returns the number of differing pixels or -1 if the image can't be read.
+static i64 vframes_compare(const char *golden_path) {
+    u32 width, height;
+    const u8 *pixels = gui_headless_framebuffer(&width, &height);
+    FILE *file = fopen(golden_path, "rb");
+    if (!file) return -1;
+    u32 golden_width, golden_height, max_value;
+    if (fscanf(file, "P6 %u %u %u", &golden_width, &golden_height, &max_value) != 3 || max_value != 255 ||
+        fgetc(file) == EOF) {
+        fclose(file);
+        return -1;
+    }
+    if (golden_width != width || golden_height != height) {
+        fclose(file);
+        fprintf(stderr, "vframes: golden image is %ux%u, the frame is %ux%u\n", golden_width, golden_height, width,
+                height);
+        return (i64) width * height;
+    }
+    u8 golden[3];
+    i64 differing = 0;
+    for (u64 i = 0; i < (u64) width * height; ++i) {
+        if (fread(golden, 1, 3, file) != 3) {
+            fclose(file);
+            return -1;
+        }
+        if (memcmp(golden, pixels + i * 3, 3) != 0) differing++;
+    }
+    fclose(file);
+    return differing;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 5 || argc > 6) return usage();
+    u64 frames = strtoull(argv[3], null, 10);
+    if (frames == 0) return usage();
+    if (kernel_initialize(argv[1]).code != KERNEL_SUCCESS) {
+        fprintf(stderr, "vframes: failed to start the kernel at %s\n", argv[1]);
+        return 1;
+    }
+    FsNode *script = vfs_node_lookup(argv[2]);
+    if (script == null || script->type != NODE_FILE) {
+        fprintf(stderr, "vframes: %s is not a script in %s\n", argv[2], argv[1]);
+        kernel_shutdown();
+        return 1;
+    }
+    gui_headless_set_rasterize(true);
+    gui_headless_set_frame_limit(frames);
+    window_initialize("vframes", VFRAMES_WIDTH, VFRAMES_HEIGHT);
+    Proc *process = kernel_create_process(script);
+    if (process == null) {
+        fprintf(stderr, "vframes: failed to spawn %s\n", argv[2]);
+        window_shutdown();
+        kernel_shutdown();
+        return 1;
+    }
+    process_start(process);
+    lua_ctx(update)
+    f64 elapsed = 0, slowest = 0;
+    while (!window_should_close()) {
+        f64 start = platform_get_absolute_time();
+        window_begin_frame();
+        event_fire(EVENT_LUA_CUSTOM, null, update);
+        kernel_poll_update();
+        window_end_frame();
+        f64 frame_time = platform_get_absolute_time() - start;
+        elapsed += frame_time;
+        if (frame_time > slowest) slowest = frame_time;
+    }
+    b8 written = gui_headless_write_ppm(argv[4]);
+    i64 differing = written && argc == 6 ? vframes_compare(argv[5]) : 0;
+    window_shutdown();
+    kernel_shutdown();
+    if (!written) {
+        fprintf(stderr, "vframes: failed to write %s\n", argv[4]);
+        return 1;
+    }
+    printf("%llu frames %8.3f ms per frame %8.3f ms slowest\n", (unsigned long long) frames, elapsed * 1000 / frames,
+           slowest * 1000);
+    if (differing < 0) {
+        fprintf(stderr, "vframes: failed to read the golden image %s\n", argv[5]);
+        return 1;
+    }
+    if (argc == 6) printf("%lld pixels differ from %s\n", (long long) differing, argv[5]);
+    return differing == 0 ? 0 : 1;
+}
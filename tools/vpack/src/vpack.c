@@ -0,0 +1,80 @@
+/**
+ * Packs asset directories into archives the vfs can mount, and inspects existing archives.
+ *
+ *   vpack pack <directory> <archive> [--store]   packs every file below the directory, --store skips compression
+ *   vpack list <archive>                         lists the entries and checks their contents against their hashes
+ *   vpack cat <archive> <path>                   writes the contents of one entry to stdout
+ */
+#include <stdio.h>
+#include <string.h>
+#include "defines.h"
+#include "core/vlogger.h"
+#include "core/vmem.h"
+#include "filesystem/varchive.h"
+
+static int usage() {
+    fprintf(stderr, "usage: vpack pack <directory> <archive> [--store]\n"
+                    "       vpack list <archive>\n"
+                    "       vpack cat <archive> <path>\n");
+    return 2;
+}
+
+static int vpack_list(const char *archive_path) {
+    Archive *archive = archive_open(archive_path);
+    if (archive == null) return 1;
+    u32 corrupt = 0;
+    for (u32 i = 0; i < archive->header->entry_count; ++i) {
+        const ArchiveEntry *entry = &archive->entries[i];
+        u8 *contents = kallocate(entry->size ? entry->size : 1, MEMORY_TAG_RESOURCE);
+        b8 valid = archive_entry_read(archive, entry, contents);
+        kfree(contents, entry->size ? entry->size : 1, MEMORY_TAG_RESOURCE);
+        if (!valid) corrupt++;
+        printf("%10llu %10llu %c %016llx %s%s\n", entry->size, entry->stored_size,
+               entry->flags & ARCHIVE_ENTRY_COMPRESSED ? 'z' : '-', entry->hash,
+               archive_entry_path(archive, entry), valid ? "" : " (corrupt)");
+    }
+    archive_close(archive);
+    return corrupt ? 1 : 0;
+}
+
+static int vpack_cat(const char *archive_path, const char *path) {
+    Archive *archive = archive_open(archive_path);
+    if (archive == null) return 1;
+    const ArchiveEntry *entry = archive_find(archive, path);
+    int result = 1;
+    if (entry == null) {
+        fprintf(stderr, "vpack: %s is not in %s\n", path, archive_path);
+    } else {
+        u8 *contents = kallocate(entry->size ? entry->size : 1, MEMORY_TAG_RESOURCE);
+        if (archive_entry_read(archive, entry, contents)) {
+            result = fwrite(contents, 1, entry->size, stdout) == entry->size ? 0 : 1;
+        } else {
+            fprintf(stderr, "vpack: %s is corrupt\n", path);
+        }
+        kfree(contents, entry->size ? entry->size : 1, MEMORY_TAG_RESOURCE);
+    }
+    archive_close(archive);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) return usage();
+    memory_system_configuration config;
+    config.heap_size = GIBIBYTES(1);
+    if (!memory_system_initialize(config)) {
+        verror("Failed to initialize memory system; shutting down.");
+        return 1;
+    }
+    int result;
+    if (strcmp(argv[1], "pack") == 0 && (argc == 4 || (argc == 5 && strcmp(argv[4], "--store") == 0))) {
+        result = archive_pack(argv[2], argv[3], argc == 4) ? 0 : 1;
+    } else if (strcmp(argv[1], "list") == 0 && argc == 3) {
+        result = vpack_list(argv[2]);
+    } else if (strcmp(argv[1], "cat") == 0 && argc == 4) {
+        result = vpack_cat(argv[2], argv[3]);
+    } else {
+        result = usage();
+    }
+    // The memory system isn't shut down, its leak report would end up in the output of cat.
+    return result;
+}
@@ -0,0 +1,69 @@
+/**
+ * Spawns and destroys a process from one script over and over, first taking lua states from the pool and then building
+ * every state on the spot, and reports the processes spawned per second each way.
+ *
+ *   vspawn <root> <script> [count]   the script path is relative to the root, count defaults to 200
+ *
+ * Spawns are paced in bursts smaller than the pool with a pause between them, the way processes are started in a
+ * session, so the pool has time to refill. Only the spawn and destroy calls are timed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "kernel/vlua.h"
+#include "filesystem/vfs.h"
+#include "platform/platform.h"
+
+// The spawns between pauses, below the size of the pool.
+#define VSPAWN_BURST 4
+// The pause between bursts, long enough for the pool to build the states taken.
+#define VSPAWN_PAUSE_MS 20
+
+static int usage() {
+    fprintf(stderr, "usage: vspawn <root> <script> [count]\n");
+    return 2;
+}
+
+// Spawns count processes from the script, returns the seconds spent spawning and destroying them or -1 on failure.
+static f64 vspawn_run(FsNode *script, u32 count) {
+    f64 elapsed = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (i % VSPAWN_BURST == 0) platform_sleep(VSPAWN_PAUSE_MS);
+        f64 start = platform_get_absolute_time();
+        Proc *process = kernel_create_process(script);
+        if (process == null) return -1;
+        kernel_destroy_process(process->pid);
+        elapsed += platform_get_absolute_time() - start;
+    }
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3 || argc > 4) return usage();
+    u32 count = argc == 4 ? (u32) strtoul(argv[3], null, 10) : 200;
+    if (count == 0) return usage();
+    if (kernel_initialize(argv[1]).code != KERNEL_SUCCESS) {
+        fprintf(stderr, "vspawn: failed to start the kernel at %s\n", argv[1]);
+        return 1;
+    }
+    FsNode *script = vfs_node_lookup(argv[2]);
+    if (script == null || script->type != NODE_FILE) {
+        fprintf(stderr, "vspawn: %s is not a script in %s\n", argv[2], argv[1]);
+        kernel_shutdown();
+        return 1;
+    }
+    intrinsics_state_pool_enable(true);
+    f64 pooled = vspawn_run(script, count);
+    intrinsics_state_pool_enable(false);
+    f64 on_demand = pooled < 0 ? -1 : vspawn_run(script, count);
+    kernel_shutdown();
+    if (pooled < 0 || on_demand < 0) {
+        fprintf(stderr, "vspawn: failed to spawn %s\n", argv[2]);
+        return 1;
+    }
+    printf("%-10s %10.0f processes/s %8.3f ms per spawn\n", "pooled", count / pooled, pooled * 1000 / count);
+    printf("%-10s %10.0f processes/s %8.3f ms per spawn\n", "on demand", count / on_demand, on_demand * 1000 / count);
+    printf("speedup    %10.2fx\n", on_demand / pooled);
+    return 0;
+}
@@ -96,12 +96,12 @@ void *_darray_pop_at(void *array, u64 index, void *dest) {
     u64 addr = (u64) array;
     kcopy_memory(dest, (void *) (addr + (index * stride)), stride);
     
-    // If not on the last element, snip out the entry and copy the rest inward.
+    // If not on the last element, snip out the entry and move the rest inward, the ranges overlap.
     if (index != length - 1) {
-        kcopy_memory(
+        memmove(
                 (void *) (addr + (index * stride)),
                 (void *) (addr + ((index + 1) * stride)),
-                stride * (length - index));
+                stride * (length - index - 1));
     }
     
     _darray_field_set(array, DARRAY_LENGTH, length - 1);
@@ -111,7 +111,8 @@ void *_darray_pop_at(void *array, u64 index, void *dest) {
 void *_darray_insert_at(void *array, u64 index, void *value_ptr) {
     u64 length = darray_length(array);
     u64 stride = darray_stride(array);
-    if (index >= length) {
+    // Inserting at the length appends.
+    if (index > length) {
         verror("Index outside the bounds of this array! Length: %i, index: %index", length, index);
         return array;
     }
@@ -121,9 +122,9 @@ void *_darray_insert_at(void *array, u64 index, void *value_ptr) {
     
     u64 addr = (u64) array;
     
-    // If not on the last element, copy the rest outward.
-    if (index != length - 1) {
-        kcopy_memory(
+    // If not past the last element, move the rest outward, the ranges overlap.
+    if (index != length) {
+        memmove(
                 (void *) (addr + ((index + 1) * stride)),
                 (void *) (addr + (index * stride)),
                 stride * (length - index));
@@ -22,10 +22,20 @@ static u64 dict_default_hash(const char *key) {
 static u64 has_table_index(Dict *dict, const char *key);
 
 static u64 has_table_index(Dict *dict, const char *key) {
-    u64 result = dict->hash_func(key) % dict->size;
+    u64 hash = dict->atom_keys ? atom_hash(key) : dict->hash_func(key);
+    u64 result = hash % dict->size;
     return result;
 }
 
+static inline b8 dict_keys_equal(Dict *dict, const char *key0, const char *key1) {
+    return dict->atom_keys ? key0 == key1 : strings_equal(key0, key1);
+}
+
+// Atoms belong to the atom table, only copied keys are freed.
+static void dict_key_free(Dict *dict, char *key) {
+    if (!dict->atom_keys) string_deallocate(key);
+}
+
 Dict *dict_create(u64 size, hash_function *hash_func) {
     Dict *table = kallocate(sizeof(Dict), MEMORY_TAG_DICT);
     table->size = size;
@@ -50,13 +60,23 @@ Dict *dict_create_sized(u64 size) {
     return dict_create(size, dict_default_hash);
 }
 
+Dict *dict_create_atoms(u64 size) {
+    Dict *table = dict_create(size, null);
+    table->atom_keys = true;
+    return table;
+}
+
+Dict *dict_new_atoms() {
+    return dict_create_atoms(DEFAULT_DICT_SIZE);
+}
+
 void dict_delete(Dict *table) {
     //Delete all keys
     for (u32 i = 0; i < table->size; i++) {
         Entry *e = table->elements[i];
         while (e != NULL) {
             Entry *next = e->next;
-            kfree(e->key, string_length(e->key) + 1, MEMORY_TAG_STRING);
+            dict_key_free(table, e->key);
             kfree(e, sizeof(Entry), MEMORY_TAG_DICT);
             e = next;
         }
@@ -66,27 +86,23 @@ void dict_delete(Dict *table) {
 }
 
 char *dict_to_string(Dict *table) {
-    char *result = string_duplicate("{");
+    StringBuilder *sb = sb_new();
+    sb_append(sb, "{", 1);
     for (u32 i = 0; i < table->size; i++) {
-        Entry *e = table->elements[i];
-        while (e != NULL) {
-            u64 hash_key = table->hash_func(e->key);
-            result = string_format("%s\n\t0x%x: {\n\t\tKey: %s,\n\t\tValue Pointer: 0x%4p\n\t}\n",
-                                   result,
-                                   hash_key,
-                                   e->key,
-                                   e->value);
-            if (e->next != NULL)
-                result = string_concat(result, ",");
-            e = e->next;
+        for (Entry *e = table->elements[i]; e != NULL; e = e->next) {
+            u64 hash_key = table->atom_keys ? atom_hash(e->key) : table->hash_func(e->key);
+            sb_appendf(sb, "\n\t0x%llx: {\n\t\tKey: %s,\n\t\tValue Pointer: 0x%4p\n\t}\n",
+                       (unsigned long long) hash_key, e->key, e->value);
+            if (e->next != NULL) sb_append(sb, ",", 1);
         }
     }
-    result = string_concat(result, "\n");
-    result[string_length(result) - 1] = '}';
-    return result;
+    sb_append(sb, "}", 1);
+    return sb_take(sb);
 }
 
 b8 dict_set(Dict *table, const char *key, void *value) {
+    if (table != NULL && table->atom_keys)
+        return dict_set_atom(table, atom_intern(key), value);
     if (key == NULL || value == NULL)
         return false;
     u64 index = has_table_index(table, key);
@@ -103,9 +119,26 @@ b8 dict_set(Dict *table, const char *key, void *value) {
     return true;
 }
 
+b8 dict_set_atom(Dict *table, Atom key, void *value) {
+    if (key == NULL || value == NULL)
+        return false;
+    if (dict_get_atom(table, key) != NULL)
+        return false;
+    u64 index = has_table_index(table, key);
+    Entry *e = kallocate(sizeof(Entry), MEMORY_TAG_DICT);
+    e->key = (char *) key;
+    e->value = value;
+    e->next = table->elements[index];
+    table->elements[index] = e;
+    return true;
+}
+
 void *dict_get(Dict *table, const char *key) {
     if (key == NULL || table == NULL)
         return NULL;
+    // A string that was never interned can't be a key.
+    if (table->atom_keys)
+        return dict_get_atom(table, atom_find(key));
     u64 index = has_table_index(table, key);
     
     Entry *temp = table->elements[index];
@@ -117,13 +150,24 @@ void *dict_get(Dict *table, const char *key) {
     return temp->value;
 }
 
-void *dict_remove(Dict *table, const char *key) {
+void *dict_get_atom(Dict *table, Atom key) {
+    if (key == NULL || table == NULL)
+        return NULL;
+    Entry *temp = table->elements[has_table_index(table, key)];
+    while (temp != NULL && temp->key != key) {
+        temp = temp->next;
+    }
+    return temp ? temp->value : NULL;
+}
+
+// Unlinks and frees the entry of a key, already an atom in a table keyed on atoms.
+static void *dict_remove_key(Dict *table, const char *key) {
     if (key == NULL || table == NULL)
         return NULL;
     u64 index = has_table_index(table, key);
     Entry *temp = table->elements[index];
     Entry *prev = NULL;
-    while (temp != NULL && !strings_equal(temp->key, key)) {
+    while (temp != NULL && !dict_keys_equal(table, temp->key, key)) {
         prev = temp;
         temp = temp->next;
     }
@@ -137,17 +181,27 @@ void *dict_remove(Dict *table, const char *key) {
         prev->next = temp->next;
     }
     void *result = temp->value;
-    kfree(temp->key, string_length(temp->key) + 1, MEMORY_TAG_STRING);
+    dict_key_free(table, temp->key);
     kfree(temp, sizeof(Entry), MEMORY_TAG_DICT);
     return result;
 }
 
+void *dict_remove(Dict *table, const char *key) {
+    if (key != NULL && table != NULL && table->atom_keys)
+        key = atom_find(key);
+    return dict_remove_key(table, key);
+}
+
+void *dict_remove_atom(Dict *table, Atom key) {
+    return dict_remove_key(table, key);
+}
+
 void dict_clear(Dict *table) {
     for (u32 i = 0; i < table->size; i++) {
         Entry *e = table->elements[i];
         while (e != NULL) {
             Entry *next = e->next;
-            kfree(e->key, string_length(e->key) + 1, MEMORY_TAG_STRING);
+            dict_key_free(table, e->key);
             kfree(e, sizeof(Entry), MEMORY_TAG_DICT);
             e = next;
         }
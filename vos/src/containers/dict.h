@@ -4,6 +4,7 @@
 #pragma once
 
 #include "defines.h"
+#include "core/vatom.h"
 
 typedef u64 (hash_function)(const char *);
 
@@ -18,6 +19,8 @@ typedef struct Dict {
     u32 size;
     hash_function *hash_func;
     Entry **elements;
+    // The keys are atoms, hashed by their interned hash and compared by pointer rather than copied and compared.
+    b8 atom_keys;
 } Dict;
 
 typedef struct DictIter {
@@ -52,6 +55,20 @@ Dict *dict_new();
  */
 Dict *dict_create_sized(u64 size);
 
+/**
+ * @brief creates a new dictionary table keyed on atoms. Keys given as plain strings are interned on insert and looked
+ * up in the atom table otherwise, the _atom functions skip that for keys that already are atoms.
+ * @param size the size of the table
+ * @return a new dictionary table
+ */
+Dict *dict_create_atoms(u64 size);
+
+/**
+ * Creates a new dictionary table keyed on atoms with the default size
+ * @return a new dictionary table
+ */
+Dict *dict_new_atoms();
+
 /**
  * @brief destroys the given dictionary table
  * @param table  the table to destroy
@@ -67,6 +84,24 @@ void dict_delete(Dict *table);
  */
 b8 dict_set(Dict *table, const char *key, void *value);
 
+/**
+ * @brief inserts the given atom key and value into a table keyed on atoms
+ * @return true if the key was inserted, false if the key already exists
+ */
+b8 dict_set_atom(Dict *table, Atom key, void *value);
+
+/**
+ * @brief looks up the given atom key in a table keyed on atoms, without hashing it
+ * @return the value associated with the key, or null if the key does not exist
+ */
+void *dict_get_atom(Dict *table, Atom key);
+
+/**
+ * @brief removes the given atom key from a table keyed on atoms
+ * @return the value that was associated with the key, or null if the key does not exist
+ */
+void *dict_remove_atom(Dict *table, Atom key);
+
 /**
  * @brief looks up the given key in the table
  * @param table the table to look in
@@ -107,7 +142,8 @@ u32 dict_size(Dict *table);
 /**
  * @brief converts the given table to a string
  * @param table
- * @return
+ * @return The string, built in place rather than by vstring. Free it with kfree(length + 1, MEMORY_TAG_STRING), not
+ * string_deallocate.
  */
 char *dict_to_string(Dict *table);
 
@@ -0,0 +1,189 @@
+/**
+ * The atom table, see vatom.h. The top bits of a string's hash pick its shard, each shard is an open addressed table
+ * probed linearly from the low bits. An atom is laid out as its header followed by the terminated string, carved from
+ * large blocks so interning rarely allocates.
+ */
+#include "vatom.h"
+#include <string.h>
+#include "vhash.h"
+#include "vlogger.h"
+#include "vmem.h"
+#include "vmutex.h"
+#include "containers/darray.h"
+
+// The slots a shard starts with, a power of two. The table doubles once it is half full.
+#define ATOM_SHARD_CAPACITY 256
+#define ATOM_SHARD_BITS (__builtin_ctz(ATOM_SHARD_COUNT))
+
+typedef struct AtomHeader {
+    u64 hash;
+    u64 length;
+} AtomHeader;
+
+typedef struct AtomBlock {
+    char *data;
+    u64 size;
+} AtomBlock;
+
+typedef struct AtomShard {
+    kmutex lock;
+    // The atoms by hash, null for an empty slot.
+    Atom *slots;
+    u32 capacity;
+    u32 count;
+    // A darray of the blocks the atoms live in, the last one is filled up first.
+    AtomBlock *blocks;
+    u64 block_used;
+} AtomShard;
+
+static AtomShard *atom_shards = null;
+
+static inline AtomHeader *atom_header(Atom atom) {
+    return (AtomHeader *) atom - 1;
+}
+
+static inline AtomShard *atom_shard(u64 hash) {
+    return &atom_shards[ATOM_SHARD_COUNT > 1 ? hash >> (64 - ATOM_SHARD_BITS) : 0];
+}
+
+void atoms_initialize() {
+    if (atom_shards) return;
+    atom_shards = kallocate(sizeof(AtomShard) * ATOM_SHARD_COUNT, MEMORY_TAG_STRING);
+    for (u32 i = 0; i < ATOM_SHARD_COUNT; ++i) {
+        AtomShard *shard = &atom_shards[i];
+        kmutex_create(&shard->lock);
+        shard->capacity = ATOM_SHARD_CAPACITY;
+        shard->slots = kallocate(sizeof(Atom) * shard->capacity, MEMORY_TAG_STRING);
+        shard->blocks = darray_create(AtomBlock);
+    }
+}
+
+void atoms_shutdown() {
+    if (atom_shards == null) return;
+    u64 count = 0;
+    for (u32 i = 0; i < ATOM_SHARD_COUNT; ++i) {
+        AtomShard *shard = &atom_shards[i];
+        count += shard->count;
+        for (u64 j = 0; j < darray_length(shard->blocks); ++j) {
+            kfree(shard->blocks[j].data, shard->blocks[j].size, MEMORY_TAG_STRING);
+        }
+        darray_destroy(shard->blocks)
+        kfree(shard->slots, sizeof(Atom) * shard->capacity, MEMORY_TAG_STRING);
+        kmutex_destroy(&shard->lock);
+    }
+    kfree(atom_shards, sizeof(AtomShard) * ATOM_SHARD_COUNT, MEMORY_TAG_STRING);
+    atom_shards = null;
+    vdebug("atoms_shutdown - Freed %llu atoms", count)
+}
+
+// Finds the slot holding a string, or the empty slot it would go in.
+static u32 shard_probe(AtomShard *shard, const char *str, u64 length, u64 hash) {
+    u32 mask = shard->capacity - 1;
+    u32 index = (u32) hash & mask;
+    while (shard->slots[index]) {
+        AtomHeader *header = atom_header(shard->slots[index]);
+        if (header->hash == hash && header->length == length && memcmp(shard->slots[index], str, length) == 0) break;
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+static void shard_grow(AtomShard *shard) {
+    Atom *slots = shard->slots;
+    u32 capacity = shard->capacity;
+    shard->capacity *= 2;
+    shard->slots = kallocate(sizeof(Atom) * shard->capacity, MEMORY_TAG_STRING);
+    u32 mask = shard->capacity - 1;
+    for (u32 i = 0; i < capacity; ++i) {
+        if (slots[i] == null) continue;
+        u32 index = (u32) atom_header(slots[i])->hash & mask;
+        while (shard->slots[index]) index = (index + 1) & mask;
+        shard->slots[index] = slots[i];
+    }
+    kfree(slots, sizeof(Atom) * capacity, MEMORY_TAG_STRING);
+}
+
+// Carves room for an atom out of the shard's last block, starting a new block when it doesn't fit.
+static char *shard_allocate(AtomShard *shard, u64 size) {
+    // Keeps the headers aligned.
+    size = (size + sizeof(u64) - 1) & ~(sizeof(u64) - 1);
+    u64 block_count = darray_length(shard->blocks);
+    if (size > ATOM_BLOCK_SIZE / 4) {
+        AtomBlock block = {kallocate(size, MEMORY_TAG_STRING), size};
+        // Ahead of the block being filled, so it stays last.
+        if (block_count > 0) {
+            darray_insert_at(shard->blocks, block_count - 1, block);
+        } else {
+            darray_push(AtomBlock, shard->blocks, block);
+        }
+        return block.data;
+    }
+    if (block_count == 0 || shard->block_used + size > ATOM_BLOCK_SIZE) {
+        AtomBlock block = {kallocate(ATOM_BLOCK_SIZE, MEMORY_TAG_STRING), ATOM_BLOCK_SIZE};
+        darray_push(AtomBlock, shard->blocks, block);
+        shard->block_used = 0;
+        block_count++;
+    }
+    char *data = shard->blocks[block_count - 1].data + shard->block_used;
+    shard->block_used += size;
+    return data;
+}
+
+Atom atom_intern_sized(const char *str, u64 length) {
+    if (str == null || atom_shards == null) return null;
+    u64 hash = hash64(str, length);
+    AtomShard *shard = atom_shard(hash);
+    kmutex_lock(&shard->lock);
+    u32 index = shard_probe(shard, str, length, hash);
+    Atom atom = shard->slots[index];
+    if (atom == null) {
+        AtomHeader *header = (AtomHeader *) shard_allocate(shard, sizeof(AtomHeader) + length + 1);
+        header->hash = hash;
+        header->length = length;
+        char *chars = (char *) (header + 1);
+        memcpy(chars, str, length);
+        chars[length] = '\0';
+        atom = chars;
+        shard->slots[index] = atom;
+        if (++shard->count * 2 > shard->capacity) shard_grow(shard);
+    }
+    kmutex_unlock(&shard->lock);
+    return atom;
+}
+
+Atom atom_intern(const char *str) {
+    return str ? atom_intern_sized(str, strlen(str)) : null;
+}
+
+Atom atom_find_sized(const char *str, u64 length) {
+    if (str == null || atom_shards == null) return null;
+    u64 hash = hash64(str, length);
+    AtomShard *shard = atom_shard(hash);
+    kmutex_lock(&shard->lock);
+    Atom atom = shard->slots[shard_probe(shard, str, length, hash)];
+    kmutex_unlock(&shard->lock);
+    return atom;
+}
+
+Atom atom_find(const char *str) {
+    return str ? atom_find_sized(str, strlen(str)) : null;
+}
+
+u64 atom_hash(Atom atom) {
+    return atom_header(atom)->hash;
+}
+
+u64 atom_length(Atom atom) {
+    return atom_header(atom)->length;
+}
+
+u64 atom_count() {
+    if (atom_shards == null) return 0;
+    u64 count = 0;
+    for (u32 i = 0; i < ATOM_SHARD_COUNT; ++i) {
+        kmutex_lock(&atom_shards[i].lock);
+        count += atom_shards[i].count;
+        kmutex_unlock(&atom_shards[i].lock);
+    }
+    return count;
+}
@@ -0,0 +1,75 @@
+/**
+ * Interned strings. Every distinct string is stored once and handed out as an atom, so two atoms are equal exactly
+ * when their pointers are, and the hash computed when the string was interned is read back rather than recomputed.
+ *
+ * An atom is a terminated string that stays valid until atoms_shutdown and is never freed on its own, so it fits
+ * strings drawn from a bounded set: paths, names and identifiers. The table is split into shards with a lock each,
+ * any thread can intern.
+ */
+#pragma once
+
+#include "defines.h"
+
+#ifndef ATOM_SHARD_COUNT
+// The number of independently locked parts of the table, a power of two.
+#define ATOM_SHARD_COUNT 16
+#endif
+
+// The size of the blocks atoms are carved from, longer strings get a block of their own.
+#define ATOM_BLOCK_SIZE KIBIBYTES(64)
+
+/**
+ * An interned string, compare atoms with == and read them like any other string.
+ */
+typedef const char *Atom;
+
+/**
+ * Creates the atom table, before anything interns.
+ */
+VAPI void atoms_initialize();
+
+/**
+ * Frees every atom, after everything holding one is gone.
+ */
+VAPI void atoms_shutdown();
+
+/**
+ * Interns the first length bytes of a string, they don't need to be terminated.
+ *
+ * @param str The bytes of the string.
+ * @param length The number of bytes.
+ * @return The atom for the string, the same one for every call with the same bytes. Null if str is null.
+ */
+VAPI Atom atom_intern_sized(const char *str, u64 length);
+
+/**
+ * Interns a terminated string.
+ */
+VAPI Atom atom_intern(const char *str);
+
+/**
+ * Looks up the atom for the first length bytes of a string without interning it.
+ *
+ * @return The atom, null if the string was never interned.
+ */
+VAPI Atom atom_find_sized(const char *str, u64 length);
+
+/**
+ * Looks up the atom for a terminated string without interning it.
+ */
+VAPI Atom atom_find(const char *str);
+
+/**
+ * Gets the hash of an atom, computed once when it was interned.
+ */
+VAPI u64 atom_hash(Atom atom);
+
+/**
+ * Gets the length of an atom.
+ */
+VAPI u64 atom_length(Atom atom);
+
+/**
+ * Gets the number of atoms interned.
+ */
+VAPI u64 atom_count();
@@ -2,57 +2,69 @@
  * Created by jraynor on 2/14/2024.
  */
 #include "vgui.h"
-#include "vlogger.h"
 
+// The windowed backend, see vgui_headless.c for the backend used by VOS_HEADLESS builds.
+#ifndef VOS_HEADLESS
 
-/**
- * Created by jraynor on 2/14/2024.
- */
 #include "vlogger.h"
+#include "vmem.h"
 #include "nanovg_gl.h"
+#include "nanovg_gl_utils.h"
 #include "vinput.h"
+#include "vgui_display.h"
+#include "vgui_text.h"
+#include "vgui_frame.h"
+#include "vmutex.h"
+#include <string.h>
+#include "containers/darray.h"
 
-// Input state structures
-typedef struct {
-    b8 keys[KEYS_MAX_KEYS];
-    b8 prev_keys[KEYS_MAX_KEYS]; // Add this line
-    b8 buttons[BUTTON_MAX_BUTTONS];
-    i32 mouse_x, mouse_y;
-    i32 prev_mouse_x, prev_mouse_y;
-    i8 mouse_wheel_delta;
-} InputState;
+// How long an idle frame waits for window events, roughly one refresh so timers keep firing at frame rate.
+#define WINDOW_IDLE_WAIT_SECONDS (1.0 / 60.0)
 
-static InputState g_input_state;
-
-void input_reset(void) {
-    memcpy(g_input_state.prev_keys, g_input_state.keys, sizeof(g_input_state.keys));
-}
+// Frames are drawn into an offscreen canvas that keeps its contents between frames, so a frame only has to repaint
+// the damaged part of it. The canvas is copied to the window's back buffer before every swap. Only the render thread
+// touches it.
+static NVGLUframebuffer *window_canvas = null;
+static int window_canvas_width = 0, window_canvas_height = 0;
+// The GL context is current on the render thread. The nanovg context is also used by the update thread to measure
+// text and load fonts, this lock keeps that from running while a frame is submitted.
+static kmutex window_vg_lock;
+// The size the last frame was composed for, a new size repaints the whole screen.
+static int window_frame_width = 0, window_frame_height = 0;
+// Set when the last frame was skipped, the next one waits for window events instead of polling.
+static b8 window_idle = false;
+// Scratch space for the glyph positions nanovg reports, grown to the longest text measured so far.
+static NVGglyphPosition *glyph_positions = null;
+static u64 glyph_positions_capacity = 0;
 
+static void window_render_thread_start();
+static void window_render_thread_stop();
+static void window_render(GuiFrame *frame);
+static void gui_submit_batch(GuiBatch *batch);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
     if (key >= 0 && key < KEYS_MAX_KEYS) {
-        g_input_state.keys[key] = action != GLFW_RELEASE;
+        input_process_key(key, action != GLFW_RELEASE);
     }
 }
+
 void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
     // Map GLFW button to buttons enum and update state
     if (button >= 0 && button < BUTTON_MAX_BUTTONS) {
-        b8 pressed = action != GLFW_RELEASE;
-        g_input_state.buttons[button] = pressed;
+        input_process_button(button, action != GLFW_RELEASE);
     }
 }
 
 void cursor_position_callback(GLFWwindow *window, double xpos, double ypos) {
-    // Update mouse position
-    g_input_state.prev_mouse_x = g_input_state.mouse_x;
-    g_input_state.prev_mouse_y = g_input_state.mouse_y;
-    g_input_state.mouse_x = (i32) xpos;
-    g_input_state.mouse_y = (i32) ypos;
+    input_process_mouse_move((i16) xpos, (i16) ypos);
+}
+
+void char_callback(GLFWwindow *window, unsigned int codepoint) {
+    input_process_char(codepoint);
 }
 
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
-    // Update mouse wheel delta
-    g_input_state.mouse_wheel_delta += (i8) yoffset;
+    input_process_mouse_wheel((i8) yoffset);
 }
 
 void window_resize_callback(GLFWwindow *window, int width, int height) {
@@ -61,39 +73,6 @@ void window_resize_callback(GLFWwindow *window, int width, int height) {
     window_context.height = height;
 }
 
-
-// Input update is not needed as GLFW handles input in its event loop, but can be used for per-frame updates
-
-// Input API implementations
-VAPI b8 input_is_key_down(keys key) {
-    return g_input_state.keys[key];
-}
-
-VAPI b8 input_is_key_up(keys key) {
-    return !g_input_state.keys[key];
-}
-
-VAPI b8 input_is_button_down(buttons button) {
-    return g_input_state.buttons[button];
-}
-
-VAPI void input_get_mouse_position(i32 *x, i32 *y) {
-    *x = g_input_state.mouse_x;
-    *y = g_input_state.mouse_y;
-}
-
-VAPI b8 input_is_button_up(buttons button) {
-    return !g_input_state.buttons[button];
-}
-
-VAPI b8 input_is_key_pressed(keys key) {
-    return g_input_state.keys[key] && !g_input_state.prev_keys[key];
-}
-
-VAPI b8 input_is_key_released(keys key) {
-    return !g_input_state.keys[key] && g_input_state.prev_keys[key];
-}
-
 b8 window_initialize(const char *title, int width, int height) {
     NVGcontext *vg = NULL;
     if (!glfwInit()) {
@@ -143,27 +122,122 @@ b8 window_initialize(const char *title, int width, int height) {
     glfwSetMouseButtonCallback(window_context.window, mouse_button_callback);
     glfwSetCursorPosCallback(window_context.window, cursor_position_callback);
     glfwSetScrollCallback(window_context.window, scroll_callback);
+    glfwSetCharCallback(window_context.window, char_callback);
     glfwSetWindowSizeCallback(window_context.window, window_resize_callback);
+    if (!kmutex_create(&window_vg_lock)) {
+        verror("Failed to create the nanovg lock.");
+        return false;
+    }
+    // The context moves to the render thread, it can only be current on one thread at a time.
+    glfwMakeContextCurrent(null);
+    GuiFrameRenderer renderer = {window_render_thread_start, window_render, window_render_thread_stop};
+    if (!gui_frame_queue_start(&renderer, true)) return false;
     return true;
 }
 
+// Recreates the canvas when the frame size changed. Frames with a new size are composed in full, so the new canvas
+// is repainted right away.
+static void window_canvas_resize(int width, int height) {
+    if (window_canvas_width == width && window_canvas_height == height) return;
+    if (window_canvas) nvgluDeleteFramebuffer(window_canvas);
+    window_canvas = nvgluCreateFramebuffer(window_context.vg, width, height, 0);
+    if (window_canvas == null) verror("Failed to create the window canvas.");
+    window_canvas_width = width;
+    window_canvas_height = height;
+}
+
 void window_begin_frame() {
+    // Input is sampled once at the start of the frame, the scripts see the same snapshot for the whole update.
+    if (window_idle) {
+        // The window keeps showing the last frame, wait for input instead of spinning through empty frames.
+        glfwWaitEventsTimeout(WINDOW_IDLE_WAIT_SECONDS);
+    } else {
+        glfwPollEvents();
+    }
+    input_publish_snapshot();
     glfwGetFramebufferSize(window_context.window, &window_context.width, &window_context.height);
-    glViewport(0, 0, window_context.width, window_context.height);
+    if (window_frame_width != window_context.width || window_frame_height != window_context.height) {
+        window_frame_width = window_context.width;
+        window_frame_height = window_context.height;
+        gui_display_invalidate();
+    }
+}
+
+
+static void window_render_thread_start() {
+    glfwMakeContextCurrent(window_context.window);
+}
+
+static void window_render_thread_stop() {
+    glfwMakeContextCurrent(null);
+}
+
+// Repaints the damaged part of the canvas and shows it, runs on the render thread.
+static void window_render(GuiFrame *frame) {
+    int width = (int) frame->width, height = (int) frame->height;
+    const GuiRect *damage = &frame->damage;
+    int x0 = (int) damage->x, y0 = (int) damage->y;
+    int x1 = (int) (damage->x + damage->width + 0.999f), y1 = (int) (damage->y + damage->height + 0.999f);
+    kmutex_lock(&window_vg_lock);
+    window_canvas_resize(width, height);
+    // Without a canvas nothing survives the swap, every following frame has to be drawn in full.
+    if (window_canvas == null) gui_frame_request_invalidate();
+    nvgBeginFrame(window_context.vg, (f32) width, (f32) height, window_context.pixel_ratio);
+    nvgluBindFramebuffer(window_canvas);
+    glViewport(0, 0, width, height);
+    // GL's scissor origin is the bottom left corner, nanovg's is the top left one.
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x0, height - y1, x1 - x0, y1 - y0);
     // Clears a nice light purple color.
     glClearColor(0.694f, 0.282f, 0.823f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-    nvgBeginFrame(window_context.vg, window_context.width, window_context.height,window_context.width/window_context.height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    nvgScissor(window_context.vg, (f32) x0, (f32) y0, (f32) (x1 - x0), (f32) (y1 - y0));
+    gui_submit_batch(&frame->batch);
+    nvgEndFrame(window_context.vg);
+    kmutex_unlock(&window_vg_lock);
+    if (window_canvas) {
+        nvgluBindFramebuffer(null);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, window_canvas->fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    glfwSwapBuffers(window_context.window);
 }
 
 void window_end_frame() {
-    nvgEndFrame(window_context.vg);
-    glfwSwapBuffers(window_context.window);
+    // Composes into a free slot while the render thread may still be presenting the previous frame.
+    GuiFrame *frame = gui_frame_acquire();
+    if (frame && gui_display_compose(window_context.width, window_context.height, &frame->batch, &frame->damage)) {
+        frame->width = (u32) window_context.width;
+        frame->height = (u32) window_context.height;
+        gui_frame_submit(frame);
+        window_idle = false;
+    } else {
+        if (frame) gui_frame_discard(frame);
+        window_idle = true;
+    }
     input_reset(); // Reset input state after processing all events.
-    glfwPollEvents();
 }
 
 void window_shutdown() {
+    // Presents the frames still in flight and takes the context back from the render thread.
+    gui_frame_queue_stop();
+    glfwMakeContextCurrent(window_context.window);
+    kmutex_destroy(&window_vg_lock);
+    gui_display_shutdown();
+    gui_text_cache_shutdown();
+    if (glyph_positions) kfree(glyph_positions, glyph_positions_capacity * sizeof(NVGglyphPosition), MEMORY_TAG_UI);
+    glyph_positions = null;
+    glyph_positions_capacity = 0;
+    if (window_canvas) nvgluDeleteFramebuffer(window_canvas);
+    window_canvas = null;
+    window_canvas_width = 0;
+    window_canvas_height = 0;
+    window_frame_width = 0;
+    window_frame_height = 0;
+    window_idle = false;
     nvgDeleteGL3(window_context.vg);
     glfwDestroyWindow(window_context.window);
     glfwTerminate();
@@ -182,38 +256,133 @@ b8 window_should_close() {
 b8 gui_load_font(FsPath font_path, const char *font_name) {
     //load our fonts
     FsNode *font = vfs_node_get(font_path);
-    if (font == null) {
+    // Glyphs are looked up all over the font, reading ahead would only waste page cache.
+    vfs_node_advise(font, FS_ACCESS_RANDOM);
+    // nanovg borrows the font data in place instead of copying it, it must never be evicted.
+    if (font == null || !vfs_node_pin(font)) {
         verror("Failed to load font");
         return false;
     }
     char *font_data = font->data.file.data;
     u32 font_data_len = font->data.file.size;
+    kmutex_lock(&window_vg_lock);
     nvgCreateFontMem(window_context.vg, font_name, (unsigned char *) font_data, font_data_len, 0);
+    kmutex_unlock(&window_vg_lock);
+    // Text measured with a font of the same name is stale now.
+    gui_text_cache_clear();
     vdebug("Loaded font: %s", font_name)
     return true;
 }
 
-void gui_draw_text(const char *text, float x, float y, float size, const char *font_name, NVGcolor color) {
-    nvgFontSize(window_context.vg, size);
-    nvgFontFace(window_context.vg, font_name);
-    nvgFillColor(window_context.vg, color);
-    nvgText(window_context.vg, x, y, text, null);
+// Orders texts by the state they need, font first since switching it is the most expensive.
+static int gui_text_state_compare(const GuiCommand *a, const GuiCommand *b) {
+    if (a->text.font != b->text.font) {
+        int result = strcmp(a->text.font, b->text.font);
+        if (result != 0) return result;
+    }
+    if (a->text.size != b->text.size) return a->text.size < b->text.size ? -1 : 1;
+    if (a->color != b->color) return a->color < b->color ? -1 : 1;
+    return 0;
+}
+
+// Insertion sort keeps texts with the same state in submission order, runs are usually already grouped.
+static void gui_sort_text_run(GuiCommand *commands, u64 count) {
+    for (u64 i = 1; i < count; ++i) {
+        GuiCommand command = commands[i];
+        u64 j = i;
+        while (j > 0 && gui_text_state_compare(&commands[j - 1], &command) > 0) {
+            commands[j] = commands[j - 1];
+            j--;
+        }
+        commands[j] = command;
+    }
 }
 
-void gui_draw_rect(float x, float y, float width, float height, NVGcolor color) {
+// Fills consecutive rects of the same color as one path, returns the number of commands consumed.
+static u64 gui_draw_rect_run(const GuiCommand *commands, u64 count) {
+    u32 color = commands[0].color;
+    u64 i = 0;
     nvgBeginPath(window_context.vg);
-    nvgRect(window_context.vg, x, y, width, height);
-    nvgFillColor(window_context.vg, color);
+    while (i < count && commands[i].type == GUI_COMMAND_RECT && commands[i].color == color) {
+        nvgRect(window_context.vg, commands[i].x, commands[i].y, commands[i].rect.width, commands[i].rect.height);
+        i++;
+    }
+    nvgFillColor(window_context.vg, gui_unpack_color(color));
     nvgFill(window_context.vg);
+    return i;
+}
+
+// Draws a run of texts, only touching the font state when it changes. Returns the number of commands consumed.
+static u64 gui_draw_text_run(GuiCommand *commands, u64 count) {
+    u64 length = 0;
+    while (length < count && commands[length].type == GUI_COMMAND_TEXT) length++;
+    gui_sort_text_run(commands, length);
+    const char *font = null;
+    f32 size = -1.0f;
+    u32 color = 0;
+    b8 has_color = false;
+    for (u64 i = 0; i < length; ++i) {
+        const GuiCommand *command = &commands[i];
+        if (font == null || (font != command->text.font && strcmp(font, command->text.font) != 0)) {
+            font = command->text.font;
+            nvgFontFace(window_context.vg, font);
+        }
+        if (size != command->text.size) {
+            size = command->text.size;
+            nvgFontSize(window_context.vg, size);
+        }
+        if (!has_color || color != command->color) {
+            color = command->color;
+            has_color = true;
+            nvgFillColor(window_context.vg, gui_unpack_color(color));
+        }
+        nvgText(window_context.vg, command->x, command->y, command->text.value, null);
+    }
+    return length;
 }
 
-f32 gui_text_width(const char *text, const char *font_name, f32 size) {
+// Issues the commands to nanovg, merging same color rects and grouping texts by their font state.
+static void gui_submit_batch(GuiBatch *batch) {
+    u64 count = darray_length(batch->commands);
+    u64 i = 0;
+    while (i < count) {
+        GuiCommand *command = &batch->commands[i];
+        if (command->type == GUI_COMMAND_RECT) {
+            i += gui_draw_rect_run(command, count - i);
+        } else {
+            i += gui_draw_text_run(command, count - i);
+        }
+    }
+}
+
+u32 gui_measure_glyphs(const char *text, u64 length, const char *font_name, f32 size, GuiGlyph *out_glyphs,
+                       f32 *out_width) {
+    // Measuring may rasterize glyphs into the font atlas, which the render thread reads while it draws text.
+    kmutex_lock(&window_vg_lock);
     nvgFontSize(window_context.vg, size);
     nvgFontFace(window_context.vg, font_name);
-    return nvgTextBounds(window_context.vg, 0, 0, text, null, null);
+    *out_width = nvgTextBounds(window_context.vg, 0, 0, text, text + length, null);
+    if (out_glyphs == null || length == 0) {
+        kmutex_unlock(&window_vg_lock);
+        return 0;
+    }
+    if (glyph_positions_capacity < length) {
+        if (glyph_positions) kfree(glyph_positions, glyph_positions_capacity * sizeof(NVGglyphPosition), MEMORY_TAG_UI);
+        glyph_positions = kallocate(length * sizeof(NVGglyphPosition), MEMORY_TAG_UI);
+        glyph_positions_capacity = length;
+    }
+    int count = nvgTextGlyphPositions(window_context.vg, 0, 0, text, text + length, glyph_positions, (int) length);
+    for (int i = 0; i < count; ++i) {
+        out_glyphs[i].offset = (u32) (glyph_positions[i].str - text);
+        out_glyphs[i].x = glyph_positions[i].x;
+    }
+    kmutex_unlock(&window_vg_lock);
+    return (u32) count;
 }
 
 void window_get_size(u32 *width, u32 *height) {
     *width = window_context.width;
     *height = window_context.height;
 }
+
+#endif // VOS_HEADLESS
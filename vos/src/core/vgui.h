@@ -4,6 +4,7 @@
 #pragma once
 
 #include "defines.h"
+#ifndef VOS_HEADLESS
 #include "gl/glew.h"
 
 #define GLFW_INCLUDE_GLEXT
@@ -12,9 +13,23 @@
 #include "nanovg.h"
 
 #define NANOVG_GL3_IMPLEMENTATION
+#endif
 
 #include "kernel/kernel.h"
 
+#ifndef VOS_HEADLESS
+/**
+ * A color with float components from 0 to 1, nanovg's color so it can be passed straight to nanovg.
+ */
+typedef NVGcolor GuiColor;
+#else
+/**
+ * A color with float components from 0 to 1. Headless builds don't have nanovg, the layout matches its color.
+ */
+typedef struct GuiColor {
+    f32 r, g, b, a;
+} GuiColor;
+#endif
 
 /**
  * @class vos_context
@@ -24,12 +39,81 @@
  * It includes the GLFW window, NVGcontext, width, height, and pixel ratio of the application.
  */
 static struct window_context {
+#ifndef VOS_HEADLESS
     GLFWwindow *window; // The GLFW window.
     NVGcontext *vg; // The NanoVG context.
+#endif
     int width, height; // The width and height of the window.
     float pixel_ratio; // The pixel ratio of the window.
 } window_context;
 
+/**
+ * The kinds of commands a gui batch can hold.
+ */
+typedef enum GuiCommandType {
+    GUI_COMMAND_RECT = 1,
+    GUI_COMMAND_TEXT = 2,
+} GuiCommandType;
+
+/**
+ * A single recorded draw command. Colors are packed as 0xRRGGBBAA.
+ */
+typedef struct GuiCommand {
+    GuiCommandType type;
+    u32 color;
+    f32 x, y;
+    union {
+        struct {
+            f32 width, height;
+        } rect;
+        struct {
+            // Borrowed, the string must outlive the batch submission.
+            const char *value;
+            const char *font;
+            f32 size;
+        } text;
+    };
+} GuiCommand;
+
+/**
+ * A list of draw commands submitted to nanovg in one go.
+ *
+ * Consecutive rects of the same color are filled as a single path and consecutive texts are grouped by font, size and
+ * color so the font state is only set when it changes. Rects and texts are never reordered across each other, so
+ * layering between them is preserved.
+ */
+typedef struct GuiBatch {
+    // A darray of the recorded commands.
+    GuiCommand *commands;
+} GuiBatch;
+
+/**
+ * Packs the color components into a single 0xRRGGBBAA integer.
+ */
+static inline u32 gui_pack_color(u8 r, u8 g, u8 b, u8 a) {
+    return ((u32) r << 24) | ((u32) g << 16) | ((u32) b << 8) | (u32) a;
+}
+
+/**
+ * Unpacks a 0xRRGGBBAA integer into a gui color.
+ */
+static inline GuiColor gui_unpack_color(u32 color) {
+    GuiColor result;
+    result.r = (f32) ((color >> 24) & 0xFF) / 255.0f;
+    result.g = (f32) ((color >> 16) & 0xFF) / 255.0f;
+    result.b = (f32) ((color >> 8) & 0xFF) / 255.0f;
+    result.a = (f32) (color & 0xFF) / 255.0f;
+    return result;
+}
+
+/**
+ * Packs a gui color back into a 0xRRGGBBAA integer.
+ */
+static inline u32 gui_color_pack(GuiColor color) {
+    return gui_pack_color((u8) (color.r * 255.0f + 0.5f), (u8) (color.g * 255.0f + 0.5f),
+                          (u8) (color.b * 255.0f + 0.5f), (u8) (color.a * 255.0f + 0.5f));
+}
+
 
 /**
  * @brief Initializes the VOS context with the given parameters.
@@ -59,7 +143,8 @@ b8 window_initialize(const char *title, int width, int height);
 /**
  * @brief Starts a new frame for rendering.
  *
- * This function should be called at the beginning of each frame before any rendering calls are made.
+ * This function should be called at the beginning of each frame before any rendering calls are made. It polls the
+ * window events and publishes the input snapshot the frame's update sees.
  *
  * @param ctx A pointer to the vos_context struct representing the current application context.
  *
@@ -91,7 +176,7 @@ void window_get_size(u32  *width, u32 *height);
  * @brief Ends a frame in the vos_context.
  *
  * This function is used to end a frame in the vos_context.
- * It performs any necessary cleanup or operations required for ending the frame.
+ * It composes the frame and hands it to the render thread, which presents it while the next frame is updated.
  *
  * @param ctx The vos_context object.
  */
@@ -134,13 +219,13 @@ VAPI/**
  * @param font_name The name of the font to be used for drawing the text.
  * @param color     The color of the text to be drawn.
  */
-void gui_draw_text(const char *text, float x, float y, float size, const char *font_name, NVGcolor color);
+void gui_draw_text(const char *text, float x, float y, float size, const char *font_name, GuiColor color);
 
 VAPI/**
  * @brief Draws a rectangle on the GUI with the given coordinates, size, and color.
  *
  * This function is used to draw a rectangle on the GUI using the specified coordin*/
-void gui_draw_rect(float x, float y, float width, float height, NVGcolor color);
+void gui_draw_rect(float x, float y, float width, float height, GuiColor color);
 
 
 /**
@@ -152,4 +237,39 @@ void gui_draw_rect(float x, float y, float width, float height, NVGcolor color);
  *
  * @return The calculated width of the text string.
  */
-f32 gui_text_width(const char *text, const char *font_name, f32 size);
\ No newline at end of file
+f32 gui_text_width(const char *text, const char *font_name, f32 size);
+
+/**
+ * Creates an empty gui batch.
+ *
+ * @param out_batch The batch to initialize.
+ */
+VAPI void gui_batch_create(GuiBatch *out_batch);
+
+/**
+ * Destroys the batch and frees its command storage.
+ */
+VAPI void gui_batch_destroy(GuiBatch *batch);
+
+/**
+ * Removes all commands from the batch, keeping its storage for reuse.
+ */
+VAPI void gui_batch_clear(GuiBatch *batch);
+
+/**
+ * Records a filled rectangle.
+ */
+VAPI void gui_batch_rect(GuiBatch *batch, f32 x, f32 y, f32 width, f32 height, u32 color);
+
+/**
+ * Records a text draw. The text and font name are borrowed and must stay valid until the batch is drawn.
+ */
+VAPI void gui_batch_text(GuiBatch *batch, const char *text, f32 x, f32 y, f32 size, const char *font_name, u32 color);
+
+/**
+ * Draws every command of the batch this frame. The commands are copied into the frame's immediate layer, so the batch
+ * can be cleared and reused right away. Text runs are sorted by font, size and color when the frame is presented.
+ *
+ * @param batch The batch to draw.
+ */
+VAPI void gui_draw_batch(GuiBatch *batch);
@@ -0,0 +1,66 @@
+/**
+ * The gui batch and the immediate draw calls are shared by every backend, they only record into the display layer.
+ */
+#include "vgui.h"
+#include "vgui_display.h"
+#include "containers/darray.h"
+
+void gui_batch_create(GuiBatch *out_batch) {
+    out_batch->commands = darray_create(GuiCommand);
+}
+
+void gui_batch_destroy(GuiBatch *batch) {
+    if (batch->commands) {
+        darray_destroy(batch->commands)
+    }
+    batch->commands = null;
+}
+
+void gui_batch_clear(GuiBatch *batch) {
+    darray_clear(batch->commands);
+}
+
+void gui_batch_rect(GuiBatch *batch, f32 x, f32 y, f32 width, f32 height, u32 color) {
+    GuiCommand command;
+    command.type = GUI_COMMAND_RECT;
+    command.color = color;
+    command.x = x;
+    command.y = y;
+    command.rect.width = width;
+    command.rect.height = height;
+    darray_push(GuiCommand, batch->commands, command)
+}
+
+void gui_batch_text(GuiBatch *batch, const char *text, f32 x, f32 y, f32 size, const char *font_name, u32 color) {
+    GuiCommand command;
+    command.type = GUI_COMMAND_TEXT;
+    command.color = color;
+    command.x = x;
+    command.y = y;
+    command.text.value = text;
+    command.text.font = font_name;
+    command.text.size = size;
+    darray_push(GuiCommand, batch->commands, command)
+}
+
+void gui_draw_text(const char *text, float x, float y, float size, const char *font_name, GuiColor color) {
+    gui_display_record_text(text, x, y, size, font_name, gui_color_pack(color));
+}
+
+void gui_draw_rect(float x, float y, float width, float height, GuiColor color) {
+    gui_display_record_rect(x, y, width, height, gui_color_pack(color));
+}
+
+void gui_draw_batch(GuiBatch *batch) {
+    u64 count = darray_length(batch->commands);
+    for (u64 i = 0; i < count; ++i) {
+        const GuiCommand *command = &batch->commands[i];
+        if (command->type == GUI_COMMAND_RECT) {
+            gui_display_record_rect(command->x, command->y, command->rect.width, command->rect.height,
+                                    command->color);
+        } else {
+            gui_display_record_text(command->text.value, command->x, command->y, command->text.size,
+                                    command->text.font, command->color);
+        }
+    }
+}
@@ -0,0 +1,401 @@
+/**
+ * The retained gui layer and the compositor, see vgui_display.h.
+ */
+#include "vgui_display.h"
+#include <string.h>
+#include "vmem.h"
+#include "containers/darray.h"
+
+// The initial size of the buffer immediate text is copied into, it is doubled as needed.
+#define GUI_IMMEDIATE_TEXT_INITIAL_CAPACITY 4096
+// Nodes are padded by this many pixels so the antialiased fringe nanovg draws around shapes is repainted too.
+#define GUI_DISPLAY_FRINGE 1.0f
+// The height of text bounds relative to the font size, measured from the top of the tallest glyph down past the
+// deepest descender. Text is placed on its baseline, one font size below the top of its bounds.
+#define GUI_DISPLAY_TEXT_HEIGHT 1.5f
+
+// Where a recorded immediate text and its font were copied to in the text buffer.
+typedef struct GuiImmediateStrings {
+    u64 text;
+    u64 font;
+} GuiImmediateStrings;
+
+typedef struct GuiImmediateLayer {
+    // A darray of the commands recorded since the last frame was composed.
+    GuiCommand *commands;
+    // A darray with the string offsets of each command, unused for rects.
+    GuiImmediateStrings *strings;
+    // The recorded strings, copied so they outlive the lua strings they came from.
+    char *text;
+    u64 text_size;
+    u64 text_capacity;
+    // Set once the layer has been composed, the next recorded command starts a new frame.
+    b8 composed;
+    // Whether the last composed frame had immediate draws, they have to be erased in the next one.
+    b8 drawn_last_frame;
+} GuiImmediateLayer;
+
+static struct {
+    // A darray of the live display lists in compose order.
+    GuiDisplayList **lists;
+    GuiImmediateLayer immediate;
+    // Damage that doesn't belong to a live list, left behind by destroyed lists or from invalidating.
+    GuiRect damage;
+    b8 damaged;
+} compositor;
+
+static b8 gui_rect_empty(GuiRect rect) {
+    return rect.width <= 0 || rect.height <= 0;
+}
+
+static GuiRect gui_rect_union(GuiRect a, GuiRect b) {
+    f32 x0 = a.x < b.x ? a.x : b.x;
+    f32 y0 = a.y < b.y ? a.y : b.y;
+    f32 x1 = a.x + a.width > b.x + b.width ? a.x + a.width : b.x + b.width;
+    f32 y1 = a.y + a.height > b.y + b.height ? a.y + a.height : b.y + b.height;
+    GuiRect result = {x0, y0, x1 - x0, y1 - y0};
+    return result;
+}
+
+static GuiRect gui_rect_intersect(GuiRect a, GuiRect b) {
+    f32 x0 = a.x > b.x ? a.x : b.x;
+    f32 y0 = a.y > b.y ? a.y : b.y;
+    f32 x1 = a.x + a.width < b.x + b.width ? a.x + a.width : b.x + b.width;
+    f32 y1 = a.y + a.height < b.y + b.height ? a.y + a.height : b.y + b.height;
+    GuiRect result = {x0, y0, x1 - x0, y1 - y0};
+    return result;
+}
+
+static b8 gui_rect_overlaps(GuiRect a, GuiRect b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// Adds the rect to the damage tracked by the given flag, a single bounding rect keeps composing cheap.
+static void gui_damage_add(GuiRect *damage, b8 *damaged, GuiRect rect) {
+    if (gui_rect_empty(rect)) return;
+    *damage = *damaged ? gui_rect_union(*damage, rect) : rect;
+    *damaged = true;
+}
+
+static char *gui_display_copy_string(const char *value) {
+    u64 length = strlen(value) + 1;
+    char *copy = kallocate(length, MEMORY_TAG_UI);
+    kcopy_memory(copy, value, length);
+    return copy;
+}
+
+static void gui_display_free_string(const char *value) {
+    if (value) kfree((void *) value, strlen(value) + 1, MEMORY_TAG_UI);
+}
+
+// Frees the strings a text node owns, rect nodes own nothing.
+static void gui_display_node_clear(GuiDisplayNode *node) {
+    if (node->has_content && node->command.type == GUI_COMMAND_TEXT) {
+        gui_display_free_string(node->command.text.value);
+        gui_display_free_string(node->command.text.font);
+    }
+    node->has_content = false;
+}
+
+// Looks up a live node, null if the id is out of range or was destroyed.
+static GuiDisplayNode *gui_display_node_get(GuiDisplayList *list, u32 id) {
+    if (list == null || id == 0 || id > darray_length(list->nodes)) return null;
+    GuiDisplayNode *node = &list->nodes[id - 1];
+    return node->alive ? node : null;
+}
+
+// Damages the area the node covers, if it is drawn at all.
+static void gui_display_node_damage(GuiDisplayList *list, GuiDisplayNode *node) {
+    if (node->visible && node->has_content) gui_damage_add(&list->damage, &list->damaged, node->bounds);
+}
+
+GuiDisplayList *gui_display_list_create() {
+    GuiDisplayList *list = kallocate(sizeof(GuiDisplayList), MEMORY_TAG_UI);
+    list->nodes = darray_create(GuiDisplayNode);
+    list->order = darray_create(u32);
+    list->free_ids = darray_create(u32);
+    list->damaged = false;
+    if (compositor.lists == null) compositor.lists = darray_create(GuiDisplayList *);
+    darray_push(GuiDisplayList *, compositor.lists, list)
+    return list;
+}
+
+void gui_display_list_destroy(GuiDisplayList *list) {
+    if (list == null) return;
+    u64 order_count = darray_length(list->order);
+    for (u64 i = 0; i < order_count; ++i) {
+        GuiDisplayNode *node = &list->nodes[list->order[i] - 1];
+        gui_display_node_damage(list, node);
+        gui_display_node_clear(node);
+    }
+    // The list is going away, its damage has to outlive it so the area is repainted without it.
+    if (list->damaged) gui_damage_add(&compositor.damage, &compositor.damaged, list->damage);
+    u64 list_count = compositor.lists ? darray_length(compositor.lists) : 0;
+    for (u64 i = 0; i < list_count; ++i) {
+        if (compositor.lists[i] != list) continue;
+        memmove(&compositor.lists[i], &compositor.lists[i + 1], (list_count - i - 1) * sizeof(GuiDisplayList *));
+        darray_length_set(compositor.lists, list_count - 1);
+        break;
+    }
+    darray_destroy(list->nodes)
+    darray_destroy(list->order)
+    darray_destroy(list->free_ids)
+    kfree(list, sizeof(GuiDisplayList), MEMORY_TAG_UI);
+}
+
+u32 gui_display_node_create(GuiDisplayList *list) {
+    u32 id;
+    if (darray_length(list->free_ids) > 0) {
+        darray_pop(list->free_ids, &id);
+    } else {
+        GuiDisplayNode empty = {0};
+        darray_push(GuiDisplayNode, list->nodes, empty)
+        id = (u32) darray_length(list->nodes);
+    }
+    GuiDisplayNode *node = &list->nodes[id - 1];
+    kzero_memory(node, sizeof(GuiDisplayNode));
+    node->alive = true;
+    node->visible = true;
+    darray_push(u32, list->order, id)
+    return id;
+}
+
+// Takes the id out of the draw order.
+static void gui_display_order_remove(GuiDisplayList *list, u32 id) {
+    u64 order_count = darray_length(list->order);
+    for (u64 i = 0; i < order_count; ++i) {
+        if (list->order[i] != id) continue;
+        memmove(&list->order[i], &list->order[i + 1], (order_count - i - 1) * sizeof(u32));
+        darray_length_set(list->order, order_count - 1);
+        return;
+    }
+}
+
+b8 gui_display_node_destroy(GuiDisplayList *list, u32 id) {
+    GuiDisplayNode *node = gui_display_node_get(list, id);
+    if (node == null) return false;
+    gui_display_node_damage(list, node);
+    gui_display_node_clear(node);
+    node->alive = false;
+    gui_display_order_remove(list, id);
+    darray_push(u32, list->free_ids, id)
+    return true;
+}
+
+b8 gui_display_node_raise(GuiDisplayList *list, u32 id) {
+    GuiDisplayNode *node = gui_display_node_get(list, id);
+    if (node == null) return false;
+    u64 order_count = darray_length(list->order);
+    if (list->order[order_count - 1] == id) return true;
+    gui_display_order_remove(list, id);
+    darray_push(u32, list->order, id)
+    gui_display_node_damage(list, node);
+    return true;
+}
+
+b8 gui_display_node_set_rect(GuiDisplayList *list, u32 id, f32 x, f32 y, f32 width, f32 height, u32 color) {
+    GuiDisplayNode *node = gui_display_node_get(list, id);
+    if (node == null) return false;
+    GuiCommand *command = &node->command;
+    if (node->has_content && command->type == GUI_COMMAND_RECT && command->x == x && command->y == y &&
+        command->rect.width == width && command->rect.height == height && command->color == color) {
+        return true;
+    }
+    gui_display_node_damage(list, node);
+    gui_display_node_clear(node);
+    command->type = GUI_COMMAND_RECT;
+    command->color = color;
+    command->x = x;
+    command->y = y;
+    command->rect.width = width;
+    command->rect.height = height;
+    node->bounds.x = x - GUI_DISPLAY_FRINGE;
+    node->bounds.y = y - GUI_DISPLAY_FRINGE;
+    node->bounds.width = width + GUI_DISPLAY_FRINGE * 2;
+    node->bounds.height = height + GUI_DISPLAY_FRINGE * 2;
+    node->has_content = true;
+    gui_display_node_damage(list, node);
+    return true;
+}
+
+b8 gui_display_node_set_text(GuiDisplayList *list, u32 id, const char *text, f32 x, f32 y, f32 size,
+                             const char *font_name, u32 color) {
+    GuiDisplayNode *node = gui_display_node_get(list, id);
+    if (node == null) return false;
+    GuiCommand *command = &node->command;
+    b8 is_text = node->has_content && command->type == GUI_COMMAND_TEXT;
+    if (is_text && command->x == x && command->y == y && command->text.size == size && command->color == color &&
+        strcmp(command->text.value, text) == 0 && strcmp(command->text.font, font_name) == 0) {
+        return true;
+    }
+    gui_display_node_damage(list, node);
+    // Keep the copies that didn't change, moving text usually keeps both strings.
+    const char *value = is_text && strcmp(command->text.value, text) == 0 ? command->text.value : null;
+    const char *font = is_text && strcmp(command->text.font, font_name) == 0 ? command->text.font : null;
+    if (is_text) {
+        if (value == null) gui_display_free_string(command->text.value);
+        if (font == null) gui_display_free_string(command->text.font);
+    } else {
+        gui_display_node_clear(node);
+    }
+    command->type = GUI_COMMAND_TEXT;
+    command->color = color;
+    command->x = x;
+    command->y = y;
+    command->text.value = value ? value : gui_display_copy_string(text);
+    command->text.font = font ? font : gui_display_copy_string(font_name);
+    command->text.size = size;
+    node->bounds.x = x - GUI_DISPLAY_FRINGE;
+    node->bounds.y = y - size - GUI_DISPLAY_FRINGE;
+    node->bounds.width = gui_text_width(text, font_name, size) + GUI_DISPLAY_FRINGE * 2;
+    node->bounds.height = size * GUI_DISPLAY_TEXT_HEIGHT + GUI_DISPLAY_FRINGE * 2;
+    node->has_content = true;
+    gui_display_node_damage(list, node);
+    return true;
+}
+
+b8 gui_display_node_set_visible(GuiDisplayList *list, u32 id, b8 visible) {
+    GuiDisplayNode *node = gui_display_node_get(list, id);
+    if (node == null) return false;
+    if (node->visible == visible) return true;
+    // Damage whichever state draws the node.
+    gui_display_node_damage(list, node);
+    node->visible = visible;
+    gui_display_node_damage(list, node);
+    return true;
+}
+
+// Drops the commands of the composed frame before the first command of the next one is recorded.
+static void gui_immediate_begin_record() {
+    GuiImmediateLayer *immediate = &compositor.immediate;
+    if (immediate->commands == null) {
+        immediate->commands = darray_create(GuiCommand);
+        immediate->strings = darray_create(GuiImmediateStrings);
+    }
+    if (immediate->composed) {
+        darray_clear(immediate->commands);
+        darray_clear(immediate->strings);
+        immediate->text_size = 0;
+        immediate->composed = false;
+    }
+}
+
+// Copies the string into the text buffer, returns its offset.
+static u64 gui_immediate_copy_text(const char *text) {
+    GuiImmediateLayer *immediate = &compositor.immediate;
+    u64 length = strlen(text) + 1;
+    if (immediate->text_size + length > immediate->text_capacity) {
+        u64 capacity = immediate->text_capacity ? immediate->text_capacity : GUI_IMMEDIATE_TEXT_INITIAL_CAPACITY;
+        while (immediate->text_size + length > capacity) capacity *= 2;
+        char *buffer = kallocate(capacity, MEMORY_TAG_UI);
+        if (immediate->text) {
+            kcopy_memory(buffer, immediate->text, immediate->text_size);
+            kfree(immediate->text, immediate->text_capacity, MEMORY_TAG_UI);
+        }
+        immediate->text = buffer;
+        immediate->text_capacity = capacity;
+    }
+    u64 offset = immediate->text_size;
+    kcopy_memory(immediate->text + offset, text, length);
+    immediate->text_size += length;
+    return offset;
+}
+
+void gui_display_record_rect(f32 x, f32 y, f32 width, f32 height, u32 color) {
+    gui_immediate_begin_record();
+    GuiCommand command;
+    command.type = GUI_COMMAND_RECT;
+    command.color = color;
+    command.x = x;
+    command.y = y;
+    command.rect.width = width;
+    command.rect.height = height;
+    GuiImmediateStrings strings = {0, 0};
+    darray_push(GuiCommand, compositor.immediate.commands, command)
+    darray_push(GuiImmediateStrings, compositor.immediate.strings, strings)
+}
+
+void gui_display_record_text(const char *text, f32 x, f32 y, f32 size, const char *font_name, u32 color) {
+    gui_immediate_begin_record();
+    GuiCommand command;
+    command.type = GUI_COMMAND_TEXT;
+    command.color = color;
+    command.x = x;
+    command.y = y;
+    command.text.value = null;
+    command.text.font = null;
+    command.text.size = size;
+    GuiImmediateStrings strings;
+    strings.text = gui_immediate_copy_text(text);
+    strings.font = gui_immediate_copy_text(font_name);
+    darray_push(GuiCommand, compositor.immediate.commands, command)
+    darray_push(GuiImmediateStrings, compositor.immediate.strings, strings)
+}
+
+void gui_display_invalidate() {
+    // Larger than any window, composing clips it to the screen.
+    GuiRect everything = {0, 0, 1e9f, 1e9f};
+    gui_damage_add(&compositor.damage, &compositor.damaged, everything);
+}
+
+b8 gui_display_compose(u32 width, u32 height, GuiBatch *out_batch, GuiRect *out_damage) {
+    GuiImmediateLayer *immediate = &compositor.immediate;
+    // A layer that was composed already holds last frame's commands, nothing was recorded since.
+    u64 immediate_count = immediate->commands && !immediate->composed ? darray_length(immediate->commands) : 0;
+    GuiRect damage = compositor.damage;
+    b8 damaged = compositor.damaged;
+    compositor.damaged = false;
+    u64 list_count = compositor.lists ? darray_length(compositor.lists) : 0;
+    for (u64 i = 0; i < list_count; ++i) {
+        GuiDisplayList *list = compositor.lists[i];
+        if (!list->damaged) continue;
+        gui_damage_add(&damage, &damaged, list->damage);
+        list->damaged = false;
+    }
+    GuiRect screen = {0, 0, (f32) width, (f32) height};
+    if (immediate_count > 0 || immediate->drawn_last_frame) {
+        damage = screen;
+        damaged = true;
+    }
+    immediate->drawn_last_frame = immediate_count > 0;
+    immediate->composed = true;
+    gui_batch_clear(out_batch);
+    if (!damaged) return false;
+    damage = gui_rect_intersect(damage, screen);
+    if (gui_rect_empty(damage)) return false;
+    for (u64 i = 0; i < list_count; ++i) {
+        GuiDisplayList *list = compositor.lists[i];
+        u64 order_count = darray_length(list->order);
+        for (u64 j = 0; j < order_count; ++j) {
+            GuiDisplayNode *node = &list->nodes[list->order[j] - 1];
+            if (!node->visible || !node->has_content || !gui_rect_overlaps(node->bounds, damage)) continue;
+            darray_push(GuiCommand, out_batch->commands, node->command)
+        }
+    }
+    for (u64 i = 0; i < immediate_count; ++i) {
+        GuiCommand command = immediate->commands[i];
+        if (command.type == GUI_COMMAND_TEXT) {
+            // The text buffer may have moved since the command was recorded, resolve the offsets now.
+            command.text.value = immediate->text + immediate->strings[i].text;
+            command.text.font = immediate->text + immediate->strings[i].font;
+        }
+        darray_push(GuiCommand, out_batch->commands, command)
+    }
+    *out_damage = damage;
+    return true;
+}
+
+void gui_display_shutdown() {
+    // The lists belong to their processes, which are destroyed after the window. Destroying a list that is no longer
+    // registered only frees it.
+    if (compositor.lists) {
+        darray_destroy(compositor.lists)
+    }
+    GuiImmediateLayer *immediate = &compositor.immediate;
+    if (immediate->commands) {
+        darray_destroy(immediate->commands)
+        darray_destroy(immediate->strings)
+    }
+    if (immediate->text) kfree(immediate->text, immediate->text_capacity, MEMORY_TAG_UI);
+    kzero_memory(&compositor, sizeof(compositor));
+}
@@ -0,0 +1,146 @@
+/**
+ * The retained gui layer, shared by every backend.
+ *
+ * Each process owns a display list of nodes with stable ids. Setting a node to the state it already has is free, only
+ * real changes damage the screen: the old and the new bounds of a changed node are added to the list's damaged rect.
+ * Once per frame the backend composes the lists, when nothing was damaged and no immediate draw calls were made the
+ * frame is skipped entirely, otherwise only the damaged rect is cleared and redrawn.
+ *
+ * Immediate draw calls (gui_draw_rect, gui_draw_text and gui_draw_batch) are recorded into an immediate layer that is
+ * drawn above the display lists. They have no identity to diff, so a frame with immediate draws, or the frame after
+ * one, redraws the whole screen.
+ */
+#pragma once
+
+#include "vgui.h"
+
+/**
+ * An axis aligned rectangle in window pixels.
+ */
+typedef struct GuiRect {
+    f32 x, y;
+    f32 width, height;
+} GuiRect;
+
+/**
+ * A node of a display list. Text nodes own copies of their text and font name.
+ */
+typedef struct GuiDisplayNode {
+    GuiCommand command;
+    // The area the node covers on screen, text is measured when it changes.
+    GuiRect bounds;
+    // False for ids that are free to be reused.
+    b8 alive;
+    // Hidden nodes and nodes without content yet are kept but not drawn.
+    b8 visible;
+    b8 has_content;
+} GuiDisplayNode;
+
+/**
+ * The retained nodes of a single process, drawn in the order they were created.
+ */
+typedef struct GuiDisplayList {
+    // A darray of nodes indexed by id - 1, ids start at 1 so 0 is never a valid id.
+    GuiDisplayNode *nodes;
+    // A darray of the live ids in draw order.
+    u32 *order;
+    // A darray of the ids of destroyed nodes, reused before new ones are handed out.
+    u32 *free_ids;
+    // The union of everything that changed since the list was last composed.
+    GuiRect damage;
+    b8 damaged;
+} GuiDisplayList;
+
+/**
+ * Creates an empty display list and adds it to the compositor. Lists are composed in the order they were created.
+ *
+ * @return The new display list.
+ */
+VAPI GuiDisplayList *gui_display_list_create();
+
+/**
+ * Removes the list from the compositor and frees it and its nodes. The area its nodes covered is redrawn.
+ *
+ * @param list The list to destroy.
+ */
+VAPI void gui_display_list_destroy(GuiDisplayList *list);
+
+/**
+ * Creates a node without content, it isn't drawn until it is given a rect or text.
+ *
+ * @param list The list to add the node to.
+ *
+ * @return The id of the node, stable until the node is destroyed.
+ */
+VAPI u32 gui_display_node_create(GuiDisplayList *list);
+
+/**
+ * Destroys the node, damaging the area it covered.
+ *
+ * @return False if the id doesn't refer to a live node.
+ */
+VAPI b8 gui_display_node_destroy(GuiDisplayList *list, u32 id);
+
+/**
+ * Makes the node a filled rectangle. Nothing is damaged when the node already is this exact rectangle.
+ *
+ * @return False if the id doesn't refer to a live node.
+ */
+VAPI b8 gui_display_node_set_rect(GuiDisplayList *list, u32 id, f32 x, f32 y, f32 width, f32 height, u32 color);
+
+/**
+ * Makes the node a text, positioned on its baseline like gui_draw_text. Nothing is damaged when the node already is
+ * this exact text.
+ *
+ * @return False if the id doesn't refer to a live node.
+ */
+VAPI b8 gui_display_node_set_text(GuiDisplayList *list, u32 id, const char *text, f32 x, f32 y, f32 size,
+                                  const char *font_name, u32 color);
+
+/**
+ * Shows or hides the node without losing its content.
+ *
+ * @return False if the id doesn't refer to a live node.
+ */
+VAPI b8 gui_display_node_set_visible(GuiDisplayList *list, u32 id, b8 visible);
+
+/**
+ * Moves the node above every other node of its list.
+ *
+ * @return False if the id doesn't refer to a live node.
+ */
+VAPI b8 gui_display_node_raise(GuiDisplayList *list, u32 id);
+
+/**
+ * Records an immediate rect, drawn above the display lists this frame only.
+ */
+void gui_display_record_rect(f32 x, f32 y, f32 width, f32 height, u32 color);
+
+/**
+ * Records an immediate text, drawn above the display lists this frame only. The text and font are copied.
+ */
+void gui_display_record_text(const char *text, f32 x, f32 y, f32 size, const char *font_name, u32 color);
+
+/**
+ * Damages the whole screen, used by the backends when the window is resized or its contents are lost.
+ */
+void gui_display_invalidate();
+
+/**
+ * Collects the damage of the frame and builds the commands that repaint it: every visible node intersecting the
+ * damaged rect, followed by the immediate layer. The commands point into the lists and the immediate layer and stay
+ * valid until a node changes or the next immediate draw call is made.
+ *
+ * @param width The width of the screen.
+ * @param height The height of the screen.
+ * @param out_batch The batch the commands are written to, it is cleared first.
+ * @param out_damage The area that has to be cleared and redrawn.
+ *
+ * @return False if nothing changed and the frame can be skipped.
+ */
+b8 gui_display_compose(u32 width, u32 height, GuiBatch *out_batch, GuiRect *out_damage);
+
+/**
+ * Frees the immediate layer and unregisters every display list, the lists themselves are freed by their owners.
+ */
+void gui_display_shutdown();
@@ -0,0 +1,165 @@
+/**
+ * The frame queue between the update and the render thread, see vgui_frame.h.
+ */
+#include "vgui_frame.h"
+#include <string.h>
+#include "vlogger.h"
+#include "vmem.h"
+#include "vmutex.h"
+#include "vsemaphore.h"
+#include "vthread.h"
+#include "containers/darray.h"
+
+typedef struct GuiFrameQueue {
+    GuiFrame slots[GUI_FRAME_SLOTS];
+    GuiFrameRenderer renderer;
+    // Counts the slots that can be acquired and the submitted slots waiting for the render thread.
+    vsemaphore free;
+    vsemaphore ready;
+    // The next slot the update thread composes into and the next one the render thread renders.
+    u32 write_index;
+    u32 read_index;
+    kthread thread;
+    b8 threaded;
+    b8 running;
+    // Guards invalidate, it is set from either thread.
+    kmutex lock;
+    b8 invalidate;
+} GuiFrameQueue;
+
+static GuiFrameQueue *frame_queue = null;
+
+static u32 gui_frame_render_thread(void *params) {
+    if (frame_queue->renderer.thread_start) frame_queue->renderer.thread_start();
+    while (true) {
+        vsemaphore_wait(&frame_queue->ready, 0);
+        // Stopping is only signalled once every submitted frame has been rendered.
+        if (!frame_queue->running) break;
+        GuiFrame *frame = &frame_queue->slots[frame_queue->read_index];
+        frame_queue->read_index = (frame_queue->read_index + 1) % GUI_FRAME_SLOTS;
+        frame_queue->renderer.render(frame);
+        vsemaphore_signal(&frame_queue->free);
+    }
+    if (frame_queue->renderer.thread_stop) frame_queue->renderer.thread_stop();
+    return 0;
+}
+
+b8 gui_frame_queue_start(const GuiFrameRenderer *renderer, b8 threaded) {
+    if (frame_queue) return true;
+    frame_queue = kallocate(sizeof(GuiFrameQueue), MEMORY_TAG_RENDERER);
+    frame_queue->renderer = *renderer;
+    for (u32 i = 0; i < GUI_FRAME_SLOTS; ++i) gui_batch_create(&frame_queue->slots[i].batch);
+    if (!kmutex_create(&frame_queue->lock) ||
+        !vsemaphore_create(&frame_queue->free, GUI_FRAME_SLOTS, GUI_FRAME_SLOTS) ||
+        !vsemaphore_create(&frame_queue->ready, GUI_FRAME_SLOTS + 1, 0)) {
+        verror("Failed to create the gui frame queue.");
+        gui_frame_queue_stop();
+        return false;
+    }
+    frame_queue->running = true;
+    if (threaded) {
+        frame_queue->threaded = kthread_create(gui_frame_render_thread, null, false, &frame_queue->thread);
+        if (!frame_queue->threaded) vwarn("Failed to start the render thread, frames are rendered on submit");
+    }
+    if (!frame_queue->threaded && renderer->thread_start) renderer->thread_start();
+    return true;
+}
+
+void gui_frame_queue_stop() {
+    if (frame_queue == null) return;
+    if (frame_queue->running) {
+        gui_frame_flush();
+        frame_queue->running = false;
+        if (frame_queue->threaded) {
+            vsemaphore_signal(&frame_queue->ready);
+            kthread_wait(&frame_queue->thread);
+            kthread_destroy(&frame_queue->thread);
+        } else if (frame_queue->renderer.thread_stop) {
+            frame_queue->renderer.thread_stop();
+        }
+    }
+    for (u32 i = 0; i < GUI_FRAME_SLOTS; ++i) {
+        GuiFrame *frame = &frame_queue->slots[i];
+        gui_batch_destroy(&frame->batch);
+        if (frame->strings) kfree(frame->strings, frame->strings_capacity, MEMORY_TAG_RENDERER);
+    }
+    vsemaphore_destroy(&frame_queue->free);
+    vsemaphore_destroy(&frame_queue->ready);
+    kmutex_destroy(&frame_queue->lock);
+    kfree(frame_queue, sizeof(GuiFrameQueue), MEMORY_TAG_RENDERER);
+    frame_queue = null;
+}
+
+GuiFrame *gui_frame_acquire() {
+    if (frame_queue == null || !frame_queue->running) return null;
+    vsemaphore_wait(&frame_queue->free, 0);
+    kmutex_lock(&frame_queue->lock);
+    b8 invalidate = frame_queue->invalidate;
+    frame_queue->invalidate = false;
+    kmutex_unlock(&frame_queue->lock);
+    if (invalidate) gui_display_invalidate();
+    return &frame_queue->slots[frame_queue->write_index];
+}
+
+// Copies the strings the text commands borrow from the display lists into the frame and points the commands at them.
+static void gui_frame_own_strings(GuiFrame *frame) {
+    u64 count = darray_length(frame->batch.commands);
+    u64 size = 0;
+    for (u64 i = 0; i < count; ++i) {
+        const GuiCommand *command = &frame->batch.commands[i];
+        if (command->type != GUI_COMMAND_TEXT) continue;
+        size += strlen(command->text.value) + strlen(command->text.font) + 2;
+    }
+    if (size > frame->strings_capacity) {
+        if (frame->strings) kfree(frame->strings, frame->strings_capacity, MEMORY_TAG_RENDERER);
+        u64 capacity = frame->strings_capacity ? frame->strings_capacity : 256;
+        while (capacity < size) capacity *= 2;
+        frame->strings = kallocate(capacity, MEMORY_TAG_RENDERER);
+        frame->strings_capacity = capacity;
+    }
+    char *cursor = frame->strings;
+    for (u64 i = 0; i < count; ++i) {
+        GuiCommand *command = &frame->batch.commands[i];
+        if (command->type != GUI_COMMAND_TEXT) continue;
+        u64 length = strlen(command->text.value) + 1;
+        kcopy_memory(cursor, command->text.value, length);
+        command->text.value = cursor;
+        cursor += length;
+        length = strlen(command->text.font) + 1;
+        kcopy_memory(cursor, command->text.font, length);
+        command->text.font = cursor;
+        cursor += length;
+    }
+}
+
+void gui_frame_submit(GuiFrame *frame) {
+    gui_frame_own_strings(frame);
+    frame_queue->write_index = (frame_queue->write_index + 1) % GUI_FRAME_SLOTS;
+    if (frame_queue->threaded) {
+        vsemaphore_signal(&frame_queue->ready);
+        return;
+    }
+    frame_queue->renderer.render(frame);
+    vsemaphore_signal(&frame_queue->free);
+}
+
+void gui_frame_discard(GuiFrame *frame) {
+    vsemaphore_signal(&frame_queue->free);
+}
+
+void gui_frame_flush() {
+    if (frame_queue == null || !frame_queue->running) return;
+    // Only the update thread acquires, holding every slot means the render thread has nothing left to render.
+    for (u32 i = 0; i < GUI_FRAME_SLOTS; ++i) vsemaphore_wait(&frame_queue->free, 0);
+    for (u32 i = 0; i < GUI_FRAME_SLOTS; ++i) vsemaphore_signal(&frame_queue->free);
+}
+
+void gui_frame_request_invalidate() {
+    if (frame_queue == null) {
+        gui_display_invalidate();
+        return;
+    }
+    kmutex_lock(&frame_queue->lock);
+    frame_queue->invalidate = true;
+    kmutex_unlock(&frame_queue->lock);
+}
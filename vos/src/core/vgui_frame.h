@@ -0,0 +1,91 @@
+/**
+ * Hands composed frames from the update thread to the render thread.
+ *
+ * The update thread runs the scripts and composes frame N+1 while the render thread submits frame N to the backend
+ * and waits on the swap, so script time and present time overlap instead of adding up. Frames live in a small ring
+ * of slots: the update thread acquires a free slot, composes into it and submits it, the render thread renders the
+ * submitted slots in order and hands them back. A frame owns copies of every string its commands use, so nodes can
+ * change while it is being rendered.
+ *
+ * The queue doesn't know about GL or nanovg, both backends plug in a renderer. Without a render thread, frames are
+ * rendered on submit.
+ */
+#pragma once
+
+#include "vgui_display.h"
+
+// The number of frame slots. Two lets the update thread compose one frame ahead of the one being rendered.
+#define GUI_FRAME_SLOTS 2
+
+/**
+ * A composed frame, ready to be rendered.
+ */
+typedef struct GuiFrame {
+    // The commands repainting the damaged area, text commands point into strings.
+    GuiBatch batch;
+    // The text and font strings of the commands, copied on submit.
+    char *strings;
+    u64 strings_capacity;
+    // The area the commands repaint.
+    GuiRect damage;
+    // The screen size the frame was composed for.
+    u32 width;
+    u32 height;
+} GuiFrame;
+
+/**
+ * The backend side of the queue. Every callback runs on the render thread.
+ */
+typedef struct GuiFrameRenderer {
+    // Called once before the first frame, e.g. to make a context current on the thread. Optional.
+    void (*thread_start)(void);
+    // Renders a frame.
+    void (*render)(GuiFrame *frame);
+    // Called once after the last frame. Optional.
+    void (*thread_stop)(void);
+} GuiFrameRenderer;
+
+/**
+ * Creates the frame slots and starts the render thread.
+ *
+ * @param renderer The renderer, copied.
+ * @param threaded Whether frames are rendered on their own thread. If false, or if the thread can't be started,
+ * frames are rendered on submit.
+ *
+ * @return False if the queue couldn't be created.
+ */
+b8 gui_frame_queue_start(const GuiFrameRenderer *renderer, b8 threaded);
+
+/**
+ * Renders every submitted frame, stops the render thread and frees the slots.
+ */
+void gui_frame_queue_stop();
+
+/**
+ * Gets a free slot to compose the next frame into, waiting for the render thread if every slot is in use. Damage
+ * requested with gui_frame_request_invalidate is applied to the compositor here.
+ *
+ * @return The slot, null if the queue isn't running.
+ */
+GuiFrame *gui_frame_acquire();
+
+/**
+ * Copies the strings of the frame's commands into the frame and hands it to the render thread.
+ */
+void gui_frame_submit(GuiFrame *frame);
+
+/**
+ * Gives back an acquired slot without rendering it, used when the frame can be skipped.
+ */
+void gui_frame_discard(GuiFrame *frame);
+
+/**
+ * Waits until every submitted frame has been rendered.
+ */
+void gui_frame_flush();
+
+/**
+ * Repaints the whole screen in the next acquired frame. Safe to call from the render thread, e.g. when the render
+ * target was recreated and lost its contents.
+ */
+void gui_frame_request_invalidate();
@@ -0,0 +1,283 @@
+/**
+ * The headless gui backend, see vgui_headless.h.
+ */
+#include "vgui_headless.h"
+
+#ifdef VOS_HEADLESS
+
+#include <stdio.h>
+#include <string.h>
+#include "vlogger.h"
+#include "vmem.h"
+#include "vinput.h"
+#include "vgui_display.h"
+#include "vgui_text.h"
+#include "vgui_frame.h"
+#include "containers/darray.h"
+
+// The advance of a glyph cell relative to the font size, matches the bundled monospace font.
+#define HEADLESS_GLYPH_ADVANCE 0.6f
+// The height of a glyph box above the baseline relative to the font size.
+#define HEADLESS_GLYPH_ASCENT 0.7f
+// The clear color of the framebuffer, the same light purple the windowed backend clears to.
+#define HEADLESS_CLEAR_COLOR 0xB148D2FF
+
+typedef struct HeadlessState {
+    // The last frame handed to the render thread, null when the frame was skipped.
+    GuiFrame *frame;
+    // The area the last frame repainted.
+    GuiRect damage;
+    // The size the last frame was composed for, a new size repaints the whole screen.
+    u32 frame_width;
+    u32 frame_height;
+    // The rasterized frame as 8 bit RGB, null unless rasterizing is enabled. It keeps its contents between frames,
+    // only the damaged area is repainted. Written by the render thread.
+    u8 *framebuffer;
+    u32 framebuffer_width;
+    u32 framebuffer_height;
+    // Pixels outside of this rect are never written, set to the damaged area while a frame is rasterized.
+    i32 clip_x0, clip_y0, clip_x1, clip_y1;
+    b8 rasterize;
+    u64 frame_limit;
+    u64 frame_count;
+} HeadlessState;
+
+static HeadlessState headless;
+
+static void headless_framebuffer_resize(u32 width, u32 height) {
+    if (headless.framebuffer && headless.framebuffer_width == width && headless.framebuffer_height == height) return;
+    if (headless.framebuffer) {
+        kfree(headless.framebuffer, (u64) headless.framebuffer_width * headless.framebuffer_height * 3,
+              MEMORY_TAG_RENDERER);
+    }
+    headless.framebuffer = kallocate((u64) width * height * 3, MEMORY_TAG_RENDERER);
+    headless.framebuffer_width = width;
+    headless.framebuffer_height = height;
+}
+
+static void headless_framebuffer_destroy() {
+    if (!headless.framebuffer) return;
+    kfree(headless.framebuffer, (u64) headless.framebuffer_width * headless.framebuffer_height * 3,
+          MEMORY_TAG_RENDERER);
+    headless.framebuffer = null;
+    headless.framebuffer_width = 0;
+    headless.framebuffer_height = 0;
+}
+
+// Blends a solid color over the pixels covered by the rectangle, pixels are covered when their center is inside.
+static void headless_fill_rect(f32 x, f32 y, f32 width, f32 height, u32 color) {
+    if (!headless.framebuffer || width <= 0 || height <= 0) return;
+    i32 x0 = (i32) (x + 0.5f), y0 = (i32) (y + 0.5f);
+    i32 x1 = (i32) (x + width + 0.5f), y1 = (i32) (y + height + 0.5f);
+    if (x0 < headless.clip_x0) x0 = headless.clip_x0;
+    if (y0 < headless.clip_y0) y0 = headless.clip_y0;
+    if (x1 > headless.clip_x1) x1 = headless.clip_x1;
+    if (y1 > headless.clip_y1) y1 = headless.clip_y1;
+    u32 alpha = color & 0xFF;
+    if (alpha == 0) return;
+    u32 r = (color >> 24) & 0xFF, g = (color >> 16) & 0xFF, b = (color >> 8) & 0xFF;
+    for (i32 row = y0; row < y1; ++row) {
+        u8 *pixel = headless.framebuffer + ((u64) row * headless.framebuffer_width + x0) * 3;
+        for (i32 column = x0; column < x1; ++column, pixel += 3) {
+            pixel[0] = (u8) ((r * alpha + pixel[0] * (255 - alpha) + 127) / 255);
+            pixel[1] = (u8) ((g * alpha + pixel[1] * (255 - alpha) + 127) / 255);
+            pixel[2] = (u8) ((b * alpha + pixel[2] * (255 - alpha) + 127) / 255);
+        }
+    }
+}
+
+// Draws every visible glyph as a box filling most of its cell, the text is positioned on its baseline like nanovg.
+static void headless_fill_text(const char *text, f32 x, f32 y, f32 size, u32 color) {
+    if (!headless.framebuffer) return;
+    f32 advance = size * HEADLESS_GLYPH_ADVANCE;
+    f32 ascent = size * HEADLESS_GLYPH_ASCENT;
+    f32 cursor = x;
+    for (const u8 *c = (const u8 *) text; *c; ++c) {
+        if ((*c & 0xC0) == 0x80) continue;
+        if (*c != ' ' && *c != '\t') {
+            headless_fill_rect(cursor + advance * 0.1f, y - ascent, advance * 0.8f, ascent, color);
+        }
+        cursor += advance;
+    }
+}
+
+// Repaints the damaged area of the framebuffer with the commands of the frame, runs on the render thread.
+static void headless_render(GuiFrame *frame) {
+    if (!headless.rasterize) return;
+    headless_framebuffer_resize(frame->width, frame->height);
+    const GuiRect *damage = &frame->damage;
+    headless.clip_x0 = (i32) damage->x;
+    headless.clip_y0 = (i32) damage->y;
+    headless.clip_x1 = (i32) (damage->x + damage->width + 0.999f);
+    headless.clip_y1 = (i32) (damage->y + damage->height + 0.999f);
+    if (headless.clip_x1 > (i32) headless.framebuffer_width) headless.clip_x1 = (i32) headless.framebuffer_width;
+    if (headless.clip_y1 > (i32) headless.framebuffer_height) headless.clip_y1 = (i32) headless.framebuffer_height;
+    for (i32 row = headless.clip_y0; row < headless.clip_y1; ++row) {
+        u8 *pixel = headless.framebuffer + ((u64) row * headless.framebuffer_width + headless.clip_x0) * 3;
+        for (i32 column = headless.clip_x0; column < headless.clip_x1; ++column, pixel += 3) {
+            pixel[0] = (HEADLESS_CLEAR_COLOR >> 24) & 0xFF;
+            pixel[1] = (HEADLESS_CLEAR_COLOR >> 16) & 0xFF;
+            pixel[2] = (HEADLESS_CLEAR_COLOR >> 8) & 0xFF;
+        }
+    }
+    u64 count = darray_length(frame->batch.commands);
+    for (u64 i = 0; i < count; ++i) {
+        const GuiCommand *command = &frame->batch.commands[i];
+        if (command->type == GUI_COMMAND_RECT) {
+            headless_fill_rect(command->x, command->y, command->rect.width, command->rect.height, command->color);
+        } else {
+            headless_fill_text(command->text.value, command->x, command->y, command->text.size, command->color);
+        }
+    }
+}
+
+b8 window_initialize(const char *title, int width, int height) {
+    headless.frame = null;
+    headless.frame_count = 0;
+    window_context.width = width;
+    window_context.height = height;
+    window_context.pixel_ratio = 1.0f;
+    if (headless.rasterize) headless_framebuffer_resize(width, height);
+    // Frames are rasterized on a render thread like the windowed backend presents them, so the handoff is exercised
+    // without a GPU.
+    GuiFrameRenderer renderer = {null, headless_render, null};
+    if (!gui_frame_queue_start(&renderer, true)) return false;
+    vinfo("Initialized headless gui %s (%dx%d)", title, width, height)
+    return true;
+}
+
+void window_begin_frame() {
+    // There are no window events to poll, anything injected through input_process_* since the last frame is
+    // published here.
+    input_publish_snapshot();
+    if (headless.frame_width != (u32) window_context.width || headless.frame_height != (u32) window_context.height) {
+        headless.frame_width = (u32) window_context.width;
+        headless.frame_height = (u32) window_context.height;
+        gui_display_invalidate();
+    }
+}
+
+void window_end_frame() {
+    GuiFrame *frame = gui_frame_acquire();
+    if (frame && gui_display_compose(window_context.width, window_context.height, &frame->batch, &frame->damage)) {
+        frame->width = (u32) window_context.width;
+        frame->height = (u32) window_context.height;
+        headless.damage = frame->damage;
+        headless.frame = frame;
+        gui_frame_submit(frame);
+    } else {
+        if (frame) gui_frame_discard(frame);
+        headless.frame = null;
+        headless.damage.width = 0;
+        headless.damage.height = 0;
+    }
+    headless.frame_count++;
+    input_reset();
+}
+
+void window_shutdown() {
+    gui_frame_queue_stop();
+    headless.frame = null;
+    headless.frame_width = 0;
+    headless.frame_height = 0;
+    gui_display_shutdown();
+    gui_text_cache_shutdown();
+    headless_framebuffer_destroy();
+    window_context.width = 0;
+    window_context.height = 0;
+    window_context.pixel_ratio = 0.0f;
+}
+
+b8 window_should_close() {
+    return headless.frame_limit > 0 && headless.frame_count >= headless.frame_limit;
+}
+
+void window_get_size(u32 *width, u32 *height) {
+    *width = window_context.width;
+    *height = window_context.height;
+}
+
+b8 gui_load_font(FsPath font_path, const char *font_name) {
+    // Text is measured and drawn with fixed glyph cells, the font only has to exist.
+    if (!vfs_node_exists(font_path)) {
+        verror("Failed to load font");
+        return false;
+    }
+    vdebug("Loaded font: %s", font_name)
+    return true;
+}
+
+u32 gui_measure_glyphs(const char *text, u64 length, const char *font_name, f32 size, GuiGlyph *out_glyphs,
+                       f32 *out_width) {
+    f32 advance = size * HEADLESS_GLYPH_ADVANCE;
+    u32 count = 0;
+    for (u64 i = 0; i < length; ++i) {
+        if (((u8) text[i] & 0xC0) == 0x80) continue;
+        if (out_glyphs) {
+            out_glyphs[count].offset = (u32) i;
+            out_glyphs[count].x = (f32) count * advance;
+        }
+        count++;
+    }
+    *out_width = (f32) count * advance;
+    return out_glyphs ? count : 0;
+}
+
+void gui_headless_set_rasterize(b8 enabled) {
+    // The render thread must be done with the framebuffer before it is replaced.
+    gui_frame_flush();
+    headless.rasterize = enabled;
+    if (!enabled) headless_framebuffer_destroy();
+    else if (window_context.width > 0 && window_context.height > 0) {
+        headless_framebuffer_resize(window_context.width, window_context.height);
+        // The new framebuffer starts out blank.
+        gui_display_invalidate();
+    }
+}
+
+void gui_headless_set_frame_limit(u64 frames) {
+    headless.frame_limit = frames;
+}
+
+u64 gui_headless_frame_count() {
+    return headless.frame_count;
+}
+
+const GuiCommand *gui_headless_commands(u64 *out_count) {
+    gui_frame_flush();
+    *out_count = headless.frame ? darray_length(headless.frame->batch.commands) : 0;
+    return headless.frame ? headless.frame->batch.commands : null;
+}
+
+b8 gui_headless_damage(GuiRect *out_damage) {
+    *out_damage = headless.damage;
+    return headless.damage.width > 0 && headless.damage.height > 0;
+}
+
+const u8 *gui_headless_framebuffer(u32 *out_width, u32 *out_height) {
+    gui_frame_flush();
+    *out_width = headless.framebuffer_width;
+    *out_height = headless.framebuffer_height;
+    return headless.framebuffer;
+}
+
+b8 gui_headless_write_ppm(const char *path) {
+    gui_frame_flush();
+    if (!headless.framebuffer) {
+        vwarn("gui_headless_write_ppm - Rasterizing is disabled, there is no framebuffer to write")
+        return false;
+    }
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        verror("gui_headless_write_ppm - Failed to open %s for writing", path)
+        return false;
+    }
+    fprintf(file, "P6\n%u %u\n255\n", headless.framebuffer_width, headless.framebuffer_height);
+    u64 size = (u64) headless.framebuffer_width * headless.framebuffer_height * 3;
+    b8 written = fwrite(headless.framebuffer, 1, size, file) == size;
+    fclose(file);
+    if (!written) verror("gui_headless_write_ppm - Failed to write %s", path)
+    return written;
+}
+
+#endif // VOS_HEADLESS
@@ -0,0 +1,75 @@
+/**
+ * The headless gui backend, compiled in place of the windowed one when VOS_HEADLESS is defined.
+ *
+ * It implements the same window_* and gui_* API without a window or a GL context. The commands the compositor draws
+ * each frame are kept, so frame times of scripts can be measured and their output compared on machines without a
+ * GPU. The frames can optionally be rasterized into an RGB framebuffer on the CPU and written out as a PPM image for
+ * golden image comparisons. Text is rasterized as one box per glyph cell of a monospace font, which keeps
+ * layout visible without a font rasterizer.
+ */
+#pragma once
+
+#include "vgui_display.h"
+
+#ifdef VOS_HEADLESS
+
+/**
+ * Enables or disables rasterizing draw calls into the framebuffer. Disabled by default, recording alone is enough
+ * for frame time measurements.
+ *
+ * @param enabled Whether draw calls should be rasterized.
+ */
+VAPI void gui_headless_set_rasterize(b8 enabled);
+
+/**
+ * Makes window_should_close return true once the given number of frames have been ended. Zero, the default, never
+ * closes the window.
+ *
+ * @param frames The number of frames to run.
+ */
+VAPI void gui_headless_set_frame_limit(u64 frames);
+
+/**
+ * @return The number of frames ended since the window was initialized.
+ */
+VAPI u64 gui_headless_frame_count();
+
+/**
+ * Gets the commands drawn by the last frame, only the nodes touching the damaged area and the immediate draw calls.
+ * The list is empty when nothing changed and the frame was skipped. Valid until the next frame begins.
+ *
+ * @param out_count The number of drawn commands.
+ *
+ * @return The drawn commands.
+ */
+VAPI const GuiCommand *gui_headless_commands(u64 *out_count);
+
+/**
+ * Gets the area the last frame repainted.
+ *
+ * @param out_damage The repainted area, empty when the frame was skipped.
+ *
+ * @return False if the frame was skipped.
+ */
+VAPI b8 gui_headless_damage(GuiRect *out_damage);
+
+/**
+ * Gets the rasterized framebuffer as tightly packed 8 bit RGB rows.
+ *
+ * @param out_width The width of the framebuffer in pixels.
+ * @param out_height The height of the framebuffer in pixels.
+ *
+ * @return The framebuffer, null if rasterizing is disabled.
+ */
+VAPI const u8 *gui_headless_framebuffer(u32 *out_width, u32 *out_height);
+
+/**
+ * Writes the rasterized framebuffer to a binary PPM (P6) file.
+ *
+ * @param path The path of the file to write.
+ *
+ * @return True if the image was written, false if rasterizing is disabled or the file couldn't be written.
+ */
+VAPI b8 gui_headless_write_ppm(const char *path);
+
+#endif // VOS_HEADLESS
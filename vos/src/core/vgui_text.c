@@ -0,0 +1,180 @@
+/**
+ * The text measurement cache, see vgui_text.h.
+ */
+#include "vgui_text.h"
+#include <string.h>
+#include "vmem.h"
+
+// The number of hash buckets, a power of two at least twice the capacity so chains stay short.
+#define GUI_TEXT_CACHE_BUCKETS 2048
+#define FNV_OFFSET 14695981039346656037UL
+#define FNV_PRIME 1099511628211UL
+
+typedef struct GuiTextEntry {
+    u64 hash;
+    f32 size;
+    // The measured text, not terminated, and the font it was measured with. Both live in the entry's block.
+    const char *text;
+    u64 length;
+    const char *font;
+    GuiTextMetrics metrics;
+    // A single allocation holding the glyphs, the text and the font name.
+    void *block;
+    u64 block_size;
+    struct GuiTextEntry *bucket_next;
+    // The neighbours in recency order, the newest entry has no newer one.
+    struct GuiTextEntry *newer;
+    struct GuiTextEntry *older;
+} GuiTextEntry;
+
+typedef struct GuiTextCache {
+    GuiTextEntry entries[GUI_TEXT_CACHE_CAPACITY];
+    // The number of entries that have been handed out, the cache is full once all of them have.
+    u32 used;
+    GuiTextEntry *buckets[GUI_TEXT_CACHE_BUCKETS];
+    GuiTextEntry *newest;
+    GuiTextEntry *oldest;
+} GuiTextCache;
+
+static GuiTextCache *text_cache = null;
+
+static u64 gui_text_hash(const char *text, u64 length, const char *font_name, f32 size) {
+    u64 hash = FNV_OFFSET;
+    for (u64 i = 0; i < length; ++i) {
+        hash ^= (u64) (unsigned char) text[i];
+        hash *= FNV_PRIME;
+    }
+    for (const char *p = font_name; *p; ++p) {
+        hash ^= (u64) (unsigned char) *p;
+        hash *= FNV_PRIME;
+    }
+    u32 size_bits;
+    kcopy_memory(&size_bits, &size, sizeof(u32));
+    hash ^= size_bits;
+    hash *= FNV_PRIME;
+    return hash;
+}
+
+static void gui_text_lru_unlink(GuiTextEntry *entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else text_cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else text_cache->oldest = entry->newer;
+    entry->newer = null;
+    entry->older = null;
+}
+
+static void gui_text_lru_push(GuiTextEntry *entry) {
+    entry->older = text_cache->newest;
+    entry->newer = null;
+    if (text_cache->newest) text_cache->newest->newer = entry;
+    text_cache->newest = entry;
+    if (text_cache->oldest == null) text_cache->oldest = entry;
+}
+
+// Unlinks the entry from its bucket and the recency list and frees its block.
+static void gui_text_entry_release(GuiTextEntry *entry) {
+    GuiTextEntry **link = &text_cache->buckets[entry->hash & (GUI_TEXT_CACHE_BUCKETS - 1)];
+    while (*link && *link != entry) link = &(*link)->bucket_next;
+    if (*link) *link = entry->bucket_next;
+    gui_text_lru_unlink(entry);
+    kfree(entry->block, entry->block_size, MEMORY_TAG_UI);
+    kzero_memory(entry, sizeof(GuiTextEntry));
+}
+
+// Gets an unused entry, evicting the least recently used one when the cache is full.
+static GuiTextEntry *gui_text_entry_acquire() {
+    if (text_cache->used < GUI_TEXT_CACHE_CAPACITY) return &text_cache->entries[text_cache->used++];
+    GuiTextEntry *entry = text_cache->oldest;
+    gui_text_entry_release(entry);
+    return entry;
+}
+
+static GuiTextEntry *gui_text_lookup(const char *text, u64 length, const char *font_name, f32 size, u64 hash) {
+    GuiTextEntry *entry = text_cache->buckets[hash & (GUI_TEXT_CACHE_BUCKETS - 1)];
+    for (; entry; entry = entry->bucket_next) {
+        if (entry->hash == hash && entry->length == length && entry->size == size &&
+            memcmp(entry->text, text, length) == 0 && strcmp(entry->font, font_name) == 0) {
+            return entry;
+        }
+    }
+    return null;
+}
+
+const GuiTextMetrics *gui_text_metrics(const char *text, u64 length, const char *font_name, f32 size) {
+    if (length > GUI_TEXT_CACHE_MAX_LENGTH) return null;
+    if (text_cache == null) text_cache = kallocate(sizeof(GuiTextCache), MEMORY_TAG_UI);
+    u64 hash = gui_text_hash(text, length, font_name, size);
+    GuiTextEntry *entry = gui_text_lookup(text, length, font_name, size, hash);
+    if (entry) {
+        gui_text_lru_unlink(entry);
+        gui_text_lru_push(entry);
+        return &entry->metrics;
+    }
+    entry = gui_text_entry_acquire();
+    // The glyphs come first so they are aligned, there is at most one glyph per byte.
+    u64 font_length = strlen(font_name) + 1;
+    u64 glyphs_size = length * sizeof(GuiGlyph);
+    entry->block_size = glyphs_size + length + font_length;
+    entry->block = kallocate(entry->block_size, MEMORY_TAG_UI);
+    char *strings = (char *) entry->block + glyphs_size;
+    kcopy_memory(strings, text, length);
+    kcopy_memory(strings + length, font_name, font_length);
+    entry->hash = hash;
+    entry->size = size;
+    entry->text = strings;
+    entry->length = length;
+    entry->font = strings + length;
+    entry->metrics.glyphs = entry->block;
+    entry->metrics.glyph_count = gui_measure_glyphs(text, length, font_name, size, entry->metrics.glyphs,
+                                                    &entry->metrics.width);
+    GuiTextEntry **bucket = &text_cache->buckets[hash & (GUI_TEXT_CACHE_BUCKETS - 1)];
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    gui_text_lru_push(entry);
+    return &entry->metrics;
+}
+
+f32 gui_text_width(const char *text, const char *font_name, f32 size) {
+    u64 length = strlen(text);
+    const GuiTextMetrics *metrics = gui_text_metrics(text, length, font_name, size);
+    if (metrics) return metrics->width;
+    f32 width;
+    gui_measure_glyphs(text, length, font_name, size, null, &width);
+    return width;
+}
+
+f32 gui_text_prefix_width(const char *text, const char *font_name, f32 size, u64 offset) {
+    u64 length = strlen(text);
+    if (offset >= length) return gui_text_width(text, font_name, size);
+    const GuiTextMetrics *metrics = gui_text_metrics(text, length, font_name, size);
+    f32 width;
+    if (metrics == null) {
+        gui_measure_glyphs(text, offset, font_name, size, null, &width);
+        return width;
+    }
+    // Finds the first glyph starting at or after the offset, the prefix ends where that glyph is drawn.
+    u32 low = 0, high = metrics->glyph_count;
+    while (low < high) {
+        u32 middle = low + (high - low) / 2;
+        if (metrics->glyphs[middle].offset < offset) low = middle + 1;
+        else high = middle;
+    }
+    return low < metrics->glyph_count ? metrics->glyphs[low].x : metrics->width;
+}
+
+void gui_text_cache_clear() {
+    if (text_cache == null) return;
+    for (u32 i = 0; i < text_cache->used; ++i) {
+        if (text_cache->entries[i].block) kfree(text_cache->entries[i].block, text_cache->entries[i].block_size,
+                                                MEMORY_TAG_UI);
+    }
+    kzero_memory(text_cache, sizeof(GuiTextCache));
+}
+
+void gui_text_cache_shutdown() {
+    if (text_cache == null) return;
+    gui_text_cache_clear();
+    kfree(text_cache, sizeof(GuiTextCache), MEMORY_TAG_UI);
+    text_cache = null;
+}
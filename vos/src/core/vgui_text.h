@@ -0,0 +1,83 @@
+/**
+ * Text measurement with a cache, shared by every backend.
+ *
+ * Measuring text through the font renderer is the most expensive thing the gui does for text heavy scripts, and the
+ * same strings are measured every frame. Measurements are kept in an LRU cache keyed by font, size and text. Every
+ * entry also stores where each glyph starts, so the width of any prefix of a cached string, like the text before a
+ * cursor, is found with a binary search instead of measuring the prefix again.
+ */
+#pragma once
+
+#include "vgui.h"
+
+// The number of measured strings kept, the least recently used one is evicted when a new one doesn't fit.
+#define GUI_TEXT_CACHE_CAPACITY 1024
+// Longer strings are measured every time, they are rarely measured twice and would push out many short ones.
+#define GUI_TEXT_CACHE_MAX_LENGTH 4096
+
+/**
+ * Where a glyph starts within its text.
+ */
+typedef struct GuiGlyph {
+    // The byte offset of the glyph's first byte.
+    u32 offset;
+    // The pen position the glyph is drawn at, relative to the start of the text.
+    f32 x;
+} GuiGlyph;
+
+/**
+ * The measurements of a string.
+ */
+typedef struct GuiTextMetrics {
+    // The advance width of the whole string.
+    f32 width;
+    u32 glyph_count;
+    // The glyphs in order, glyph_count long.
+    GuiGlyph *glyphs;
+} GuiTextMetrics;
+
+/**
+ * Measures text without the cache, implemented by each backend.
+ *
+ * @param text The text to measure, it doesn't have to be terminated.
+ * @param length The length of the text in bytes.
+ * @param font_name The name of the font to measure with.
+ * @param size The font size.
+ * @param out_glyphs Receives a glyph for every glyph of the text, room for one per byte. Null if only the width is
+ * needed.
+ * @param out_width Receives the advance width of the text.
+ *
+ * @return The number of glyphs written to out_glyphs.
+ */
+u32 gui_measure_glyphs(const char *text, u64 length, const char *font_name, f32 size, GuiGlyph *out_glyphs,
+                       f32 *out_width);
+
+/**
+ * Gets the measurements of a string, measuring it on a cache miss.
+ *
+ * @return The cached metrics, valid until the next text is measured. Null if the string is too long to be cached.
+ */
+VAPI const GuiTextMetrics *gui_text_metrics(const char *text, u64 length, const char *font_name, f32 size);
+
+/**
+ * Gets the width of the first bytes of a string, i.e. the x of a cursor placed before the byte at the given offset.
+ * Offsets inside a multi byte glyph round up to the end of that glyph.
+ *
+ * @param text The whole string, it is measured and cached as a whole.
+ * @param font_name The name of the font to measure with.
+ * @param size The font size.
+ * @param offset The number of bytes to measure, clamped to the length of the string.
+ *
+ * @return The advance width of the prefix.
+ */
+VAPI f32 gui_text_prefix_width(const char *text, const char *font_name, f32 size, u64 offset);
+
+/**
+ * Drops every cached measurement, needed when a font is replaced.
+ */
+void gui_text_cache_clear();
+
+/**
+ * Frees the cache.
+ */
+void gui_text_cache_shutdown();
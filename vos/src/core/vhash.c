@@ -0,0 +1,93 @@
+/**
+ * XXH64, see vhash.h. Stripes of 32 bytes are consumed by four independent lanes, so the multiplies of one stripe
+ * overlap instead of waiting on each other, and the tail is folded in 8, 4 and 1 bytes at a time.
+ */
+#include "vhash.h"
+#include <string.h>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+#define HASH_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME_5 0x27D4EB2F165667C5ULL
+
+static inline u64 hash_rotl(u64 value, u32 bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Unaligned little endian reads, the compiler turns the memcpy into a single load.
+static inline u64 hash_read64(const u8 *bytes) {
+    u64 value;
+    memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static inline u32 hash_read32(const u8 *bytes) {
+    u32 value;
+    memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+static inline u64 hash_round(u64 lane, u64 input) {
+    lane += input * HASH_PRIME_2;
+    lane = hash_rotl(lane, 31);
+    return lane * HASH_PRIME_1;
+}
+
+static inline u64 hash_merge(u64 hash, u64 lane) {
+    hash ^= hash_round(0, lane);
+    return hash * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+u64 hash64_seeded(const void *data, u64 size, u64 seed) {
+    const u8 *bytes = data;
+    const u8 *end = bytes + size;
+    u64 hash;
+    if (size >= 32) {
+        u64 lanes[4] = {seed + HASH_PRIME_1 + HASH_PRIME_2, seed + HASH_PRIME_2, seed, seed - HASH_PRIME_1};
+        const u8 *last_stripe = end - 32;
+        do {
+            lanes[0] = hash_round(lanes[0], hash_read64(bytes));
+            lanes[1] = hash_round(lanes[1], hash_read64(bytes + 8));
+            lanes[2] = hash_round(lanes[2], hash_read64(bytes + 16));
+            lanes[3] = hash_round(lanes[3], hash_read64(bytes + 24));
+            bytes += 32;
+        } while (bytes <= last_stripe);
+        hash = hash_rotl(lanes[0], 1) + hash_rotl(lanes[1], 7) + hash_rotl(lanes[2], 12) + hash_rotl(lanes[3], 18);
+        for (u32 i = 0; i < 4; ++i) hash = hash_merge(hash, lanes[i]);
+    } else {
+        hash = seed + HASH_PRIME_5;
+    }
+    hash += size;
+    while (bytes + 8 <= end) {
+        hash ^= hash_round(0, hash_read64(bytes));
+        hash = hash_rotl(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+        bytes += 8;
+    }
+    if (bytes + 4 <= end) {
+        hash ^= (u64) hash_read32(bytes) * HASH_PRIME_1;
+        hash = hash_rotl(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        bytes += 4;
+    }
+    while (bytes < end) {
+        hash ^= (*bytes++) * HASH_PRIME_5;
+        hash = hash_rotl(hash, 11) * HASH_PRIME_1;
+    }
+    // Avalanche, every input bit affects every output bit.
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+u64 hash64(const void *data, u64 size) {
+    return hash64_seeded(data, size, 0);
+}
@@ -0,0 +1,22 @@
+/**
+ * Fast non cryptographic hashing of byte ranges, for content hashes that key caches and find duplicate contents.
+ */
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Hashes a byte range with XXH64, the output matches the reference implementation for the same seed.
+ *
+ * @param data The bytes to hash, may be null if size is zero.
+ * @param size The number of bytes.
+ * @param seed Hashes of the same bytes with different seeds are unrelated.
+ *
+ * @return The 64 bit hash.
+ */
+VAPI u64 hash64_seeded(const void *data, u64 size, u64 seed);
+
+/**
+ * Hashes a byte range with XXH64 and a seed of zero.
+ */
+VAPI u64 hash64(const void *data, u64 size);
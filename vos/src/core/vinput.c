@@ -0,0 +1,114 @@
+/**
+ * The input state shared by every gui backend. The backends feed events in through the input_process_* functions and
+ * publish a snapshot once per frame.
+ */
+#include "vinput.h"
+#include "vmem.h"
+
+// Input state structures
+typedef struct {
+    b8 keys[KEYS_MAX_KEYS];
+    b8 prev_keys[KEYS_MAX_KEYS];
+    b8 buttons[BUTTON_MAX_BUTTONS];
+    i32 mouse_x, mouse_y;
+    i32 prev_mouse_x, prev_mouse_y;
+    i8 mouse_wheel_delta;
+    // The codepoints typed since the last snapshot was published.
+    u32 text[INPUT_MAX_TEXT_EVENTS];
+    u32 text_count;
+} InputState;
+
+static InputState g_input_state;
+static InputSnapshot g_input_snapshot;
+
+void input_reset(void) {
+    kcopy_memory(g_input_state.prev_keys, g_input_state.keys, sizeof(g_input_state.keys));
+}
+
+void input_process_key(keys key, b8 pressed) {
+    if (key >= 0 && key < KEYS_MAX_KEYS) {
+        g_input_state.keys[key] = pressed;
+    }
+}
+
+void input_process_button(buttons button, b8 pressed) {
+    if (button >= 0 && button < BUTTON_MAX_BUTTONS) {
+        g_input_state.buttons[button] = pressed;
+    }
+}
+
+void input_process_mouse_move(i16 x, i16 y) {
+    g_input_state.prev_mouse_x = g_input_state.mouse_x;
+    g_input_state.prev_mouse_y = g_input_state.mouse_y;
+    g_input_state.mouse_x = x;
+    g_input_state.mouse_y = y;
+}
+
+void input_process_mouse_wheel(i8 z_delta) {
+    g_input_state.mouse_wheel_delta += z_delta;
+}
+
+void input_process_char(u32 codepoint) {
+    if (g_input_state.text_count < INPUT_MAX_TEXT_EVENTS) {
+        g_input_state.text[g_input_state.text_count++] = codepoint;
+    }
+}
+
+void input_publish_snapshot(void) {
+    InputSnapshot *snapshot = &g_input_snapshot;
+    snapshot->frame++;
+    kzero_memory(snapshot->keys, sizeof(snapshot->keys));
+    kzero_memory(snapshot->prev_keys, sizeof(snapshot->prev_keys));
+    for (u32 key = 0; key < KEYS_MAX_KEYS; ++key) {
+        snapshot->keys[key >> 6] |= (u64) g_input_state.keys[key] << (key & 63);
+        snapshot->prev_keys[key >> 6] |= (u64) g_input_state.prev_keys[key] << (key & 63);
+    }
+    snapshot->prev_buttons = snapshot->buttons;
+    snapshot->buttons = 0;
+    for (u32 button = 0; button < BUTTON_MAX_BUTTONS; ++button) {
+        snapshot->buttons |= (u32) g_input_state.buttons[button] << button;
+    }
+    snapshot->prev_mouse_x = snapshot->mouse_x;
+    snapshot->prev_mouse_y = snapshot->mouse_y;
+    snapshot->mouse_x = g_input_state.mouse_x;
+    snapshot->mouse_y = g_input_state.mouse_y;
+    snapshot->wheel_delta = g_input_state.mouse_wheel_delta;
+    g_input_state.mouse_wheel_delta = 0;
+    kcopy_memory(snapshot->text, g_input_state.text, g_input_state.text_count * sizeof(u32));
+    snapshot->text_count = g_input_state.text_count;
+    g_input_state.text_count = 0;
+}
+
+VAPI const InputSnapshot *input_get_snapshot(void) {
+    return &g_input_snapshot;
+}
+
+// Input API implementations
+VAPI b8 input_is_key_down(keys key) {
+    return g_input_state.keys[key];
+}
+
+VAPI b8 input_is_key_up(keys key) {
+    return !g_input_state.keys[key];
+}
+
+VAPI b8 input_is_button_down(buttons button) {
+    return g_input_state.buttons[button];
+}
+
+VAPI void input_get_mouse_position(i32 *x, i32 *y) {
+    *x = g_input_state.mouse_x;
+    *y = g_input_state.mouse_y;
+}
+
+VAPI b8 input_is_button_up(buttons button) {
+    return !g_input_state.buttons[button];
+}
+
+VAPI b8 input_is_key_pressed(keys key) {
+    return g_input_state.keys[key] && !g_input_state.prev_keys[key];
+}
+
+VAPI b8 input_is_key_released(keys key) {
+    return !g_input_state.keys[key] && g_input_state.prev_keys[key];
+}
@@ -13,7 +13,11 @@
 #pragma once
 
 #include "defines.h"
+#ifndef VOS_HEADLESS
 #include "GLFW/glfw3.h"
+#else
+#include "vinput_keys.h"
+#endif
 
 
 /**
@@ -312,6 +316,12 @@ void input_process_mouse_move(i16 x, i16 y);
  */
 void input_process_mouse_wheel(i8 z_delta);
 
+/**
+ * @brief Records a typed unicode codepoint for the text entry list of the next snapshot.
+ * @param codepoint The codepoint that was typed.
+ */
+void input_process_char(u32 codepoint);
+
 /**
  * @brief Returns a string representation of the provided key. Ex. "tab" for the tab key.
  *
@@ -333,4 +343,49 @@ VAPI void input_keymap_push(const struct keymap *map);
  *
  * @return True if a keymap was popped; otherwise false.
  */
-VAPI b8 input_keymap_pop(void);
\ No newline at end of file
+VAPI b8 input_keymap_pop(void);
+
+// The number of 64 bit words needed to hold one bit per key.
+#define INPUT_KEY_WORDS ((KEYS_MAX_KEYS + 63) / 64)
+// The maximum number of text entry codepoints recorded per frame, anything past it is dropped.
+#define INPUT_MAX_TEXT_EVENTS 64
+
+/**
+ * @brief A read-only copy of the input state published once per frame.
+ *
+ * Keys and buttons are stored as bitsets along with the state of the previous frame, so pressed/released transitions
+ * are answered from the snapshot alone. Text entry is recorded as the list of unicode codepoints typed during the
+ * frame, in order, which respects the keyboard layout and shift state unlike the raw key codes.
+ */
+typedef struct InputSnapshot {
+    // Incremented every time a snapshot is published.
+    u64 frame;
+    u64 keys[INPUT_KEY_WORDS];
+    u64 prev_keys[INPUT_KEY_WORDS];
+    u32 buttons;
+    u32 prev_buttons;
+    i32 mouse_x, mouse_y;
+    i32 prev_mouse_x, prev_mouse_y;
+    // The scroll accumulated over the frame.
+    i32 wheel_delta;
+    u32 text[INPUT_MAX_TEXT_EVENTS];
+    u32 text_count;
+} InputSnapshot;
+
+/**
+ * @brief Copies the live input state into the snapshot. Called once per frame after the window events are polled.
+ */
+void input_publish_snapshot(void);
+
+/**
+ * @brief Gets the snapshot published for the current frame.
+ * @return A pointer to the snapshot, valid for the lifetime of the program.
+ */
+VAPI const InputSnapshot *input_get_snapshot(void);
+
+/**
+ * @brief Tests a bit of a key bitset.
+ */
+static inline b8 input_bitset_test(const u64 *bitset, u32 key) {
+    return key < KEYS_MAX_KEYS && ((bitset[key >> 6] >> (key & 63)) & 1);
+}
@@ -0,0 +1,53 @@
+/**
+ * The GLFW key codes the input keys are defined with, for headless builds that don't have GLFW. The values are the
+ * ones glfw3.h uses, so a key means the same in both builds.
+ */
+#pragma once
+
+#define GLFW_KEY_SPACE              32
+#define GLFW_KEY_APOSTROPHE         39
+#define GLFW_KEY_COMMA              44
+#define GLFW_KEY_MINUS              45
+#define GLFW_KEY_PERIOD             46
+#define GLFW_KEY_SLASH              47
+#define GLFW_KEY_SEMICOLON          59
+#define GLFW_KEY_EQUAL              61
+#define GLFW_KEY_LEFT_BRACKET       91
+#define GLFW_KEY_BACKSLASH          92
+#define GLFW_KEY_RIGHT_BRACKET      93
+#define GLFW_KEY_GRAVE_ACCENT       96
+#define GLFW_KEY_ESCAPE             256
+#define GLFW_KEY_ENTER              257
+#define GLFW_KEY_TAB                258
+#define GLFW_KEY_BACKSPACE          259
+#define GLFW_KEY_INSERT             260
+#define GLFW_KEY_DELETE             261
+#define GLFW_KEY_RIGHT              262
+#define GLFW_KEY_LEFT               263
+#define GLFW_KEY_DOWN               264
+#define GLFW_KEY_UP                 265
+#define GLFW_KEY_PAGE_UP            266
+#define GLFW_KEY_PAGE_DOWN          267
+#define GLFW_KEY_HOME               268
+#define GLFW_KEY_END                269
+#define GLFW_KEY_CAPS_LOCK          280
+#define GLFW_KEY_SCROLL_LOCK        281
+#define GLFW_KEY_NUM_LOCK           282
+#define GLFW_KEY_PRINT_SCREEN       283
+#define GLFW_KEY_PAUSE              284
+#define GLFW_KEY_F1                 290
+#define GLFW_KEY_F24                313
+#define GLFW_KEY_KP_0               320
+#define GLFW_KEY_KP_DIVIDE          331
+#define GLFW_KEY_KP_EQUAL           336
+#define GLFW_KEY_LEFT_SHIFT         340
+#define GLFW_KEY_LEFT_CONTROL       341
+#define GLFW_KEY_LEFT_ALT           342
+#define GLFW_KEY_LEFT_SUPER         343
+#define GLFW_KEY_RIGHT_SHIFT        344
+#define GLFW_KEY_RIGHT_CONTROL      345
+#define GLFW_KEY_RIGHT_ALT          346
+#define GLFW_KEY_RIGHT_SUPER        347
+#define GLFW_KEY_MENU               348
+
+#define GLFW_KEY_LAST               GLFW_KEY_MENU
@@ -0,0 +1,338 @@
+/**
+ * The I/O thread pool, see vio.h. Requests wait in a queue in submission order, running requests are tracked so a
+ * cancelled one can have its result dropped, and finished ones wait in a completed list until the next poll.
+ */
+#include "vio.h"
+#include <stdio.h>
+#include "vlogger.h"
+#include "vmem.h"
+#include "vmutex.h"
+#include "vsemaphore.h"
+#include "vstring.h"
+#include "vthread.h"
+#include "containers/darray.h"
+
+// Mapped pages are touched at this stride to fault them in, the smallest page size of the supported platforms.
+#define VIO_PAGE_SIZE 4096
+
+typedef struct IoTask {
+    IoRequest request;
+    // Owned copy of the request's path.
+    char *path;
+    IoCompletion completion;
+    // Set while the task runs, its result is dropped on delivery.
+    b8 cancelled;
+} IoTask;
+
+typedef struct IoContext {
+    kmutex lock;
+    // Signalled once per queued task, and once per thread on shutdown.
+    vsemaphore work;
+    // Darrays of the tasks waiting to run, running and finished.
+    IoTask **queue;
+    IoTask **running;
+    IoTask **completed;
+    // The tasks the current poll is delivering, a callback may still cancel the ones after it.
+    IoTask **delivering;
+    kthread threads[VIO_THREADS];
+    u32 thread_count;
+    u32 next_id;
+    b8 stopping;
+} IoContext;
+
+static IoContext *io_context = null;
+
+// Reads a whole file into a heap copy. The string tracking isn't thread safe, nothing here goes through it.
+static void io_task_read(IoTask *task) {
+    FILE *file = fopen(task->path, "rb");
+    if (file == null) {
+        task->completion.status = IO_STATUS_FAILED;
+        return;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        task->completion.status = IO_STATUS_FAILED;
+        return;
+    }
+    char *data = size > 0 ? kallocate(size, MEMORY_TAG_RESOURCE) : null;
+    if (data && fread(data, 1, size, file) != (u64) size) {
+        kfree(data, size, MEMORY_TAG_RESOURCE);
+        fclose(file);
+        task->completion.status = IO_STATUS_FAILED;
+        return;
+    }
+    fclose(file);
+    task->completion.data = data;
+    task->completion.size = size;
+}
+
+// Maps a file and touches every page, so the faults wait on the disk here instead of wherever the data is read.
+static void io_task_map(IoTask *task) {
+    u64 size = 0;
+    char *data = platform_map_file(task->path, &size);
+    if (data == null) {
+        task->completion.status = IO_STATUS_FAILED;
+        return;
+    }
+    platform_advise_mapping(data, size, task->request.advice);
+    volatile char sink = 0;
+    for (u64 offset = 0; offset < size; offset += VIO_PAGE_SIZE) sink ^= data[offset];
+    (void) sink;
+    task->completion.data = data;
+    task->completion.size = size;
+}
+
+static void io_task_stat(IoTask *task) {
+    if (platform_is_directory(task->path)) {
+        task->completion.is_directory = true;
+    } else if (platform_is_file(task->path)) {
+        task->completion.size = platform_file_size(task->path);
+    } else {
+        task->completion.status = IO_STATUS_FAILED;
+    }
+}
+
+static void io_task_run(IoTask *task) {
+    switch (task->request.operation) {
+        case IO_OPERATION_READ:
+            io_task_read(task);
+            break;
+        case IO_OPERATION_MAP:
+            io_task_map(task);
+            break;
+        case IO_OPERATION_STAT:
+            io_task_stat(task);
+            break;
+        case IO_OPERATION_POST:
+            break;
+    }
+}
+
+// Takes tasks off the queue until the I/O system shuts down.
+static u32 io_worker(void *params) {
+    IoContext *context = params;
+    while (true) {
+        vsemaphore_wait(&context->work, 0);
+        kmutex_lock(&context->lock);
+        if (context->stopping) {
+            kmutex_unlock(&context->lock);
+            break;
+        }
+        // A cancelled task leaves its signal behind, the queue may be empty.
+        IoTask *task = null;
+        if (darray_length(context->queue) > 0) {
+            darray_pop_at(context->queue, 0, &task);
+            darray_push(IoTask *, context->running, task);
+        }
+        kmutex_unlock(&context->lock);
+        if (task == null) continue;
+        
+        io_task_run(task);
+        
+        kmutex_lock(&context->lock);
+        darray_remove(context->running, &task);
+        darray_push(IoTask *, context->completed, task);
+        kmutex_unlock(&context->lock);
+    }
+    return 0;
+}
+
+b8 vio_initialize() {
+    if (io_context) {
+        vwarn("vio_initialize - I/O already initialized.")
+        return false;
+    }
+    io_context = kallocate(sizeof(IoContext), MEMORY_TAG_RESOURCE);
+    io_context->queue = darray_create(IoTask *);
+    io_context->running = darray_create(IoTask *);
+    io_context->completed = darray_create(IoTask *);
+    kmutex_create(&io_context->lock);
+    // The count is bounded by the number of queued tasks, the maximum only matters where the platform enforces one.
+    vsemaphore_create(&io_context->work, 0x7fffffff, 0);
+    for (u32 i = 0; i < VIO_THREADS; i++) {
+        if (!kthread_create(io_worker, io_context, false, &io_context->threads[io_context->thread_count])) break;
+        io_context->thread_count++;
+    }
+    if (io_context->thread_count == 0) {
+        verror("vio_initialize - Failed to start any I/O thread.")
+        return false;
+    }
+    vdebug("vio_initialize - Started %u I/O threads", io_context->thread_count)
+    return true;
+}
+
+static void io_task_free(IoTask *task) {
+    if (task->path) kfree(task->path, string_length(task->path) + 1, MEMORY_TAG_STRING);
+    kfree(task, sizeof(IoTask), MEMORY_TAG_RESOURCE);
+}
+
+void vio_shutdown() {
+    if (io_context == null) {
+        vwarn("vio_shutdown - I/O not initialized.")
+        return;
+    }
+    kmutex_lock(&io_context->lock);
+    while (darray_length(io_context->queue) > 0) {
+        IoTask *task = null;
+        darray_pop_at(io_context->queue, 0, &task);
+        task->completion.status = IO_STATUS_CANCELLED;
+        darray_push(IoTask *, io_context->completed, task);
+    }
+    io_context->stopping = true;
+    kmutex_unlock(&io_context->lock);
+    for (u32 i = 0; i < io_context->thread_count; i++) vsemaphore_signal(&io_context->work);
+    for (u32 i = 0; i < io_context->thread_count; i++) {
+        kthread_wait(&io_context->threads[i]);
+        kthread_destroy(&io_context->threads[i]);
+    }
+    // Every task is finished now, their owners still get to release what they hold.
+    vio_poll();
+    vsemaphore_destroy(&io_context->work);
+    kmutex_destroy(&io_context->lock);
+    darray_destroy(io_context->queue)
+    darray_destroy(io_context->running)
+    darray_destroy(io_context->completed)
+    kfree(io_context, sizeof(IoContext), MEMORY_TAG_RESOURCE);
+    io_context = null;
+}
+
+// Creates a task for a request, the caller queues it.
+static IoTask *io_task_create(const IoRequest *request) {
+    IoTask *task = kallocate(sizeof(IoTask), MEMORY_TAG_RESOURCE);
+    task->request = *request;
+    if (request->path) {
+        u64 length = string_length(request->path);
+        task->path = kallocate(length + 1, MEMORY_TAG_STRING);
+        kcopy_memory(task->path, request->path, length + 1);
+    }
+    task->request.path = task->path;
+    task->completion.operation = request->operation;
+    task->completion.user_data = request->user_data;
+    // Ids wrap around, skipping the invalid one.
+    if (++io_context->next_id == INVALID_ID) io_context->next_id = 1;
+    task->completion.id = io_context->next_id;
+    return task;
+}
+
+u32 vio_submit(const IoRequest *requests, u32 count, u32 *out_ids) {
+    if (io_context == null || io_context->thread_count == 0) {
+        vwarn("vio_submit - I/O not initialized.")
+        return 0;
+    }
+    u32 submitted = 0, queued = 0;
+    kmutex_lock(&io_context->lock);
+    for (u32 i = 0; i < count; i++) {
+        const IoRequest *request = &requests[i];
+        if (request->operation != IO_OPERATION_POST && request->path == null) {
+            if (out_ids) out_ids[i] = INVALID_ID;
+            continue;
+        }
+        IoTask *task = io_task_create(request);
+        if (out_ids) out_ids[i] = task->completion.id;
+        submitted++;
+        // Nothing to run, it only waits for the next poll.
+        if (request->operation == IO_OPERATION_POST) {
+            darray_push(IoTask *, io_context->completed, task);
+        } else {
+            darray_push(IoTask *, io_context->queue, task);
+            queued++;
+        }
+    }
+    kmutex_unlock(&io_context->lock);
+    for (u32 i = 0; i < queued; i++) vsemaphore_signal(&io_context->work);
+    return submitted;
+}
+
+// Submits a single request and returns its id.
+static u32 vio_submit_one(IoOperation operation, const char *path, IoCallback callback, void *user_data) {
+    IoRequest request = {operation, path, PLATFORM_MAP_ADVICE_NORMAL, callback, user_data};
+    u32 id = INVALID_ID;
+    vio_submit(&request, 1, &id);
+    return id;
+}
+
+u32 vio_read(const char *path, IoCallback callback, void *user_data) {
+    return vio_submit_one(IO_OPERATION_READ, path, callback, user_data);
+}
+
+u32 vio_stat(const char *path, IoCallback callback, void *user_data) {
+    return vio_submit_one(IO_OPERATION_STAT, path, callback, user_data);
+}
+
+u32 vio_post(IoCallback callback, void *user_data) {
+    return vio_submit_one(IO_OPERATION_POST, null, callback, user_data);
+}
+
+// Finds a task by id in a darray of tasks, returns its index or -1. Delivered tasks are null.
+static i64 io_task_find(IoTask **tasks, u32 id) {
+    if (tasks == null) return -1;
+    u64 length = darray_length(tasks);
+    for (u64 i = 0; i < length; i++) {
+        if (tasks[i] && tasks[i]->completion.id == id) return (i64) i;
+    }
+    return -1;
+}
+
+b8 vio_cancel(u32 id) {
+    if (io_context == null || id == INVALID_ID) return false;
+    b8 found = true;
+    kmutex_lock(&io_context->lock);
+    i64 index = io_task_find(io_context->queue, id);
+    if (index >= 0) {
+        IoTask *task = null;
+        darray_pop_at(io_context->queue, index, &task);
+        task->completion.status = IO_STATUS_CANCELLED;
+        darray_push(IoTask *, io_context->completed, task);
+    } else if ((index = io_task_find(io_context->running, id)) >= 0) {
+        io_context->running[index]->cancelled = true;
+    } else if ((index = io_task_find(io_context->completed, id)) >= 0) {
+        io_context->completed[index]->cancelled = true;
+    } else if ((index = io_task_find(io_context->delivering, id)) >= 0) {
+        io_context->delivering[index]->cancelled = true;
+    } else {
+        found = false;
+    }
+    kmutex_unlock(&io_context->lock);
+    return found;
+}
+
+void vio_release(IoOperation operation, void *data, u64 size) {
+    if (data == null) return;
+    if (operation == IO_OPERATION_MAP) platform_unmap_file(data, size);
+    else kfree(data, size, MEMORY_TAG_RESOURCE);
+}
+
+u32 vio_poll() {
+    if (io_context == null) return 0;
+    // Taken as a whole, callbacks are free to submit and cancel requests.
+    kmutex_lock(&io_context->lock);
+    u64 count = darray_length(io_context->completed);
+    if (count == 0) {
+        kmutex_unlock(&io_context->lock);
+        return 0;
+    }
+    IoTask **completed = io_context->completed;
+    io_context->completed = darray_create(IoTask *);
+    kmutex_unlock(&io_context->lock);
+    // A callback polling again delivers a batch of its own, this one is picked up again after.
+    IoTask **outer = io_context->delivering;
+    io_context->delivering = completed;
+    for (u64 i = 0; i < count; i++) {
+        IoTask *task = completed[i];
+        IoCompletion *completion = &task->completion;
+        if (task->cancelled) {
+            vio_release(completion->operation, completion->data, completion->size);
+            completion->data = null;
+            completion->status = IO_STATUS_CANCELLED;
+        }
+        if (task->request.callback) task->request.callback(completion);
+        vio_release(completion->operation, completion->data, completion->size);
+        io_task_free(task);
+        completed[i] = null;
+    }
+    io_context->delivering = outer;
+    darray_destroy(completed)
+    return (u32) count;
+}
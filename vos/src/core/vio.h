@@ -0,0 +1,132 @@
+/**
+ * Asynchronous file I/O. Requests are queued to a small pool of threads that read, map and stat files off the main
+ * thread, their completions are handed back to whoever polls, so a slow volume stalls a worker rather than a frame.
+ *
+ * Callbacks always run on the thread calling vio_poll, the kernel polls once per frame. A request can be cancelled
+ * until its completion is delivered, the callback still runs once with IO_STATUS_CANCELLED so whatever it owns can
+ * be released.
+ */
+#pragma once
+
+#include "defines.h"
+#include "platform/platform.h"
+
+#ifndef VIO_THREADS
+// The number of I/O threads. Reads mostly wait on the disk, a couple of threads keep a slow volume busy and a fast one
+// isn't held up behind it.
+#define VIO_THREADS 2
+#endif
+
+typedef enum IoOperation {
+    // Reads the whole file into a heap copy.
+    IO_OPERATION_READ,
+    // Maps the file read only and faults its pages in on the I/O thread.
+    IO_OPERATION_MAP,
+    // Gets the size and type of the path.
+    IO_OPERATION_STAT,
+    // Does nothing, the completion is delivered by the next poll. Defers work to the same place I/O completes.
+    IO_OPERATION_POST
+} IoOperation;
+
+typedef enum IoStatus {
+    IO_STATUS_OK,
+    // The path doesn't exist or couldn't be read.
+    IO_STATUS_FAILED,
+    // The request was cancelled, or the I/O system shut down before it ran.
+    IO_STATUS_CANCELLED
+} IoStatus;
+
+typedef struct IoCompletion {
+    u32 id;
+    IoOperation operation;
+    IoStatus status;
+    // The contents of a read or map. A callback keeping them sets data to null and releases them with vio_release
+    // later, contents left in place are released once the callback returns.
+    void *data;
+    // The number of bytes read or mapped, or the size of the file for a stat.
+    u64 size;
+    // Whether a stat found a directory.
+    b8 is_directory;
+    void *user_data;
+} IoCompletion;
+
+/**
+ * Called with the completion of a request on the thread polling.
+ */
+typedef void (*IoCallback)(IoCompletion *completion);
+
+typedef struct IoRequest {
+    IoOperation operation;
+    // The system path, copied on submit.
+    const char *path;
+    // How a mapping is going to be read, only used by IO_OPERATION_MAP.
+    platform_map_advice advice;
+    IoCallback callback;
+    void *user_data;
+} IoRequest;
+
+/**
+ * Starts the I/O threads.
+ *
+ * @return False if no thread could be started, requests are then never run.
+ */
+b8 vio_initialize();
+
+/**
+ * Cancels every request still queued, waits for the running ones and delivers every completion left, then stops the
+ * threads.
+ */
+void vio_shutdown();
+
+/**
+ * Queues a batch of requests under a single lock.
+ *
+ * @param requests The requests.
+ * @param count The number of requests.
+ * @param out_ids An array of count ids to hold the id of each request, may be null.
+ *
+ * @return The number of requests queued, zero before vio_initialize.
+ */
+u32 vio_submit(const IoRequest *requests, u32 count, u32 *out_ids);
+
+/**
+ * Queues a read of a whole file.
+ *
+ * @return The id of the request, INVALID_ID if it couldn't be queued.
+ */
+u32 vio_read(const char *path, IoCallback callback, void *user_data);
+
+/**
+ * Queues a stat of a path.
+ *
+ * @return The id of the request, INVALID_ID if it couldn't be queued.
+ */
+u32 vio_stat(const char *path, IoCallback callback, void *user_data);
+
+/**
+ * Queues a completion without any I/O, delivered by the next poll.
+ *
+ * @return The id of the request, INVALID_ID if it couldn't be queued.
+ */
+u32 vio_post(IoCallback callback, void *user_data);
+
+/**
+ * Cancels a request. A queued request never runs, the result of a running one is dropped.
+ *
+ * @return False if the request was already delivered or doesn't exist.
+ */
+b8 vio_cancel(u32 id);
+
+/**
+ * Delivers the completions of every request finished since the last poll, in the order they finished.
+ *
+ * @return The number of completions delivered.
+ */
+u32 vio_poll();
+
+/**
+ * Releases the contents of a completion that its callback kept.
+ *
+ * @param operation The operation of the completion, IO_OPERATION_MAP contents are unmapped.
+ */
+void vio_release(IoOperation operation, void *data, u64 size);
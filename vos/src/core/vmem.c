@@ -135,11 +135,12 @@ void _memory_system_shutdown(int line, const char *file) {
     vdebug("%s:%d memory_system_shutdown called.", file, line);
     if (state_ptr) {
         report_memory_leaks();
-        kmutex_destroy(&state_ptr->allocation_mutex);
         
         dynamic_allocator_destroy(&state_ptr->allocator);
         //TODO print all memory leaks
         ptr_hash_table_destroy(state_ptr->stats.allocations);
+        // Destroyed last, tearing down the allocation table still goes through the locked free path.
+        kmutex_destroy(&state_ptr->allocation_mutex);
         platform_free(state_ptr, state_ptr->allocator_memory_requirement + sizeof(memory_system_state));
     }
     state_ptr = 0;
@@ -299,6 +300,16 @@ void _kfree_report(u64 size, memory_tag tag, int line, const char *file) {
     kmutex_unlock(&state_ptr->allocation_mutex);
 }
 
+void _kresize_report(u64 old_size, u64 new_size, memory_tag tag, int line, const char *file) {
+    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
+        vfatal("%s:%d Error obtaining mutex lock during allocation reporting.", file, line);
+        return;
+    }
+    state_ptr->stats.total_allocated = state_ptr->stats.total_allocated - old_size + new_size;
+    state_ptr->stats.tagged_allocations[tag] = state_ptr->stats.tagged_allocations[tag] - old_size + new_size;
+    kmutex_unlock(&state_ptr->allocation_mutex);
+}
+
 b8 _kmemory_get_size_alignment(void *block, u64 *out_size, u16 *out_alignment, int line, const char *file) {
 //    vdebug("%s:%d kmemory_get_size_alignment called.", file, line);
     if (!kmutex_lock(&state_ptr->allocation_mutex)) {
@@ -68,6 +68,10 @@ VAPI void _kfree_aligned(void *block, u64 size, u16 alignment, memory_tag tag, i
 
 VAPI void _kfree_report(u64 size, memory_tag tag, int line, const char *file);
 
+// Reports that a live block will be freed with a different size than it was allocated with, such as a buffer handed
+// off with only the part in use. Moves the tagged bytes without touching the allocation count.
+VAPI void _kresize_report(u64 old_size, u64 new_size, memory_tag tag, int line, const char *file);
+
 VAPI b8 _kmemory_get_size_alignment(void *block, u64 *out_size, u16 *out_alignment, int line, const char *file);
 
 VAPI void *_kzero_memory(void *block, u64 size, int line, const char *file);
@@ -93,6 +97,7 @@ VAPI b8 _kis_free(void *block, int line, const char *file);
 #define kfree(block, size, tag) _kfree(block, size, tag, __LINE__, __FILE__)
 #define kfree_aligned(block, size, alignment, tag) _kfree_aligned(block, size, alignment, tag, __LINE__, __FILE__)
 #define kfree_report(size, tag) _kfree_report(size, tag, __LINE__, __FILE__)
+#define kresize_report(old_size, new_size, tag) _kresize_report(old_size, new_size, tag, __LINE__, __FILE__)
 #define kmemory_get_size_alignment(block, out_size, out_alignment) _kmemory_get_size_alignment(block, out_size, out_alignment, __LINE__, __FILE__)
 #define kzero_memory(block, size) _kzero_memory(block, size, __LINE__, __FILE__)
 #define kcopy_memory(dest, source, size) _kcopy_memory(dest, source, size, __LINE__, __FILE__)
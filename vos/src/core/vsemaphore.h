@@ -15,7 +15,7 @@ VAPI b8 vsemaphore_signal(vsemaphore *semaphore);
 /**
  * Decreases the semaphore count by 1. If the count reaches 0, the
  * semaphore is considered unsignaled and this call blocks until the
- * semaphore is signaled by vsemaphore_signal.
+ * semaphore is signaled by vsemaphore_signal. A timeout of zero waits without a limit.
  */
 VAPI b8 vsemaphore_wait(vsemaphore *semaphore, u64 timeout_ms);
 
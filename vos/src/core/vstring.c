@@ -5,74 +5,74 @@
 #include "containers/ptrhash.h"
 #include "containers/darray.h"
 #include "platform/platform.h"
+#include "vhash.h"
 
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
 
 
-// a tracked allocation of a string
-typedef struct StringAllocation {
-    char *string;
+// A string allocated here sits right behind its header, the header is where the allocation starts.
+typedef struct StringHeader {
+    // The bytes the string has room for, the terminator not included.
     u64 length;
-    u64 tag;
-} StringAllocation;
+    u32 tag;
+    // The string's slot in string_allocations, STRING_UNTRACKED if it isn't in there.
+    u32 index;
+} StringHeader;
 
-static void **string_allocations = NULL;
+#define STRING_UNTRACKED 0xFFFFFFFFu
+
+// The strings still alive, each one knows its slot so it comes out by swapping the last one into it.
+static char **string_allocations = NULL;
+
+static inline StringHeader *string_header(const char *str) {
+    return (StringHeader *) str - 1;
+}
 
 void strings_initialize() {
-    string_allocations = darray_create(StringAllocation*);
+#if VSTRING_TRACKING
+    string_allocations = darray_create(char *);
+#endif
 }
 
 void strings_shutdown() {
     if (!string_allocations) return;
-    
-    for (u64 i = 0; i < darray_length(string_allocations); ++i) {
-        StringAllocation *allocation = *(StringAllocation **) darray_get(string_allocations, i);
-        if (allocation) {
-            // free the string and the allocation
-//            vdebug("Freeing string: %s", allocation->string)
-            kfree(allocation->string, allocation->length + 1, allocation->tag); // Free the string
-            kfree(allocation, sizeof(StringAllocation), MEMORY_TAG_STRING); // Free the allocation struct
-            //remove from the hash table
-        }
+    u64 count = darray_length(string_allocations);
+    for (u64 i = 0; i < count; ++i) {
+        StringHeader *header = string_header(string_allocations[i]);
+        kfree(header, sizeof(StringHeader) + header->length + 1, header->tag);
     }
-    
     darray_destroy(string_allocations);
     string_allocations = NULL;
+    vdebug("strings_shutdown - Freed %llu strings left alive", count)
 }
 
-// Allocate a string with tracking
-char *string_allocate_empty(u64 length) {
-    char *copiedString = kallocate(length + 1, MEMORY_TAG_STRING);
-    kzero_memory(copiedString, length + 1);
-    
-    StringAllocation *allocation = kallocate(sizeof(StringAllocation), MEMORY_TAG_STRING);
-    allocation->string = copiedString;
-    allocation->length = length;
-    allocation->tag = MEMORY_TAG_STRING;
-    
-    darray_push(StringAllocation*, string_allocations, allocation);
-    return copiedString;
+// Allocates a zeroed string with room for length bytes and its terminator, tracked if tracking is on.
+static char *string_reserve(u64 length) {
+    StringHeader *header = kallocate(sizeof(StringHeader) + length + 1, MEMORY_TAG_STRING);
+    header->length = length;
+    header->tag = MEMORY_TAG_STRING;
+    header->index = STRING_UNTRACKED;
+    char *str = (char *) (header + 1);
+#if VSTRING_TRACKING
+    if (string_allocations) {
+        header->index = (u32) darray_length(string_allocations);
+        darray_push(char *, string_allocations, str);
+    }
+#endif
+    return str;
 }
 
+char *string_allocate_empty(u64 length) {
+    return string_reserve(length);
+}
 
 char *string_allocate_sized(const char *input, u64 length) {
-    
-    char *copiedString = kallocate(length + 1, MEMORY_TAG_STRING);
-    kcopy_memory(copiedString, input, length + 1);
-    //append the null terminator if it's not there
-    if (copiedString[length] != '\0') {
-        copiedString[length] = '\0';
-    }
-    StringAllocation *allocation = kallocate(sizeof(StringAllocation), MEMORY_TAG_STRING);
-    allocation->string = copiedString;
-    allocation->length = length;
-    allocation->tag = MEMORY_TAG_STRING;
-    
-    darray_push(StringAllocation *, string_allocations, allocation);
-    
-    return copiedString;
+    char *copied = string_reserve(length);
+    kcopy_memory(copied, input, length);
+    copied[length] = '\0';
+    return copied;
 }
 
 char *string_allocate(const char *input) {
@@ -82,16 +82,21 @@ char *string_allocate(const char *input) {
 
 void string_deallocate(char *str) {
     if (!str) return;
-    //Finds the allocation and removes it from the darray
-    for (u64 i = 0; i < darray_length(string_allocations); ++i) {
-        StringAllocation *allocation = *(StringAllocation **) darray_get(string_allocations, i);
-        if (strings_equal(allocation->string, str)) {
-            kfree(allocation->string, allocation->length + 1, allocation->tag); // Free the string
-            kfree(allocation, sizeof(StringAllocation), MEMORY_TAG_STRING); // Free the allocation struct
-            darray_remove(string_allocations, allocation);
+    StringHeader *header = string_header(str);
+#if VSTRING_TRACKING
+    if (header->index != STRING_UNTRACKED) {
+        u64 last = string_allocations ? darray_length(string_allocations) : 0;
+        if (header->index >= last || string_allocations[header->index] != str) {
+            verror("string_deallocate - %p isn't a live string", str)
             return;
         }
+        char *moved = string_allocations[last - 1];
+        string_allocations[header->index] = moved;
+        string_header(moved)->index = header->index;
+        darray_length_set(string_allocations, last - 1);
     }
+#endif
+    kfree(header, sizeof(StringHeader) + header->length + 1, header->tag);
 }
 
 
@@ -114,13 +119,9 @@ inline b8 string_contains(const char *str, const char *substr) {
     return strstr(str, substr) != null;
 }
 
-// Splits the given string into an array of strings using the given delimiter.
-// The returned array must be freed using darray_free.
+// Returns a copy of the first part of the given string before the given delimiter.
 inline char *string_split(const char *str, const char *delimiter) {
-    char *copy = string_duplicate(str);
-    char *token = strtok(copy, delimiter);
-    kfree(copy, string_length(copy) + 1, MEMORY_TAG_STRING);
-    return token;
+    return string_split_at(str, delimiter, 0);
 }
 
 b8 string_starts_with(const char *str, const char *substr) {
@@ -131,30 +132,20 @@ char *string_concat(const char *str0, const char *str1) {
     if (!str0 || !str1) return null;
     u64 str0_len = string_length(str0);
     u64 str1_len = string_length(str1);
-    char *result = kallocate(str0_len + str1_len + 1, MEMORY_TAG_STRING); // Allocate once
+    char *result = string_reserve(str0_len + str1_len);
     kcopy_memory(result, str0, str0_len);
-    kcopy_memory(result + str0_len, str1, str1_len + 1); // Include null terminator
-    result[str0_len + str1_len] = '\0';
-    
-    // Track the allocation right after creating it
-    StringAllocation *allocation = kallocate(sizeof(StringAllocation), MEMORY_TAG_STRING);
-    allocation->string = result;
-    allocation->length = str0_len + str1_len;
-    allocation->tag = MEMORY_TAG_STRING;
-    darray_push(StringAllocation *, string_allocations, allocation);
+    kcopy_memory(result + str0_len, str1, str1_len);
     return result;
 }
 
 // Lowercase conversion with tracking
 char *string_to_lower(const char *input) {
     if (input == NULL) return NULL;
-    u32 len = strlen(input);
-    char *lowercase_str = kallocate(len + 1, MEMORY_TAG_STRING);
-    for (u32 i = 0; i < len; ++i) {
+    u64 len = strlen(input);
+    char *lowercase_str = string_reserve(len);
+    for (u64 i = 0; i < len; ++i) {
         lowercase_str[i] = input[i] >= 'A' && input[i] <= 'Z' ? input[i] + 32 : input[i];
     }
-    lowercase_str[len] = '\0';
-    string_allocate_sized(lowercase_str, len);
     return lowercase_str;
 }
 
@@ -165,42 +156,25 @@ b8 string_ends_with(const char *str, const char *substr) {
     return strncmp(str + str_len - substr_len, substr, substr_len) == 0;
 }
 
-// Splits the given string into an array of strings using the given delimiter.
-inline char *string_split_at(const char *str, const char *delimiter, u64 index) {
-    char *copy = string_duplicate(str);
-    char *token = strtok(copy, delimiter);
-    u64 i = 0;
-    while (token != null) {
-        if (i == index) {
-            char *output = string_duplicate(token);
-            kfree(copy, string_length(copy) + 1, MEMORY_TAG_STRING);
-//            vdebug("string_split_at: %s", output);
-            return output;
-        }
-        token = strtok(null, delimiter);
-        i++;
+// Copies out the part at the given index, walking the parts in place.
+char *string_split_at(const char *str, const char *delimiter, u64 index) {
+    if (str == null || delimiter == null) return null;
+    StrSplit split = sv_tokenize(sv_from(str), delimiter);
+    StrView part;
+    for (u64 i = 0; sv_split_next(&split, &part); ++i) {
+        if (i == index) return sv_to_string(part);
     }
     return null;
 }
 
-inline i32 string_split_count(const char *str, const char *delimiter) {
+i32 string_split_count(const char *str, const char *delimiter) {
     if (str == NULL || delimiter == NULL) {
         return 0; // Early return for NULL input
     }
-    
-    char *copy = strdup(str);
-    if (copy == NULL) {
-        return 0; // Failed to allocate memory for the copy
-    }
-    
+    StrSplit split = sv_tokenize(sv_from(str), delimiter);
+    StrView part;
     i32 count = 0;
-    char *token = strtok(copy, delimiter);
-    while (token != NULL) {
-        count++;
-        token = strtok(NULL, delimiter);
-    }
-    
-    kfree(copy, strlen(str) + 1, MEMORY_TAG_STRING); // Replace string_length with the correct function if necessary
+    while (sv_split_next(&split, &part)) count++;
     return count;
 }
 
@@ -220,39 +194,38 @@ char *string_replace(const char *str, const char *substr, const char *replacemen
     char *result = string_duplicate(token);
     token = strtok(null, substr);
     while (token != null) {
-        result = string_concat(result, replacement);
-        result = string_concat(result, token);
+        char *joined = string_concat(result, replacement);
+        string_deallocate(result);
+        result = string_concat(joined, token);
+        string_deallocate(joined);
         token = strtok(null, substr);
     }
-    kfree(copy, string_length(copy) + 1, MEMORY_TAG_STRING);
+    string_deallocate(copy);
     return result;
 }
 
-// Format string with tracking
+// Format string with tracking, measured first and then formatted straight into the string
 char *string_format(const char *str, ...) {
     va_list args;
-            va_start(args, str);
-    char formatted[1024]; // Assuming 1024 is enough; adjust as needed
-    vsprintf(formatted, str, args);
-            va_end(args);
-    return string_allocate(formatted);;
+    va_start(args, str);
+    va_list measured;
+    va_copy(measured, args);
+    int length = vsnprintf(null, 0, str, measured);
+    va_end(measured);
+    char *formatted = string_reserve(length > 0 ? length : 0);
+    if (length > 0) vsnprintf(formatted, length + 1, str, args);
+    va_end(args);
+    return formatted;
 }
 
 
 char *string_repeat(const char *str, u64 count) {
     if (!str) return null;
     u64 str_len = string_length(str);
-    char *result = kallocate(str_len * count + 1, MEMORY_TAG_STRING); // Allocate once
+    char *result = string_reserve(str_len * count);
     for (u64 i = 0; i < count; ++i) {
         kcopy_memory(result + i * str_len, str, str_len);
     }
-    result[str_len * count] = '\0';
-    // Track the allocation right after creating it
-    StringAllocation *allocation = kallocate(sizeof(StringAllocation), MEMORY_TAG_STRING);
-    allocation->string = result;
-    allocation->length = str_len * count;
-    allocation->tag = MEMORY_TAG_STRING;
-    darray_push(StringAllocation*, string_allocations, allocation);
     return result;
 }
 
@@ -303,56 +276,188 @@ char *string_ndup(const char *str, u64 n) {
 
 typedef struct StringBuilder {
     char *buffer;
-    size_t capacity;
-    size_t length;
+    u64 capacity;
+    // The bytes written, the buffer is always terminated right after them.
+    u64 length;
 } StringBuilder;
 
 // Initializes a new string builder
 StringBuilder *sb_new() {
-    StringBuilder *sb = (StringBuilder *) platform_allocate(sizeof(StringBuilder), false);
+    StringBuilder *sb = kallocate(sizeof(StringBuilder), MEMORY_TAG_STRING);
     sb->capacity = 256; // Initial capacity
     sb->length = 0;
-    sb->buffer = (char *) platform_allocate(sb->capacity * sizeof(char), false);
-    sb->buffer[0] = '\0'; // Ensure it's a valid C-string
+    sb->buffer = kallocate(sb->capacity, MEMORY_TAG_STRING);
     return sb;
 }
 
-// Ensures the string builder has enough capacity
-void sb_ensure_capacity(StringBuilder *sb, u32 additional_capacity) {
-    if (sb->length + additional_capacity >= sb->capacity) {
-        while (sb->length + additional_capacity >= sb->capacity) {
-            sb->capacity *= 2;
-        }
-        sb->buffer = (char *) platform_reallocate(sb->buffer, sb->capacity * sizeof(char), false);
-    }
+// Ensures the string builder has room for additional bytes and the terminator, doubling so appends stay linear.
+void sb_ensure_capacity(StringBuilder *sb, u64 additional_capacity) {
+    if (sb->length + additional_capacity < sb->capacity) return;
+    u64 capacity = sb->capacity;
+    while (sb->length + additional_capacity >= capacity) capacity *= 2;
+    char *buffer = kallocate(capacity, MEMORY_TAG_STRING);
+    kcopy_memory(buffer, sb->buffer, sb->length + 1);
+    kfree(sb->buffer, sb->capacity, MEMORY_TAG_STRING);
+    sb->buffer = buffer;
+    sb->capacity = capacity;
+}
+
+// Appends length bytes to the string builder
+void sb_append(StringBuilder *sb, const char *data, u64 length) {
+    sb_ensure_capacity(sb, length);
+    kcopy_memory(sb->buffer + sb->length, data, length);
+    sb->length += length;
+    sb->buffer[sb->length] = '\0';
 }
 
-// Appends a formatted string to the string builder
+// Appends a formatted string to the string builder, formatted straight into its buffer
 void sb_appendf(StringBuilder *sb, const char *format, ...) {
     va_list args;
-            va_start(args, format);
-    char tmp[2048]; // Temporary buffer for formatted string
-    vsnprintf(tmp, sizeof(tmp), format, args);
-            va_end(args);
-    size_t tmp_len = strlen(tmp);
-    sb_ensure_capacity(sb, tmp_len + 1);
-    strcpy(sb->buffer + sb->length, tmp);
-    sb->length += tmp_len;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+    int length = vsnprintf(sb->buffer + sb->length, sb->capacity - sb->length, format, args);
+    va_end(args);
+    // Didn't fit, the first attempt measured it.
+    if (length >= 0 && sb->length + length >= sb->capacity) {
+        sb_ensure_capacity(sb, length);
+        vsnprintf(sb->buffer + sb->length, sb->capacity - sb->length, format, retry);
+    }
+    va_end(retry);
+    if (length > 0) sb->length += length;
+    sb->buffer[sb->length] = '\0';
+}
+
+u64 sb_length(StringBuilder *sb) {
+    return sb->length;
 }
 
-// Frees the string builder and returns the built string
+// Returns a tracked copy of the built string, the builder stays usable
 char *sb_build(StringBuilder *sb) {
-    char *result = string_duplicate(sb->buffer); // Duplicate the buffer for the result
-    //add null terminator if it's not there
-    if (result[sb->length] != '\0') {
-        result[sb->length] = '\0';
-    }
+    return string_allocate_sized(sb->buffer, sb->length);
+}
+
+// Frees the string builder and hands its buffer over as the built string
+char *sb_take(StringBuilder *sb) {
+    char *result = sb->buffer;
+    // The string is freed by its length like any other, the rest of the buffer comes off the books now.
+    if (sb->capacity > sb->length + 1) kresize_report(sb->capacity, sb->length + 1, MEMORY_TAG_STRING);
+    kfree(sb, sizeof(StringBuilder), MEMORY_TAG_STRING);
     return result;
 }
 
 void sb_free(StringBuilder *sb) {
-    platform_free(sb->buffer, false); // Free the original buffer
-    platform_free(sb, false); // Free the string builder itself
+    kfree(sb->buffer, sb->capacity, MEMORY_TAG_STRING); // Free the buffer
+    kfree(sb, sizeof(StringBuilder), MEMORY_TAG_STRING); // Free the string builder itself
+}
+
+StrView sv_from(const char *str) {
+    return (StrView) {str, str ? strlen(str) : 0};
+}
+
+StrView sv_sized(const char *str, u64 length) {
+    return (StrView) {str, length};
+}
+
+StrView sv_slice(StrView view, u64 start, u64 end) {
+    if (end > view.len) end = view.len;
+    if (start > end) start = end;
+    return (StrView) {view.ptr + start, end - start};
+}
+
+b8 sv_equals(StrView a, StrView b) {
+    return a.len == b.len && (a.len == 0 || memcmp(a.ptr, b.ptr, a.len) == 0);
+}
+
+b8 sv_equals_str(StrView view, const char *str) {
+    return sv_equals(view, sv_from(str));
+}
+
+b8 sv_starts_with(StrView view, StrView prefix) {
+    return prefix.len <= view.len && (prefix.len == 0 || memcmp(view.ptr, prefix.ptr, prefix.len) == 0);
+}
+
+b8 sv_ends_with(StrView view, StrView suffix) {
+    return suffix.len <= view.len && (suffix.len == 0 || memcmp(view.ptr + view.len - suffix.len, suffix.ptr, suffix.len) == 0);
+}
+
+i64 sv_find_char(StrView view, char c) {
+    const char *found = view.len ? memchr(view.ptr, c, view.len) : null;
+    return found ? found - view.ptr : -1;
+}
+
+i64 sv_find_last_char(StrView view, char c) {
+    for (u64 i = view.len; i > 0; --i) {
+        if (view.ptr[i - 1] == c) return (i64) i - 1;
+    }
+    return -1;
+}
+
+i64 sv_find(StrView view, StrView needle) {
+    if (needle.len == 0) return 0;
+    // Only the first byte is searched for, the rest is compared where it matches.
+    for (u64 i = 0; i + needle.len <= view.len;) {
+        const char *found = memchr(view.ptr + i, needle.ptr[0], view.len - needle.len + 1 - i);
+        if (found == null) return -1;
+        i = found - view.ptr;
+        if (memcmp(found, needle.ptr, needle.len) == 0) return (i64) i;
+        i++;
+    }
+    return -1;
+}
+
+static inline b8 sv_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+StrView sv_trim(StrView view) {
+    while (view.len > 0 && sv_is_space(view.ptr[0])) {
+        view.ptr++;
+        view.len--;
+    }
+    while (view.len > 0 && sv_is_space(view.ptr[view.len - 1])) view.len--;
+    return view;
+}
+
+u64 sv_hash(StrView view) {
+    return hash64(view.ptr, view.len);
+}
+
+char *sv_to_string(StrView view) {
+    if (view.ptr == null) return null;
+    return string_allocate_sized(view.ptr, view.len);
+}
+
+StrSplit sv_split(StrView view, char delimiter) {
+    return (StrSplit) {view, null, delimiter, view.ptr == null};
+}
+
+StrSplit sv_tokenize(StrView view, const char *delimiters) {
+    return (StrSplit) {view, delimiters, '\0', view.ptr == null};
 }
 
+static inline b8 sv_split_is_delimiter(StrSplit *split, char c) {
+    return split->delimiters ? strchr(split->delimiters, c) != null && c != '\0' : c == split->delimiter;
+}
 
+b8 sv_split_next(StrSplit *split, StrView *out_part) {
+    if (split->done) return false;
+    StrView rest = split->rest;
+    u64 start = 0;
+    if (split->delimiters) {
+        while (start < rest.len && sv_split_is_delimiter(split, rest.ptr[start])) start++;
+        if (start == rest.len) {
+            split->done = true;
+            return false;
+        }
+    }
+    u64 end = start;
+    while (end < rest.len && !sv_split_is_delimiter(split, rest.ptr[end])) end++;
+    *out_part = (StrView) {rest.ptr + start, end - start};
+    if (end == rest.len) {
+        split->done = true;
+    } else {
+        split->rest = (StrView) {rest.ptr + end + 1, rest.len - end - 1};
+    }
+    return true;
+}
@@ -2,6 +2,12 @@
 
 #include "defines.h"
 
+#ifndef VSTRING_TRACKING
+// Tracks every string allocated here so strings_shutdown frees the ones never deallocated. Release builds define it
+// as 0, a string left alive is then reported as a leak instead.
+#define VSTRING_TRACKING 1
+#endif
+
 void strings_initialize();
 
 void strings_shutdown();
@@ -13,6 +19,8 @@ VAPI char *string_allocate(const char *input);
 
 VAPI char *string_allocate_empty(u64 length);
 
+// Frees a string allocated by any of the functions here that return a new one, in constant time. These strings start
+// after a header, never hand them to kfree.
 VAPI void string_deallocate(char *str);
 
 // Returns the length of the given string.
@@ -26,8 +34,8 @@ VAPI b8 strings_equal(const char *str0, const char *str1);
 // Case-insensitive string comparison. True if the same, otherwise false.
 VAPI b8 string_contains(const char *str, const char *substr);
 
-// Splits the given string into an array of strings using the given delimiter.
-// The returned array must be freed using darray_free.
+// Returns a copy of the first part of the given string before the given delimiter.
+// The returned string must be freed using string_deallocate.
 VAPI char *string_split(const char *str, const char *delimiter);
 
 VAPI b8 string_starts_with(const char *str, const char *substr);
@@ -35,8 +43,8 @@ VAPI b8 string_starts_with(const char *str, const char *substr);
 VAPI b8 string_ends_with(const char *str, const char *substr);
 
 // Combines two strings into a new string. and returns a new one.
-// The returned string must be freed using kfree.
-// The original strings are freed
+// The returned string must be freed using string_deallocate.
+// The original strings are left alone
 VAPI char *string_concat(const char *str0, const char *str1);
 
 VAPI char *string_replace(const char *str, const char *substr, const char *replacement);
@@ -44,8 +52,10 @@ VAPI char *string_replace(const char *str, const char *substr, const char *repla
 // Returns -1 if the character is not found.
 VAPI i64 string_index_of(const char *str, char c);
 
+// Counts the non empty parts between any of the delimiter characters, without allocating.
 VAPI i32 string_split_count(const char *str, const char *delimiter);
 
+// Returns a copy of the part at the given index, counted as string_split_count does. Null past the last part.
 VAPI char *string_split_at(const char *str, const char *delimiter, u64 index);
 
 VAPI char *string_trim(const char *str);
@@ -73,14 +83,92 @@ typedef struct StringBuilder StringBuilder;
 // Initializes a new string builder
 StringBuilder *sb_new();
 
-// Ensures the string builder has enough capacity
-void sb_ensure_capacity(StringBuilder *sb, u32 additional_capacity);
+// Ensures the string builder has room for additional bytes past its length
+void sb_ensure_capacity(StringBuilder *sb, u64 additional_capacity);
+
+// Appends length bytes to the string builder, they don't need to be terminated
+void sb_append(StringBuilder *sb, const char *data, u64 length);
 
 // Appends a formatted string to the string builder
 void sb_appendf(StringBuilder *sb, const char *format, ...);
 
-// Frees the string builder and returns the built string
+// The number of bytes built so far
+u64 sb_length(StringBuilder *sb);
+
+// Returns a tracked copy of the built string, the builder still has to be freed
 char *sb_build(StringBuilder *sb);
 
+// Frees the string builder and returns its buffer as the built string, free it with kfree(length + 1, MEMORY_TAG_STRING)
+// rather than string_deallocate, it has no vstring header
+char *sb_take(StringBuilder *sb);
+
 // Frees the string builder
-void sb_free(StringBuilder *sb);
\ No newline at end of file
+void sb_free(StringBuilder *sb);
+
+/**
+ * A view of part of a string, it doesn't own the bytes and they don't need to be terminated. Views are passed by value
+ * and nothing here allocates, copy one with sv_to_string where an owned string is needed.
+ */
+typedef struct StrView {
+    const char *ptr;
+    u64 len;
+} StrView;
+
+/**
+ * Walks the parts of a view between delimiters, see sv_split and sv_tokenize.
+ */
+typedef struct StrSplit {
+    // The part not walked yet.
+    StrView rest;
+    // The delimiter set of a tokenizer, null when splitting on the single delimiter.
+    const char *delimiters;
+    char delimiter;
+    // Set once the last part was handed out.
+    b8 done;
+} StrSplit;
+
+// A view of a terminated string, an empty view for null
+VAPI StrView sv_from(const char *str);
+
+// A view of length bytes
+VAPI StrView sv_sized(const char *str, u64 length);
+
+// The bytes from start up to but not including end, both clamped to the view
+VAPI StrView sv_slice(StrView view, u64 start, u64 end);
+
+// True if the views hold the same bytes
+VAPI b8 sv_equals(StrView a, StrView b);
+
+// True if the view holds the same bytes as the terminated string
+VAPI b8 sv_equals_str(StrView view, const char *str);
+
+VAPI b8 sv_starts_with(StrView view, StrView prefix);
+
+VAPI b8 sv_ends_with(StrView view, StrView suffix);
+
+// The index of the first occurrence of the character, -1 if there is none
+VAPI i64 sv_find_char(StrView view, char c);
+
+// The index of the last occurrence of the character, -1 if there is none
+VAPI i64 sv_find_last_char(StrView view, char c);
+
+// The index of the first occurrence of the needle, -1 if there is none. An empty needle is found at 0
+VAPI i64 sv_find(StrView view, StrView needle);
+
+// The view without the whitespace at either end
+VAPI StrView sv_trim(StrView view);
+
+// Hashes the bytes of the view, the same hash atoms and dicts use
+VAPI u64 sv_hash(StrView view);
+
+// Copies the view into a new tracked string, free it with string_deallocate
+VAPI char *sv_to_string(StrView view);
+
+// Splits on a single delimiter, every part is handed out including empty ones: "a//b" gives "a", "" and "b"
+VAPI StrSplit sv_split(StrView view, char delimiter);
+
+// Splits on any character of a delimiter set and skips empty parts, as strtok would but without touching the input
+VAPI StrSplit sv_tokenize(StrView view, const char *delimiters);
+
+// Moves to the next part, false once there are none left
+VAPI b8 sv_split_next(StrSplit *split, StrView *out_part);
@@ -0,0 +1,293 @@
+/**
+ * The terminal text buffer, see vterminal.h.
+ */
+#include "vterminal.h"
+#include <string.h>
+#include "vmem.h"
+#include "containers/darray.h"
+
+// The storage a line starts with, it is doubled as the line grows.
+#define TERMINAL_LINE_INITIAL_CAPACITY 32
+// The storage the input line starts with.
+#define TERMINAL_INPUT_INITIAL_CAPACITY 64
+// How far below its row a line's baseline sits, relative to the text size, leaving room for descenders.
+#define TERMINAL_ROW_DESCENT 0.25f
+
+TerminalBuffer *terminal_buffer_create(u32 capacity) {
+    TerminalBuffer *buffer = kallocate(sizeof(TerminalBuffer), MEMORY_TAG_UI);
+    buffer->capacity = capacity ? capacity : TERMINAL_DEFAULT_SCROLLBACK;
+    buffer->lines = kallocate(sizeof(TerminalLine) * buffer->capacity, MEMORY_TAG_UI);
+    buffer->input_capacity = TERMINAL_INPUT_INITIAL_CAPACITY;
+    buffer->input = kallocate(buffer->input_capacity, MEMORY_TAG_UI);
+    buffer->gap_start = 0;
+    buffer->gap_end = buffer->input_capacity;
+    buffer->rows = darray_create(TerminalRow);
+    return buffer;
+}
+
+static void terminal_line_free(TerminalLine *line) {
+    if (line->text) kfree(line->text, line->capacity, MEMORY_TAG_UI);
+    kzero_memory(line, sizeof(TerminalLine));
+}
+
+void terminal_buffer_destroy(TerminalBuffer *buffer) {
+    if (buffer == null) return;
+    if (buffer->list) {
+        u64 row_count = darray_length(buffer->rows);
+        for (u64 i = 0; i < row_count; ++i) gui_display_node_destroy(buffer->list, buffer->rows[i].node);
+    }
+    darray_destroy(buffer->rows)
+    for (u32 i = 0; i < buffer->capacity; ++i) terminal_line_free(&buffer->lines[i]);
+    kfree(buffer->lines, sizeof(TerminalLine) * buffer->capacity, MEMORY_TAG_UI);
+    kfree(buffer->input, buffer->input_capacity, MEMORY_TAG_UI);
+    kfree(buffer, sizeof(TerminalBuffer), MEMORY_TAG_UI);
+}
+
+static TerminalLine *terminal_line_at(TerminalBuffer *buffer, u32 index) {
+    return &buffer->lines[(buffer->head + index) % buffer->capacity];
+}
+
+// Starts a new empty line, dropping the oldest one once the ring is full. Its storage is reused.
+static TerminalLine *terminal_line_push(TerminalBuffer *buffer) {
+    TerminalLine *line;
+    if (buffer->count < buffer->capacity) {
+        line = terminal_line_at(buffer, buffer->count);
+        buffer->count++;
+    } else {
+        line = terminal_line_at(buffer, 0);
+        buffer->head = (buffer->head + 1) % buffer->capacity;
+        buffer->first_line++;
+    }
+    if (line->text == null) {
+        line->capacity = TERMINAL_LINE_INITIAL_CAPACITY;
+        line->text = kallocate(line->capacity, MEMORY_TAG_UI);
+    }
+    line->length = 0;
+    line->text[0] = '\0';
+    line->dirty = true;
+    return line;
+}
+
+static void terminal_line_append(TerminalLine *line, const char *text, u64 length) {
+    if (line->length + length + 1 > line->capacity) {
+        u32 capacity = line->capacity;
+        while (line->length + length + 1 > capacity) capacity *= 2;
+        char *grown = kallocate(capacity, MEMORY_TAG_UI);
+        kcopy_memory(grown, line->text, line->length);
+        kfree(line->text, line->capacity, MEMORY_TAG_UI);
+        line->text = grown;
+        line->capacity = capacity;
+    }
+    kcopy_memory(line->text + line->length, text, length);
+    line->length += (u32) length;
+    line->text[line->length] = '\0';
+    line->dirty = true;
+}
+
+void terminal_buffer_write(TerminalBuffer *buffer, const char *text, u64 length) {
+    u64 start = 0;
+    for (u64 i = 0; i <= length; ++i) {
+        b8 newline = i < length && text[i] == '\n';
+        if (i < length && !newline) continue;
+        if (i > start || newline) {
+            if (!buffer->line_open) {
+                terminal_line_push(buffer);
+                buffer->line_open = true;
+            }
+            terminal_line_append(terminal_line_at(buffer, buffer->count - 1), text + start, i - start);
+        }
+        if (newline) buffer->line_open = false;
+        start = i + 1;
+    }
+}
+
+void terminal_buffer_print(TerminalBuffer *buffer, const char *text, u64 length) {
+    terminal_buffer_write(buffer, text, length);
+    terminal_buffer_write(buffer, "\n", 1);
+}
+
+void terminal_buffer_clear(TerminalBuffer *buffer) {
+    // The sequence numbers keep counting so rows that showed the old lines are drawn again.
+    buffer->first_line += buffer->count;
+    for (u32 i = 0; i < buffer->capacity; ++i) terminal_line_free(&buffer->lines[i]);
+    buffer->head = 0;
+    buffer->count = 0;
+    buffer->scroll = 0;
+    buffer->line_open = false;
+}
+
+const TerminalLine *terminal_buffer_line(TerminalBuffer *buffer, u32 index) {
+    if (index >= buffer->count) return null;
+    return terminal_line_at(buffer, index);
+}
+
+void terminal_buffer_scroll(TerminalBuffer *buffer, i32 lines) {
+    i64 scroll = (i64) buffer->scroll + lines;
+    i64 limit = buffer->count > 0 ? (i64) buffer->count - 1 : 0;
+    if (scroll < 0) scroll = 0;
+    if (scroll > limit) scroll = limit;
+    buffer->scroll = (u32) scroll;
+}
+
+static u32 terminal_input_gap(TerminalBuffer *buffer) {
+    return buffer->gap_end - buffer->gap_start;
+}
+
+// Gets the byte at a logical offset of the input line, skipping over the gap.
+static char terminal_input_at(TerminalBuffer *buffer, u32 offset) {
+    return offset < buffer->gap_start ? buffer->input[offset] : buffer->input[offset + terminal_input_gap(buffer)];
+}
+
+static b8 terminal_is_continuation(char c) {
+    return ((u8) c & 0xC0) == 0x80;
+}
+
+// Grows the input storage so the gap holds at least the given number of bytes.
+static void terminal_input_reserve(TerminalBuffer *buffer, u64 length) {
+    if (terminal_input_gap(buffer) >= length) return;
+    u32 used = buffer->input_capacity - terminal_input_gap(buffer);
+    u32 capacity = buffer->input_capacity;
+    while (capacity - used < length) capacity *= 2;
+    char *grown = kallocate(capacity, MEMORY_TAG_UI);
+    u32 tail = buffer->input_capacity - buffer->gap_end;
+    kcopy_memory(grown, buffer->input, buffer->gap_start);
+    kcopy_memory(grown + capacity - tail, buffer->input + buffer->gap_end, tail);
+    kfree(buffer->input, buffer->input_capacity, MEMORY_TAG_UI);
+    buffer->input = grown;
+    buffer->input_capacity = capacity;
+    buffer->gap_end = capacity - tail;
+}
+
+void terminal_input_set_cursor(TerminalBuffer *buffer, u32 offset) {
+    u32 length = terminal_input_length(buffer);
+    if (offset > length) offset = length;
+    if (offset < buffer->gap_start) {
+        u32 moved = buffer->gap_start - offset;
+        memmove(buffer->input + buffer->gap_end - moved, buffer->input + offset, moved);
+        buffer->gap_start -= moved;
+        buffer->gap_end -= moved;
+    } else if (offset > buffer->gap_start) {
+        u32 moved = offset - buffer->gap_start;
+        memmove(buffer->input + buffer->gap_start, buffer->input + buffer->gap_end, moved);
+        buffer->gap_start += moved;
+        buffer->gap_end += moved;
+    }
+}
+
+u32 terminal_input_cursor(TerminalBuffer *buffer) {
+    return buffer->gap_start;
+}
+
+u32 terminal_input_length(TerminalBuffer *buffer) {
+    return buffer->input_capacity - terminal_input_gap(buffer);
+}
+
+void terminal_input_insert(TerminalBuffer *buffer, const char *text, u64 length) {
+    terminal_input_reserve(buffer, length);
+    kcopy_memory(buffer->input + buffer->gap_start, text, length);
+    buffer->gap_start += (u32) length;
+}
+
+// Finds the start of the character before the offset.
+static u32 terminal_input_previous(TerminalBuffer *buffer, u32 offset) {
+    if (offset == 0) return 0;
+    offset--;
+    while (offset > 0 && terminal_is_continuation(terminal_input_at(buffer, offset))) offset--;
+    return offset;
+}
+
+// Finds the start of the character after the one at the offset.
+static u32 terminal_input_next(TerminalBuffer *buffer, u32 offset) {
+    u32 length = terminal_input_length(buffer);
+    if (offset >= length) return length;
+    offset++;
+    while (offset < length && terminal_is_continuation(terminal_input_at(buffer, offset))) offset++;
+    return offset;
+}
+
+b8 terminal_input_backspace(TerminalBuffer *buffer) {
+    if (buffer->gap_start == 0) return false;
+    buffer->gap_start = terminal_input_previous(buffer, buffer->gap_start);
+    return true;
+}
+
+b8 terminal_input_delete(TerminalBuffer *buffer) {
+    if (buffer->gap_end == buffer->input_capacity) return false;
+    buffer->gap_end += terminal_input_next(buffer, buffer->gap_start) - buffer->gap_start;
+    return true;
+}
+
+void terminal_input_move(TerminalBuffer *buffer, i32 characters) {
+    u32 offset = buffer->gap_start;
+    for (; characters < 0; ++characters) offset = terminal_input_previous(buffer, offset);
+    for (; characters > 0; --characters) offset = terminal_input_next(buffer, offset);
+    terminal_input_set_cursor(buffer, offset);
+}
+
+void terminal_input_move_word(TerminalBuffer *buffer, i32 direction) {
+    u32 length = terminal_input_length(buffer);
+    u32 offset = buffer->gap_start;
+    if (direction > 0) {
+        while (offset < length && terminal_input_at(buffer, offset) != ' ') offset++;
+        while (offset < length && terminal_input_at(buffer, offset) == ' ') offset++;
+    } else {
+        while (offset > 0 && terminal_input_at(buffer, offset - 1) == ' ') offset--;
+        while (offset > 0 && terminal_input_at(buffer, offset - 1) != ' ') offset--;
+    }
+    terminal_input_set_cursor(buffer, offset);
+}
+
+void terminal_input_set(TerminalBuffer *buffer, const char *text, u64 length) {
+    buffer->gap_start = 0;
+    buffer->gap_end = buffer->input_capacity;
+    terminal_input_insert(buffer, text, length);
+}
+
+void terminal_input_copy(TerminalBuffer *buffer, char *out_text) {
+    u32 tail = buffer->input_capacity - buffer->gap_end;
+    kcopy_memory(out_text, buffer->input, buffer->gap_start);
+    kcopy_memory(out_text + buffer->gap_start, buffer->input + buffer->gap_end, tail);
+    out_text[buffer->gap_start + tail] = '\0';
+}
+
+b8 terminal_buffer_draw(TerminalBuffer *buffer, GuiDisplayList *list, GuiRect area, f32 text_size,
+                        const char *font_name, u32 color) {
+    if (text_size <= 0) return false;
+    buffer->list = list;
+    u32 row_count = area.height > 0 ? (u32) (area.height / text_size) : 0;
+    b8 created = false;
+    while (darray_length(buffer->rows) < row_count) {
+        TerminalRow row = {gui_display_node_create(list), TERMINAL_NO_LINE};
+        darray_push(TerminalRow, buffer->rows, row)
+        created = true;
+    }
+    while (darray_length(buffer->rows) > row_count) {
+        TerminalRow row;
+        darray_pop(buffer->rows, &row);
+        gui_display_node_destroy(list, row.node);
+    }
+    b8 relayout = buffer->layout.x != area.x || buffer->layout.y != area.y || buffer->layout.width != area.width ||
+                  buffer->layout.height != area.height || buffer->text_size != text_size || buffer->color != color;
+    buffer->layout = area;
+    buffer->text_size = text_size;
+    buffer->color = color;
+    // Rows count up from the bottom, the newest visible line sits in row 0.
+    i64 newest = (i64) buffer->first_line + buffer->count - 1 - buffer->scroll;
+    for (u32 r = 0; r < row_count; ++r) {
+        TerminalRow *row = &buffer->rows[r];
+        i64 sequence = newest - r;
+        if (sequence < (i64) buffer->first_line) {
+            if (row->line != TERMINAL_NO_LINE) gui_display_node_set_visible(list, row->node, false);
+            row->line = TERMINAL_NO_LINE;
+            continue;
+        }
+        TerminalLine *line = terminal_line_at(buffer, (u32) (sequence - (i64) buffer->first_line));
+        if (!relayout && !line->dirty && row->line == (u64) sequence) continue;
+        f32 baseline = area.y + area.height - (f32) r * text_size - text_size * TERMINAL_ROW_DESCENT;
+        gui_display_node_set_text(list, row->node, line->text, area.x, baseline, text_size, font_name, color);
+        gui_display_node_set_visible(list, row->node, true);
+        row->line = (u64) sequence;
+        line->dirty = false;
+    }
+    return created;
+}
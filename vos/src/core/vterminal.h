@@ -0,0 +1,173 @@
+/**
+ * A terminal text buffer: a fixed capacity ring of scrollback lines and a gap buffer holding the line being edited.
+ *
+ * Appending a line is constant time no matter how much scrollback there is, once the ring is full the oldest line is
+ * dropped and its storage reused. The input line is edited through a gap at the cursor, so typing and deleting only
+ * move the bytes between the old and the new cursor position.
+ *
+ * The buffer draws itself into a display list with one text node per visible row. A row is only set again when it
+ * shows a different line than last time or its line was written to, so an idle terminal with a huge scrollback costs
+ * nothing per frame.
+ */
+#pragma once
+
+#include "defines.h"
+#include "vgui_display.h"
+
+// The scrollback used when a buffer is created with a capacity of zero.
+#define TERMINAL_DEFAULT_SCROLLBACK 50000
+// Marks a row that doesn't show any line.
+#define TERMINAL_NO_LINE ((u64) -1)
+
+typedef struct TerminalLine {
+    // The text of the line, always terminated.
+    char *text;
+    u32 length;
+    u32 capacity;
+    // Set when the line is written to, cleared when it is drawn.
+    b8 dirty;
+} TerminalLine;
+
+// A visible row and the node drawing it.
+typedef struct TerminalRow {
+    u32 node;
+    // The sequence number of the line the row showed when it was last drawn, TERMINAL_NO_LINE for none.
+    u64 line;
+} TerminalRow;
+
+typedef struct TerminalBuffer {
+    // The ring of lines, the oldest one is at head.
+    TerminalLine *lines;
+    u32 capacity;
+    u32 head;
+    u32 count;
+    // The sequence number of the oldest line, it grows by one for every line dropped from the ring.
+    u64 first_line;
+    // The number of lines the view is scrolled up from the newest line.
+    u32 scroll;
+    // Whether the newest line is still being written, a write without a newline keeps it open.
+    b8 line_open;
+    // The input line, the gap sits at the cursor.
+    char *input;
+    u32 input_capacity;
+    u32 gap_start;
+    u32 gap_end;
+    // The display list the rows were created in and a darray of the rows from the bottom up.
+    GuiDisplayList *list;
+    TerminalRow *rows;
+    // The layout the rows were last drawn with, any change redraws every row.
+    GuiRect layout;
+    f32 text_size;
+    u32 color;
+} TerminalBuffer;
+
+/**
+ * Creates a terminal buffer.
+ *
+ * @param capacity The number of scrollback lines kept, zero for TERMINAL_DEFAULT_SCROLLBACK.
+ *
+ * @return The new buffer.
+ */
+VAPI TerminalBuffer *terminal_buffer_create(u32 capacity);
+
+/**
+ * Destroys the buffer, removing its rows from the display list they were drawn into.
+ */
+VAPI void terminal_buffer_destroy(TerminalBuffer *buffer);
+
+/**
+ * Appends text to the newest line, every newline starts a new line.
+ */
+VAPI void terminal_buffer_write(TerminalBuffer *buffer, const char *text, u64 length);
+
+/**
+ * Appends text as complete lines, the next write starts a new line.
+ */
+VAPI void terminal_buffer_print(TerminalBuffer *buffer, const char *text, u64 length);
+
+/**
+ * Drops every scrollback line.
+ */
+VAPI void terminal_buffer_clear(TerminalBuffer *buffer);
+
+/**
+ * Gets a scrollback line.
+ *
+ * @param index The index of the line, 0 being the oldest line still kept.
+ *
+ * @return The line, null if the index is out of range.
+ */
+VAPI const TerminalLine *terminal_buffer_line(TerminalBuffer *buffer, u32 index);
+
+/**
+ * Scrolls the view by the given number of lines, positive values scroll towards older lines. The scroll is clamped to
+ * the available scrollback.
+ */
+VAPI void terminal_buffer_scroll(TerminalBuffer *buffer, i32 lines);
+
+/**
+ * Inserts text into the input line at the cursor and moves the cursor past it.
+ */
+VAPI void terminal_input_insert(TerminalBuffer *buffer, const char *text, u64 length);
+
+/**
+ * Deletes the character before the cursor, returns false if the cursor is at the start.
+ */
+VAPI b8 terminal_input_backspace(TerminalBuffer *buffer);
+
+/**
+ * Deletes the character after the cursor, returns false if the cursor is at the end.
+ */
+VAPI b8 terminal_input_delete(TerminalBuffer *buffer);
+
+/**
+ * Moves the cursor by a number of characters, negative values move left. Stops at either end.
+ */
+VAPI void terminal_input_move(TerminalBuffer *buffer, i32 characters);
+
+/**
+ * Moves the cursor to the start of the next word, or of the previous one when direction is negative.
+ */
+VAPI void terminal_input_move_word(TerminalBuffer *buffer, i32 direction);
+
+/**
+ * Moves the cursor to a byte offset, clamped to the input line.
+ */
+VAPI void terminal_input_set_cursor(TerminalBuffer *buffer, u32 offset);
+
+/**
+ * @return The cursor position as a byte offset into the input line.
+ */
+VAPI u32 terminal_input_cursor(TerminalBuffer *buffer);
+
+/**
+ * @return The length of the input line in bytes.
+ */
+VAPI u32 terminal_input_length(TerminalBuffer *buffer);
+
+/**
+ * Replaces the input line, the cursor moves to its end.
+ */
+VAPI void terminal_input_set(TerminalBuffer *buffer, const char *text, u64 length);
+
+/**
+ * Copies the input line into a terminated string.
+ *
+ * @param out_text The buffer to copy into, it must hold terminal_input_length + 1 bytes.
+ */
+VAPI void terminal_input_copy(TerminalBuffer *buffer, char *out_text);
+
+/**
+ * Draws the visible scrollback lines as text nodes in the display list, the newest line at the bottom of the area.
+ * Only rows that show a different or changed line are set again.
+ *
+ * @param list The display list to draw into, it must stay the same for the lifetime of the buffer.
+ * @param area The area to fill with rows, one row per text_size pixels.
+ * @param text_size The font size of the lines.
+ * @param font_name The font of the lines.
+ * @param color The color of the lines.
+ *
+ * @return True if new rows were created, they sit above every node created before them.
+ */
+VAPI b8 terminal_buffer_draw(TerminalBuffer *buffer, GuiDisplayList *list, GuiRect area, f32 text_size,
+                             const char *font_name, u32 color);
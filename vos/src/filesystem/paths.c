@@ -15,37 +15,39 @@ typedef struct PathContext {
 //Static pointer to the path context.
 static PathContext *path_context = null;
 
+// Writes the normalized form of a path to out, which has room for its length and a leading slash. Returns the length
+// written, the output isn't terminated.
+static u64 path_normalize_into(char *out, StrView path) {
+    u64 j = 0; // Index for writing to out
+    
+    // Ensure it starts with a slash
+    if (path.len == 0 || path.ptr[0] != '/') {
+        out[j++] = '/';
+    }
+    
+    // Replace backslashes with slashes and skip colons
+    for (u64 i = 0; i < path.len; ++i) {
+        if (path.ptr[i] == '\\') {
+            out[j++] = '/';
+        } else if (path.ptr[i] != ':') {
+            out[j++] = path.ptr[i];
+        }
+    }
+    return j;
+}
+
 char *path_normalize(char *path) {
     if (path == null) {
         return null;
     }
-    
+    StrView view = sv_from(path);
     // Allocate enough space for the normalized path, including potential leading slash
-    char *normalized_path = string_allocate_empty(
-            string_length(path) + 2); // +1 for null terminator, +1 for potential leading slash
+    char *normalized_path = string_allocate_empty(view.len + 1);
     if (normalized_path == null) {
         // Memory allocation failed
         return null;
     }
-    
-    size_t j = 0; // Index for writing to normalized_path
-    
-    // Ensure it starts with a slash
-    if (path[0] != '/') {
-        normalized_path[j++] = '/';
-    }
-    
-    // Replace backslashes with slashes and skip colons
-    for (size_t i = 0; i < strlen(path); ++i) {
-        if (path[i] == '\\') {
-            normalized_path[j++] = '/';
-        } else if (path[i] != ':') {
-            normalized_path[j++] = path[i];
-        }
-    }
-    
-    normalized_path[j] = '\0'; // Null-terminate the modified path
-    
+    normalized_path[path_normalize_into(normalized_path, view)] = '\0'; // Null-terminate the modified path
     return normalized_path;
 }
 
@@ -62,19 +64,18 @@ char *path_relative(char *path) {
         return null;
     }
     
-    char *input_path = path_normalize(path);
-    char *root_path = path_normalize(path_root_directory());
+    // The root is normalized when it is set, only the input needs it. The relative part is moved down in place.
+    char *relative_path = path_normalize(path);
+    StrView input = sv_from(relative_path);
+    StrView root = sv_from(path_root_directory());
     // if the strings are equal, we know it's the root and just return a slash
-    if (strcmp(input_path, root_path) == 0) return string_duplicate("/");
-    if (string_starts_with(input_path, root_path)) {
-        char *relative_path = string_duplicate(input_path + string_length(root_path) + 1);
-        kfree(input_path, string_length(input_path) + 1, MEMORY_TAG_STRING);
-        kfree(root_path, string_length(root_path) + 1, MEMORY_TAG_STRING);
-//        vdebug("relative path: %s", relative_path)
-//
-        return relative_path;
+    if (sv_equals(input, root)) {
+        relative_path[1] = '\0';
+    } else if (sv_starts_with(input, root) && input.ptr[root.len] == '/') {
+        memmove(relative_path, relative_path + root.len + 1, input.len - root.len);
     }
-    return input_path;
+//    vdebug("relative path: %s", relative_path)
+    return relative_path;
 }
 
 /**
@@ -88,7 +89,7 @@ char *path_relative(char *path) {
 
 // Example modification for path_move to demonstrate the pattern:
 void initialize_paths(char *path) {
-    char *normalized = path_normalize(string_duplicate(path)); // Use string_duplicate for tracking
+    char *normalized = path_normalize(path); // Tracked, like every string path_normalize returns
     if (path_context == null) {
         path_context = kallocate(sizeof(PathContext), MEMORY_TAG_STRING); // Keep as is; non-string allocation
         path_context->root_directory = null;
@@ -123,17 +124,16 @@ char *path_absolute(char *path) {
     if (path[0] == '/') {
         return path_normalize(path); // Assuming path_normalize handles NULL correctly
     }
-    size_t total_length =
-            strlen(path_context->current_directory) + strlen(path) + 1; // +1 for the separator or terminator
-    char *absolute_path = kallocate(total_length, MEMORY_TAG_STRING);
     vdebug("current directory: %s", path_context->current_directory)
     vdebug("path: %s", path)
-    strcpy(absolute_path, path_context->current_directory);
-    strcat(absolute_path, "/"); // Ensure there's a separator
-    strcat(absolute_path, path);
-    char *result = path_normalize(absolute_path);
-    //free the absolute path
-    return result;
+    // The current directory is already normalized, the path is normalized after it, its leading slash the separator.
+    StrView current = sv_from(path_context->current_directory);
+    StrView relative = sv_from(path);
+    char *absolute_path = string_allocate_empty(current.len + relative.len + 1);
+    kcopy_memory(absolute_path, current.ptr, current.len);
+    u64 length = current.len + path_normalize_into(absolute_path + current.len, relative);
+    absolute_path[length] = '\0';
+    return absolute_path;
 }
 
 
@@ -147,11 +147,7 @@ char *path_file_name(char *path) {
     if (path == null) {
         return null;
     }
-    char *absolute_path = path_absolute(path);
-    char *file_name = string_split_at(absolute_path, "/", string_split_count(absolute_path, "/") - 1);
-    file_name = string_split_at(file_name, ".", 0);
-    kfree(absolute_path, string_length(absolute_path) + 1, MEMORY_TAG_STRING);
-    return file_name;
+    return sv_to_string(path_stem_view(sv_from(path)));
 }
 
 /**
@@ -187,13 +183,32 @@ char *path_file_extension(char *path) {
     if (path == null) {
         return null;
     }
-    char *absolute_path = path_absolute(path);
-    char *file_extension = string_split_at(absolute_path, ".", string_split_count(absolute_path, ".") - 1);
-    kfree(absolute_path, string_length(absolute_path) + 1, MEMORY_TAG_STRING);
-    return file_extension;
+    return sv_to_string(path_extension_view(sv_from(path)));
 }
 
 
+StrView path_name_view(StrView path) {
+    // Both kinds of separator, the path may not be normalized.
+    u64 start = path.len;
+    while (start > 0 && path.ptr[start - 1] != '/' && path.ptr[start - 1] != '\\') start--;
+    return sv_slice(path, start, path.len);
+}
+
+StrView path_stem_view(StrView path) {
+    StrView name = path_name_view(path);
+    // Leading dots belong to the stem, a hidden file without an extension is all stem.
+    u64 start = 0;
+    while (start < name.len && name.ptr[start] == '.') start++;
+    i64 dot = sv_find_char(sv_slice(name, start, name.len), '.');
+    return dot < 0 ? name : sv_slice(name, 0, start + dot);
+}
+
+StrView path_extension_view(StrView path) {
+    StrView name = path_name_view(path);
+    i64 dot = sv_find_last_char(name, '.');
+    return dot <= 0 ? sv_slice(name, name.len, name.len) : sv_slice(name, dot + 1, name.len);
+}
+
 /**
  * Gets the platform specific path from a path.
  * @param path The path to get the platform specific path from.
@@ -205,7 +220,7 @@ char *path_to_platform(char *path) {
         return NULL; // Added NULL check
     }
     u32 len = strlen(path);
-    char *platform_path = string_allocate_sized(path, len + 2);
+    char *platform_path = string_allocate_empty(len + 2);
     
     strcpy(platform_path, path);  // Copy the original path
     
@@ -257,3 +272,44 @@ char *path_locate_root() {
     }
     return strdup(root_path);
 }
+
+b8 path_match_segment(const char *pattern, u64 pattern_length, const char *name, u64 name_length) {
+    u64 p = 0, n = 0;
+    // The last star seen and the position in the name it was tried at, a mismatch retries it one character further.
+    u64 star = INVALID_ID_U64, retry = 0;
+    while (n < name_length) {
+        if (p < pattern_length && (pattern[p] == '?' || pattern[p] == name[n])) {
+            p++;
+            n++;
+        } else if (p < pattern_length && pattern[p] == '*') {
+            star = p++;
+            retry = n;
+        } else if (star != INVALID_ID_U64) {
+            p = star + 1;
+            n = ++retry;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern_length && pattern[p] == '*') p++;
+    return p == pattern_length;
+}
+
+b8 path_match(const char *pattern, const char *path) {
+    const char *pattern_end = strchr(pattern, '/');
+    if (pattern_end == null) pattern_end = pattern + strlen(pattern);
+    if (pattern_end - pattern == 2 && pattern[0] == '*' && pattern[1] == '*') {
+        if (*pattern_end == '\0') return true;
+        // Try the rest of the pattern at every segment boundary left, starting with none skipped.
+        for (const char *segment = path; segment != null; segment = strchr(segment, '/')) {
+            if (segment != path) segment++;
+            if (path_match(pattern_end + 1, segment)) return true;
+        }
+        return false;
+    }
+    const char *path_end = strchr(path, '/');
+    if (path_end == null) path_end = path + strlen(path);
+    if (!path_match_segment(pattern, pattern_end - pattern, path, path_end - path)) return false;
+    if (*pattern_end == '\0' || *path_end == '\0') return *pattern_end == *path_end;
+    return path_match(pattern_end + 1, path_end + 1);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "defines.h"
+#include "core/vstring.h"
 
 /**
  * Moves the current directory to the given path. If no root path is given, the current working directory will be used.
@@ -68,14 +69,14 @@ char *path_absolute(char *path);
 /**
  * Gets the file name from a path.
  * @param path The path to get the file name from.
- * @return The file name from the path.
+ * @return The file name from the path without its extension, a copy of path_stem_view to free with string_deallocate.
  */
 char *path_file_name(char *path);
 
 /**
  * Gets the file extension from a path.
  * @param path The path to get the file extension from.
- * @return The file extension from the path.
+ * @return The file extension from the path, a copy of path_extension_view to free with string_deallocate.
  */
 char *path_file_extension(char *path);
 
@@ -86,6 +87,24 @@ char *path_file_extension(char *path);
  */
 char *path_file_name_without_extension(char *path);
 
+/**
+ * Views the last segment of a path, everything after the last separator.
+ * @example path_name_view("dir/asset.tar.gz") -> "asset.tar.gz"
+ */
+StrView path_name_view(StrView path);
+
+/**
+ * Views the last segment of a path up to its first dot.
+ * @example path_stem_view("dir/asset.tar.gz") -> "asset"
+ */
+StrView path_stem_view(StrView path);
+
+/**
+ * Views what follows the last dot of the last segment of a path, empty if it has no extension.
+ * @example path_extension_view("dir/asset.tar.gz") -> "gz"
+ */
+StrView path_extension_view(StrView path);
+
 /**
  * Gets the platform specific path from a path.
  * @param path The path to get the platform specific path from.
@@ -100,4 +119,24 @@ char *path_to_platform(char *path);
  * It will search in the user's home directory if no init.lua file is found in the current working directory.
  * @return The root directory of the application.
  */
-char* path_locate_root();
\ No newline at end of file
+char* path_locate_root();
+
+/**
+ * Matches a path against a glob pattern, segment by segment. Within a segment '*' matches any run of characters and
+ * '?' any single character, neither matches a slash. A segment that is exactly "**" matches any number of whole
+ * segments, none included.
+ * @param pattern The pattern.
+ * @param path The path to match.
+ * @return True if the whole path matches the whole pattern.
+ */
+b8 path_match(const char *pattern, const char *path);
+
+/**
+ * Matches a single segment against a single pattern segment, '**' has no special meaning here.
+ * @param pattern The pattern segment, not terminated.
+ * @param pattern_length The length of the pattern segment.
+ * @param name The segment, not terminated.
+ * @param name_length The length of the segment.
+ * @return True if the whole segment matches the whole pattern segment.
+ */
+b8 path_match_segment(const char *pattern, u64 pattern_length, const char *name, u64 name_length);
@@ -0,0 +1,385 @@
+/**
+ * The asset archive format and its codec, see varchive.h.
+ */
+#include "varchive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/vlogger.h"
+#include "core/vmem.h"
+#include "core/vstring.h"
+#include "core/vhash.h"
+#include "containers/darray.h"
+#include "platform/platform.h"
+
+// Matches shorter than this cost more to encode than the literals they replace.
+#define ARCHIVE_MIN_MATCH 4
+// Matches are encoded with a 16 bit offset.
+#define ARCHIVE_MAX_OFFSET 65535
+#define ARCHIVE_HASH_BITS 12
+// An entry is only stored compressed if that saves at least an eighth of it.
+#define ARCHIVE_COMPRESS_RATIO(size) ((size) - (size) / 8)
+
+static u64 archive_align(u64 offset) {
+    return (offset + ARCHIVE_ALIGNMENT - 1) & ~((u64) ARCHIVE_ALIGNMENT - 1);
+}
+
+u64 archive_hash(const void *data, u64 size) {
+    return hash64(data, size);
+}
+
+// Codec
+//
+// The compressed stream is a list of sequences. A sequence starts with a token, the high nibble is the number of
+// literals and the low nibble the match length minus ARCHIVE_MIN_MATCH, a nibble of 15 is continued by bytes that are
+// added to it until one is below 255. The literals follow, then a little endian u16 offset back into the output and
+// the rest of the match length. The last sequence only has literals, the stream ends right after them.
+
+static u32 archive_read32(const u8 *p) {
+    u32 value;
+    memcpy(&value, p, sizeof(u32));
+    return value;
+}
+
+static b8 archive_write_length(u8 **op, const u8 *out_end, u64 length) {
+    while (length >= 255) {
+        if (*op >= out_end) return false;
+        *(*op)++ = 255;
+        length -= 255;
+    }
+    if (*op >= out_end) return false;
+    *(*op)++ = (u8) length;
+    return true;
+}
+
+// Writes a sequence of literals followed by a match, a match length of zero ends the stream.
+static b8 archive_write_sequence(u8 **op, const u8 *out_end, const u8 *literals, u64 literal_count, u64 offset,
+                                 u64 match_length) {
+    if (*op >= out_end) return false;
+    u64 match_code = match_length ? match_length - ARCHIVE_MIN_MATCH : 0;
+    u8 *token = (*op)++;
+    *token = (u8) ((literal_count < 15 ? literal_count : 15) << 4 | (match_code < 15 ? match_code : 15));
+    if (literal_count >= 15 && !archive_write_length(op, out_end, literal_count - 15)) return false;
+    if ((u64) (out_end - *op) < literal_count) return false;
+    memcpy(*op, literals, literal_count);
+    *op += literal_count;
+    if (match_length == 0) return true;
+    if (out_end - *op < 2) return false;
+    *(*op)++ = (u8) (offset & 0xff);
+    *(*op)++ = (u8) (offset >> 8);
+    if (match_code >= 15 && !archive_write_length(op, out_end, match_code - 15)) return false;
+    return true;
+}
+
+u64 archive_compress_bound(u64 size) {
+    return size + size / 255 + 16;
+}
+
+u64 archive_compress(const void *source, u64 size, void *destination, u64 capacity) {
+    const u8 *in = source;
+    const u8 *ip = in;
+    const u8 *end = in + size;
+    const u8 *anchor = in;
+    u8 *op = destination;
+    const u8 *out_end = op + capacity;
+    // The last position each hashed four bytes were seen at, plus one so zero means never.
+    u64 *table = kallocate(sizeof(u64) << ARCHIVE_HASH_BITS, MEMORY_TAG_RESOURCE);
+    b8 fits = true;
+    while (fits && ip + ARCHIVE_MIN_MATCH <= end) {
+        u32 sequence = archive_read32(ip);
+        u32 slot = (sequence * 2654435761u) >> (32 - ARCHIVE_HASH_BITS);
+        u64 position = (u64) (ip - in);
+        u64 candidate = table[slot];
+        table[slot] = position + 1;
+        if (candidate == 0 || position + 1 - candidate > ARCHIVE_MAX_OFFSET ||
+            archive_read32(in + candidate - 1) != sequence) {
+            ip++;
+            continue;
+        }
+        const u8 *match = in + candidate - 1;
+        u64 length = ARCHIVE_MIN_MATCH;
+        while (ip + length < end && match[length] == ip[length]) length++;
+        fits = archive_write_sequence(&op, out_end, anchor, (u64) (ip - anchor), (u64) (ip - match), length);
+        ip += length;
+        anchor = ip;
+    }
+    if (fits) fits = archive_write_sequence(&op, out_end, anchor, (u64) (end - anchor), 0, 0);
+    kfree(table, sizeof(u64) << ARCHIVE_HASH_BITS, MEMORY_TAG_RESOURCE);
+    return fits ? (u64) (op - (u8 *) destination) : 0;
+}
+
+static b8 archive_read_length(const u8 **ip, const u8 *in_end, u64 *length) {
+    u8 byte;
+    do {
+        if (*ip >= in_end) return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+u64 archive_decompress(const void *source, u64 size, void *destination, u64 capacity) {
+    const u8 *ip = source;
+    const u8 *in_end = ip + size;
+    u8 *out = destination;
+    u8 *op = out;
+    const u8 *out_end = out + capacity;
+    while (ip < in_end) {
+        u8 token = *ip++;
+        u64 literal_count = token >> 4;
+        if (literal_count == 15 && !archive_read_length(&ip, in_end, &literal_count)) return 0;
+        if ((u64) (in_end - ip) < literal_count || (u64) (out_end - op) < literal_count) return 0;
+        memcpy(op, ip, literal_count);
+        ip += literal_count;
+        op += literal_count;
+        if (ip == in_end) break;
+        if (in_end - ip < 2) return 0;
+        u64 offset = (u64) ip[0] | (u64) ip[1] << 8;
+        ip += 2;
+        u64 match_length = token & 0xf;
+        if (match_length == 15 && !archive_read_length(&ip, in_end, &match_length)) return 0;
+        match_length += ARCHIVE_MIN_MATCH;
+        if (offset == 0 || offset > (u64) (op - out) || (u64) (out_end - op) < match_length) return 0;
+        // Matches may overlap their own output, so they are copied forward one byte at a time.
+        const u8 *match = op - offset;
+        for (u64 i = 0; i < match_length; ++i) op[i] = match[i];
+        op += match_length;
+    }
+    return (u64) (op - out);
+}
+
+// Reading
+
+Archive *archive_open(const char *path) {
+    u64 size = 0;
+    const u8 *data = platform_map_file(path, &size);
+    if (data == null) {
+        vwarn("archive_open - Failed to map archive %s", path)
+        return null;
+    }
+    const ArchiveHeader *header = (const ArchiveHeader *) data;
+    const char *error = null;
+    if (size < sizeof(ArchiveHeader) || header->magic != ARCHIVE_MAGIC) error = "not an archive";
+    else if (header->version != ARCHIVE_VERSION) error = "unsupported version";
+    else if (header->index_offset % ARCHIVE_ALIGNMENT != 0 || header->index_offset > size ||
+             (size - header->index_offset) / sizeof(ArchiveEntry) < header->entry_count) error = "index out of range";
+    else if (header->names_offset > size || size - header->names_offset < header->names_size ||
+             (header->names_size && data[header->names_offset + header->names_size - 1] != '\0')) {
+        error = "paths out of range";
+    }
+    const ArchiveEntry *entries = error ? null : (const ArchiveEntry *) (data + header->index_offset);
+    const char *names = error ? null : (const char *) data + header->names_offset;
+    // Every entry is checked once up front so reads don't have to, including the order the lookup relies on.
+    for (u32 i = 0; entries && error == null && i < header->entry_count; ++i) {
+        const ArchiveEntry *entry = &entries[i];
+        if (entry->name_offset >= header->names_size ||
+            header->names_size - entry->name_offset <= entry->name_length ||
+            names[entry->name_offset + entry->name_length] != '\0') {
+            error = "entry path out of range";
+        } else if (entry->offset > size || size - entry->offset < entry->stored_size ||
+                   (!(entry->flags & ARCHIVE_ENTRY_COMPRESSED) && entry->stored_size != entry->size)) {
+            error = "entry contents out of range";
+        } else if (i > 0 && strcmp(names + entries[i - 1].name_offset, names + entry->name_offset) >= 0) {
+            error = "index not sorted";
+        }
+    }
+    if (error) {
+        vwarn("archive_open - Invalid archive %s: %s", path, error)
+        platform_unmap_file((void *) data, size);
+        return null;
+    }
+    Archive *archive = kallocate(sizeof(Archive), MEMORY_TAG_RESOURCE);
+    u64 path_length = string_length(path);
+    archive->path = kallocate(path_length + 1, MEMORY_TAG_STRING);
+    kcopy_memory(archive->path, path, path_length + 1);
+    archive->data = data;
+    archive->size = size;
+    archive->header = header;
+    archive->entries = entries;
+    archive->names = names;
+    return archive;
+}
+
+void archive_close(Archive *archive) {
+    if (archive == null) return;
+    platform_unmap_file((void *) archive->data, archive->size);
+    kfree(archive->path, string_length(archive->path) + 1, MEMORY_TAG_STRING);
+    kfree(archive, sizeof(Archive), MEMORY_TAG_RESOURCE);
+}
+
+const ArchiveEntry *archive_find(const Archive *archive, const char *path) {
+    u32 low = 0, high = archive->header->entry_count;
+    while (low < high) {
+        u32 middle = low + (high - low) / 2;
+        int order = strcmp(archive->names + archive->entries[middle].name_offset, path);
+        if (order == 0) return &archive->entries[middle];
+        if (order < 0) low = middle + 1;
+        else high = middle;
+    }
+    return null;
+}
+
+const char *archive_entry_path(const Archive *archive, const ArchiveEntry *entry) {
+    return archive->names + entry->name_offset;
+}
+
+const void *archive_entry_data(const Archive *archive, const ArchiveEntry *entry) {
+    return archive->data + entry->offset;
+}
+
+b8 archive_entry_read(const Archive *archive, const ArchiveEntry *entry, void *out_data) {
+    const void *stored = archive_entry_data(archive, entry);
+    if (entry->flags & ARCHIVE_ENTRY_COMPRESSED) {
+        if (archive_decompress(stored, entry->stored_size, out_data, entry->size) != entry->size) return false;
+    } else {
+        kcopy_memory(out_data, stored, entry->size);
+    }
+    return archive_hash(out_data, entry->size) == entry->hash;
+}
+
+// Packing
+
+typedef struct ArchiveSource {
+    // The path relative to the packed directory, with forward slashes.
+    char *path;
+    u64 size;
+} ArchiveSource;
+
+static char *archive_path_join(const char *parent, const char *name) {
+    u64 parent_length = parent ? string_length(parent) : 0;
+    u64 name_length = string_length(name);
+    u64 length = parent_length ? parent_length + 1 + name_length : name_length;
+    char *path = kallocate(length + 1, MEMORY_TAG_STRING);
+    if (parent_length) {
+        kcopy_memory(path, parent, parent_length);
+        path[parent_length] = '/';
+    }
+    kcopy_memory(path + (parent_length ? parent_length + 1 : 0), name, name_length + 1);
+    return path;
+}
+
+// Collects every file below the directory into the darray of sources.
+static ArchiveSource *archive_collect(const char *root, const char *relative, ArchiveSource *sources) {
+    char *system_path = relative ? archive_path_join(root, relative) : (char *) root;
+    VDirectoryList *list = platform_scan_directory(system_path);
+    if (relative) kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    if (list == null) return sources;
+    for (int i = 0; i < list->count; ++i) {
+        VDirectoryEntry *entry = &list->entries[i];
+        char *path = archive_path_join(relative, entry->name);
+        if (entry->is_directory) {
+            sources = archive_collect(root, path, sources);
+            kfree(path, string_length(path) + 1, MEMORY_TAG_STRING);
+        } else if (string_ends_with(entry->name, ARCHIVE_EXTENSION)) {
+            kfree(path, string_length(path) + 1, MEMORY_TAG_STRING);
+        } else {
+            ArchiveSource source = {path, entry->size};
+            darray_push(ArchiveSource, sources, source);
+        }
+    }
+    directory_list_free(list);
+    return sources;
+}
+
+static int archive_source_compare(const void *a, const void *b) {
+    return strcmp(((const ArchiveSource *) a)->path, ((const ArchiveSource *) b)->path);
+}
+
+static b8 archive_write_padding(FILE *file, u64 *offset) {
+    static const u8 zeros[ARCHIVE_ALIGNMENT] = {0};
+    u64 padding = archive_align(*offset) - *offset;
+    *offset += padding;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+b8 archive_pack(const char *directory, const char *output_path, b8 compress) {
+    ArchiveSource *sources = archive_collect(directory, null, darray_create(ArchiveSource));
+    u32 count = (u32) darray_length(sources);
+    // The lookup is a binary search, so the index is sorted by path.
+    qsort(sources, count, sizeof(ArchiveSource), archive_source_compare);
+
+    ArchiveHeader header = {0};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entry_count = count;
+    header.index_offset = sizeof(ArchiveHeader);
+    header.names_offset = header.index_offset + (u64) count * sizeof(ArchiveEntry);
+    ArchiveEntry *entries = kallocate((u64) (count ? count : 1) * sizeof(ArchiveEntry), MEMORY_TAG_RESOURCE);
+    for (u32 i = 0; i < count; ++i) {
+        entries[i].name_offset = header.names_size;
+        entries[i].name_length = (u32) string_length(sources[i].path);
+        header.names_size += entries[i].name_length + 1;
+    }
+
+    b8 success = false;
+    FILE *file = fopen(output_path, "wb");
+    if (file == null) {
+        verror("archive_pack - Failed to create %s", output_path)
+        goto cleanup;
+    }
+    // The header, the index and the paths are written last, once the contents have been placed.
+    u64 offset = archive_align(header.names_offset + header.names_size);
+    u8 *placeholder = kallocate(offset, MEMORY_TAG_RESOURCE);
+    b8 written = fwrite(placeholder, 1, offset, file) == offset;
+    kfree(placeholder, offset, MEMORY_TAG_RESOURCE);
+    u64 stored_total = 0, size_total = 0;
+    for (u32 i = 0; written && i < count; ++i) {
+        ArchiveEntry *entry = &entries[i];
+        char *system_path = archive_path_join(directory, sources[i].path);
+        u64 read_size = 0;
+        u8 *contents = sources[i].size ? platform_read_file(system_path, &read_size) : null;
+        kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+        if (sources[i].size && (contents == null || read_size != sources[i].size)) {
+            verror("archive_pack - Failed to read %s, or it changed while packing", sources[i].path)
+            if (contents) platform_free(contents, false);
+            written = false;
+            break;
+        }
+        entry->size = sources[i].size;
+        entry->hash = archive_hash(contents, entry->size);
+        entry->offset = offset;
+        const u8 *stored = contents;
+        entry->stored_size = entry->size;
+        u8 *compressed = null;
+        u64 bound = archive_compress_bound(entry->size);
+        if (compress && entry->size >= ARCHIVE_ALIGNMENT) {
+            compressed = kallocate(bound, MEMORY_TAG_RESOURCE);
+            u64 compressed_size = archive_compress(contents, entry->size, compressed, bound);
+            if (compressed_size && compressed_size <= ARCHIVE_COMPRESS_RATIO(entry->size)) {
+                stored = compressed;
+                entry->stored_size = compressed_size;
+                entry->flags |= ARCHIVE_ENTRY_COMPRESSED;
+            }
+        }
+        written = fwrite(stored, 1, entry->stored_size, file) == entry->stored_size;
+        offset += entry->stored_size;
+        written = written && archive_write_padding(file, &offset);
+        stored_total += entry->stored_size;
+        size_total += entry->size;
+        if (compressed) kfree(compressed, bound, MEMORY_TAG_RESOURCE);
+        if (contents) platform_free(contents, false);
+    }
+    if (written) {
+        u64 start = header.names_offset + header.names_size;
+        written = fseek(file, 0, SEEK_SET) == 0 &&
+                  fwrite(&header, sizeof(ArchiveHeader), 1, file) == 1 &&
+                  (count == 0 || fwrite(entries, sizeof(ArchiveEntry), count, file) == count);
+        for (u32 i = 0; written && i < count; ++i) {
+            written = fwrite(sources[i].path, 1, entries[i].name_length + 1, file) == entries[i].name_length + 1;
+        }
+        written = written && archive_write_padding(file, &start);
+    }
+    success = fclose(file) == 0 && written;
+    if (!success) {
+        verror("archive_pack - Failed to write %s", output_path)
+        remove(output_path);
+    } else {
+        vinfo("archive_pack - Packed %u files, %llu bytes stored for %llu bytes", count, stored_total, size_total)
+    }
+
+    cleanup:
+    for (u32 i = 0; i < count; ++i) kfree(sources[i].path, string_length(sources[i].path) + 1, MEMORY_TAG_STRING);
+    darray_destroy(sources)
+    kfree(entries, (u64) (count ? count : 1) * sizeof(ArchiveEntry), MEMORY_TAG_RESOURCE);
+    return success;
+}
@@ -0,0 +1,145 @@
+/**
+ * A single file asset archive, packed ahead of time and mounted into the vfs.
+ *
+ * The archive is mapped as a whole and read in place: a 64 byte header, a sorted index of 64 byte entries, the
+ * terminated entry paths, then the contents of every entry at a 64 byte aligned offset. Entries can be stored as is,
+ * in which case their contents are borrowed straight from the mapping, or compressed with a small built in LZ77
+ * codec. Every entry carries the hash64 of its original contents, the same hash the vfs keys file contents by.
+ *
+ * Because the index is sorted by path, an entry is found with a binary search and mounting an archive costs one open
+ * and the page faults of whatever is actually read.
+ */
+#pragma once
+
+#include <assert.h>
+#include "defines.h"
+
+// "VPAK" read as a little endian u32.
+#define ARCHIVE_MAGIC 0x4B415056
+// Version 2 hashes entries with hash64 instead of FNV-1a.
+#define ARCHIVE_VERSION 2
+// The alignment of the index, the paths and the contents of every entry.
+#define ARCHIVE_ALIGNMENT 64
+// The extension of archives mounted automatically from the root directory.
+#define ARCHIVE_EXTENSION ".vpak"
+
+// The entry is compressed, stored_size bytes decompress to size bytes.
+#define ARCHIVE_ENTRY_COMPRESSED 0x1
+
+typedef struct ArchiveHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 flags;
+    // The offset of the index, entry_count entries sorted by path.
+    u64 index_offset;
+    // The offset and size of the block of terminated paths.
+    u64 names_offset;
+    u64 names_size;
+    u8 reserved[24];
+} ArchiveHeader;
+
+typedef struct ArchiveEntry {
+    // The path of the entry relative to the mount root, an offset into the paths.
+    u64 name_offset;
+    u32 name_length;
+    u32 flags;
+    // The offset of the stored contents from the start of the archive, always aligned.
+    u64 offset;
+    // The number of bytes stored and the size of the contents once decompressed.
+    u64 stored_size;
+    u64 size;
+    // The archive_hash of the original contents.
+    u64 hash;
+    u8 reserved[16];
+} ArchiveEntry;
+
+STATIC_ASSERT(sizeof(ArchiveHeader) == ARCHIVE_ALIGNMENT, "The archive header must fill one aligned block.");
+STATIC_ASSERT(sizeof(ArchiveEntry) == ARCHIVE_ALIGNMENT, "Archive entries must fill one aligned block.");
+
+typedef struct Archive {
+    // The system path the archive was opened from.
+    char *path;
+    // The read only mapping of the whole archive.
+    const u8 *data;
+    u64 size;
+    const ArchiveHeader *header;
+    const ArchiveEntry *entries;
+    const char *names;
+} Archive;
+
+/**
+ * Maps an archive and validates its header and index.
+ *
+ * @param path The system path of the archive.
+ *
+ * @return The archive, null if it couldn't be mapped or isn't a valid archive.
+ */
+VAPI Archive *archive_open(const char *path);
+
+/**
+ * Unmaps the archive. Contents borrowed from it become invalid.
+ */
+VAPI void archive_close(Archive *archive);
+
+/**
+ * Finds an entry by path with a binary search of the index.
+ *
+ * @return The entry, null if the archive has no entry with that path.
+ */
+VAPI const ArchiveEntry *archive_find(const Archive *archive, const char *path);
+
+/**
+ * @return The terminated path of an entry.
+ */
+VAPI const char *archive_entry_path(const Archive *archive, const ArchiveEntry *entry);
+
+/**
+ * @return The stored contents of an entry inside the mapping, compressed if the entry is.
+ */
+VAPI const void *archive_entry_data(const Archive *archive, const ArchiveEntry *entry);
+
+/**
+ * Copies or decompresses the contents of an entry and checks them against the entry's hash.
+ *
+ * @param out_data The buffer to write to, it must hold entry->size bytes.
+ *
+ * @return False if the contents are corrupt.
+ */
+VAPI b8 archive_entry_read(const Archive *archive, const ArchiveEntry *entry, void *out_data);
+
+/**
+ * Hashes contents the way archive entries are hashed, with hash64, so an entry's hash is also the content hash of
+ * the vfs node it is mounted as.
+ */
+VAPI u64 archive_hash(const void *data, u64 size);
+
+/**
+ * @return The most bytes archive_compress can produce for an input of the given size.
+ */
+VAPI u64 archive_compress_bound(u64 size);
+
+/**
+ * Compresses a buffer with the archive codec.
+ *
+ * @return The compressed size, zero if it doesn't fit the capacity.
+ */
+VAPI u64 archive_compress(const void *source, u64 size, void *destination, u64 capacity);
+
+/**
+ * Decompresses a buffer compressed with archive_compress.
+ *
+ * @return The decompressed size, zero if the input is corrupt or doesn't fit the capacity.
+ */
+VAPI u64 archive_decompress(const void *source, u64 size, void *destination, u64 capacity);
+
+/**
+ * Packs every file below a directory into an archive, archives already in the directory are skipped.
+ *
+ * @param directory The system path of the directory, entry paths are relative to it.
+ * @param output_path The system path of the archive to write.
+ * @param compress Whether entries are compressed when it makes them smaller.
+ *
+ * @return False if the archive couldn't be written.
+ */
+VAPI b8 archive_pack(const char *directory, const char *output_path, b8 compress);
@@ -2,6 +2,8 @@
  * Created by jraynor on 2/13/2024.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "vfs.h"
 #include "containers/dict.h"
 #include "core/vlogger.h"
@@ -9,21 +11,67 @@
 #include "core/vstring.h"
 #include "platform/platform.h"
 #include "paths.h"
+#include "varchive.h"
 #include "containers/darray.h"
+#include "containers/ptrhash.h"
+#include "core/vmutex.h"
+#include "core/vsemaphore.h"
+#include "core/vthread.h"
+#include "core/vhash.h"
+#include "core/vatom.h"
 
 #define MAX_PATH 1024
+// The number of files a hashing thread claims at a time, enough to keep the lock out of the way.
+#define VFS_HASH_CHUNK 16
+// The smallest allocation for written contents, so a file built from small appends doesn't reallocate for each.
+#define VFS_WRITE_MIN_CAPACITY 64
 
 // File System Structure
 typedef struct FSContext {
     FsNode *root; // Root directory node
     Dict *users; // Users loaded in memory
-    Dict *nodes;// The nodes that are currently loaded in memory. They can be directories or files.
+    u32 node_count; // The number of nodes in the tree, the root included.
+    // The resident files from the most to the least recently used, and the bytes of contents they hold.
+    FsNode *newest;
+    FsNode *oldest;
+    u64 resident_bytes;
+    u64 resident_budget;
+    // A darray of the mounted archives, in mount order.
+    Archive **archives;
+    // The watched directories keyed by their watch id, null if the platform can't watch directories.
+    PtrHashTable *watches;
+    // A darray of the changes applied by the last poll, followed by the ones made through the vfs since.
+    FsChange *changes;
+    // A darray of the nodes deleted by the last poll, freed by the next one, followed by the ones deleted since.
+    FsNode **removed;
+    // How many of the changes and removed nodes the last poll handed out, the rest wait for the next one.
+    u64 changes_delivered;
+    u64 removed_delivered;
+    // A darray of the files with unflushed writes, and when the oldest of them was written.
+    FsNode **dirty;
+    f64 dirty_since;
+    // A darray of the asynchronous loads waiting on the I/O system.
+    struct VfsLoad **loads;
+    u32 next_load_id;
 } FSContext;
 
+// An asynchronous load of a file, see vfs_node_load_async.
+typedef struct VfsLoad {
+    u32 id;
+    // The I/O request currently serving the load.
+    u32 io_id;
+    // Null once the node is deleted.
+    FsNode *node;
+    // The file was written while it was read, the contents are read again.
+    b8 stale;
+    FsLoadCallback callback;
+    void *user_data;
+} VfsLoad;
+
 static FSContext *fs_context = null;
 
 /**
- * Loads all the nodes in the file system into memory, recursively.
+ * Indexes every node below the root, the directories are scanned by VFS_SCAN_THREADS threads.
  */
 void load_nodes();
 
@@ -33,15 +81,24 @@ void load_nodes();
 void unload_nodes();
 
 /**
- * @brief Loads a node from the file system into memory.
- *
- * This function loads a node from the file system into memory, regardless of whether it is a file or a directory.
- *
- * @param path The path of the node to load.
- * @return A pointer to the loaded node, or null if the node could not be loaded.
+ * Mounts the archives in the root directory, in name order so later names take priority.
  */
-FsNode *load_node(FsPath path);
+static void mount_root_archives();
 
+/**
+ * Watches a directory and every directory below it for changes.
+ */
+static void watch_tree(FsNode *node);
+
+/**
+ * Stops watching a directory and every directory below it.
+ */
+static void unwatch_tree(FsNode *node);
+
+/**
+ * Frees a node taken out of the tree and everything below it.
+ */
+static void node_free(FsNode *node);
 
 /**
  * @brief Unloads a node from memory.
@@ -77,11 +134,24 @@ b8 vfs_initialize(FsPath root) {
     initialize_paths(path_normalize(root));
     fs_context = kallocate(sizeof(FSContext), MEMORY_TAG_RESOURCE);
     fs_context->users = dict_new();
-    fs_context->nodes = dict_new();
+    fs_context->resident_budget = VFS_RESIDENT_BUDGET;
+    fs_context->archives = darray_create(Archive *);
+    fs_context->changes = darray_create(FsChange);
+    fs_context->removed = darray_create(FsNode *);
+    fs_context->loads = darray_create(VfsLoad *);
+    fs_context->dirty = darray_create(FsNode *);
     load_nodes();
-    //Collect the total nodes and tell the user how many nodes were loaded.
-    u32 total_nodes = dict_size(fs_context->nodes);
-    vinfo("vfs_initialize - Loaded %d nodes into memory.", total_nodes);
+    mount_root_archives();
+    fs_context->watches = ptr_hash_table_create(NODE_CAPACITY);
+    watch_tree(fs_context->root);
+    if (fs_context->root->data.directory.watch_id == INVALID_ID) {
+        vdebug("vfs_initialize - Directories can't be watched, changes on disk are picked up on restart.")
+        ptr_hash_table_destroy(fs_context->watches);
+        fs_context->watches = null;
+    }
+    //Collect the total nodes and tell the user how many nodes were indexed, their contents are read on demand.
+    u32 total_nodes = fs_context->node_count;
+    vinfo("vfs_initialize - Indexed %d nodes.", total_nodes);
     return true;
 }
 
@@ -90,101 +160,608 @@ void vfs_shutdown() {
         vwarn("vfs_shutdown - File system not initialized.")
         return;
     }
-    
+    u32 failed = vfs_flush(true);
+    if (failed) verror("vfs_shutdown - Failed to write %u files, their changes are lost", failed)
+    darray_destroy(fs_context->dirty)
+    if (fs_context->watches) {
+        unwatch_tree(fs_context->root);
+        ptr_hash_table_destroy(fs_context->watches);
+    }
+    // The loads still running are delivered as cancelled by the I/O system, without the tree.
+    for (u64 i = 0; i < darray_length(fs_context->loads); ++i) {
+        fs_context->loads[i]->node = null;
+        vio_cancel(fs_context->loads[i]->io_id);
+    }
+    darray_destroy(fs_context->loads)
+    for (u64 i = 0; i < darray_length(fs_context->removed); ++i) node_free(fs_context->removed[i]);
+    darray_destroy(fs_context->removed)
+    darray_destroy(fs_context->changes)
     //free/shutdown all the nodes in the system
     unload_nodes();
+    // Nothing borrows from the archives anymore.
+    for (u64 i = 0; i < darray_length(fs_context->archives); ++i) archive_close(fs_context->archives[i]);
+    darray_destroy(fs_context->archives)
     //root should have been freed by the shutdown_nodes function, at this point it should be null
     dict_delete(fs_context->users);
-    dict_delete(fs_context->nodes);
     kfree(fs_context, sizeof(FSContext), MEMORY_TAG_RESOURCE);
     fs_context = null;
     shutdown_paths();
 }
 
 
-// Loads a file from the file system into memory.
-FsNode *load_file(FsPath path) {
-    if (!fs_context) {
-        vwarn("load_file - File system not initialized.");
-        return null;
+// The directories waiting to be scanned, shared by the threads indexing the tree.
+typedef struct VfsScan {
+    kmutex lock;
+    // Signalled once per queued directory, and once per thread when the scan is finished.
+    vsemaphore work;
+    // A darray of the directory nodes waiting to be scanned.
+    FsNode **queue;
+    // The directories queued or being scanned, the scan is finished once it drops to zero.
+    u32 pending;
+    b8 finished;
+    u32 thread_count;
+    // The system path of the root, directories are opened relative to it.
+    const char *root_path;
+    // The number of nodes created, used to size the node index.
+    u32 node_count;
+} VfsScan;
+
+// Joins two paths with a slash. The string tracking isn't thread safe, so node paths are allocated directly.
+static char *vfs_path_join(const char *parent, const char *name) {
+    u64 parent_length = parent ? string_length(parent) : 0;
+    u64 name_length = string_length(name);
+    u64 length = parent_length ? parent_length + 1 + name_length : name_length;
+    char *path = kallocate(length + 1, MEMORY_TAG_STRING);
+    if (parent_length) {
+        kcopy_memory(path, parent, parent_length);
+        path[parent_length] = '/';
+        kcopy_memory(path + parent_length + 1, name, name_length);
+    } else {
+        kcopy_memory(path, name, name_length);
+    }
+    path[length] = '\0';
+    return path;
+}
+
+// Interns the path of a node, its parent's path joined to its name. Interning is thread safe, the scanning threads
+// create nodes side by side.
+static FsPath node_path_intern(const char *parent, const char *name) {
+    u64 parent_length = parent ? string_length(parent) : 0;
+    u64 name_length = string_length(name);
+    u64 length = parent_length ? parent_length + 1 + name_length : name_length;
+    if (length >= MAX_PATH) {
+        char *joined = vfs_path_join(parent, name);
+        Atom path = atom_intern_sized(joined, length);
+        kfree(joined, length + 1, MEMORY_TAG_STRING);
+        return (FsPath) path;
+    }
+    char joined[MAX_PATH];
+    if (parent_length) {
+        kcopy_memory(joined, parent, parent_length);
+        joined[parent_length] = '/';
+        kcopy_memory(joined + parent_length + 1, name, name_length);
+    } else {
+        kcopy_memory(joined, name, name_length);
+    }
+    return (FsPath) atom_intern_sized(joined, length);
+}
+
+// The system path of a node in the tree, joined to the root and converted for the platform.
+static char *node_system_path(FsNode *node) {
+    if (node->parent == null) return platform_path(path_root_directory());
+    char *joined = string_format("%s/%s", path_root_directory(), node->path);
+    char *system_path = platform_path(joined);
+    string_deallocate(joined);
+    return system_path;
+}
+
+// Orders nodes by name, the order children are kept in.
+static int node_name_compare(const void *a, const void *b) {
+    return strcmp((*(FsNode *const *) a)->name, (*(FsNode *const *) b)->name);
+}
+
+// Compares a terminated name with a segment that isn't terminated.
+static int segment_compare(const char *name, const char *segment, u64 length) {
+    int order = strncmp(name, segment, length);
+    if (order != 0) return order;
+    return name[length] == '\0' ? 0 : 1;
+}
+
+// Binary searches the sorted children of a directory. Returns the index of the child with the name, or the index it
+// would be inserted at if there is none.
+static u32 directory_search(FsNode *directory, const char *segment, u64 length, b8 *out_found) {
+    u32 low = 0, high = directory->data.directory.child_count;
+    while (low < high) {
+        u32 middle = low + (high - low) / 2;
+        int order = segment_compare(directory->data.directory.children[middle]->name, segment, length);
+        if (order == 0) {
+            *out_found = true;
+            return middle;
+        }
+        if (order < 0) low = middle + 1;
+        else high = middle;
     }
+    *out_found = false;
+    return low;
+}
+
+// Gets the child of a directory with the given name, null if there is none.
+static FsNode *directory_child(FsNode *directory, const char *segment, u64 length) {
+    if (directory->type != NODE_DIRECTORY) return null;
+    b8 found = false;
+    u32 index = directory_search(directory, segment, length, &found);
+    return found ? directory->data.directory.children[index] : null;
+}
+
+// Looks up the first length bytes of a path one segment at a time, empty segments are skipped.
+static FsNode *node_lookup(const char *path, u64 length) {
+    FsNode *node = fs_context->root;
+    u64 start = 0;
+    while (node && start < length) {
+        u64 end = start;
+        while (end < length && path[end] != '/') end++;
+        if (end > start) node = directory_child(node, path + start, end - start);
+        start = end + 1;
+    }
+    return node;
+}
+
+static FsNode *scan_node_create(FsNode *parent, const char *name, FsNodeType type) {
     FsNode *node = kallocate(sizeof(FsNode), MEMORY_TAG_RESOURCE);
-    //Make sure to sanitize the path, the path will be relative to the root. i.e:
-    // D:/root/asset.txt -> asset.txt
-    // D:/root/asset/asset.txt -> asset/asset.txt
-    node->path = path_relative(path);
-    node->type = NODE_FILE;
-    //Load the file into memory. Internally we use the real absolute path system file path,
-    // but we store the relative path in the node and use that for all operations i.e. lookups, etc.
-    if (platform_file_exists(path)) {
-        node->data.file.size = platform_file_size(path);
-        node->data.file.data = platform_read_file(path);
-        dict_set(fs_context->nodes, node->path, node);
-        vdebug("load_file - Loaded file at path: %s", node->path)
-        return node;
+    // The children of the root have the bare name as their path.
+    b8 root = parent == null || parent->parent == null;
+    node->path = node_path_intern(root ? null : parent->path, name);
+    node->name = node->path + (root ? 0 : string_length(parent->path) + 1);
+    node->parent = parent;
+    node->type = type;
+    if (type == NODE_DIRECTORY) node->data.directory.watch_id = INVALID_ID;
+    return node;
+}
+
+// Lists a directory, creates its children and queues its subdirectories. Runs on any of the scanning threads.
+static void scan_directory(VfsScan *scan, FsNode *dir_node) {
+    b8 root = dir_node->parent == null;
+    char *system_path = root ? (char *) scan->root_path : vfs_path_join(scan->root_path, dir_node->path);
+    // The listing carries the type of each entry and the size of each file, no path is stat'ed on its own.
+    VDirectoryList *list = platform_scan_directory(system_path);
+    if (!root) kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    if (list == null) {
+        vwarn("scan_directory - Failed to open directory at path: %s", dir_node->path)
+        return;
     }
-    vwarn("load_file - Failed to load file at path: %s", node->path);
-    kfree(node, sizeof(FsNode), MEMORY_TAG_RESOURCE);
-    return null;
+    dir_node->data.directory.children = darray_reserve(FsNode *, list->count > 0 ? list->count : 1);
+    FsNode **subdirectories = null;
+    if (list->count > 0) subdirectories = kallocate(list->count * sizeof(FsNode *), MEMORY_TAG_RESOURCE);
+    u32 subdirectory_count = 0;
+    for (int i = 0; i < list->count; i++) {
+        VDirectoryEntry *entry = &list->entries[i];
+        // Left behind by a flush that didn't finish, the file it was meant for still has its old contents.
+        if (string_ends_with(entry->name, VFS_TEMP_SUFFIX)) continue;
+        FsNode *child = scan_node_create(dir_node, entry->name, entry->is_directory ? NODE_DIRECTORY : NODE_FILE);
+        if (entry->is_directory) subdirectories[subdirectory_count++] = child;
+        else child->data.file.size = entry->size;
+        darray_push(FsNode *, dir_node->data.directory.children, child);
+        dir_node->data.directory.child_count++;
+    }
+    // The listing comes in whatever order the file system keeps, the index needs it sorted.
+    qsort(dir_node->data.directory.children, dir_node->data.directory.child_count, sizeof(FsNode *), node_name_compare);
+    kmutex_lock(&scan->lock);
+    for (u32 i = 0; i < subdirectory_count; i++) darray_push(FsNode *, scan->queue, subdirectories[i]);
+    scan->pending += subdirectory_count;
+    scan->node_count += dir_node->data.directory.child_count;
+    kmutex_unlock(&scan->lock);
+    for (u32 i = 0; i < subdirectory_count; i++) vsemaphore_signal(&scan->work);
+    if (subdirectories) kfree(subdirectories, list->count * sizeof(FsNode *), MEMORY_TAG_RESOURCE);
+    directory_list_free(list);
 }
 
-// Loads a directory from the file system into memory.
-FsNode *load_directory(FsPath path) {
-    if (!fs_context) {
-        vwarn("load_directory - File system not initialized.");
-        return null;
+// Takes directories off the queue until the whole tree has been scanned.
+static u32 scan_worker(void *params) {
+    VfsScan *scan = params;
+    while (true) {
+        vsemaphore_wait(&scan->work, 0);
+        kmutex_lock(&scan->lock);
+        if (scan->finished) {
+            kmutex_unlock(&scan->lock);
+            break;
+        }
+        FsNode *dir_node = null;
+        darray_pop(scan->queue, &dir_node);
+        kmutex_unlock(&scan->lock);
+        
+        scan_directory(scan, dir_node);
+        
+        kmutex_lock(&scan->lock);
+        b8 finished = --scan->pending == 0;
+        if (finished) scan->finished = true;
+        kmutex_unlock(&scan->lock);
+        // Nothing is queued anymore, wake every thread so it sees the scan is finished.
+        if (finished) for (u32 i = 0; i < scan->thread_count; i++) vsemaphore_signal(&scan->work);
     }
-    FsNode *dir_node = kallocate(sizeof(FsNode), MEMORY_TAG_RESOURCE);
-    dir_node->path = path_relative(path);
-    dir_node->type = NODE_DIRECTORY;
-    dir_node->data.directory.children = null; // Initialize to null
-    dir_node->data.directory.child_count = 0; // Initialize count to 0
-    
-    dict_set(fs_context->nodes, dir_node->path, dir_node);
-    vdebug("load_directory - Loaded directory at path: %s", dir_node->path);
-    
-    // Loads all the files and directories in the directory into memory.
-    VFilePathList *child_files = platform_collect_files_direct(path);
-    if (child_files == null) {
-        vwarn("load_directory - No files found in directory at path: %s", dir_node->path);
-        return null;
+    return 0;
+}
+
+// Counts a node and everything below it.
+static u32 tree_size(FsNode *node) {
+    u32 count = 1;
+    if (node->type != NODE_DIRECTORY) return count;
+    for (u32 i = 0; i < node->data.directory.child_count; i++) count += tree_size(node->data.directory.children[i]);
+    return count;
+}
+
+static void resident_unlink(FsNode *node) {
+    if (node->data.file.newer) node->data.file.newer->data.file.older = node->data.file.older;
+    else if (fs_context->newest == node) fs_context->newest = node->data.file.older;
+    if (node->data.file.older) node->data.file.older->data.file.newer = node->data.file.newer;
+    else if (fs_context->oldest == node) fs_context->oldest = node->data.file.newer;
+    node->data.file.newer = null;
+    node->data.file.older = null;
+}
+
+static void resident_push(FsNode *node) {
+    node->data.file.older = fs_context->newest;
+    node->data.file.newer = null;
+    if (fs_context->newest) fs_context->newest->data.file.newer = node;
+    fs_context->newest = node;
+    if (fs_context->oldest == null) fs_context->oldest = node;
+}
+
+// Drops the contents of a file, the node stays indexed and is read again on its next access.
+static void file_evict(FsNode *node) {
+    if (node->data.file.data == null) return;
+    resident_unlink(node);
+    // Stored archive entries are borrowed from the archive's mapping, there is nothing to release.
+    if (node->data.file.mapped) {
+        if (!node->data.file.archive) platform_unmap_file(node->data.file.data, node->data.file.size);
+    } else {
+        u64 capacity = node->data.file.capacity;
+        kfree(node->data.file.data, capacity ? capacity : node->data.file.size, MEMORY_TAG_RESOURCE);
     }
-    
-    // Allocate memory for children pointers based on count
-    dir_node->data.directory.children = kallocate(child_files->count * sizeof(FsNode *), MEMORY_TAG_RESOURCE);
-    for (int i = 0; i < child_files->count; i++) {
-        char *file_path = child_files->paths[i];
-        FsNode *child_node = load_node(string_duplicate(file_path));
-        if (child_node == null) {
-            vwarn("load_directory - Failed to load child node at path: %s", file_path);
-            continue;
+    node->data.file.data = null;
+    node->data.file.mapped = false;
+    node->data.file.capacity = 0;
+    fs_context->resident_bytes -= node->data.file.size;
+    vdebug("file_evict - Evicted file at path: %s", node->path)
+}
+
+// Evicts the least recently used unpinned files until the resident contents fit the budget. Unflushed writes stay,
+// they count against the budget until the next flush.
+static void resident_trim(FsNode *keep) {
+    FsNode *node = fs_context->oldest;
+    while (node && fs_context->resident_bytes > fs_context->resident_budget) {
+        FsNode *newer = node->data.file.newer;
+        if (node != keep && node->data.file.pin_count == 0 && !node->data.file.dirty) file_evict(node);
+        node = newer;
+    }
+}
+
+// Counts newly loaded contents as resident and evicts older files past the budget.
+static void resident_add(FsNode *node) {
+    fs_context->resident_bytes += node->data.file.size;
+    resident_push(node);
+    resident_trim(node);
+}
+
+// Loads a file from its archive, stored entries are borrowed from the mapping and compressed ones decompressed.
+static b8 archive_node_load(FsNode *node) {
+    Archive *archive = node->data.file.archive;
+    const ArchiveEntry *entry = node->data.file.archive_entry;
+    if (entry->flags & ARCHIVE_ENTRY_COMPRESSED) {
+        char *data = kallocate(entry->size, MEMORY_TAG_RESOURCE);
+        if (!archive_entry_read(archive, entry, data)) {
+            vwarn("archive_node_load - Corrupt entry %s in archive %s", node->path, archive->path)
+            kfree(data, entry->size, MEMORY_TAG_RESOURCE);
+            return false;
         }
-        child_node->parent = dir_node; // Set the parent of the node to the current directory.
-        dir_node->data.directory.children[dir_node->data.directory.child_count++] = child_node; // Add the child to the directory.
+        node->data.file.data = data;
+    } else {
+        node->data.file.data = (char *) archive_entry_data(archive, entry);
+        node->data.file.mapped = true;
     }
-    file_path_list_free(child_files);
-    return dir_node;
+    resident_add(node);
+    vdebug("archive_node_load - Loaded file at path: %s from %s", node->path, archive->path)
+    return true;
 }
 
-//Loads a node from the file system into memory, doesn't care if it's a file or directory.
-FsNode *load_node(FsPath path) {
-    if (!fs_context) {
-        vwarn("load_node - File system not initialized.");
-        return null;
+b8 vfs_node_load(FsNode *node) {
+    if (fs_context == null || node == null || node->type != NODE_FILE) return false;
+    if (node->data.file.data) {
+        resident_unlink(node);
+        resident_push(node);
+        return true;
     }
-    char *system_path = platform_path(path);
-    FsNode *node = null;
-    if (platform_file_exists(system_path)) {
-        if (platform_is_directory(system_path))
-            node = load_directory(system_path);
-        else node = load_file(system_path);
+    if (node->data.file.archive) return archive_node_load(node);
+    char *system_path = node_system_path(node);
+    char *data = null;
+    if (node->data.file.size >= VFS_MAP_THRESHOLD) {
+        // The mapping is as large as the file is now, which may differ from what was indexed.
+        u64 size = 0;
+        data = platform_map_file(system_path, &size);
+        if (data) {
+            node->data.file.size = size;
+            node->data.file.mapped = true;
+            platform_advise_mapping(data, size, (platform_map_advice) node->data.file.access);
+        }
     }
-    if (node == null) {
-        vwarn("load_node - Failed to load node at path: %s", path)
-        return null;
+    if (data == null) {
+        // The file may have changed since it was indexed, the contents are as large as what was read.
+        u64 size = 0;
+        data = platform_read_file(system_path, &size);
+        if (data) {
+            node->data.file.size = size;
+            // The platform reads into its own allocation, account for it so evicting it balances the books.
+            kallocate_report(size, MEMORY_TAG_RESOURCE);
+        }
     }
     kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
-    return node;
+    if (data == null) {
+        vwarn("vfs_node_load - Failed to read file at path: %s", node->path)
+        return false;
+    }
+    node->data.file.data = data;
+    resident_add(node);
+    vdebug("vfs_node_load - %s file at path: %s", node->data.file.mapped ? "Mapped" : "Loaded", node->path)
+    return true;
+}
+
+// Hashes the contents of a file without making them resident: resident contents are hashed in place and files on
+// disk are mapped for as long as it takes. Touches nothing shared, so the threads hashing a tree run it side by side.
+static b8 file_hash(FsNode *node, const char *root_path) {
+    if (node->data.file.archive) {
+        node->data.file.hash = node->data.file.archive_entry->hash;
+    } else if (node->data.file.data) {
+        node->data.file.hash = hash64(node->data.file.data, node->data.file.size);
+    } else {
+        char *system_path = vfs_path_join(root_path, node->path);
+        u64 size = 0;
+        void *data = platform_map_file(system_path, &size);
+        // Empty files can't be mapped, they still have a hash.
+        b8 empty = data == null && platform_is_file(system_path) && platform_file_size(system_path) == 0;
+        kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+        if (data == null && !empty) return false;
+        node->data.file.hash = hash64(data, size);
+        if (data) platform_unmap_file(data, size);
+    }
+    node->data.file.hashed = true;
+    return true;
+}
+
+b8 vfs_node_hash(FsNode *node, u64 *out_hash) {
+    if (fs_context == null || node == null || node->type != NODE_FILE) return false;
+    if (!node->data.file.hashed) {
+        char *root_path = platform_path(path_root_directory());
+        b8 hashed = file_hash(node, root_path);
+        kfree(root_path, string_length(root_path) + 1, MEMORY_TAG_STRING);
+        if (!hashed) {
+            vwarn("vfs_node_hash - Failed to read file at path: %s", node->path)
+            return false;
+        }
+    }
+    if (out_hash) *out_hash = node->data.file.hash;
+    return true;
+}
+
+// The files waiting to be hashed, shared by the threads hashing a tree.
+typedef struct VfsHash {
+    kmutex lock;
+    // A darray of the files, handed out in chunks from next on.
+    FsNode **files;
+    u32 next;
+    // The number of files that couldn't be read.
+    u32 failed;
+    // The system path of the root, files are mapped relative to it.
+    const char *root_path;
+} VfsHash;
+
+// Claims chunks of files until every one is handed out.
+static u32 hash_worker(void *params) {
+    VfsHash *job = params;
+    u32 count = darray_length(job->files);
+    u32 failed = 0;
+    while (true) {
+        kmutex_lock(&job->lock);
+        u32 first = job->next;
+        job->next = first + VFS_HASH_CHUNK < count ? first + VFS_HASH_CHUNK : count;
+        u32 last = job->next;
+        kmutex_unlock(&job->lock);
+        if (first == last) break;
+        for (u32 i = first; i < last; i++) {
+            if (!file_hash(job->files[i], job->root_path)) failed++;
+        }
+    }
+    kmutex_lock(&job->lock);
+    job->failed += failed;
+    kmutex_unlock(&job->lock);
+    return 0;
+}
+
+// Collects the files below a node that have no hash yet.
+static FsNode **collect_unhashed(FsNode *node, FsNode **files) {
+    if (node->type == NODE_FILE) {
+        if (!node->data.file.hashed) darray_push(FsNode *, files, node);
+        return files;
+    }
+    if (node->type != NODE_DIRECTORY) return files;
+    for (u32 i = 0; i < node->data.directory.child_count; i++) {
+        files = collect_unhashed(node->data.directory.children[i], files);
+    }
+    return files;
+}
+
+u32 vfs_hash_tree(FsNode *node) {
+    if (fs_context == null) {
+        vwarn("vfs_hash_tree - File system not initialized.");
+        return 0;
+    }
+    f64 start = platform_get_absolute_time();
+    VfsHash job = {0};
+    job.files = collect_unhashed(node ? node : fs_context->root, darray_create(FsNode *));
+    u32 count = darray_length(job.files);
+    if (count == 0) {
+        darray_destroy(job.files)
+        return 0;
+    }
+    job.root_path = platform_path(path_root_directory());
+    kmutex_create(&job.lock);
+    // Nothing else touches the tree until the hashing threads are done, the calling thread hashes along with them.
+    i32 processors = platform_get_processor_count();
+    u32 thread_count = processors < VFS_SCAN_THREADS ? processors : VFS_SCAN_THREADS;
+    u32 chunks = (count + VFS_HASH_CHUNK - 1) / VFS_HASH_CHUNK;
+    if (thread_count > chunks) thread_count = chunks;
+    kthread threads[VFS_SCAN_THREADS > 1 ? VFS_SCAN_THREADS - 1 : 1];
+    u32 started = 0;
+    for (u32 i = 1; i < thread_count; i++) {
+        if (!kthread_create(hash_worker, &job, false, &threads[started])) break;
+        started++;
+    }
+    hash_worker(&job);
+    for (u32 i = 0; i < started; i++) {
+        kthread_wait(&threads[i]);
+        kthread_destroy(&threads[i]);
+    }
+    kmutex_destroy(&job.lock);
+    kfree((char *) job.root_path, string_length(job.root_path) + 1, MEMORY_TAG_STRING);
+    darray_destroy(job.files)
+    if (job.failed) vwarn("vfs_hash_tree - Failed to read %u of %u files", job.failed, count)
+    (void) start; // Without debug logging the timing below isn't printed.
+    vdebug("vfs_hash_tree - Hashed %u files with %u threads in %.2f ms", count - job.failed, started + 1,
+           (platform_get_absolute_time() - start) * 1000.0)
+    return job.failed;
+}
+
+static void load_complete(IoCompletion *completion);
+
+// Starts the I/O serving a load. A resident or archived file needs none, it is loaded here and delivered by the next
+// poll like everything else.
+static void load_submit(VfsLoad *load) {
+    FsNode *node = load->node;
+    if (node->data.file.data || node->data.file.archive) {
+        vfs_node_load(node);
+        load->io_id = vio_post(load_complete, load);
+        return;
+    }
+    char *system_path = node_system_path(node);
+    b8 map = node->data.file.size >= VFS_MAP_THRESHOLD;
+    IoRequest request = {map ? IO_OPERATION_MAP : IO_OPERATION_READ, system_path,
+                         (platform_map_advice) node->data.file.access, load_complete, load};
+    load->io_id = INVALID_ID;
+    vio_submit(&request, 1, &load->io_id);
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+}
+
+// Takes the contents read by an I/O thread, unless the file was loaded some other way in the meantime.
+static b8 load_install(FsNode *node, IoCompletion *completion) {
+    if (node->data.file.data) {
+        resident_unlink(node);
+        resident_push(node);
+        return true;
+    }
+    if (completion->operation == IO_OPERATION_POST) return false;
+    // Empty files have no contents to hand over, the loader gives them a buffer of their own.
+    if (completion->data == null) return vfs_node_load(node);
+    node->data.file.data = completion->data;
+    node->data.file.size = completion->size;
+    node->data.file.mapped = completion->operation == IO_OPERATION_MAP;
+    completion->data = null;
+    resident_add(node);
+    vdebug("load_complete - %s file at path: %s", node->data.file.mapped ? "Mapped" : "Loaded", node->path)
+    return true;
+}
+
+// Delivers a load once its I/O completes.
+static void load_complete(IoCompletion *completion) {
+    VfsLoad *load = completion->user_data;
+    FsNode *node = load->node;
+    IoStatus status = completion->status;
+    if (node && status == IO_STATUS_OK && load->stale) {
+        load->stale = false;
+        load_submit(load);
+        if (load->io_id != INVALID_ID) return;
+        status = IO_STATUS_FAILED;
+    }
+    if (fs_context) darray_remove(fs_context->loads, &load);
+    if (node == null) status = IO_STATUS_CANCELLED;
+    else if (status == IO_STATUS_OK && !load_install(node, completion)) status = IO_STATUS_FAILED;
+    if (status == IO_STATUS_FAILED && node) vwarn("vfs_node_load_async - Failed to read file at path: %s", node->path)
+    if (load->callback) load->callback(node, status, load->user_data);
+    kfree(load, sizeof(VfsLoad), MEMORY_TAG_RESOURCE);
+}
+
+u32 vfs_node_load_async(FsNode *node, FsLoadCallback callback, void *user_data) {
+    if (fs_context == null || node == null || node->type != NODE_FILE) return INVALID_ID;
+    VfsLoad *load = kallocate(sizeof(VfsLoad), MEMORY_TAG_RESOURCE);
+    if (++fs_context->next_load_id == INVALID_ID) fs_context->next_load_id = 1;
+    load->id = fs_context->next_load_id;
+    load->node = node;
+    load->callback = callback;
+    load->user_data = user_data;
+    load_submit(load);
+    if (load->io_id == INVALID_ID) {
+        kfree(load, sizeof(VfsLoad), MEMORY_TAG_RESOURCE);
+        return INVALID_ID;
+    }
+    darray_push(VfsLoad *, fs_context->loads, load);
+    return load->id;
+}
+
+b8 vfs_node_cancel_load(u32 load_id) {
+    if (fs_context == null || load_id == INVALID_ID) return false;
+    for (u64 i = 0; i < darray_length(fs_context->loads); ++i) {
+        if (fs_context->loads[i]->id == load_id) return vio_cancel(fs_context->loads[i]->io_id);
+    }
+    return false;
+}
+
+// Lets go of a deleted file in every load of it, they are delivered as cancelled.
+static void loads_detach(FsNode *node) {
+    for (u64 i = 0; i < darray_length(fs_context->loads); ++i) {
+        VfsLoad *load = fs_context->loads[i];
+        if (load->node != node) continue;
+        load->node = null;
+        vio_cancel(load->io_id);
+    }
+}
+
+b8 vfs_node_pin(FsNode *node) {
+    if (!vfs_node_load(node)) return false;
+    node->data.file.pin_count++;
+    return true;
+}
+
+void vfs_node_unpin(FsNode *node) {
+    if (node == null || node->type != NODE_FILE || node->data.file.pin_count == 0) return;
+    node->data.file.pin_count--;
+    if (node->data.file.pin_count == 0) resident_trim(null);
+}
+
+void *vfs_node_map(FsNode *node, u64 *out_size) {
+    if (fs_context == null || node == null || node->type != NODE_FILE || node->data.file.archive) return null;
+    // The file on disk is behind the written contents.
+    if (node->data.file.dirty) return null;
+    char *system_path = node_system_path(node);
+    void *data = platform_map_file(system_path, out_size);
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    if (data) platform_advise_mapping(data, *out_size, (platform_map_advice) node->data.file.access);
+    return data;
+}
+
+void vfs_node_advise(FsNode *node, FsAccess access) {
+    if (node == null || node->type != NODE_FILE || node->data.file.access == access) return;
+    node->data.file.access = access;
+    // An archive entry isn't page aligned, only mappings of their own take advice.
+    if (node->data.file.mapped && !node->data.file.archive) {
+        platform_advise_mapping(node->data.file.data, node->data.file.size, (platform_map_advice) access);
+    }
+}
+
+void vfs_set_resident_budget(u64 bytes) {
+    if (fs_context == null) return;
+    fs_context->resident_budget = bytes;
+    resident_trim(null);
+}
+
+u64 vfs_resident_bytes() {
+    return fs_context ? fs_context->resident_bytes : 0;
 }
 
 // Unloads a file from memory
@@ -204,10 +781,9 @@ b8 unload_file(FsNode *node) {
     }
     
     vdebug("unload_file - Unloaded file at path: %s", path);
-    kfree(node->data.file.data, node->data.file.size, MEMORY_TAG_RESOURCE);
+    file_evict(node);
+    fs_context->node_count--;
     kfree(node, sizeof(FsNode), MEMORY_TAG_RESOURCE);
-    
-    dict_remove(fs_context->nodes, path);
     return true;
 }
 
@@ -232,13 +808,15 @@ b8 unload_directory(FsNode *node) {
     for (u32 i = 0; i < node->data.directory.child_count; i++) {
         unload_node(node->data.directory.children[i]);
     }
-    // Free the children array
-    kfree(node->data.directory.children, node->data.directory.child_count * sizeof(FsNode *), MEMORY_TAG_RESOURCE);
+    // Free the children array, a directory that couldn't be listed never got one
+    if (node->data.directory.children) {
+        darray_destroy(node->data.directory.children)
+    }
     node->data.directory.children = null; // Ensure pointer is NULL after free
     node->data.directory.child_count = 0; // Reset count to 0
     
     vdebug("unload_directory - Unloaded folder at path: %s", path);
-    dict_remove(fs_context->nodes, path);
+    fs_context->node_count--;
     kfree(node, sizeof(FsNode), MEMORY_TAG_RESOURCE);
     return true;
 }
@@ -256,22 +834,63 @@ b8 unload_node(FsNode *node) {
     return false;
 }
 
-void load_nodes() {
-    //Loads all the nodes in the file system into memory, recursively.
-    FsNode *root = load_node(path_root_directory());
-    //iterate children to make sure they are loaded.
-    // Iterate the children of the root node to make sure they are loaded.
-    for (u32 i = 0; i < root->data.directory.child_count; i++) {
-        FsNode *child = root->data.directory.children[i];
-        vdebug("load_nodes - Loaded child node at path: %s\n%s", child->path, vfs_node_to_string(child));
+// Scans everything below a directory node with up to thread_count threads, the calling thread included. Returns the
+// number of nodes created.
+static u32 scan_tree(FsNode *directory, u32 thread_count) {
+    VfsScan scan = {0};
+    scan.root_path = platform_path(path_root_directory());
+    scan.queue = darray_create(FsNode *);
+    scan.thread_count = thread_count < 1 ? 1 : thread_count;
+    kmutex_create(&scan.lock);
+    // The count is bounded by the number of directories, the maximum only matters where the platform enforces one.
+    vsemaphore_create(&scan.work, 0x7fffffff, 0);
+    darray_push(FsNode *, scan.queue, directory);
+    scan.pending = 1;
+    vsemaphore_signal(&scan.work);
+    
+    // The calling thread scans too, the others only help with wide trees.
+    kthread threads[VFS_SCAN_THREADS > 1 ? VFS_SCAN_THREADS - 1 : 1];
+    u32 started = 0;
+    for (u32 i = 1; i < scan.thread_count; i++) {
+        if (!kthread_create(scan_worker, &scan, false, &threads[started])) break;
+        started++;
     }
+    // Threads that failed to start still get woken when the scan finishes, the extra signals are harmless.
+    scan_worker(&scan);
+    for (u32 i = 0; i < started; i++) {
+        kthread_wait(&threads[i]);
+        kthread_destroy(&threads[i]);
+    }
+    vsemaphore_destroy(&scan.work);
+    kmutex_destroy(&scan.lock);
+    darray_destroy(scan.queue)
+    kfree((char *) scan.root_path, string_length(scan.root_path) + 1, MEMORY_TAG_STRING);
+    return scan.node_count;
+}
+
+void load_nodes() {
+    f64 start = platform_get_absolute_time();
+    (void) start; // Only read by the debug log at the end.
+    // More threads than cores only fight over the allocator lock.
+    i32 processors = platform_get_processor_count();
+    u32 thread_count = processors < VFS_SCAN_THREADS ? processors : VFS_SCAN_THREADS;
+    FsNode *root = kallocate(sizeof(FsNode), MEMORY_TAG_RESOURCE);
+    root->path = node_path_intern(null, "/");
+    root->name = root->path + 1;
+    root->type = NODE_DIRECTORY;
+    root->data.directory.watch_id = INVALID_ID;
+    // Every directory is listed and sorted by the scan, the tree is the index.
+    fs_context->node_count = scan_tree(root, thread_count) + 1;
     fs_context->root = root;
-    
+    vdebug("load_nodes - Scanned %d nodes with %d threads in %.2f ms", fs_context->node_count,
+           thread_count < 1 ? 1 : thread_count,
+           (platform_get_absolute_time() - start) * 1000.0)
 }
 
 void unload_nodes() {
     //we just need to unload the root node, the root node will recursively unload all the children.
-    u8 count = dict_size(fs_context->nodes);
+    u32 count = fs_context->node_count;
+    (void) count; // Unloading counts the nodes down, the log reports how many there were.
     if (fs_context->root) {
         unload_node(fs_context->root);
         fs_context->root = null;
@@ -281,59 +900,27 @@ void unload_nodes() {
 }
 
 
-char *node_tree_to_string(FsNode *node, int depth) {
-    if (node == NULL) {
-        return string_duplicate(""); // Return an empty string for easy concatenation
-    }
-    
-    char *result = NULL;
-    // Calculate indentation for depth, adjusting for the root node's representation
-    char *indent = depth > 1 ? string_repeat("   ", depth - 1) : string_duplicate("");
-    
-    // Determine the prefix based on the node's type and its depth
-    // For the root node, use a special case to skip the initial slash in its display
-    char *prefix = (depth == 1) ? "@--/" : (node->type == NODE_DIRECTORY ? "@--" : "$--");
-    
-    // Adjust the displayPath formatting for the root node to directly include the prefix without an additional slash
-    char *displayPath;
+// Appends a line for a node and, below a directory, for everything in it.
+static void node_tree_append(StringBuilder *sb, FsNode *node, int depth) {
+    // The root is shown as the bare prefix, everything else indented by its depth.
     if (depth == 1) {
-        displayPath = string_duplicate(prefix); // For the root, displayPath is just the prefix
+        sb_append(sb, "@--/\n", 5);
     } else {
-        // For non-root nodes, append the node path, adding a slash for directories
-        displayPath = string_format("%s%s%s", indent, prefix, node->path);
-        if (node->type == NODE_DIRECTORY) {
-            char *temp = displayPath;
-            displayPath = string_format("%s/", displayPath); // Append slash for directories
-            kfree(temp, string_length(temp) + 1, MEMORY_TAG_STRING);
-        }
+        for (int i = 1; i < depth; ++i) sb_append(sb, "   ", 3);
+        sb_appendf(sb, "%s%s%s\n", node->type == NODE_DIRECTORY ? "@--" : "$--", node->path,
+                   node->type == NODE_DIRECTORY ? "/" : "");
     }
-    
-    // Initialize formatted line with the display path and a newline
-    char *formattedLine = string_format("%s\n", displayPath);
-    
-    // Handle children for directories
-    if (node->type == NODE_DIRECTORY) {
-        char *children_str = string_duplicate(""); // Initialize to an empty string
-        for (u32 i = 0; i < node->data.directory.child_count; ++i) {
-            FsNode *child = node->data.directory.children[i];
-            if (child == NULL) continue;
-            char *child_str = node_tree_to_string(child, depth + 1);
-            char *temp = children_str;
-            children_str = string_format("%s%s", children_str, child_str);
-            kfree(child_str, string_length(child_str) + 1, MEMORY_TAG_STRING);
-            kfree(temp, string_length(temp) + 1, MEMORY_TAG_STRING);
-        }
-        char *temp = formattedLine;
-        formattedLine = string_format("%s%s", formattedLine, children_str); // Append children string
-        kfree(temp, string_length(temp) + 1, MEMORY_TAG_STRING);
-        kfree(children_str, string_length(children_str) + 1, MEMORY_TAG_STRING);
+    if (node->type != NODE_DIRECTORY) return;
+    for (u32 i = 0; i < node->data.directory.child_count; ++i) {
+        FsNode *child = node->data.directory.children[i];
+        if (child) node_tree_append(sb, child, depth + 1);
     }
-    
-    // Cleanup
-    kfree(indent, string_length(indent) + 1, MEMORY_TAG_STRING);
-    kfree(displayPath, string_length(displayPath) + 1, MEMORY_TAG_STRING);
-    
-    return formattedLine; // Return the formatted directory tree or an empty string if NULL
+}
+
+char *node_tree_to_string(FsNode *node, int depth) {
+    StringBuilder *sb = sb_new();
+    if (node) node_tree_append(sb, node, depth);
+    return sb_take(sb);
 }
 
 char *vfs_to_string() {
@@ -357,7 +944,15 @@ b8 vfs_node_exists(FsPath path) {
         vwarn("vfs_node_exists - File system not initialized.");
         return false;
     }
-    return dict_contains(fs_context->nodes, path);
+    return node_lookup(path, string_length(path)) != null;
+}
+
+FsNode *vfs_node_lookup(FsPath path) {
+    if (fs_context == null) {
+        vwarn("vfs_node_lookup - File system not initialized.");
+        return null;
+    }
+    return node_lookup(path, string_length(path));
 }
 
 FsNode *vfs_node_get(FsPath path) {
@@ -365,6 +960,749 @@ FsNode *vfs_node_get(FsPath path) {
         vwarn("vfs_node_get - File system not initialized.");
         return null;
     }
-    return dict_get(fs_context->nodes, path);
+    FsNode *node = node_lookup(path, string_length(path));
+    // A file that can't be read is still returned, its data stays null.
+    if (node && node->type == NODE_FILE) vfs_node_load(node);
+    return node;
+}
+
+// Pushes every node below a directory in sorted tree order.
+static FsNode **collect_descendants(FsNode *directory, FsNode **nodes) {
+    for (u32 i = 0; i < directory->data.directory.child_count; i++) {
+        FsNode *child = directory->data.directory.children[i];
+        darray_push(FsNode *, nodes, child);
+        if (child->type == NODE_DIRECTORY) nodes = collect_descendants(child, nodes);
+    }
+    return nodes;
+}
+
+FsNode **vfs_find(const char *prefix) {
+    FsNode **nodes = darray_create(FsNode *);
+    if (fs_context == null) {
+        vwarn("vfs_find - File system not initialized.");
+        return nodes;
+    }
+    const char *slash = strrchr(prefix, '/');
+    FsNode *directory = slash ? node_lookup(prefix, slash - prefix) : fs_context->root;
+    if (directory == null || directory->type != NODE_DIRECTORY) return nodes;
+    const char *name = slash ? slash + 1 : prefix;
+    u64 length = string_length(name);
+    // The children starting with the name are a run in the sorted children, starting where the name would go.
+    b8 found = false;
+    for (u32 i = directory_search(directory, name, length, &found); i < directory->data.directory.child_count; i++) {
+        FsNode *child = directory->data.directory.children[i];
+        if (strncmp(child->name, name, length) != 0) break;
+        darray_push(FsNode *, nodes, child);
+        if (child->type == NODE_DIRECTORY) nodes = collect_descendants(child, nodes);
+    }
+    return nodes;
+}
+
+// Matches the rest of a pattern below a directory, the pattern starts at a segment.
+static FsNode **glob_directory(FsNode *directory, const char *pattern, FsNode **nodes) {
+    while (*pattern == '/') pattern++;
+    if (*pattern == '\0') return nodes;
+    const char *end = strchr(pattern, '/');
+    if (end == null) end = pattern + string_length(pattern);
+    u64 length = end - pattern;
+    const char *rest = *end ? end + 1 : null;
+    if (length == 2 && pattern[0] == '*' && pattern[1] == '*') {
+        if (rest == null) return collect_descendants(directory, nodes);
+        // No segments skipped, then one more for every directory below.
+        nodes = glob_directory(directory, rest, nodes);
+        for (u32 i = 0; i < directory->data.directory.child_count; i++) {
+            FsNode *child = directory->data.directory.children[i];
+            if (child->type == NODE_DIRECTORY) nodes = glob_directory(child, pattern, nodes);
+        }
+        return nodes;
+    }
+    // A segment without wildcards is a lookup.
+    const char *wildcard = strpbrk(pattern, "*?");
+    if (wildcard == null || wildcard >= end) {
+        FsNode *child = directory_child(directory, pattern, length);
+        if (child == null) return nodes;
+        if (rest == null) darray_push(FsNode *, nodes, child)
+        else if (child->type == NODE_DIRECTORY) nodes = glob_directory(child, rest, nodes);
+        return nodes;
+    }
+    for (u32 i = 0; i < directory->data.directory.child_count; i++) {
+        FsNode *child = directory->data.directory.children[i];
+        if (!path_match_segment(pattern, length, child->name, string_length(child->name))) continue;
+        if (rest == null) darray_push(FsNode *, nodes, child)
+        else if (child->type == NODE_DIRECTORY) nodes = glob_directory(child, rest, nodes);
+    }
+    return nodes;
 }
 
+FsNode **vfs_glob(const char *pattern) {
+    FsNode **nodes = darray_create(FsNode *);
+    if (fs_context == null) {
+        vwarn("vfs_glob - File system not initialized.");
+        return nodes;
+    }
+    return glob_directory(fs_context->root, pattern, nodes);
+}
+
+// Adds a node to a directory's children at its place in the order.
+static void directory_attach(FsNode *directory, FsNode *node) {
+    node->parent = directory;
+    b8 found = false;
+    u32 index = directory_search(directory, node->name, string_length(node->name), &found);
+    darray_insert_at(directory->data.directory.children, index, node);
+    directory->data.directory.child_count++;
+}
+
+// Gets the directory at the first length bytes of the path, creating it and any missing parent. Null if a file is in
+// the way.
+static FsNode *directory_get_or_create(const char *path, u64 length) {
+    if (length == 0) return fs_context->root;
+    FsNode *node = node_lookup(path, length);
+    if (node) return node->type == NODE_DIRECTORY ? node : null;
+    u64 slash = length;
+    while (slash > 0 && path[slash - 1] != '/') slash--;
+    FsNode *parent = directory_get_or_create(path, slash ? slash - 1 : 0);
+    if (parent == null) return null;
+    node = kallocate(sizeof(FsNode), MEMORY_TAG_RESOURCE);
+    node->path = (FsPath) atom_intern_sized(path, length);
+    node->name = node->path + slash;
+    node->type = NODE_DIRECTORY;
+    node->data.directory.children = darray_create(FsNode *);
+    // Made up for an archive or a write, there is nothing on disk to watch yet.
+    node->data.directory.watch_id = INVALID_ID;
+    directory_attach(parent, node);
+    fs_context->node_count++;
+    return node;
+}
+
+b8 vfs_mount_archive(const char *archive_path) {
+    if (fs_context == null) {
+        vwarn("vfs_mount_archive - File system not initialized.");
+        return false;
+    }
+    Archive *archive = archive_open(archive_path);
+    if (archive == null) return false;
+    u32 mounted = 0;
+    for (u32 i = 0; i < archive->header->entry_count; ++i) {
+        const ArchiveEntry *entry = &archive->entries[i];
+        const char *path = archive_entry_path(archive, entry);
+        FsNode *node = node_lookup(path, string_length(path));
+        if (node == null) {
+            const char *name = strrchr(path, '/');
+            FsNode *parent = directory_get_or_create(path, name ? (u64) (name - path) : 0);
+            if (parent == null) {
+                vwarn("vfs_mount_archive - A file is in the way of %s", path)
+                continue;
+            }
+            node = kallocate(sizeof(FsNode), MEMORY_TAG_RESOURCE);
+            node->path = (FsPath) atom_intern(path);
+            node->name = node->path + (name ? name - path + 1 : 0);
+            node->type = NODE_FILE;
+            directory_attach(parent, node);
+            fs_context->node_count++;
+        } else if (node->type != NODE_FILE) {
+            vwarn("vfs_mount_archive - %s is a directory, its archive entry is ignored", path)
+            continue;
+        } else if (node->data.file.pin_count > 0) {
+            vwarn("vfs_mount_archive - %s is pinned, it keeps its current contents", path)
+            continue;
+        } else if (node->data.file.dirty) {
+            vwarn("vfs_mount_archive - %s has unflushed writes, it keeps them", path)
+            continue;
+        } else {
+            // The archive takes priority, the loose contents are dropped and never read again.
+            file_evict(node);
+        }
+        node->data.file.archive = archive;
+        node->data.file.archive_entry = entry;
+        node->data.file.size = entry->size;
+        // Entries are hashed the way nodes are, the archive already did the work.
+        node->data.file.hash = entry->hash;
+        node->data.file.hashed = true;
+        mounted++;
+    }
+    darray_push(Archive *, fs_context->archives, archive);
+    vinfo("vfs_mount_archive - Mounted %u files from %s", mounted, archive_path)
+    return true;
+}
+
+static int archive_node_compare(const void *a, const void *b) {
+    return strcmp((*(FsNode *const *) a)->path, (*(FsNode *const *) b)->path);
+}
+
+static void mount_root_archives() {
+    FsNode *root = fs_context->root;
+    // Collected first, mounting can add children to the root.
+    FsNode **archives = darray_create(FsNode *);
+    for (u32 i = 0; i < root->data.directory.child_count; ++i) {
+        FsNode *child = root->data.directory.children[i];
+        if (child->type == NODE_FILE && string_ends_with(child->path, ARCHIVE_EXTENSION)) {
+            darray_push(FsNode *, archives, child);
+        }
+    }
+    u64 count = darray_length(archives);
+    qsort(archives, count, sizeof(FsNode *), archive_node_compare);
+    for (u64 i = 0; i < count; ++i) {
+        char *joined = string_format("%s/%s", path_root_directory(), archives[i]->path);
+        char *system_path = platform_path(joined);
+        vfs_mount_archive(system_path);
+        kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+        string_deallocate(joined);
+    }
+    darray_destroy(archives)
+}
+
+static void watch_tree(FsNode *node) {
+    if (fs_context->watches == null) return;
+    FsNode **stack = darray_create(FsNode *);
+    darray_push(FsNode *, stack, node);
+    // Once a watch fails the platform is likely out of them, the rest of the tree isn't tried.
+    b8 watching = true;
+    while (darray_length(stack) > 0) {
+        FsNode *directory = null;
+        darray_pop(stack, &directory);
+        if (directory->type != NODE_DIRECTORY) continue;
+        if (watching && directory->data.directory.watch_id == INVALID_ID) {
+            char *system_path = node_system_path(directory);
+            u32 watch_id = INVALID_ID;
+            // Directories made up for an archive aren't on disk, there is nothing to watch.
+            b8 on_disk = platform_is_directory(system_path);
+            if (on_disk) watching = platform_watch_directory(system_path, &watch_id);
+            kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+            if (on_disk && watching) {
+                directory->data.directory.watch_id = watch_id;
+                ptr_hash_table_set(fs_context->watches, (void *) (u64) watch_id, directory);
+            }
+        }
+        for (u32 i = 0; i < directory->data.directory.child_count; i++) {
+            darray_push(FsNode *, stack, directory->data.directory.children[i]);
+        }
+    }
+    darray_destroy(stack)
+}
+
+static void unwatch_tree(FsNode *node) {
+    if (node->type != NODE_DIRECTORY) return;
+    if (node->data.directory.watch_id != INVALID_ID) {
+        platform_unwatch_directory(node->data.directory.watch_id);
+        ptr_hash_table_remove(fs_context->watches, (void *) (u64) node->data.directory.watch_id);
+        node->data.directory.watch_id = INVALID_ID;
+    }
+    for (u32 i = 0; i < node->data.directory.child_count; i++) unwatch_tree(node->data.directory.children[i]);
+}
+
+static void node_free(FsNode *node) {
+    if (node->type == NODE_DIRECTORY) {
+        for (u32 i = 0; i < node->data.directory.child_count; i++) node_free(node->data.directory.children[i]);
+        if (node->data.directory.children) {
+            darray_destroy(node->data.directory.children)
+        }
+    }
+    kfree(node, sizeof(FsNode), MEMORY_TAG_RESOURCE);
+}
+
+// Records a change to a node and, for a directory, to every node below it.
+static void changes_push_tree(FsNode *node, FsChangeType type) {
+    FsChange change = {type, node};
+    darray_push(FsChange, fs_context->changes, change);
+    if (node->type != NODE_DIRECTORY) return;
+    for (u32 i = 0; i < node->data.directory.child_count; i++) {
+        changes_push_tree(node->data.directory.children[i], type);
+    }
+}
+
+// Whether a node can be taken out of the tree. Pinned contents are still in use and archive files aren't on disk.
+// Unless dropping them, unflushed writes aren't on disk yet either.
+static b8 node_removable(FsNode *node, b8 keep_dirty) {
+    if (node->type == NODE_FILE) {
+        if (keep_dirty && node->data.file.dirty) return false;
+        return node->data.file.pin_count == 0 && node->data.file.archive == null;
+    }
+    for (u32 i = 0; i < node->data.directory.child_count; i++) {
+        if (!node_removable(node->data.directory.children[i], keep_dirty)) return false;
+    }
+    return true;
+}
+
+// Drops the contents of a node and everything below it and takes them out of the node count.
+static void node_unindex(FsNode *node) {
+    if (node->type == NODE_FILE) {
+        file_evict(node);
+        loads_detach(node);
+    } else {
+        for (u32 i = 0; i < node->data.directory.child_count; i++) node_unindex(node->data.directory.children[i]);
+    }
+    fs_context->node_count--;
+}
+
+// Takes a node deleted on disk out of its parent and the index, it is freed by the next poll.
+static void node_remove(FsNode *node) {
+    if (!node_removable(node, true)) {
+        vwarn("vfs_poll_changes - %s is pinned, unflushed or mounted from an archive, it stays in the tree", node->path)
+        return;
+    }
+    FsNode *parent = node->parent;
+    b8 found = false;
+    u32 index = directory_search(parent, node->name, string_length(node->name), &found);
+    if (found) {
+        FsNode *removed = null;
+        darray_pop_at(parent->data.directory.children, index, &removed);
+        parent->data.directory.child_count--;
+    }
+    // The parent pointer is kept, a parent deleted in the same poll is freed along with it.
+    unwatch_tree(node);
+    node_unindex(node);
+    changes_push_tree(node, FS_CHANGE_DELETED);
+    darray_push(FsNode *, fs_context->removed, node);
+    vdebug("vfs_poll_changes - Removed %s", node->path)
+}
+
+// Drops the contents and the hash of a loose file and takes its size from disk again.
+static void file_reload(FsNode *node) {
+    file_evict(node);
+    node->data.file.hashed = false;
+    // Whatever is being read for it may be the old contents.
+    for (u64 i = 0; i < darray_length(fs_context->loads); ++i) {
+        if (fs_context->loads[i]->node == node) fs_context->loads[i]->stale = true;
+    }
+    char *system_path = node_system_path(node);
+    node->data.file.size = platform_file_size(system_path);
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+}
+
+b8 vfs_node_reload(FsNode *node) {
+    if (fs_context == null || node == null || node->type != NODE_FILE) return false;
+    if (node->data.file.pin_count > 0) {
+        vwarn("vfs_node_reload - %s is pinned, it keeps its current contents", node->path)
+        return false;
+    }
+    if (node->data.file.dirty) {
+        vwarn("vfs_node_reload - %s has unflushed writes, it keeps them", node->path)
+        return false;
+    }
+    if (node->data.file.archive) file_evict(node);
+    else file_reload(node);
+    return true;
+}
+
+// Adds a node for an entry created on disk. A directory is scanned, indexed and watched with everything in it.
+static void node_create(FsNode *directory, const char *name, b8 is_directory) {
+    FsNode *node = scan_node_create(directory, name, is_directory ? NODE_DIRECTORY : NODE_FILE);
+    if (is_directory) {
+        scan_tree(node, 1);
+        // A directory gone again before it was listed still needs its children.
+        if (node->data.directory.children == null) node->data.directory.children = darray_create(FsNode *);
+    } else {
+        char *system_path = node_system_path(node);
+        node->data.file.size = platform_file_size(system_path);
+        kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    }
+    directory_attach(directory, node);
+    fs_context->node_count += tree_size(node);
+    watch_tree(node);
+    changes_push_tree(node, FS_CHANGE_CREATED);
+    vdebug("vfs_poll_changes - Added %s", node->path)
+}
+
+// Drops the contents of a file written on disk, the next access reads the new contents.
+static void file_refresh(FsNode *node) {
+    // The loose file is shadowed by the archive, the tree doesn't change.
+    if (node->data.file.archive) return;
+    if (node->data.file.pin_count > 0) {
+        vwarn("vfs_poll_changes - %s is pinned, it keeps its current contents", node->path)
+        return;
+    }
+    // Written through the vfs since, the next flush puts those contents on disk over whatever is there.
+    if (node->data.file.dirty) return;
+    file_reload(node);
+    // A flush that creates directories has its files reported by their events and again by the directory's.
+    for (u64 i = fs_context->changes_delivered; i < darray_length(fs_context->changes); ++i) {
+        if (fs_context->changes[i].node == node && fs_context->changes[i].type == FS_CHANGE_MODIFIED) return;
+    }
+    FsChange change = {FS_CHANGE_MODIFIED, node};
+    darray_push(FsChange, fs_context->changes, change);
+}
+
+// Applies an entry found on disk to a directory, whether it is new, replaced by the other type or possibly written.
+static void directory_entry_update(FsNode *directory, const char *name, b8 is_directory);
+
+// Brings a directory and everything below it back in line with the disk, used once events were dropped. Without
+// write times every file is treated as written.
+static void directory_resync(FsNode *directory) {
+    char *system_path = node_system_path(directory);
+    VDirectoryList *list = platform_scan_directory(system_path);
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    if (list == null) {
+        if (directory->parent) node_remove(directory);
+        return;
+    }
+    // Backwards, a removal shifts the children after it.
+    for (u32 i = directory->data.directory.child_count; i-- > 0;) {
+        FsNode *child = directory->data.directory.children[i];
+        b8 found = false;
+        for (int j = 0; j < list->count && !found; j++) found = strcmp(list->entries[j].name, child->name) == 0;
+        if (!found) node_remove(child);
+    }
+    for (int i = 0; i < list->count; i++) {
+        if (string_ends_with(list->entries[i].name, VFS_TEMP_SUFFIX)) continue;
+        directory_entry_update(directory, list->entries[i].name, list->entries[i].is_directory);
+    }
+    directory_list_free(list);
+}
+
+static void directory_entry_update(FsNode *directory, const char *name, b8 is_directory) {
+    FsNode *node = directory_child(directory, name, string_length(name));
+    if (node && (node->type == NODE_DIRECTORY) == is_directory) {
+        if (is_directory) directory_resync(node);
+        else file_refresh(node);
+        return;
+    }
+    if (node) node_remove(node);
+    node_create(directory, name, is_directory);
+}
+
+// Applies one platform event to the tree.
+static void watch_event_apply(const platform_watch_event *event) {
+    if (event->action == PLATFORM_WATCH_OVERFLOW) {
+        vwarn("vfs_poll_changes - Watch events were dropped, rescanning the tree")
+        directory_resync(fs_context->root);
+        return;
+    }
+    // Events still queued for a directory removed since are stale.
+    FsNode *directory = ptr_hash_table_get(fs_context->watches, (void *) (u64) event->watch_id);
+    if (directory == null) return;
+    // The temporary files of a flush come and go, only the rename over the file counts.
+    if (string_ends_with(event->name, VFS_TEMP_SUFFIX)) return;
+    if (event->action == PLATFORM_WATCH_DELETED) {
+        FsNode *node = directory_child(directory, event->name, string_length(event->name));
+        if (node) node_remove(node);
+        return;
+    }
+    // A file written in place and a file saved by renaming a new one over it both end up written.
+    directory_entry_update(directory, event->name, event->is_directory);
+}
+
+// Drops the first count elements of a darray, the ones a poll already handed out.
+static void drop_delivered(void *array, u64 count) {
+    u64 length = darray_length(array);
+    if (count == 0) return;
+    u64 stride = darray_stride(array);
+    memmove(array, (char *) array + count * stride, (length - count) * stride);
+    darray_length_set(array, length - count);
+}
+
+FsChange *vfs_poll_changes(u32 *out_count) {
+    if (out_count) *out_count = 0;
+    if (fs_context == null) {
+        vwarn("vfs_poll_changes - File system not initialized.");
+        return null;
+    }
+    // Whoever looked at the last changes is done with them, so the nodes they removed can go. What was changed through
+    // the vfs since is handed out along with this poll's changes.
+    for (u64 i = 0; i < fs_context->removed_delivered; ++i) node_free(fs_context->removed[i]);
+    drop_delivered(fs_context->removed, fs_context->removed_delivered);
+    drop_delivered(fs_context->changes, fs_context->changes_delivered);
+    fs_context->removed_delivered = 0;
+    fs_context->changes_delivered = 0;
+    if (fs_context->watches) {
+        platform_watch_event events[VFS_WATCH_EVENT_BATCH];
+        u32 count;
+        while ((count = platform_read_watch_events(events, VFS_WATCH_EVENT_BATCH)) > 0) {
+            for (u32 i = 0; i < count; i++) watch_event_apply(&events[i]);
+        }
+    }
+    fs_context->removed_delivered = darray_length(fs_context->removed);
+    fs_context->changes_delivered = darray_length(fs_context->changes);
+    u32 change_count = darray_length(fs_context->changes);
+    if (change_count == 0) return null;
+    if (out_count) *out_count = change_count;
+    return fs_context->changes;
+}
+
+// Whether a path can be written to: relative, without empty, "." or ".." segments and not named like a temporary file.
+static b8 path_writable(const char *path) {
+    if (path == null || path[0] == '\0' || string_ends_with(path, VFS_TEMP_SUFFIX)) return false;
+    const char *segment = path;
+    while (true) {
+        const char *end = strchr(segment, '/');
+        u64 length = end ? (u64) (end - segment) : string_length(segment);
+        if (length == 0) return false;
+        if (segment[0] == '.' && (length == 1 || (length == 2 && segment[1] == '.'))) return false;
+        if (end == null) return true;
+        segment = end + 1;
+    }
+}
+
+// Whether a node is a directory or below it.
+static b8 node_within(FsNode *node, FsNode *directory) {
+    for (; node; node = node->parent) if (node == directory) return true;
+    return false;
+}
+
+// Gets the file at a path to write to, adding it and its missing directories to the tree. They are created on disk
+// by the flush.
+static FsNode *file_writable(const char *path, const char *caller) {
+    if (!path_writable(path)) {
+        vwarn("%s - Can't write to %s", caller, path ? path : "null")
+        return null;
+    }
+    FsNode *node = node_lookup(path, string_length(path));
+    if (node == null) {
+        const char *name = strrchr(path, '/');
+        FsNode *parent = directory_get_or_create(path, name ? (u64) (name - path) : 0);
+        if (parent == null) {
+            vwarn("%s - A file is in the way of %s", caller, path)
+            return null;
+        }
+        node = scan_node_create(parent, name ? name + 1 : path, NODE_FILE);
+        directory_attach(parent, node);
+        fs_context->node_count++;
+        return node;
+    }
+    if (node->type != NODE_FILE) {
+        vwarn("%s - %s is a directory", caller, path)
+        return null;
+    }
+    if (node->data.file.archive) {
+        vwarn("%s - %s is mounted from an archive, it can't be written", caller, path)
+        return null;
+    }
+    // Pinned contents are read in place, they can't change under the reader.
+    if (node->data.file.pin_count > 0) {
+        vwarn("%s - %s is pinned, it keeps its current contents", caller, path)
+        return null;
+    }
+    return node;
+}
+
+// Gives a file contents of its own with room for size bytes, keeping what it holds if asked. The room doubles as it
+// grows, so a file appended to every frame is only copied now and then.
+static void file_reserve(FsNode *node, u64 size, b8 keep) {
+    u64 capacity = node->data.file.capacity;
+    // Borrowed contents, mapped or read by the platform, have no capacity and are always replaced by an own buffer.
+    if (capacity != 0 && capacity >= size) return;
+    u64 grown = capacity * 2 > size ? capacity * 2 : size;
+    if (grown < VFS_WRITE_MIN_CAPACITY) grown = VFS_WRITE_MIN_CAPACITY;
+    char *data = kallocate(grown, MEMORY_TAG_RESOURCE);
+    u64 kept = keep && node->data.file.data ? node->data.file.size : 0;
+    if (kept) kcopy_memory(data, node->data.file.data, kept);
+    file_evict(node);
+    node->data.file.data = data;
+    node->data.file.capacity = grown;
+    node->data.file.size = kept;
+    fs_context->resident_bytes += kept;
+    resident_push(node);
+}
+
+// Writes or appends to the contents of a file in memory and queues it for the next flush.
+static b8 file_write(FsPath path, const void *data, u64 size, b8 append, const char *caller) {
+    if (fs_context == null) {
+        vwarn("%s - File system not initialized.", caller)
+        return false;
+    }
+    FsNode *node = file_writable(path, caller);
+    if (node == null) return false;
+    // Appending comes after what is on disk, unless nothing is.
+    if (append && node->data.file.data == null && node->data.file.size > 0 && !vfs_node_load(node)) return false;
+    u64 offset = append ? node->data.file.size : 0;
+    file_reserve(node, offset + size, append);
+    if (size) kcopy_memory(node->data.file.data + offset, data, size);
+    fs_context->resident_bytes = fs_context->resident_bytes - node->data.file.size + offset + size;
+    node->data.file.size = offset + size;
+    node->data.file.hashed = false;
+    if (!node->data.file.dirty) {
+        node->data.file.dirty = true;
+        if (darray_length(fs_context->dirty) == 0) fs_context->dirty_since = platform_get_absolute_time();
+        darray_push(FsNode *, fs_context->dirty, node);
+    }
+    resident_unlink(node);
+    resident_push(node);
+    resident_trim(node);
+    return true;
+}
+
+b8 vfs_node_write(FsPath path, const void *data, u64 size) {
+    return file_write(path, data, size, false, "vfs_node_write");
+}
+
+b8 vfs_node_append(FsPath path, const void *data, u64 size) {
+    return file_write(path, data, size, true, "vfs_node_append");
+}
+
+// Creates a directory of the tree on disk along with its missing parents, and watches the ones it created.
+static b8 directory_materialize(FsNode *directory) {
+    if (directory->parent == null) return true;
+    char *system_path = node_system_path(directory);
+    b8 exists = platform_is_directory(system_path);
+    b8 created = !exists && directory_materialize(directory->parent) && platform_create_directory(system_path);
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    if (created) watch_tree(directory);
+    return exists || created;
+}
+
+// Writes a file's contents next to it and renames them over it, the file on disk never holds part of them. The
+// directories of a new file are created on the way.
+static b8 file_flush(FsNode *node, b8 sync) {
+    char *system_path = node_system_path(node);
+    char *temp_path = string_format("%s%s", system_path, VFS_TEMP_SUFFIX);
+    b8 written = platform_write_file(temp_path, node->data.file.data, node->data.file.size, sync);
+    if (!written && directory_materialize(node->parent)) {
+        written = platform_write_file(temp_path, node->data.file.data, node->data.file.size, sync);
+    }
+    b8 flushed = written && platform_rename_file(temp_path, system_path);
+    if (written && !flushed) platform_remove_file(temp_path);
+    if (!flushed) vwarn("vfs_flush - Failed to write %s", node->path)
+    string_deallocate(temp_path);
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    return flushed;
+}
+
+// Flushes the dirty files below a node, or every one without a node. The files that fail stay dirty.
+static u32 dirty_flush(FsNode *below, b8 sync) {
+    u32 failed = 0;
+    u64 kept = 0;
+    // The directories holding the renamed files, each is synced once after all of them.
+    FsNode **directories = sync ? darray_create(FsNode *) : null;
+    for (u64 i = 0; i < darray_length(fs_context->dirty); ++i) {
+        FsNode *node = fs_context->dirty[i];
+        b8 flushed = false;
+        if (below == null || node_within(node, below)) {
+            flushed = file_flush(node, sync);
+            if (!flushed) failed++;
+        }
+        if (!flushed) {
+            fs_context->dirty[kept++] = node;
+            continue;
+        }
+        node->data.file.dirty = false;
+        if (directories && darray_find(directories, &node->parent) == (u64) -1) {
+            darray_push(FsNode *, directories, node->parent);
+        }
+    }
+    darray_length_set(fs_context->dirty, kept);
+    for (u64 i = 0; directories && i < darray_length(directories); ++i) {
+        char *system_path = node_system_path(directories[i]);
+        if (!platform_sync_directory(system_path)) vwarn("vfs_flush - Failed to sync %s", system_path)
+        kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    }
+    if (directories) darray_destroy(directories)
+    // Tried again a whole interval later rather than every frame.
+    if (failed) fs_context->dirty_since = platform_get_absolute_time();
+    // The flushed contents are like any other resident contents now.
+    resident_trim(null);
+    return failed;
+}
+
+u32 vfs_flush(b8 sync) {
+    if (fs_context == null || darray_length(fs_context->dirty) == 0) return 0;
+    f64 start = platform_get_absolute_time();
+    u32 count = darray_length(fs_context->dirty);
+    // Both only feed the debug log.
+    (void) start;
+    (void) count;
+    u32 failed = dirty_flush(null, sync);
+    vdebug("vfs_flush - Flushed %u of %u files in %.2f ms", count - failed, count,
+           (platform_get_absolute_time() - start) * 1000.0)
+    return failed;
+}
+
+u32 vfs_flush_if_due() {
+    if (fs_context == null || darray_length(fs_context->dirty) == 0) return 0;
+    if ((platform_get_absolute_time() - fs_context->dirty_since) * 1000.0 < VFS_FLUSH_INTERVAL_MS) return 0;
+    return vfs_flush(VFS_FLUSH_SYNC);
+}
+
+// Drops the unflushed writes below a node that is deleted.
+static void dirty_forget(FsNode *node) {
+    u64 kept = 0;
+    for (u64 i = 0; i < darray_length(fs_context->dirty); ++i) {
+        FsNode *dirty = fs_context->dirty[i];
+        if (node_within(dirty, node)) dirty->data.file.dirty = false;
+        else fs_context->dirty[kept++] = dirty;
+    }
+    darray_length_set(fs_context->dirty, kept);
+}
+
+// Deletes a node and everything below it on disk, the children first. What was never flushed isn't there to delete.
+static b8 node_delete_disk(FsNode *node) {
+    b8 deleted = true;
+    if (node->type == NODE_DIRECTORY) {
+        for (u32 i = 0; i < node->data.directory.child_count; i++) {
+            if (!node_delete_disk(node->data.directory.children[i])) deleted = false;
+        }
+    }
+    char *system_path = node_system_path(node);
+    b8 exists = node->type == NODE_DIRECTORY ? platform_is_directory(system_path) : platform_is_file(system_path);
+    if (deleted && exists && !platform_remove_file(system_path)) {
+        vwarn("vfs_node_delete - Failed to delete %s", node->path)
+        deleted = false;
+    }
+    kfree(system_path, string_length(system_path) + 1, MEMORY_TAG_STRING);
+    return deleted;
+}
+
+b8 vfs_node_delete(FsPath path) {
+    if (fs_context == null) {
+        vwarn("vfs_node_delete - File system not initialized.")
+        return false;
+    }
+    FsNode *node = path ? node_lookup(path, string_length(path)) : null;
+    if (node == null || node->parent == null) {
+        vwarn("vfs_node_delete - Nothing to delete at %s", path ? path : "null")
+        return false;
+    }
+    if (!node_removable(node, false)) {
+        vwarn("vfs_node_delete - %s is pinned or mounted from an archive", node->path)
+        return false;
+    }
+    if (!node_delete_disk(node)) return false;
+    dirty_forget(node);
+    node_remove(node);
+    return true;
+}
+
+b8 vfs_node_rename(FsPath from, FsPath to) {
+    if (fs_context == null) {
+        vwarn("vfs_node_rename - File system not initialized.")
+        return false;
+    }
+    FsNode *node = from ? node_lookup(from, string_length(from)) : null;
+    if (node == null || node->parent == null) {
+        vwarn("vfs_node_rename - Nothing to rename at %s", from ? from : "null")
+        return false;
+    }
+    // A directory can't be moved into itself.
+    u64 length = string_length(node->path);
+    if (!path_writable(to) || (strncmp(to, node->path, length) == 0 && to[length] == '/') ||
+        node_lookup(to, string_length(to))) {
+        vwarn("vfs_node_rename - Can't rename %s to %s", node->path, to)
+        return false;
+    }
+    if (!node_removable(node, false)) {
+        vwarn("vfs_node_rename - %s is pinned or mounted from an archive", node->path)
+        return false;
+    }
+    const char *name = strrchr(to, '/');
+    FsNode *parent = directory_get_or_create(to, name ? (u64) (name - to) : 0);
+    if (parent == null) {
+        vwarn("vfs_node_rename - A file is in the way of %s", to)
+        return false;
+    }
+    // The rename moves what is on disk, so the written contents go there first.
+    if (dirty_flush(node, false) > 0 || !directory_materialize(parent)) return false;
+    if (node->type == NODE_DIRECTORY && !directory_materialize(node)) return false;
+    char *source = node_system_path(node);
+    char *joined = string_format("%s/%s", path_root_directory(), to);
+    char *dest = platform_path(joined);
+    b8 renamed = platform_rename_file(source, dest);
+    kfree(dest, string_length(dest) + 1, MEMORY_TAG_STRING);
+    string_deallocate(joined);
+    kfree(source, string_length(source) + 1, MEMORY_TAG_STRING);
+    if (!renamed) {
+        vwarn("vfs_node_rename - Failed to rename %s to %s", node->path, to)
+        return false;
+    }
+    b8 is_directory = node->type == NODE_DIRECTORY;
+    node_remove(node);
+    node_create(parent, name ? name + 1 : to, is_directory);
+    return true;
+}
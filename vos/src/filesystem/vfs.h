@@ -7,15 +7,48 @@
 #include "defines.h"
 #include "kernel/vresult.h"
 #include "containers/dict.h"
+#include "core/vio.h"
 
 typedef char *FsPath;
 
+struct Archive;
+struct ArchiveEntry;
+
 #ifndef NODE_CAPACITY
 #define NODE_CAPACITY 1024
 #endif
 #ifndef USER_CAPACITY
 #define USER_CAPACITY 1024
 #endif
+#ifndef VFS_RESIDENT_BUDGET
+// The number of bytes of file contents kept in memory, the least recently used files are dropped past it.
+#define VFS_RESIDENT_BUDGET (64 * 1024 * 1024)
+#endif
+#ifndef VFS_SCAN_THREADS
+// The most threads indexing the tree at startup and hashing it on demand, the calling thread included. Capped by the
+// number of cores, one scans serially.
+#define VFS_SCAN_THREADS 8
+#endif
+#ifndef VFS_WATCH_EVENT_BATCH
+// The number of watch events read from the platform at a time while polling for changes.
+#define VFS_WATCH_EVENT_BATCH 32
+#endif
+#ifndef VFS_FLUSH_INTERVAL_MS
+// How long written contents stay in memory before the kernel flushes them. Writes in between coalesce, a file saved
+// every frame is written to disk once per interval.
+#define VFS_FLUSH_INTERVAL_MS 1000
+#endif
+#ifndef VFS_FLUSH_SYNC
+// Whether the periodic flush waits for the disk, the flush at shutdown always does.
+#define VFS_FLUSH_SYNC 0
+#endif
+// Flushed contents are written next to the file under this suffix and renamed over it. Entries with it are never
+// indexed.
+#define VFS_TEMP_SUFFIX ".vfs-tmp"
+#ifndef VFS_MAP_THRESHOLD
+// Files of at least this many bytes are mapped instead of read, smaller ones would waste most of a page.
+#define VFS_MAP_THRESHOLD 4096
+#endif
 
 /**
  * A serializable representation of a user
@@ -47,7 +80,29 @@ typedef enum FsNodeType {
     NODE_SYMLINK
 } FsNodeType;
 
+/**
+ * How the contents of a file are going to be read, passed on to the platform for mapped files.
+ */
+typedef enum FsAccess {
+    FS_ACCESS_NORMAL,
+    // Read through once right after loading, like a script being compiled.
+    FS_ACCESS_WILLNEED,
+    // Read at scattered offsets for as long as it is resident, like a font.
+    FS_ACCESS_RANDOM
+} FsAccess;
+
 
+/**
+ * The kind of change made on disk to a node.
+ */
+typedef enum FsChangeType {
+    // The contents of a file were written, its old contents are dropped.
+    FS_CHANGE_MODIFIED,
+    // The node was created, for a directory every node below it is reported too.
+    FS_CHANGE_CREATED,
+    // The node was deleted, for a directory every node below it is reported too.
+    FS_CHANGE_DELETED
+} FsChangeType;
 /**
  * @class FsNode
  *
@@ -58,10 +113,31 @@ typedef enum FsNodeType {
  * The data is stored as a union depending on whether the node is a directory or a file.
  * If the node is a directory, it contains an array of child nodes along with the count of children.
  * If the node is a file, it stores the size of the file in bytes and a pointer to the raw data of the file.
+ *
+ * The tree is also the path index. The children of every directory are kept sorted by name, so a path is looked up
+ * one segment at a time with a binary search per directory, and walking the tree lists it in sorted order.
+ *
+ * Only the tree is scanned up front. The contents of a file are read on first access and may be dropped again once
+ * the resident files exceed the budget, unless the node is pinned. Files of at least VFS_MAP_THRESHOLD bytes are
+ * mapped read only rather than copied, their pages are shared with the page cache and every other process mapping
+ * them. Pinning a node borrows its contents in place, there is no copy to hand out.
+ *
+ * A file can also come from a mounted archive, which takes priority over a loose file at the same path. Stored
+ * entries are borrowed from the archive's mapping, compressed ones are decompressed on load like a read file.
+ *
+ * Files can be written too. Written contents replace the node's contents in memory and mark it dirty, vfs_flush
+ * writes every dirty file to a temporary file and renames it over the original, so a file on disk is always either
+ * the old or the new contents. Changes on disk never replace contents that weren't flushed yet.
+ *
+ * The content hash of a file is computed on first use and outlives its contents, so it can key caches of anything
+ * derived from them. Archive files take the hash stored in the archive and are never read for it.
  */
 typedef struct FsNode {
-    //The path of the node relative to the root.
+    //The path of the node relative to the root. An atom, compare paths by pointer and key dicts on them with the
+    //_atom functions. It outlives the node.
     FsPath path;
+    // The last segment of the path, pointing into it. Empty for the root.
+    const char *name;
     // The Parent of the node.
     struct FsNode *parent;
     // the type of the node.
@@ -70,22 +146,64 @@ typedef struct FsNode {
     union {
         // The data of the node if it is a directory.
         struct {
-            //A darray of the children for the directory.
+            //A darray of the children for the directory, sorted by name.
             struct FsNode **children;
             // The number of children in the directory.
             u32 child_count;
+            // The platform watch reporting changes to the directory's entries, INVALID_ID while it isn't watched.
+            u32 watch_id;
         } directory;
         // The data of the node if it is a file.
         struct {
             // The size of the file in bytes.
             u64 size;
-            // The raw data of the file.
+            // The raw data of the file, null while the file isn't resident. Read only, it may be a mapping.
             char *data;
+            // Whether data is a mapping of the file rather than a heap copy.
+            b8 mapped;
+            // The access pattern given to the platform when the file is mapped.
+            FsAccess access;
+            // The archive and entry the contents come from, null for a file on disk.
+            struct Archive *archive;
+            const struct ArchiveEntry *archive_entry;
+            // The bytes allocated for contents written to the node, appends grow it ahead of the size. Zero for
+            // contents that were read.
+            u64 capacity;
+            // The contents were written and not flushed yet, the node is never evicted and its file on disk is stale.
+            b8 dirty;
+            // The number of pins, a pinned file is never evicted.
+            u32 pin_count;
+            // The hash64 of the contents, valid while hashed is set. Kept when the contents are evicted and dropped
+            // when the file changes on disk.
+            u64 hash;
+            b8 hashed;
+            // The neighbours in the list of resident files, ordered by last access.
+            struct FsNode *newer;
+            struct FsNode *older;
         } file;
     } data;
 } FsNode;
 
 
+/**
+ * Called once an asynchronous load finishes, on the thread polling the I/O system.
+ * @param node The node, its contents are resident if the status is IO_STATUS_OK. Null if the node was deleted before
+ * the load finished.
+ * @param status Whether the contents were loaded, failed to read or the load was cancelled.
+ * @param user_data The pointer given to vfs_node_load_async.
+ */
+typedef void (*FsLoadCallback)(FsNode *node, IoStatus status, void *user_data);
+
+/**
+ * A change on disk applied to the tree by vfs_poll_changes.
+ */
+typedef struct FsChange {
+    FsChangeType type;
+    // The node that changed. A deleted node is already out of the tree and the index, it stays valid until the next
+    // poll so whoever held on to it can let go.
+    FsNode *node;
+} FsChange;
+
 /**
  * This function will initialize the vfs file system.
  * @param root The root path of the vfs file system.
@@ -94,6 +212,26 @@ typedef struct FsNode {
 b8 vfs_initialize(FsPath root);
 
 
+/**
+ * Mounts an asset archive over the tree. Its files replace loose files at the same paths and later mounts replace
+ * earlier ones, missing directories are created. Archives in the root directory are mounted by vfs_initialize in
+ * name order.
+ * @param archive_path The system path of the archive.
+ * @return true if the archive was mounted.
+ */
+b8 vfs_mount_archive(const char *archive_path);
+
+/**
+ * Applies the changes made on disk since the last poll to the tree, and reports them along with the nodes deleted and
+ * renamed through the vfs since. Every directory is watched from vfs_initialize on, so only the entries that changed
+ * are touched: a written file drops its contents and hash and takes its new size, created and deleted entries are added
+ * to or taken out of their parent and the index. Files with unflushed writes keep them. Pinned files and files mounted from an
+ * archive keep their contents. Platforms that can't watch directories never report a change.
+ * @param out_count A pointer to hold the number of changes.
+ * @return The changes in the order they were applied, valid until the next poll. Null if nothing changed.
+ */
+FsChange *vfs_poll_changes(u32 *out_count);
+
 /**
  * This function will return the node at the given path. If the path is invalid, the node will be NULL.
  * It uses the cached nodes in memory and does not attempt to load the node from the file system.
@@ -102,22 +240,195 @@ b8 vfs_initialize(FsPath root);
  */
 b8 vfs_node_exists(FsPath path);
 
+/**
+ * Looks up the node at the given path without loading the contents of a file node.
+ * @param path The path of the node.
+ * @return The node at the given path or NULL if the path is invalid.
+ */
+FsNode *vfs_node_lookup(FsPath path);
+
 /**
  * This function will return the node at the given path. If the path is invalid, the node will be NULL.
+ * The contents of a file node are loaded if they aren't resident, they stay valid until the next file is loaded
+ * unless the node is pinned.
  * @param path  The path to get the node from.
  * @return The node at the given path or NULL if the path is invalid.
  */
 FsNode *vfs_node_get(FsPath path);
 
 /**
- * This function will return the node at the given path. If the path is invalid, the node will be NULL.
- * @param node The node to get the path from.
- * @return The path of the node.
+ * Drops the contents and the hash of a file node and takes its size from disk again, for changes made while the
+ * directory wasn't watched. Files mounted from an archive only drop their contents, the archive can't change.
+ * @param node The file node to reload.
+ * @return true if the node was reloaded, false if it isn't a file or is pinned.
+ */
+b8 vfs_node_reload(FsNode *node);
+
+/**
+ * Gets the content hash of a file node, the hash64 of its contents. Computed on first use and cached on the node until
+ * the file changes on disk or is reloaded. Contents that aren't resident are hashed from a temporary mapping, the
+ * file isn't made resident for it.
+ * @param node The file node.
+ * @param out_hash A pointer to hold the hash.
+ * @return true if the node is a file that could be hashed.
+ */
+b8 vfs_node_hash(FsNode *node, u64 *out_hash);
+
+/**
+ * Hashes every file below a node that has no hash yet, on up to VFS_SCAN_THREADS threads. Blocks until all of them
+ * are hashed, use it ahead of hashing many files one by one, like before looking for duplicate contents.
+ * @param node The directory or file to hash, the root if null.
+ * @return The number of files that couldn't be hashed.
+ */
+u32 vfs_hash_tree(FsNode *node);
+
+/**
+ * Makes the contents of a file node resident and marks it as the most recently used file. Other unpinned files may
+ * be evicted to stay within the budget.
+ * @param node The file node to load.
+ * @return true if the contents are resident, false if the node isn't a file or couldn't be read.
+ */
+b8 vfs_node_load(FsNode *node);
+
+/**
+ * Loads the contents of a file node on an I/O thread, so a slow volume doesn't stall the caller. The callback runs
+ * from vio_poll once the contents are resident, a file that already is only waits for the next poll. A file written
+ * on disk while it is read is read again, one deleted meanwhile is reported cancelled.
+ * @param node The file node to load.
+ * @param callback Called once with the outcome, may be null.
+ * @param user_data Passed on to the callback.
+ * @return The id of the load, INVALID_ID if the node isn't a file.
+ */
+u32 vfs_node_load_async(FsNode *node, FsLoadCallback callback, void *user_data);
+
+/**
+ * Cancels a load started with vfs_node_load_async, its callback still runs with IO_STATUS_CANCELLED.
+ * @param load_id The id of the load.
+ * @return false if the load already finished.
+ */
+b8 vfs_node_cancel_load(u32 load_id);
+
+/**
+ * Loads the contents of a file node and keeps them resident until every pin is released. Used when the data is
+ * handed to code that keeps pointing at it, like a font renderer. Pins are counted, every pin needs its own unpin.
+ * @param node The file node to pin.
+ * @return true if the contents are resident.
+ */
+b8 vfs_node_pin(FsNode *node);
+
+/**
+ * Releases a pin taken with vfs_node_pin, the contents can be evicted again once no pins are left.
+ * @param node The file node to unpin.
+ */
+void vfs_node_unpin(FsNode *node);
+
+/**
+ * Maps a loose file node on its own, outside the resident files and their budget, for reading through files larger
+ * than the budget. Unmap it with platform_unmap_file.
+ * @param node The file node to map.
+ * @param out_size A pointer to hold the size of the mapping.
+ * @return The mapping, null if the node isn't a file on disk, is empty or has unflushed writes.
+ */
+void *vfs_node_map(FsNode *node, u64 *out_size);
+
+/**
+ * Sets how the contents of a file node are going to be read. Applied to the current mapping if the node is mapped and
+ * to every later one, call it before vfs_node_load to let the platform read ahead.
+ * @param node The file node.
+ * @param access The expected access pattern.
+ */
+void vfs_node_advise(FsNode *node, FsAccess access);
+
+/**
+ * Sets the number of bytes of file contents kept resident, evicting least recently used files past it.
+ * @param bytes The budget in bytes.
+ */
+void vfs_set_resident_budget(u64 bytes);
+
+/**
+ * @return The number of bytes of file contents currently resident.
+ */
+u64 vfs_resident_bytes();
+
+/**
+ * Collects the nodes whose path starts with the given prefix, like "sys/gu" or "sys/gui/", along with everything below
+ * the directories among them. Only the directory holding the prefix is searched.
+ * @param prefix The prefix of the paths, an empty prefix collects the whole tree.
+ * @return A darray of the nodes in sorted tree order, free it with darray_destroy.
+ */
+FsNode **vfs_find(const char *prefix);
+
+/**
+ * Collects the nodes whose path matches a glob pattern, such as every .mgl file in sys/gui or every .lua file in the
+ * tree. Only the directories the pattern can reach are visited, a segment without wildcards is a lookup. See
+ * path_match for the syntax.
+ * @param pattern The pattern, relative to the root.
+ * @return A darray of the matching nodes in sorted tree order, free it with darray_destroy.
+ */
+FsNode **vfs_glob(const char *pattern);
+
+/**
+ * Replaces the contents of a file in memory, creating the file and its missing directories if needed. Nothing touches
+ * the disk until the next flush, writing a file again before then only replaces the contents again.
+ * @param path The path of the file.
+ * @param data The new contents, may be null if size is zero.
+ * @param size The number of bytes.
+ * @return true if the contents were written, false if the path is a directory or the file is pinned or comes from an
+ * archive.
+ */
+b8 vfs_node_write(FsPath path, const void *data, u64 size);
+
+/**
+ * Appends to the contents of a file in memory, creating it if needed. Like vfs_node_write, appends coalesce until the
+ * next flush.
+ * @param path The path of the file.
+ * @param data The bytes to append.
+ * @param size The number of bytes.
+ * @return true if the bytes were appended.
+ */
+b8 vfs_node_append(FsPath path, const void *data, u64 size);
+
+/**
+ * Deletes a file or a directory with everything in it, from the disk right away and from the tree. Unflushed writes
+ * below it are dropped. Reported as deleted by the next vfs_poll_changes.
+ * @param path The path to delete.
+ * @return false if nothing is at the path, or something below it is pinned or comes from an archive.
+ */
+b8 vfs_node_delete(FsPath path);
+
+/**
+ * Renames a file or a directory on disk right away, flushing it first if it has unflushed writes. Reported as the
+ * old path deleted and the new one created by the next vfs_poll_changes.
+ * @param from The current path.
+ * @param to The new path, nothing may be at it yet. Missing directories are created.
+ * @return true if the node was renamed.
+ */
+b8 vfs_node_rename(FsPath from, FsPath to);
+
+/**
+ * Writes every dirty file to disk. Each file is written to a temporary file that is renamed over it.
+ * @param sync Whether to wait until the files reached the disk. The directories they are in are synced once each
+ * after all the files.
+ * @return The number of files that couldn't be written, they stay dirty and are tried again by the next flush.
+ */
+u32 vfs_flush(b8 sync);
+
+/**
+ * Flushes the dirty files once VFS_FLUSH_INTERVAL_MS passed since the oldest write that wasn't flushed, called by the
+ * kernel every frame.
+ * @return The number of files that couldn't be written.
+ */
+u32 vfs_flush_if_due();
+
+/**
+ * Renders a node and everything below it as an indented tree, one line per node.
+ * @param node The node to render.
+ * @return The tree, null if the node is null. Free it with kfree(length + 1, MEMORY_TAG_STRING).
  */
 char *vfs_node_to_string(FsNode *node);
 
 /**
- * @breif this function will create a string representation of the vfs file system.
+ * @breif this function will create a string representation of the vfs file system, freed like vfs_node_to_string.
  */
 char *vfs_to_string();
 
@@ -3,10 +3,13 @@
 #include "core/vmem.h"
 #include "core/vlogger.h"
 #include "vlua.h"
+#include "vmodule.h"
 #include "core/vevent.h"
 #include "core/vtimer.h"
+#include "core/vio.h"
 #include "containers/dict.h"
 #include "core/vstring.h"
+#include "core/vatom.h"
 #include "filesystem/paths.h"
 #include "platform/platform.h"
 
@@ -36,6 +39,8 @@ KernelResult kernel_initialize(char *root_path) {
     }
     platform_initialize();
     strings_initialize();
+    atoms_initialize();
+    vio_initialize();
     vfs_initialize(root_path);
     initialize_logging();
     vdebug("Root path: %s", root_path)
@@ -49,8 +54,10 @@ KernelResult kernel_initialize(char *root_path) {
     kernel_context->id_pool->max_id = 0;
     initialize_timer();
     kernel_initialized = true;
-    processes_by_name = dict_new();
+    // Keyed on the script paths, which are atoms.
+    processes_by_name = dict_new_atoms();
     event_initialize();
+    module_cache_initialize();
     intrinsics_initialize();
     vinfo("Kernel initialized")
     KernelResult result = {KERNEL_SUCCESS, kernel_context};
@@ -78,12 +85,16 @@ KernelResult kernel_shutdown() {
     
     //shutdown the vfs
     vfs_shutdown();
+    // Delivers the loads the vfs left behind, after the processes that asked for them are gone.
+    vio_shutdown();
     kernel_initialized = false;
     timer_cleanup();
     intrinsics_shutdown();
+    module_cache_shutdown();
     event_shutdown();
     dict_delete(processes_by_name);
     strings_shutdown();
+    atoms_shutdown();
     platform_shutdown();
     vtrace("Mem usage: %s", get_memory_usage_str())
     memory_system_shutdown();
@@ -98,7 +109,7 @@ Proc *kernel_create_process(FsNode *script_node_file) {
         return null;
     }
     // Check if a process with the same name already exists.
-    if (dict_get(processes_by_name, script_node_file->path) != null) {
+    if (dict_get_atom(processes_by_name, script_node_file->path) != null) {
         vwarn("Process already exists with name %s", script_node_file->path)
         return null;
     }
@@ -112,12 +123,66 @@ Proc *kernel_create_process(FsNode *script_node_file) {
     }
     process->pid = pid;
     intrinsics_install_to(process);
-    dict_set(processes_by_name, process->source_file_node->path, process);
+    dict_set_atom(processes_by_name, process->source_file_node->path, process);
     kernel_context->processes[pid] = process;
     vdebug("Created process 0x%04x named %s", pid, process->process_name)
     return process;
 }
 
+// Whether the node was deleted by one of the changes.
+static b8 kernel_change_deleted(FsChange *changes, u32 count, FsNode *node) {
+    for (u32 i = 0; i < count; ++i) {
+        if (changes[i].node == node && changes[i].type == FS_CHANGE_DELETED) return true;
+    }
+    return false;
+}
+
+/**
+ * Hot reloads the scripts changed on disk. The compiled modules of changed files are dropped and every process whose
+ * script changed, or imports a module that changed, is restarted with a fresh lua state. Processes whose script was
+ * deleted are destroyed, every other process keeps running untouched.
+ */
+static void kernel_reload_changes(FsChange *changes, u32 count) {
+    FsNode **stale = darray_create(FsNode *);
+    for (u32 i = 0; i < count; ++i) {
+        FsNode *node = changes[i].node;
+        if (node->type != NODE_FILE) continue;
+        // The importers are collected before a deleted module is dropped from the graph.
+        stale = module_cache_collect_dependents(node, stale);
+        if (changes[i].type == FS_CHANGE_DELETED) module_cache_remove(node);
+        else module_cache_invalidate(node);
+    }
+    // Collected first, restarting a process hands its id back to the pool.
+    Proc **restart = darray_create(Proc *);
+    ProcPool *pool = kernel_context->id_pool;
+    u64 stale_count = darray_length(stale);
+    for (ProcID pid = 1; pid <= pool->max_id && pid < MAX_PROCESSES; ++pid) {
+        Proc *process = kernel_context->processes[pid];
+        if (process == null) continue;
+        for (u64 i = 0; i < stale_count; ++i) {
+            if (process->source_file_node != stale[i]) continue;
+            darray_push(Proc *, restart, process);
+            break;
+        }
+    }
+    for (u64 i = 0; i < darray_length(restart); ++i) {
+        FsNode *script = restart[i]->source_file_node;
+        kernel_destroy_process(restart[i]->pid);
+        if (kernel_change_deleted(changes, count, script)) {
+            vinfo("Destroyed process %s, its script was deleted", script->path)
+            continue;
+        }
+        Proc *process = kernel_create_process(script);
+        if (process == null || !process_start(process)) {
+            verror("Failed to reload process %s", script->path)
+            continue;
+        }
+        vinfo("Reloaded process %s", script->path)
+    }
+    darray_destroy(restart)
+    darray_destroy(stale)
+}
+
 //TODO: here we should do some kind of thread watch dog to make sure the process is still running and all
 b8 kernel_poll_update() {
     if (!kernel_initialized) {
@@ -125,6 +190,13 @@ b8 kernel_poll_update() {
         return false;
     }
     timer_poll();
+    // Before the changes, so the events of the flush are picked up by this poll when they're already queued.
+    vfs_flush_if_due();
+    u32 change_count = 0;
+    FsChange *changes = vfs_poll_changes(&change_count);
+    if (change_count > 0) kernel_reload_changes(changes, change_count);
+    // After the changes, so a load of a file deleted by them is delivered while its node is still valid.
+    vio_poll();
     return true;
 }
 
@@ -152,15 +224,16 @@ KernelResult kernel_destroy_process(ProcID pid) {
         KernelResult result = {KERNEL_PROCESS_NOT_FOUND, (void *) pid};
         return result;
     }
-    dict_remove(processes_by_name, process->source_file_node->path);
+    dict_remove_atom(processes_by_name, process->source_file_node->path);
     vdebug("Destroyed process 0x%04x named %s", pid, process->process_name)
+    intrinsics_uninstall_from(process);
+    kernel_context->processes[pid] = null;
     process_destroy(process);
     id_pool_release_id(pid);
     KernelResult result = {KERNEL_SUCCESS, null};
     return result;
 }
 
-//TODO more advanced process lookup with wildcards and such
 ProcID *kernel_lookup_process_id(const char *name) {
     if (!kernel_initialized) {
         vtrace("Attempted to locate process before initialization")
@@ -174,6 +247,20 @@ ProcID *kernel_lookup_process_id(const char *name) {
     return &process->pid;
 }
 
+ProcID *kernel_lookup_process_ids(const char *pattern) {
+    ProcID *ids = darray_create(ProcID);
+    if (!kernel_initialized) {
+        vtrace("Attempted to locate processes before initialization")
+        return ids;
+    }
+    ProcPool *pool = kernel_context->id_pool;
+    for (ProcID pid = 1; pid <= pool->max_id && pid < MAX_PROCESSES; ++pid) {
+        Proc *process = kernel_context->processes[pid];
+        if (process && path_match(pattern, process->source_file_node->path)) darray_push(ProcID, ids, pid)
+    }
+    return ids;
+}
+
 ProcID id_pool_next_id() {
     ProcPool *pool = kernel_context->id_pool;
     // Check if we are overflowing the pool.
@@ -60,7 +60,8 @@ KernelResult kernel_initialize(char *root_path);
 Proc *kernel_create_process(FsNode *script_node_file);
 
 /**
- * This is called once per frame. This will update the kernel and all processes.
+ * This is called once per frame. This will update the kernel and all processes, hot reload the scripts changed
+ * on disk since the last call and deliver the asynchronous I/O finished since then.
  * @return TRUE if the kernel was successfully updated; otherwise FALSE.
  */
 b8 kernel_poll_update();
@@ -86,6 +87,14 @@ KernelResult kernel_destroy_process(ProcID pid);
  */
 ProcID *kernel_lookup_process_id(const char *name);
 
+/**
+ * Locates every process whose script path matches a glob pattern, such as every process started from a script in sys.
+ * See path_match for the syntax.
+ * @param pattern The pattern to match the script paths against.
+ * @return A darray of the ids of the matching processes, free it with darray_destroy.
+ */
+ProcID *kernel_lookup_process_ids(const char *pattern);
+
 /**
  * Destroys the kernel. This will deallocate the kernel context and destroy the root process view.
  * @param context The kernel context.
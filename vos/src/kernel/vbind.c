@@ -0,0 +1,73 @@
+#include "vbind.h"
+#include <lauxlib.h>
+
+// Checks a single argument against its spec character, returns the expected type name when it doesn't match.
+static const char *binding_check_arg(lua_State *L, int index, char spec) {
+    switch (spec) {
+        case 's':
+            return lua_isstring(L, index) ? null : "string";
+        case 'n':
+            return lua_type(L, index) == LUA_TNUMBER ? null : "number";
+        case 'b':
+            return lua_type(L, index) == LUA_TBOOLEAN ? null : "boolean";
+        case 'f':
+            return lua_isfunction(L, index) ? null : "function";
+        case 't':
+            return lua_istable(L, index) ? null : "table";
+        case 'u':
+            return lua_isuserdata(L, index) ? null : "userdata";
+        case '.':
+            return lua_isnone(L, index) ? "value" : null;
+        default:
+            return null;
+    }
+}
+
+// Every binding goes through this closure, the binding it dispatches to is stored in its upvalue.
+static int binding_dispatch(lua_State *L) {
+    const LuaBinding *binding = lua_touserdata(L, lua_upvalueindex(1));
+    const char *spec = binding->args;
+    if (spec == null) return binding->function(L);
+
+    int top = lua_gettop(L);
+    int index = 1;
+    b8 optional = false;
+    for (const char *c = spec; *c; ++c) {
+        if (*c == '|') {
+            optional = true;
+            continue;
+        }
+        if (*c == '*') return binding->function(L);
+        if (optional && lua_isnoneornil(L, index)) {
+            index++;
+            continue;
+        }
+        if (index > top) {
+            return luaL_error(L, "%s: expected argument #%d, got none", binding->name, index);
+        }
+        const char *expected = binding_check_arg(L, index, *c);
+        if (expected != null) {
+            return luaL_error(L, "%s: bad argument #%d, expected %s, got %s", binding->name, index, expected,
+                              luaL_typename(L, index));
+        }
+        index++;
+    }
+    if (top >= index) {
+        return luaL_error(L, "%s: expected at most %d arguments, got %d", binding->name, index - 1, top);
+    }
+    return binding->function(L);
+}
+
+void binding_register(lua_State *L, const LuaBinding *bindings) {
+    for (const LuaBinding *binding = bindings; binding->name != null; ++binding) {
+        lua_pushlightuserdata(L, (void *) binding);
+        lua_pushcclosure(L, binding_dispatch, 1);
+        lua_setfield(L, -2, binding->name);
+    }
+}
+
+void binding_register_table(lua_State *L, const char *name, const LuaBinding *bindings) {
+    lua_newtable(L);
+    binding_register(L, bindings);
+    lua_setfield(L, -2, name);
+}
@@ -0,0 +1,85 @@
+/**
+ * The binding layer exposes C functions to lua from declarative tables. Each binding names the lua field, the C
+ * function and an argument spec; the arguments are validated against the spec before the C function is called, so
+ * intrinsics can read their arguments directly without re-checking the stack themselves.
+ *
+ * It also owns the per state context slot. The process that owns a lua state is stored in the state's extra space,
+ * so an intrinsic can resolve its process in O(1) without touching the sys table or the kernel process table.
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+#include "vproc.h"
+
+/**
+ * Describes a single C function exposed to lua.
+ *
+ * The argument spec is a string with one character per argument:
+ *  - 's' a string (numbers are accepted and converted like lua_tostring)
+ *  - 'n' a number
+ *  - 'b' a boolean
+ *  - 'f' a function
+ *  - 't' a table
+ *  - 'u' a userdata
+ *  - '.' any value
+ *  - '|' marks the remaining arguments as optional, they may be omitted or nil
+ *  - '*' allows any number of further arguments of any type
+ *
+ * Without a trailing '*' passing more arguments than the spec describes is an error. A null spec disables checking
+ * for functions that validate their own (overloaded) arguments.
+ */
+typedef struct LuaBinding {
+    const char *name;
+    lua_CFunction function;
+    const char *args;
+} LuaBinding;
+
+/**
+ * Declares an entry of a binding table.
+ */
+#define LUA_BINDING(name, function, args) {name, function, args}
+
+/**
+ * Terminates a binding table.
+ */
+#define LUA_BINDING_END {0, 0, 0}
+
+/**
+ * Sets every binding of the null terminated table as a field on the table at the top of the stack.
+ *
+ * @param L The lua state.
+ * @param bindings The binding table, terminated by LUA_BINDING_END. It must outlive the lua state.
+ */
+void binding_register(lua_State *L, const LuaBinding *bindings);
+
+/**
+ * Pushes a new table with every binding of the table set as a field on it and attaches it to the table at the top
+ * of the stack under the given name.
+ *
+ * @param L The lua state.
+ * @param name The field name of the new table.
+ * @param bindings The binding table, terminated by LUA_BINDING_END. It must outlive the lua state.
+ */
+void binding_register_table(lua_State *L, const char *name, const LuaBinding *bindings);
+
+/**
+ * Stores the owning process in the extra space of the lua state.
+ *
+ * @param L The lua state.
+ * @param process The process that owns the state.
+ */
+static inline void binding_set_process(lua_State *L, Proc *process) {
+    *(Proc **) lua_getextraspace(L) = process;
+}
+
+/**
+ * Gets the process that owns the lua state.
+ *
+ * @param L The lua state.
+ *
+ * @return The owning process, or null if the state hasn't been installed to a process yet.
+ */
+static inline Proc *binding_get_process(lua_State *L) {
+    return *(Proc **) lua_getextraspace(L);
+}
@@ -6,19 +6,35 @@
 #include <lauxlib.h>
 #include <lualib.h>
 #include <string.h>
+#include <stdio.h>
 //#include <raylib.h>
 #include "core/vevent.h"
 #include "core/vstring.h"
+#include "core/vatom.h"
 #include "core/vmem.h"
 #include "containers/dict.h"
 #include "filesystem/paths.h"
 #include "platform/platform.h"
-#include "core/vinput.h"
+#include "vmodule.h"
+#include "vbind.h"
+#include "vlua_gui.h"
+#include "vlua_input.h"
+#include "vlua_fs.h"
+#include "vlua_terminal.h"
+#include "core/vmutex.h"
+#include "core/vthread.h"
+#include "core/vsemaphore.h"
 
 #define MAX_LUA_PAYLOADS 100
+#define MAX_IMPORT_DEPTH 64
+#define MAX_IMPORT_PATH 1024
+// The number of warm lua states kept ready for new processes.
+#ifndef LUA_STATE_POOL_SIZE
+#define LUA_STATE_POOL_SIZE 8
+#endif
 typedef struct LuaPayload {
     Proc *process;
-    char *event_name;
+    Atom event_name;
     int callback_ref;
 } LuaPayload;
 
@@ -27,8 +43,25 @@ typedef struct LuaPayloadContext {
     int count;
 } LuaPayloadContext;
 
+/**
+ * A pool of lua states that already have the standard libraries and the sys table installed. A worker thread keeps
+ * the pool filled so creating a process only has to patch in its pid, path and name.
+ */
+typedef struct LuaStatePool {
+    lua_State *states[LUA_STATE_POOL_SIZE];
+    u32 count;
+    kmutex lock;
+    // Counts the empty slots, the worker blocks on it while the pool is full.
+    vsemaphore free;
+    kthread worker;
+    volatile b8 running;
+    // Cleared to build every state on the spot, the pool stays filled but isn't drawn from.
+    volatile b8 enabled;
+} LuaStatePool;
+
 typedef char *string;
 static LuaPayloadContext lua_context;
+static LuaStatePool state_pool;
 
 int lua_execute_process(lua_State *L) {
 //    Get the argument passed to the function, it can be a string or an int
@@ -98,13 +131,10 @@ int lua_execute_process(lua_State *L) {
  * Takes two lua arguments, a string and a function.
  */
 int lua_listen_for_event(lua_State *L) {
-    if (lua_gettop(L) != 2) {
-        return luaL_error(L, "Expected 2 arguments to listen_for_event");
-    }
-
     const char *event_name = lua_tostring(L, 1);
-    if (!lua_isfunction(L, 2)) {
-        return luaL_error(L, "Expected a function as the second argument");
+    Proc *process = binding_get_process(L);
+    if (process == null) {
+        return luaL_error(L, "listen called from a lua state without a process");
     }
 
     if (lua_context.count >= MAX_LUA_PAYLOADS) {
@@ -125,136 +155,23 @@ int lua_listen_for_event(lua_State *L) {
 
     LuaPayload *payload = &lua_context.payloads[index];
     lua_context.count++;
-    payload->event_name = string_duplicate(event_name); // we'll need to free this later
+    payload->event_name = atom_intern(event_name);
     payload->callback_ref = luaL_ref(L, LUA_REGISTRYINDEX);
-
-    lua_getglobal(L, "sys");
-    lua_getfield(L, -1, "pid");
-    int process_id = lua_tointeger(L, -1);
-    vdebug("Executing process with id: %d", process_id);
-    KernelResult result = kernel_lookup_process((ProcID) process_id);
-    if (!kernel_is_result_success(result.code)) {
-        verror("Failed to lookup process: %s", kernel_get_result_message(result));
-        return 1;
-    }
-    Proc *process = result.data;
     payload->process = process;
     return 0;
 }
 
 int lua_log_message(lua_State *L) {
-    if (lua_gettop(L) != 1) {
-        return luaL_error(L, "Expected 1 argument to log_message");
-    }
-    const char *message = lua_tostring(L, 1);
-    lua_getglobal(L, "sys");
-    lua_getfield(L, -1, "pid");
-    int process_id = lua_tointeger(L, -1);
-    lua_getfield(L, -2, "name");
-//    printf("[%d] %s: %s\n", process_id, lua_tostring(L, -1), message);
-    const char *process_name = lua_tostring(L, -1);
-    vinfo("[%s - 0x%04x] %s", process_name, process_id, message);
-    return 0;
-}
-
-int lua_draw_string(lua_State *L) {
-    if (lua_gettop(L) != 5) {
-        return luaL_error(L, "Expected 1 argument to log_message");
-    }
     const char *message = lua_tostring(L, 1);
-    // Get the x and y coordinates
-    int x = lua_tonumber(L, 2);
-    int y = lua_tonumber(L, 3);
-    // Get the font size
-    int size = lua_tonumber(L, 4);
-
-    //check if we have a color at the top of the stack in a table
-    if (lua_istable(L, 5)) {
-        lua_getfield(L, 5, "r");
-        int r = lua_tonumber(L, -1);
-        lua_getfield(L, 5, "g");
-        int g = lua_tonumber(L, -1);
-        lua_getfield(L, 5, "b");
-        int b = lua_tonumber(L, -1);
-        lua_getfield(L, 5, "a");
-        int a = lua_tonumber(L, -1);
-        // log the position and color
-//        DrawText(message, x, y, size, (Color) {r, g, b, a});
-        gui_draw_text(message, x, y, size, "sans", nvgRGBA(r, g, b, a));
-        return 0;
-    }
-    return 0;
-}
-
-int lua_draw_rect(lua_State *L) {
-    if (lua_gettop(L) < 4) {
-        return luaL_error(L, "Expected 4 argument to log_message");
-    }
-    // Get the x and y coordinates
-    int x = (int) lua_tonumber(L, 1);
-    int y = (int) lua_tonumber(L, 2);
-
-    // Get width and height as integers
-    int width = (int) lua_tonumber(L, 3);
-    int height = (int) lua_tonumber(L, 4);
-//    vdebug("Got: %d, %d, %d, %d", x, y, width, height);
-    //check if we have a color at the top of the stack in a table
-    if (lua_istable(L, 5)) {
-        lua_getfield(L, 5, "r");
-        int r = lua_tointeger(L, -1);
-        lua_getfield(L, 5, "g");
-        int g = lua_tointeger(L, -1);
-        lua_getfield(L, 5, "b");
-        int b = lua_tointeger(L, -1);
-        lua_getfield(L, 5, "a");
-        int a = lua_tointeger(L, -1);
-        gui_draw_rect(x, y, width, height, nvgRGBA(r, g, b, a));
-        // log the position and color
+    Proc *process = binding_get_process(L);
+    if (process == null) {
+        vinfo("[lua] %s", message);
         return 0;
     }
-//    DrawRectangle(x, y, width, height, DARKGRAY);
-
+    vinfo("[%s - 0x%04x] %s", process->process_name, process->pid, message);
     return 0;
 }
 
-int lua_color(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 4 && top != 1) {
-        return luaL_error(L, "Expected 4 argument to log_message");
-    }
-    if (top == 1) {
-        //read hex string
-        const char *hex = lua_tostring(L, 1);
-        int r, g, b, a;
-        sscanf(hex, "%02x%02x%02x%02x", &r, &g, &b, &a);
-        lua_newtable(L);
-        lua_pushinteger(L, r);
-        lua_setfield(L, -2, "r");
-        lua_pushinteger(L, g);
-        lua_setfield(L, -2, "g");
-        lua_pushinteger(L, b);
-        lua_setfield(L, -2, "b");
-        lua_pushinteger(L, a);
-        lua_setfield(L, -2, "a");
-        return 1;
-    }
-    int r = lua_tointeger(L, 1);
-    int g = lua_tointeger(L, 2);
-    int b = lua_tointeger(L, 3);
-    int a = lua_tointeger(L, 4);
-    lua_newtable(L);
-    lua_pushinteger(L, r);
-    lua_setfield(L, -2, "r");
-    lua_pushinteger(L, g);
-    lua_setfield(L, -2, "g");
-    lua_pushinteger(L, b);
-    lua_setfield(L, -2, "b");
-    lua_pushinteger(L, a);
-    lua_setfield(L, -2, "a");
-    return 1;
-}
-
-
 int lua_time(lua_State *L) {
     static u64 start_time = 0;
     if (start_time == 0) {
@@ -265,162 +182,70 @@ int lua_time(lua_State *L) {
     return 1;
 }
 
-int lua_import(lua_State *L) {
-    if (lua_gettop(L) != 1) {
-        return luaL_error(L, "Expected 1 argument to import");
-    }
-    const char *module_name = lua_tostring(L, 1);
-    lua_getglobal(L, "sys");
-    lua_getfield(L, -1, "path");
-    const char *path = lua_tostring(L, -1);
-    char *full_path = string_concat(module_name, ".lua");
-    // get the node data from the file system
-    FsNode *node = vfs_node_get(full_path);
+// Tracks the modules that are currently executing so nested imports are attributed to the module that made them.
+static FsNode *import_stack[MAX_IMPORT_DEPTH];
+static u32 import_depth = 0;
 
-    if (node == null) {
-        verror("Failed to import module %s, file not found", module_name);
-        return 1;
-    }
-
-    //Execute the lua from source
-    char *data = node->data.file.data;
-    u64 size = node->data.file.size;
+// Gets the node of the script performing an import, either the module being imported or the process script.
+static FsNode *lua_importer_node(lua_State *L) {
+    if (import_depth > 0) return import_stack[import_depth - 1];
+    Proc *process = binding_get_process(L);
+    return process ? process->source_file_node : null;
+}
 
-    if (luaL_loadbuffer(L, data, size, full_path) != LUA_OK) {
-        const char *error_string = lua_tostring(L, -1);
-        verror("Failed to run script %d: %s", full_path, error_string);
+/**
+ * Imports a module by its path relative to the root without the extension, i.e. sys.import("sys/terminal").
+ * Like require, a module only executes once per lua state. Its result is stored in package.loaded and returned by
+ * every later import. The compiled chunk itself is shared between all processes through the module cache.
+ */
+int lua_import(lua_State *L) {
+    const char *module_name = lua_tostring(L, 1);
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    if (lua_getfield(L, 2, module_name) != LUA_TNIL) {
         return 1;
     }
-    // execute the script
-    if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
-        const char *error_string = lua_tostring(L, -1);
-        verror("Failed to run script %d: %s", full_path, error_string);
+    lua_pop(L, 1);
+    
+    char full_path[MAX_IMPORT_PATH];
+    snprintf(full_path, sizeof(full_path), "%s.lua", module_name);
+    // Only found here, module_cache_load reads the source when the module has to be compiled.
+    FsNode *node = vfs_node_lookup(full_path);
+    if (node == null || node->type != NODE_FILE) {
+        verror("Failed to import module %s, file not found", module_name);
+        lua_pushnil(L);
         return 1;
     }
-    kfree(full_path, string_length(full_path), MEMORY_TAG_STRING);
-    //TODO build a list of dependencies that can be used for hot reloading
-    return 10;
-}
-
-int lua_is_button_down(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 1) {
-        return luaL_error(L, "Expected 1 argument to is_button_down");
-    }
-    int button = lua_tointeger(L, 1);
-    lua_pushboolean(L, input_is_button_down(button));
-    return 1;
-}
-
-int lua_is_button_up(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 1) {
-        return luaL_error(L, "Expected 1 argument to is_button_down");
-    }
-    int button = lua_tointeger(L, 1);
-    lua_pushboolean(L, input_is_key_up(button));
-    return 1;
-}
-
-int lua_is_button_pressed(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 1) {
-        return luaL_error(L, "Expected 1 argument to is_button_down");
-    }
-    int button = lua_tointeger(L, 1);
-    lua_pushboolean(L, input_is_button_down(button));
-    return 1;
-}
-
-int lua_is_button_released(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 1) {
-        return luaL_error(L, "Expected 1 argument to is_button_down");
+    if (import_depth >= MAX_IMPORT_DEPTH) {
+        return luaL_error(L, "Exceeded the maximum import depth while importing %s", module_name);
     }
-    int button = lua_tointeger(L, 1);
-    lua_pushboolean(L, input_is_button_up(button));
-    return 1;
-}
-
-int lua_mouse(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 0) {
-        return luaL_error(L, "Expected 0 argument to mouse");
+    module_cache_add_dependency(lua_importer_node(L), node);
+    
+    if (module_cache_load(L, node) != LUA_OK) {
+        verror("Failed to load module %s: %s", full_path, lua_tostring(L, -1));
+        lua_pop(L, 1);
+        lua_pushnil(L);
+        return 1;
     }
-    i32 x, y;
-    input_get_mouse_position(&x, &y);
-    lua_newtable(L);
-    lua_pushinteger(L, x);
-    lua_setfield(L, -2, "x");
-    lua_pushinteger(L, y);
-    lua_setfield(L, -2, "y");
-    lua_pushcfunction(L, lua_is_button_down);
-    lua_setfield(L, -2, "is_down");
-
-    lua_pushcfunction(L, lua_is_button_up);
-    lua_setfield(L, -2, "is_up");
-
-    lua_pushcfunction(L, lua_is_button_pressed);
-    lua_setfield(L, -2, "is_pressed");
-
-    lua_pushcfunction(L, lua_is_button_released);
-    lua_setfield(L, -2, "is_released");
-    return 1;
-}
-
-int lua_key(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 1) {
-        return luaL_error(L, "Expected 1 argument to keyboard");
+    import_stack[import_depth++] = node;
+    int status = lua_pcall(L, 0, 1, 0);
+    import_depth--;
+    if (status != LUA_OK) {
+        verror("Failed to run module %s: %s", full_path, lua_tostring(L, -1));
+        lua_pop(L, 1);
+        lua_pushnil(L);
+        return 1;
     }
-    int key = lua_tointeger(L, 1);
-    lua_newtable(L);
-    //TODO: assign key codes to lua
-    lua_pushboolean(L, input_is_key_down(key));
-    lua_setfield(L, -2, "is_down");
-    lua_pushboolean(L, input_is_key_up(key));
-    lua_setfield(L, -2, "is_up");
-    lua_pushboolean(L, input_is_key_pressed(key));
-    lua_setfield(L, -2, "is_pressed");
-    lua_pushboolean(L, input_is_key_released(key));
-    lua_setfield(L, -2, "is_released");
-    return 1;
-}
-
-
-void configure_lua_input(Proc *process) {
-    // Create the gui table
-    lua_newtable(process->lua_state);
-
-    // Add a color function to the gui table
-    lua_pushcfunction(process->lua_state, lua_mouse);
-    lua_setfield(process->lua_state, -2, "mouse");
-
-    // Add a color function to the gui table
-    lua_pushcfunction(process->lua_state, lua_key);
-    lua_setfield(process->lua_state, -2, "key");
-
-    // Attach the gui table to the sys table
-    lua_setfield(process->lua_state, -2, "input");
-}
-
-int lua_text_width(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 2) {
-        return luaL_error(L, "Expected 2 argument to text_width");
+    // Modules that don't return anything are still marked as loaded.
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_pushboolean(L, true);
     }
-    const char *text = lua_tostring(L, 1);
-    int size = lua_tointeger(L, 2);
-    void *vg = window_context.vg;
-    lua_pushnumber(L, gui_text_width(text, "sans", size));
+    lua_pushvalue(L, -1);
+    lua_setfield(L, 2, module_name);
     return 1;
 }
 
 int lua_windwow_size(lua_State *L) {
-    int top = lua_gettop(L);
-    if (top != 0) {
-        return luaL_error(L, "Expected 0 argument to window_size");
-    }
     u32 width, height;
     window_get_size(&width, &height);
     lua_newtable(L);
@@ -431,103 +256,132 @@ int lua_windwow_size(lua_State *L) {
     return 1;
 }
 
-int configure_lua_window(Proc *process) {
-    // Create the gui table
-    lua_newtable(process->lua_state);
-
-    // Add a color function to the gui table
-    lua_pushcfunction(process->lua_state, lua_windwow_size);
-    lua_setfield(process->lua_state, -2, "size");
+static const LuaBinding window_bindings[] = {
+    LUA_BINDING("size", lua_windwow_size, ""),
+    LUA_BINDING_END
+};
 
-    // Attach the gui table to the sys table
-    lua_setfield(process->lua_state, -2, "window");
+// Dumps the tree, the files themselves are read through sys.fs.open.
+int lua_file_system_string(lua_State *L) {
+    char *tree = vfs_to_string();
+    lua_pushstring(L, tree);
+    if (tree) kfree(tree, string_length(tree) + 1, MEMORY_TAG_STRING);
     return 1;
 }
 
-void configure_lua_gui(Proc *process) {
-    // Create the gui table
-    lua_newtable(process->lua_state);
-
-    // Add a color function to the gui table
-    lua_pushcfunction(process->lua_state, lua_color);
-    lua_setfield(process->lua_state, -2, "color");
-
-    // Add a draw_string function to the gui table
-    lua_pushcfunction(process->lua_state, lua_draw_string);
-    lua_setfield(process->lua_state, -2, "draw_text");
-
-    // Add a draw_rect function to the gui table
-    lua_pushcfunction(process->lua_state, lua_draw_rect);
-    lua_setfield(process->lua_state, -2, "draw_rect");
-
-    // Add a text_width function to the gui table
-    lua_pushcfunction(process->lua_state, lua_text_width);
-    lua_setfield(process->lua_state, -2, "text_width");
+// The execute function takes either a script path or a pid, it checks the type itself.
+static const LuaBinding sys_bindings[] = {
+    LUA_BINDING("execute", lua_execute_process, "."),
+    LUA_BINDING("listen", lua_listen_for_event, "sf"),
+    LUA_BINDING("log", lua_log_message, "s"),
+    LUA_BINDING("time", lua_time, ""),
+    LUA_BINDING("import", lua_import, "s"),
+    LUA_BINDING("fs_str", lua_file_system_string, ""),
+    LUA_BINDING_END
+};
+
+// Builds a fresh lua state with the standard libraries and the process independent part of the sys table installed.
+static lua_State *intrinsics_create_state() {
+    lua_State *L = luaL_newstate();
+    if (L == null) return null;
+    luaL_openlibs(L);
+    binding_set_process(L, null);
+    lua_newtable(L); // Create the sys table
+    binding_register(L, sys_bindings);
+    lua_gui_register(L);
+    lua_input_register(L);
+    lua_fs_register(L);
+    lua_terminal_register(L);
+    binding_register_table(L, "window", window_bindings);
+    lua_setglobal(L, "sys"); // Set the sys table as a global variable
+    return L;
+}
 
-    // Attach the gui table to the sys table
-    lua_setfield(process->lua_state, -2, "gui");
+// Takes a warm state from the pool, returns null if the pool is empty.
+static lua_State *lua_state_pool_acquire() {
+    lua_State *L = null;
+    if (!state_pool.enabled) return null;
+    kmutex_lock(&state_pool.lock);
+    if (state_pool.count > 0) {
+        L = state_pool.states[--state_pool.count];
+    }
+    kmutex_unlock(&state_pool.lock);
+    if (L) vsemaphore_signal(&state_pool.free);
+    return L;
 }
 
-int lua_file_system_string(lua_State *L) {
-    //TODO: add the ability to read files from the file system
-    lua_pushstring(L, vfs_to_string());
-    return 1;
+// Keeps the pool topped up in the background so spawning a process never has to build a state itself.
+static u32 lua_state_pool_worker(void *params) {
+    while (state_pool.running) {
+        // Sleeps until a slot is empty, shutdown signals once more to wake it. A wait cut short by a signal is
+        // retried, only shutdown ends the worker.
+        if (!vsemaphore_wait(&state_pool.free, 0)) continue;
+        if (!state_pool.running) break;
+        // The state is built outside the lock, only the push into the pool is guarded.
+        lua_State *L = intrinsics_create_state();
+        if (L == null) {
+            // The slot stays empty rather than being retried in a loop, processes build their own state meanwhile.
+            vwarn("Failed to create a lua state for the pool")
+            continue;
+        }
+        kmutex_lock(&state_pool.lock);
+        state_pool.states[state_pool.count++] = L;
+        kmutex_unlock(&state_pool.lock);
+    }
+    return 0;
 }
 
 b8 intrinsics_install_to(Proc *process) {
-    process->lua_state = luaL_newstate();
-    luaL_openlibs(process->lua_state);
-    lua_newtable(process->lua_state); // Create the sys table
+    lua_State *L = lua_state_pool_acquire();
+    if (L == null) {
+        // The pool hasn't caught up yet (or there is no worker), build the state on the spot.
+        L = intrinsics_create_state();
+        if (L == null) {
+            verror("Failed to create lua state for process %s", process->process_name);
+            return false;
+        }
+    }
+    process->lua_state = L;
+    binding_set_process(L, process);
+    // Only the per process fields need to be patched into the prebuilt sys table.
+    lua_getglobal(L, "sys");
     // Register the process ID
-    lua_pushinteger(process->lua_state, process->pid);
-    lua_setfield(process->lua_state, -2, "pid");
-
-    lua_pushstring(process->lua_state, process->source_file_node->path);
-    lua_setfield(process->lua_state, -2, "path");
-
+    lua_pushinteger(L, process->pid);
+    lua_setfield(L, -2, "pid");
+    
+    lua_pushstring(L, process->source_file_node->path);
+    lua_setfield(L, -2, "path");
+    
     // Register the process name
-    lua_pushstring(process->lua_state, process->process_name);
-//    lua_pushstring(process->lua_state, process->process_name);
-    lua_setfield(process->lua_state, -2, "name");
-
-    lua_pushcfunction(process->lua_state, lua_execute_process);
-    lua_setfield(process->lua_state, -2, "execute");
-
-    lua_pushcfunction(process->lua_state, lua_listen_for_event);
-    lua_setfield(process->lua_state, -2, "listen");
-
-    lua_pushcfunction(process->lua_state, lua_log_message);
-    lua_setfield(process->lua_state, -2, "log");
-
-    lua_pushcfunction(process->lua_state, lua_time);
-    lua_setfield(process->lua_state, -2, "time");
-
-    lua_pushcfunction(process->lua_state, lua_import);
-    lua_setfield(process->lua_state, -2, "import");
-
-    lua_pushcfunction(process->lua_state, lua_file_system_string);
-    lua_setfield(process->lua_state, -2, "fs_str");
-
-    configure_lua_gui(process);
-
-    configure_lua_input(process);
-
-    configure_lua_window(process);
-
-    lua_setglobal(process->lua_state, "sys"); // Set the sys table as a global variable
+    lua_pushstring(L, process->process_name);
+    lua_setfield(L, -2, "name");
+    lua_pop(L, 1);
+    return true;
+}
 
-    return 1;
+void intrinsics_uninstall_from(Proc *process) {
+    lua_fs_uninstall_from(process);
+    for (int i = 0; i < MAX_LUA_PAYLOADS; ++i) {
+        LuaPayload *payload = &lua_context.payloads[i];
+        if (payload->process != process) continue;
+        // The callback reference goes away with the lua state.
+        payload->event_name = null;
+        payload->process = null;
+        lua_context.count--;
+    }
 }
 
 b8 lua_payload_passthrough(u16 code, void *sender, void *listener_inst, event_context data) {
     if (code != EVENT_LUA_CUSTOM) return false;
 
-    char *event_name = data.data.c;
+    // The name fills the context and may not be terminated. A name nobody listens for was never interned.
+    Atom event_name = atom_find_sized(data.data.c, strnlen(data.data.c, sizeof(data.data.c)));
+    if (event_name == null) return true;
 
-    for (int i = 0; i < lua_context.count; ++i) {
+    // Slots freed by destroyed processes leave holes, so every slot is checked.
+    for (int i = 0; i < MAX_LUA_PAYLOADS; ++i) {
         LuaPayload *payload = &lua_context.payloads[i];
-        if (payload->process == NULL)continue;
-//        if (strcmp(payload->event_name, event_name) == 0) {
+        if (payload->process == NULL || payload->event_name != event_name) continue;
         lua_State *L = payload->process->lua_state; // Get your Lua state from wherever it's stored
 
         lua_rawgeti(L, LUA_REGISTRYINDEX, payload->callback_ref);
@@ -536,7 +390,6 @@ b8 lua_payload_passthrough(u16 code, void *sender, void *listener_inst, event_co
             verror("Error executing Lua callback: %s", lua_tostring(L, -1));
             lua_pop(L, 1); // Remove error message
         }
-//        }
     }
 
     return true;
@@ -545,8 +398,41 @@ b8 lua_payload_passthrough(u16 code, void *sender, void *listener_inst, event_co
 
 void intrinsics_initialize() {
     event_register(EVENT_LUA_CUSTOM, 0, lua_payload_passthrough);
+    kzero_memory(&state_pool, sizeof(LuaStatePool));
+    if (!kmutex_create(&state_pool.lock)) {
+        vwarn("Failed to create the lua state pool lock, lua states will be created on demand");
+        return;
+    }
+    // One more than the slots, so shutdown can always wake the worker.
+    if (!vsemaphore_create(&state_pool.free, LUA_STATE_POOL_SIZE + 1, LUA_STATE_POOL_SIZE)) {
+        vwarn("Failed to create the lua state pool semaphore, lua states will be created on demand");
+        return;
+    }
+    state_pool.running = true;
+    state_pool.enabled = true;
+    if (!kthread_create(lua_state_pool_worker, null, false, &state_pool.worker)) {
+        vwarn("Failed to start the lua state pool worker, lua states will be created on demand");
+        state_pool.running = false;
+    }
+}
+
+void intrinsics_state_pool_enable(b8 enabled) {
+    state_pool.enabled = enabled;
 }
 
 void intrinsics_shutdown() {
     event_unregister(EVENT_LUA_CUSTOM, 0, lua_payload_passthrough);
+    if (state_pool.running) {
+        state_pool.running = false;
+        vsemaphore_signal(&state_pool.free);
+        kthread_wait(&state_pool.worker);
+        kthread_destroy(&state_pool.worker);
+    }
+    for (u32 i = 0; i < state_pool.count; ++i) {
+        lua_close(state_pool.states[i]);
+    }
+    state_pool.count = 0;
+    if (state_pool.free.internal_data) vsemaphore_destroy(&state_pool.free);
+    kmutex_destroy(&state_pool.lock);
+    lua_gui_shutdown();
 }
\ No newline at end of file
@@ -10,23 +10,44 @@
  * @brief Initializes the intrinsics system.
  *
  * This function registers a custom event called `EVENT_LUA_CUSTOM` and sets `lua_payload_passthrough` as the event listener.
- * The `EVENT_LUA_CUSTOM` event is processed by the Lua system and allows for custom payloads.
+ * The `EVENT_LUA_CUSTOM` event is processed by the Lua system and allows for custom payloads. It also starts the
+ * worker thread that keeps a pool of pre-warmed lua states (standard libraries and sys table already installed) ready
+ * for new processes.
  */
 void intrinsics_initialize();
 
 /**
  * Installs the necessary intrinsics to the given process.
  *
+ * Takes a pre-warmed state from the pool when one is available and only patches in the process specific fields
+ * (pid, path, name). Falls back to building the state synchronously when the pool is empty.
+ *
  * @param process The process to install the intrinsics to.
  *
  * @return Returns 1 on success, 0 otherwise.
  */
 b8 intrinsics_install_to(Proc *process);
 
+/**
+ * Drops the event callbacks the given process registered, called before its lua state is closed.
+ *
+ * @param process The process being destroyed.
+ */
+void intrinsics_uninstall_from(Proc *process);
+
+/**
+ * Turns drawing states from the pool on or off, on by default. While it is off every process builds its own state as
+ * if the pool were empty, which is what the spawn benchmark compares against.
+ *
+ * @param enabled Whether new processes take their state from the pool.
+ */
+void intrinsics_state_pool_enable(b8 enabled);
+
 /**
  * @brief Shuts down the intrinsics system.
  *
- * This function unregisters the EVENT_LUA_CUSTOM event with the lua_payload_passthrough listener.
+ * This function unregisters the EVENT_LUA_CUSTOM event with the lua_payload_passthrough listener, stops the pool
+ * worker and closes any lua states still left in the pool.
  *
  * @see event_unregister
  * @see EVENT_LUA_CUSTOM
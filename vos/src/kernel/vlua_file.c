@@ -0,0 +1,341 @@
+#include "vlua_file.h"
+#include <lauxlib.h>
+#include <string.h>
+#include "vbind.h"
+#include "filesystem/vfs.h"
+#include "platform/platform.h"
+
+typedef struct LuaFile {
+    // The node whose contents are pinned, null if the file is mapped on its own.
+    FsNode *node;
+    // The contents, null once released.
+    const char *data;
+    u64 size;
+    u64 position;
+    // Whether data is a mapping of its own rather than the pinned contents of the node.
+    b8 mapped;
+    b8 closed;
+    // The views of the file still alive, the contents outlive a close until the last one is collected.
+    u32 view_count;
+} LuaFile;
+
+typedef struct LuaBuffer {
+    // The file the view points into, kept alive by the view's user value.
+    LuaFile *file;
+    const char *data;
+    u64 length;
+} LuaBuffer;
+
+static void lua_file_release(LuaFile *file) {
+    if (file->data == null && file->node == null) return;
+    if (file->mapped) platform_unmap_file((void *) file->data, file->size);
+    else vfs_node_unpin(file->node);
+    file->data = null;
+    file->node = null;
+}
+
+static LuaFile *lua_file_check(lua_State *L) {
+    LuaFile *file = luaL_checkudata(L, 1, LUA_FILE_METATABLE);
+    if (file->closed) luaL_error(L, "the file is closed");
+    return file;
+}
+
+// Turns 1 based indices, negative ones counting from the end, into a byte range of a buffer of the given length like
+// string.sub does. Returns false if the range is empty.
+static b8 lua_buffer_range(lua_Integer i, lua_Integer j, u64 length, u64 *out_start, u64 *out_end) {
+    lua_Integer size = (lua_Integer) length;
+    if (i < 0) i = i < -size ? 1 : size + i + 1;
+    else if (i == 0) i = 1;
+    if (j < 0) j = size + j + 1;
+    else if (j > size) j = size;
+    if (i > j) return false;
+    *out_start = (u64) i - 1;
+    *out_end = (u64) j;
+    return true;
+}
+
+// Pushes a view of a range of a file. The user value at the given index, a file or another view, keeps it alive.
+static void lua_buffer_push(lua_State *L, LuaFile *file, const char *data, u64 length, int owner) {
+    owner = lua_absindex(L, owner);
+    LuaBuffer *buffer = lua_newuserdatauv(L, sizeof(LuaBuffer), 1);
+    buffer->file = file;
+    buffer->data = data;
+    buffer->length = length;
+    file->view_count++;
+    lua_pushvalue(L, owner);
+    lua_setiuservalue(L, -2, 1);
+    luaL_setmetatable(L, LUA_BUFFER_METATABLE);
+}
+
+int lua_file_open(lua_State *L) {
+    FsNode *node = vfs_node_lookup((FsPath) luaL_checkstring(L, 1));
+    if (node == null || node->type != NODE_FILE) {
+        lua_pushnil(L);
+        lua_pushstring(L, "not a file");
+        return 2;
+    }
+    LuaFile *file = lua_newuserdatauv(L, sizeof(LuaFile), 0);
+    memset(file, 0, sizeof(LuaFile));
+    // Mapping pays off once the file spans a few pages, and keeps a large file from pushing the others out.
+    if (!node->data.file.archive && node->data.file.size >= VFS_MAP_THRESHOLD) {
+        file->data = vfs_node_map(node, &file->size);
+        file->mapped = file->data != null;
+    }
+    if (!file->mapped) {
+        if (!vfs_node_pin(node)) {
+            lua_pushnil(L);
+            lua_pushstring(L, "failed to read");
+            return 2;
+        }
+        file->node = node;
+        file->data = node->data.file.data;
+        file->size = node->data.file.size;
+    }
+    luaL_setmetatable(L, LUA_FILE_METATABLE);
+    return 1;
+}
+
+static int lua_file_gc(lua_State *L) {
+    LuaFile *file = luaL_checkudata(L, 1, LUA_FILE_METATABLE);
+    // Views collected in the same cycle are unreachable too, nothing reads the contents anymore.
+    file->closed = true;
+    lua_file_release(file);
+    return 0;
+}
+
+/**
+ * Closes the file. Views taken from it stay valid until they are collected.
+ */
+static int lua_file_close(lua_State *L) {
+    LuaFile *file = lua_file_check(L);
+    file->closed = true;
+    if (file->view_count == 0) lua_file_release(file);
+    return 0;
+}
+
+/**
+ * Reads up to n bytes from the current position, the rest of the file if n is omitted. Returns nil at the end of the
+ * file.
+ */
+static int lua_file_read(lua_State *L) {
+    LuaFile *file = lua_file_check(L);
+    u64 remaining = file->size - file->position;
+    lua_Integer count = luaL_optinteger(L, 2, (lua_Integer) remaining);
+    if (count < 0) return luaL_argerror(L, 2, "the count can't be negative");
+    if (remaining == 0 && count > 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    u64 length = (u64) count < remaining ? (u64) count : remaining;
+    lua_pushlstring(L, file->data + file->position, length);
+    file->position += length;
+    return 1;
+}
+
+/**
+ * Moves the position like file:seek in the io library, relative to "set", "cur" or "end". Returns the new position,
+ * or nil and an error if it would be outside the file.
+ */
+static int lua_file_seek(lua_State *L) {
+    LuaFile *file = lua_file_check(L);
+    const char *whence = luaL_optstring(L, 2, "cur");
+    lua_Integer offset = luaL_optinteger(L, 3, 0);
+    lua_Integer base;
+    if (strcmp(whence, "set") == 0) base = 0;
+    else if (strcmp(whence, "cur") == 0) base = (lua_Integer) file->position;
+    else if (strcmp(whence, "end") == 0) base = (lua_Integer) file->size;
+    else return luaL_argerror(L, 2, "expected \"set\", \"cur\" or \"end\"");
+    lua_Integer position = base + offset;
+    if (position < 0 || position > (lua_Integer) file->size) {
+        lua_pushnil(L);
+        lua_pushstring(L, "position out of range");
+        return 2;
+    }
+    file->position = (u64) position;
+    lua_pushinteger(L, position);
+    return 1;
+}
+
+static int lua_file_lines_next(lua_State *L) {
+    LuaFile *file = lua_touserdata(L, lua_upvalueindex(1));
+    if (file->closed) return luaL_error(L, "the file is closed");
+    if (file->position >= file->size) {
+        lua_pushnil(L);
+        return 1;
+    }
+    const char *start = file->data + file->position;
+    u64 remaining = file->size - file->position;
+    const char *newline = memchr(start, '\n', remaining);
+    u64 length = newline ? (u64) (newline - start) : remaining;
+    lua_pushlstring(L, start, length);
+    file->position += newline ? length + 1 : length;
+    return 1;
+}
+
+/**
+ * Returns an iterator over the lines from the current position on, without their newlines. It reads through the
+ * handle, so reads and seeks in between move it along.
+ */
+static int lua_file_lines(lua_State *L) {
+    lua_file_check(L);
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, lua_file_lines_next, 1);
+    return 1;
+}
+
+/**
+ * Returns the size of the file in bytes.
+ */
+static int lua_file_size(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer) lua_file_check(L)->size);
+    return 1;
+}
+
+/**
+ * Returns a view of the bytes from i to j, the whole file by default. Indices work like string.sub.
+ */
+static int lua_file_view(lua_State *L) {
+    LuaFile *file = lua_file_check(L);
+    u64 start = 0, end = 0;
+    if (!lua_buffer_range(luaL_optinteger(L, 2, 1), luaL_optinteger(L, 3, -1), file->size, &start, &end)) {
+        start = end = 0;
+    }
+    lua_buffer_push(L, file, file->data + start, end - start, 1);
+    return 1;
+}
+
+static int lua_buffer_gc(lua_State *L) {
+    LuaBuffer *buffer = luaL_checkudata(L, 1, LUA_BUFFER_METATABLE);
+    LuaFile *file = buffer->file;
+    if (--file->view_count == 0 && file->closed) lua_file_release(file);
+    return 0;
+}
+
+static int lua_buffer_len(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer) ((LuaBuffer *) luaL_checkudata(L, 1, LUA_BUFFER_METATABLE))->length);
+    return 1;
+}
+
+static int lua_buffer_tostring(lua_State *L) {
+    LuaBuffer *buffer = luaL_checkudata(L, 1, LUA_BUFFER_METATABLE);
+    lua_pushfstring(L, "buffer (%I bytes)", (lua_Integer) buffer->length);
+    return 1;
+}
+
+/**
+ * Copies the bytes from i to j out as a string, indices work like string.sub.
+ */
+static int lua_buffer_sub(lua_State *L) {
+    LuaBuffer *buffer = luaL_checkudata(L, 1, LUA_BUFFER_METATABLE);
+    u64 start, end;
+    if (!lua_buffer_range(luaL_checkinteger(L, 2), luaL_optinteger(L, 3, -1), buffer->length, &start, &end)) {
+        lua_pushliteral(L, "");
+        return 1;
+    }
+    lua_pushlstring(L, buffer->data + start, end - start);
+    return 1;
+}
+
+/**
+ * Returns the bytes from i to j as integers, only the byte at i by default, like string.byte.
+ */
+static int lua_buffer_byte(lua_State *L) {
+    LuaBuffer *buffer = luaL_checkudata(L, 1, LUA_BUFFER_METATABLE);
+    lua_Integer i = luaL_optinteger(L, 2, 1);
+    u64 start, end;
+    if (!lua_buffer_range(i, luaL_optinteger(L, 3, i), buffer->length, &start, &end)) return 0;
+    int count = (int) (end - start);
+    luaL_checkstack(L, count, "buffer slice too long");
+    for (u64 k = start; k < end; k++) lua_pushinteger(L, (u8) buffer->data[k]);
+    return count;
+}
+
+/**
+ * Finds the first occurrence of a plain string from index init on. Returns its first and last index, or nil.
+ */
+static int lua_buffer_find(lua_State *L) {
+    LuaBuffer *buffer = luaL_checkudata(L, 1, LUA_BUFFER_METATABLE);
+    size_t needle_length;
+    const char *needle = luaL_checklstring(L, 2, &needle_length);
+    lua_Integer init = luaL_optinteger(L, 3, 1);
+    u64 start = 0, end = 0;
+    b8 in_range = lua_buffer_range(init, -1, buffer->length, &start, &end);
+    // Like string.find, an empty string is found right at init, even one past the end.
+    if (needle_length == 0) {
+        if (!in_range && (init > (lua_Integer) buffer->length + 1)) {
+            lua_pushnil(L);
+            return 1;
+        }
+        lua_Integer at = in_range ? (lua_Integer) start + 1 : (lua_Integer) buffer->length + 1;
+        lua_pushinteger(L, at);
+        lua_pushinteger(L, at - 1);
+        return 2;
+    }
+    // The first byte is found with memchr, the rest is only compared where it matches.
+    const char *cursor = buffer->data + start;
+    const char *limit = buffer->data + end;
+    while (in_range && needle_length <= (u64) (limit - cursor)) {
+        const char *candidate = memchr(cursor, needle[0], (limit - cursor) - needle_length + 1);
+        if (candidate == null) break;
+        if (memcmp(candidate, needle, needle_length) == 0) {
+            lua_pushinteger(L, (lua_Integer) (candidate - buffer->data) + 1);
+            lua_pushinteger(L, (lua_Integer) (candidate - buffer->data + needle_length));
+            return 2;
+        }
+        cursor = candidate + 1;
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+/**
+ * Returns a view of the bytes from i to j of this view, sharing its contents.
+ */
+static int lua_buffer_view(lua_State *L) {
+    LuaBuffer *buffer = luaL_checkudata(L, 1, LUA_BUFFER_METATABLE);
+    u64 start = 0, end = 0;
+    if (!lua_buffer_range(luaL_optinteger(L, 2, 1), luaL_optinteger(L, 3, -1), buffer->length, &start, &end)) {
+        start = end = 0;
+    }
+    lua_buffer_push(L, buffer->file, buffer->data + start, end - start, 1);
+    return 1;
+}
+
+static const LuaBinding file_methods[] = {
+    LUA_BINDING("read", lua_file_read, "u|n"),
+    LUA_BINDING("seek", lua_file_seek, "u|sn"),
+    LUA_BINDING("lines", lua_file_lines, "u"),
+    LUA_BINDING("size", lua_file_size, "u"),
+    LUA_BINDING("view", lua_file_view, "u|nn"),
+    LUA_BINDING("close", lua_file_close, "u"),
+    LUA_BINDING_END
+};
+
+static const LuaBinding buffer_methods[] = {
+    LUA_BINDING("sub", lua_buffer_sub, "un|n"),
+    LUA_BINDING("byte", lua_buffer_byte, "u|nn"),
+    LUA_BINDING("find", lua_buffer_find, "us|n"),
+    LUA_BINDING("view", lua_buffer_view, "u|nn"),
+    LUA_BINDING_END
+};
+
+void lua_file_register(lua_State *L) {
+    luaL_newmetatable(L, LUA_FILE_METATABLE);
+    lua_pushcfunction(L, lua_file_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_newtable(L);
+    binding_register(L, file_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    luaL_newmetatable(L, LUA_BUFFER_METATABLE);
+    lua_pushcfunction(L, lua_buffer_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pushcfunction(L, lua_buffer_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, lua_buffer_tostring);
+    lua_setfield(L, -2, "__tostring");
+    lua_newtable(L);
+    binding_register(L, buffer_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
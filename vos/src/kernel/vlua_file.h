@@ -0,0 +1,30 @@
+/**
+ * File handles and buffer views for lua, opened with sys.fs.open.
+ *
+ * A handle reads a file in chunks from a position, so a script can walk through a large log or data file without
+ * ever holding all of it in a lua string. Small files and files from an archive are pinned in the vfs for as long as
+ * the handle is open, larger loose files get a read only mapping of their own that doesn't count against the
+ * resident budget. A buffer is a view of a range of a file, indexing it copies nothing until a piece is taken out as
+ * a string.
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+
+// The registry names of the file handle and buffer view userdata metatables.
+#define LUA_FILE_METATABLE "vos.file"
+#define LUA_BUFFER_METATABLE "vos.buffer"
+
+/**
+ * Registers the file handle and buffer view metatables in the lua state.
+ *
+ * @param L The lua state.
+ */
+void lua_file_register(lua_State *L);
+
+/**
+ * Opens a file of the vfs for reading, installed as sys.fs.open. Takes the path and returns a file handle, or nil and
+ * the reason it couldn't be opened.
+ */
+int lua_file_open(lua_State *L);
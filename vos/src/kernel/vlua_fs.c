@@ -0,0 +1,230 @@
+#include "vlua_fs.h"
+#include <stdio.h>
+#include <lauxlib.h>
+#include "vbind.h"
+#include "vlua_file.h"
+#include "containers/darray.h"
+#include "core/vlogger.h"
+#include "core/vmem.h"
+#include "filesystem/vfs.h"
+
+// A read started from lua, waiting for its completion.
+typedef struct LuaRead {
+    // The process to call back, null once it is destroyed.
+    Proc *process;
+    int callback_ref;
+    u32 load_id;
+    struct LuaRead *next;
+} LuaRead;
+
+// The reads waiting for their completion, across every process.
+static LuaRead *lua_reads = null;
+
+// Pushes the paths of the nodes as an array and frees the darray.
+static int lua_fs_push_paths(lua_State *L, FsNode **nodes) {
+    u64 count = darray_length(nodes);
+    lua_createtable(L, (int) count, 0);
+    for (u64 i = 0; i < count; ++i) {
+        lua_pushstring(L, nodes[i]->path);
+        lua_rawseti(L, -2, (lua_Integer) i + 1);
+    }
+    darray_destroy(nodes)
+    return 1;
+}
+
+/**
+ * Lists the paths of the children of a directory, the root if no directory is given. Returns nil if the path isn't a
+ * directory.
+ */
+static int lua_fs_list(lua_State *L) {
+    const char *path = luaL_optstring(L, 1, "");
+    FsNode *directory = vfs_node_get((FsPath) path);
+    if (directory == null || directory->type != NODE_DIRECTORY) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_createtable(L, (int) directory->data.directory.child_count, 0);
+    for (u32 i = 0; i < directory->data.directory.child_count; ++i) {
+        lua_pushstring(L, directory->data.directory.children[i]->path);
+        lua_rawseti(L, -2, (lua_Integer) i + 1);
+    }
+    return 1;
+}
+
+/**
+ * Finds the paths starting with a prefix, along with everything below the directories among them.
+ */
+static int lua_fs_find(lua_State *L) {
+    return lua_fs_push_paths(L, vfs_find(lua_tostring(L, 1)));
+}
+
+/**
+ * Finds the paths matching a glob pattern, like every .mgl file in sys/gui.
+ */
+static int lua_fs_glob(lua_State *L) {
+    return lua_fs_push_paths(L, vfs_glob(lua_tostring(L, 1)));
+}
+
+/**
+ * Checks whether a path is in the tree.
+ */
+static int lua_fs_exists(lua_State *L) {
+    lua_pushboolean(L, vfs_node_exists((FsPath) lua_tostring(L, 1)));
+    return 1;
+}
+
+/**
+ * Gets the content hash of a file as 16 hex digits, the same for every file with the same contents. Returns nil if
+ * the path isn't a readable file.
+ */
+static int lua_fs_hash(lua_State *L) {
+    u64 hash = 0;
+    if (!vfs_node_hash(vfs_node_lookup((FsPath) lua_tostring(L, 1)), &hash)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%016llx", (unsigned long long) hash);
+    lua_pushstring(L, digits);
+    return 1;
+}
+
+/**
+ * Replaces the contents of a file, creating it and its directories if needed. The contents reach the disk with the
+ * next flush, so saving every frame is cheap. Returns false if the path can't be written.
+ */
+static int lua_fs_write(lua_State *L) {
+    size_t size = 0;
+    const char *data = lua_tolstring(L, 2, &size);
+    lua_pushboolean(L, vfs_node_write((FsPath) lua_tostring(L, 1), data, size));
+    return 1;
+}
+
+/**
+ * Appends to the contents of a file, creating it if needed. Returns false if the path can't be written.
+ */
+static int lua_fs_append(lua_State *L) {
+    size_t size = 0;
+    const char *data = lua_tolstring(L, 2, &size);
+    lua_pushboolean(L, vfs_node_append((FsPath) lua_tostring(L, 1), data, size));
+    return 1;
+}
+
+/**
+ * Deletes a file, or a directory with everything in it. Returns false if nothing could be deleted.
+ */
+static int lua_fs_remove(lua_State *L) {
+    lua_pushboolean(L, vfs_node_delete((FsPath) lua_tostring(L, 1)));
+    return 1;
+}
+
+/**
+ * Renames a file or a directory, nothing may be at the new path yet. Returns false if it couldn't be renamed.
+ */
+static int lua_fs_rename(lua_State *L) {
+    lua_pushboolean(L, vfs_node_rename((FsPath) lua_tostring(L, 1), (FsPath) lua_tostring(L, 2)));
+    return 1;
+}
+
+/**
+ * Writes every file written since the last flush to disk now, waiting for the disk if sync is true. Returns the number
+ * of files that couldn't be written.
+ */
+static int lua_fs_flush(lua_State *L) {
+    lua_pushinteger(L, vfs_flush(lua_toboolean(L, 1)));
+    return 1;
+}
+
+// Calls back the process that started a read with the contents, or nil and the reason they couldn't be read.
+static void lua_fs_read_complete(FsNode *node, IoStatus status, void *user_data) {
+    LuaRead *read = user_data;
+    LuaRead **link = &lua_reads;
+    while (*link && *link != read) link = &(*link)->next;
+    if (*link) *link = read->next;
+    if (read->process) {
+        lua_State *L = read->process->lua_state;
+        lua_rawgeti(L, LUA_REGISTRYINDEX, read->callback_ref);
+        luaL_unref(L, LUA_REGISTRYINDEX, read->callback_ref);
+        if (status == IO_STATUS_OK) {
+            lua_pushlstring(L, node->data.file.data, node->data.file.size);
+            lua_pushnil(L);
+        } else {
+            lua_pushnil(L);
+            lua_pushstring(L, status == IO_STATUS_CANCELLED ? "cancelled" : "failed to read");
+        }
+        if (lua_pcall(L, 2, 0, 0) != LUA_OK) {
+            verror("Error executing Lua read callback: %s", lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+    }
+    kfree(read, sizeof(LuaRead), MEMORY_TAG_KERNEL);
+}
+
+/**
+ * Reads a file without blocking the frame. The callback gets the contents once they are read, or nil and a reason if
+ * they couldn't be. Returns an id to cancel the read with, nil if the path isn't a file.
+ */
+static int lua_fs_read_async(lua_State *L) {
+    Proc *process = binding_get_process(L);
+    if (process == null) return luaL_error(L, "read_async called from a lua state without a process");
+    FsNode *node = vfs_node_lookup((FsPath) lua_tostring(L, 1));
+    if (node == null || node->type != NODE_FILE) {
+        lua_pushnil(L);
+        return 1;
+    }
+    LuaRead *read = kallocate(sizeof(LuaRead), MEMORY_TAG_KERNEL);
+    read->process = process;
+    lua_pushvalue(L, 2);
+    read->callback_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    // The callback is never called from here, it waits for the next poll even if the file is resident.
+    read->load_id = vfs_node_load_async(node, lua_fs_read_complete, read);
+    if (read->load_id == INVALID_ID) {
+        luaL_unref(L, LUA_REGISTRYINDEX, read->callback_ref);
+        kfree(read, sizeof(LuaRead), MEMORY_TAG_KERNEL);
+        lua_pushnil(L);
+        return 1;
+    }
+    read->next = lua_reads;
+    lua_reads = read;
+    lua_pushinteger(L, read->load_id);
+    return 1;
+}
+
+/**
+ * Cancels a read started with read_async, its callback gets nil and "cancelled". Returns false if it already finished.
+ */
+static int lua_fs_cancel(lua_State *L) {
+    lua_pushboolean(L, vfs_node_cancel_load((u32) lua_tointeger(L, 1)));
+    return 1;
+}
+
+static const LuaBinding fs_bindings[] = {
+    LUA_BINDING("list", lua_fs_list, "|s"),
+    LUA_BINDING("find", lua_fs_find, "s"),
+    LUA_BINDING("glob", lua_fs_glob, "s"),
+    LUA_BINDING("exists", lua_fs_exists, "s"),
+    LUA_BINDING("hash", lua_fs_hash, "s"),
+    LUA_BINDING("open", lua_file_open, "s"),
+    LUA_BINDING("read_async", lua_fs_read_async, "sf"),
+    LUA_BINDING("cancel", lua_fs_cancel, "n"),
+    LUA_BINDING("write", lua_fs_write, "ss"),
+    LUA_BINDING("append", lua_fs_append, "ss"),
+    LUA_BINDING("remove", lua_fs_remove, "s"),
+    LUA_BINDING("rename", lua_fs_rename, "ss"),
+    LUA_BINDING("flush", lua_fs_flush, "|b"),
+    LUA_BINDING_END
+};
+
+void lua_fs_register(lua_State *L) {
+    lua_file_register(L);
+    binding_register_table(L, "fs", fs_bindings);
+}
+
+void lua_fs_uninstall_from(Proc *process) {
+    for (LuaRead *read = lua_reads; read; read = read->next) {
+        if (read->process != process) continue;
+        // The callback reference goes away with the lua state, the completion only frees the read.
+        read->process = null;
+        vfs_node_cancel_load(read->load_id);
+    }
+}
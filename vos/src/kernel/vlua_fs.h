@@ -0,0 +1,30 @@
+/**
+ * The lua side of the vfs, installed as sys.fs.
+ *
+ * Queries go through the path index of the vfs, so listing a directory or matching a pattern only visits the
+ * directories involved. Every query listing nodes returns an array of paths relative to the root, in sorted tree
+ * order.
+ *
+ * Files are read in chunks through the handles returned by open, see vlua_file.h, or without blocking with read_async,
+ * whose callback runs on a later frame once the contents are in.
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+#include "vproc.h"
+
+/**
+ * Attaches the fs table to the table at the top of the stack.
+ *
+ * @param L The lua state.
+ */
+void lua_fs_register(lua_State *L);
+
+/**
+ * Drops the reads the given process started and hasn't been called back for yet, called before its lua state is
+ * closed.
+ *
+ * @param process The process being destroyed.
+ */
+void lua_fs_uninstall_from(Proc *process);
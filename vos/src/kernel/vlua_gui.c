@@ -0,0 +1,483 @@
+#include "vlua_gui.h"
+#include <lauxlib.h>
+#include <string.h>
+#include "vbind.h"
+#include "core/vgui_display.h"
+#include "core/vgui_text.h"
+
+// The number of slots each command takes in a flat batch buffer, the opcode followed by five operands.
+#define LUA_BATCH_STRIDE 6
+
+// Reused by every sys.gui.batch call so submitting a frame doesn't allocate once the storage has grown.
+static GuiBatch shared_batch = {null};
+
+// Parses a single hex digit, returns -1 if the character isn't one.
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Parses a RRGGBBAA or RRGGBB hex string, colors without an alpha are opaque.
+static b8 parse_hex_color(const char *hex, size_t length, u32 *out_color) {
+    if (hex[0] == '#') {
+        hex++;
+        length--;
+    }
+    if (length != 8 && length != 6) return false;
+    u32 color = 0;
+    for (size_t i = 0; i < length; ++i) {
+        int digit = hex_digit(hex[i]);
+        if (digit < 0) return false;
+        color = (color << 4) | (u32) digit;
+    }
+    *out_color = length == 6 ? (color << 8) | 0xFF : color;
+    return true;
+}
+
+b8 lua_gui_to_color(lua_State *L, int index, u32 *out_color) {
+    index = lua_absindex(L, index);
+    if (lua_isinteger(L, index)) {
+        *out_color = (u32) lua_tointeger(L, index);
+        return true;
+    }
+    if (lua_istable(L, index)) {
+        lua_getfield(L, index, "r");
+        lua_getfield(L, index, "g");
+        lua_getfield(L, index, "b");
+        lua_getfield(L, index, "a");
+        *out_color = gui_pack_color(lua_tointeger(L, -4), lua_tointeger(L, -3), lua_tointeger(L, -2),
+                                    lua_tointeger(L, -1));
+        lua_pop(L, 4);
+        return true;
+    }
+    return false;
+}
+
+LuaRect *lua_gui_to_rect(lua_State *L, int index) {
+    return luaL_testudata(L, index, LUA_RECT_METATABLE);
+}
+
+LuaVec2 *lua_gui_to_vec2(lua_State *L, int index) {
+    return luaL_testudata(L, index, LUA_VEC2_METATABLE);
+}
+
+/**
+ * Creates a packed color. Takes either a hex string ("RRGGBBAA" or "RRGGBB") or 3 to 4 components.
+ */
+static int lua_color(lua_State *L) {
+    int top = lua_gettop(L);
+    u32 color;
+    if (top == 1 && lua_type(L, 1) == LUA_TSTRING) {
+        size_t length;
+        const char *hex = lua_tolstring(L, 1, &length);
+        if (!parse_hex_color(hex, length, &color)) {
+            return luaL_error(L, "color: invalid hex color '%s'", hex);
+        }
+        lua_pushinteger(L, color);
+        return 1;
+    }
+    if (top != 3 && top != 4) {
+        return luaL_error(L, "color: expected a hex string or 3 to 4 components, got %d arguments", top);
+    }
+    color = gui_pack_color(luaL_checkinteger(L, 1), luaL_checkinteger(L, 2), luaL_checkinteger(L, 3),
+                           top == 4 ? luaL_checkinteger(L, 4) : 255);
+    lua_pushinteger(L, color);
+    return 1;
+}
+
+// Reads the color of a draw call, either a single color value or r, g, b[, a] components starting at the index.
+static b8 lua_draw_color(lua_State *L, int index, GuiColor *out_color) {
+    u32 color;
+    if (lua_gettop(L) >= index + 2 && lua_type(L, index) == LUA_TNUMBER) {
+        color = gui_pack_color(lua_tointeger(L, index), lua_tointeger(L, index + 1), lua_tointeger(L, index + 2),
+                               lua_isnoneornil(L, index + 3) ? 255 : lua_tointeger(L, index + 3));
+    } else if (!lua_gui_to_color(L, index, &color)) {
+        return false;
+    }
+    *out_color = gui_unpack_color(color);
+    return true;
+}
+
+// Reads a position given as either a vec2 or x, y components at the index, returns the index after it.
+static int lua_read_position(lua_State *L, int index, f32 *out_x, f32 *out_y) {
+    LuaVec2 *position = lua_gui_to_vec2(L, index);
+    if (position) {
+        *out_x = position->x;
+        *out_y = position->y;
+        return index + 1;
+    }
+    *out_x = (f32) luaL_checknumber(L, index);
+    *out_y = (f32) luaL_checknumber(L, index + 1);
+    return index + 2;
+}
+
+// Reads a rectangle given as either a rect or x, y, width, height components at the index, returns the index after it.
+static int lua_read_rect(lua_State *L, int index, GuiRect *out_rect) {
+    LuaRect *rect = lua_gui_to_rect(L, index);
+    if (rect) {
+        out_rect->x = rect->x;
+        out_rect->y = rect->y;
+        out_rect->width = rect->width;
+        out_rect->height = rect->height;
+        return index + 1;
+    }
+    out_rect->x = (f32) luaL_checknumber(L, index);
+    out_rect->y = (f32) luaL_checknumber(L, index + 1);
+    out_rect->width = (f32) luaL_checknumber(L, index + 2);
+    out_rect->height = (f32) luaL_checknumber(L, index + 3);
+    return index + 4;
+}
+
+/**
+ * Draws text, takes (text, x, y, size, color) or (text, vec2, size, color).
+ */
+static int lua_draw_string(lua_State *L) {
+    const char *message = luaL_checkstring(L, 1);
+    f32 x, y;
+    int next = lua_read_position(L, 2, &x, &y);
+    f32 size = (f32) luaL_checknumber(L, next);
+    GuiColor color;
+    // Text without a color isn't drawn.
+    if (!lua_draw_color(L, next + 1, &color)) return 0;
+    gui_draw_text(message, x, y, size, "sans", color);
+    return 0;
+}
+
+/**
+ * Draws a filled rectangle, takes (x, y, width, height, color) or (rect, color).
+ */
+static int lua_draw_rect(lua_State *L) {
+    GuiRect rect;
+    int next = lua_read_rect(L, 1, &rect);
+    GuiColor color;
+    // Rectangles without a color aren't drawn.
+    if (!lua_draw_color(L, next, &color)) return 0;
+    gui_draw_rect(rect.x, rect.y, rect.width, rect.height, color);
+    return 0;
+}
+
+GuiDisplayList *lua_gui_display_list(lua_State *L) {
+    Proc *process = binding_get_process(L);
+    if (process == null) {
+        luaL_error(L, "retained gui calls need a lua state with a process");
+        return null;
+    }
+    if (process->display_list == null) process->display_list = gui_display_list_create();
+    return process->display_list;
+}
+
+// Reads the color operand of a node setter, nodes only take packed colors.
+static u32 lua_node_color(lua_State *L, int index) {
+    u32 color;
+    if (!lua_gui_to_color(L, index, &color)) luaL_error(L, "expected a color at argument %d", index);
+    return color;
+}
+
+/**
+ * Creates a retained node and returns its id. The node isn't drawn until it is given a rect or text, after that it
+ * stays on screen without being redrawn every frame.
+ */
+static int lua_node(lua_State *L) {
+    lua_pushinteger(L, gui_display_node_create(lua_gui_display_list(L)));
+    return 1;
+}
+
+/**
+ * Makes a node a filled rectangle, takes (id, x, y, width, height, color) or (id, rect, color). Setting the same
+ * values again is free.
+ */
+static int lua_node_rect(lua_State *L) {
+    GuiDisplayList *list = lua_gui_display_list(L);
+    lua_Integer id = luaL_checkinteger(L, 1);
+    GuiRect rect;
+    int next = lua_read_rect(L, 2, &rect);
+    u32 color = lua_node_color(L, next);
+    if (!gui_display_node_set_rect(list, (u32) id, rect.x, rect.y, rect.width, rect.height, color)) {
+        return luaL_error(L, "node_rect: there is no node %d", (int) id);
+    }
+    return 0;
+}
+
+/**
+ * Makes a node a text, takes (id, text, x, y, size, color) or (id, text, vec2, size, color). Setting the same values
+ * again is free.
+ */
+static int lua_node_text(lua_State *L) {
+    GuiDisplayList *list = lua_gui_display_list(L);
+    lua_Integer id = luaL_checkinteger(L, 1);
+    const char *text = luaL_checkstring(L, 2);
+    f32 x, y;
+    int next = lua_read_position(L, 3, &x, &y);
+    f32 size = (f32) luaL_checknumber(L, next);
+    u32 color = lua_node_color(L, next + 1);
+    if (!gui_display_node_set_text(list, (u32) id, text, x, y, size, "sans", color)) {
+        return luaL_error(L, "node_text: there is no node %d", (int) id);
+    }
+    return 0;
+}
+
+static int lua_node_visible(lua_State *L) {
+    lua_Integer id = lua_tointeger(L, 1);
+    if (!gui_display_node_set_visible(lua_gui_display_list(L), (u32) id, lua_toboolean(L, 2))) {
+        return luaL_error(L, "node_visible: there is no node %d", (int) id);
+    }
+    return 0;
+}
+
+static int lua_node_raise(lua_State *L) {
+    lua_Integer id = lua_tointeger(L, 1);
+    if (!gui_display_node_raise(lua_gui_display_list(L), (u32) id)) {
+        return luaL_error(L, "node_raise: there is no node %d", (int) id);
+    }
+    return 0;
+}
+
+static int lua_node_remove(lua_State *L) {
+    lua_Integer id = lua_tointeger(L, 1);
+    if (!gui_display_node_destroy(lua_gui_display_list(L), (u32) id)) {
+        return luaL_error(L, "node_remove: there is no node %d", (int) id);
+    }
+    return 0;
+}
+
+/**
+ * Measures text, takes (text, size[, bytes]). With a byte count only that many leading bytes are measured, which is
+ * where a cursor before that byte is drawn. Measurements are cached, so measuring every frame is cheap.
+ */
+static int lua_text_width(lua_State *L) {
+    const char *text = lua_tostring(L, 1);
+    f32 size = (f32) lua_tonumber(L, 2);
+    if (lua_isnoneornil(L, 3)) {
+        lua_pushnumber(L, gui_text_width(text, "sans", size));
+        return 1;
+    }
+    lua_Integer bytes = lua_tointeger(L, 3);
+    lua_pushnumber(L, bytes <= 0 ? 0 : gui_text_prefix_width(text, "sans", size, (u64) bytes));
+    return 1;
+}
+
+// Reads a number operand of a batch command.
+static f32 lua_batch_number(lua_State *L, int buffer, lua_Integer index) {
+    lua_rawgeti(L, buffer, index);
+    int is_number;
+    lua_Number value = lua_tonumberx(L, -1, &is_number);
+    lua_pop(L, 1);
+    if (!is_number) luaL_error(L, "batch: expected a number at slot %d", (int) index);
+    return (f32) value;
+}
+
+// Reads the color operand of a batch command.
+static u32 lua_batch_color(lua_State *L, int buffer, lua_Integer index) {
+    lua_rawgeti(L, buffer, index);
+    u32 color;
+    if (!lua_gui_to_color(L, -1, &color)) luaL_error(L, "batch: expected a color at slot %d", (int) index);
+    lua_pop(L, 1);
+    return color;
+}
+
+/**
+ * Submits a flat command buffer in one call, takes (buffer[, count]). Every command takes six slots:
+ *  - sys.gui.RECT, x, y, width, height, color
+ *  - sys.gui.TEXT, text, x, y, size, color
+ * The optional count is the number of used slots, it lets a script reuse the same buffer every frame without
+ * clearing the slots left over from a bigger frame.
+ */
+static int lua_batch(lua_State *L) {
+    lua_Integer count = lua_isnoneornil(L, 2) ? (lua_Integer) lua_rawlen(L, 1) : lua_tointeger(L, 2);
+    if (count % LUA_BATCH_STRIDE != 0) {
+        return luaL_error(L, "batch: the buffer holds %d slots, expected a multiple of %d", (int) count,
+                          LUA_BATCH_STRIDE);
+    }
+    if (shared_batch.commands == null) gui_batch_create(&shared_batch);
+    gui_batch_clear(&shared_batch);
+    for (lua_Integer i = 1; i <= count; i += LUA_BATCH_STRIDE) {
+        lua_rawgeti(L, 1, i);
+        lua_Integer opcode = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        switch (opcode) {
+            case GUI_COMMAND_RECT:
+                gui_batch_rect(&shared_batch, lua_batch_number(L, 1, i + 1), lua_batch_number(L, 1, i + 2),
+                               lua_batch_number(L, 1, i + 3), lua_batch_number(L, 1, i + 4),
+                               lua_batch_color(L, 1, i + 5));
+                break;
+            case GUI_COMMAND_TEXT: {
+                // The buffer keeps the string alive until the batch is drawn at the end of this call. Only a string
+                // is, a number would be converted into a new string nothing holds on to once it is popped.
+                lua_rawgeti(L, 1, i + 1);
+                const char *text = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1) : null;
+                lua_pop(L, 1);
+                if (text == null) return luaL_error(L, "batch: expected a string at slot %d", (int) i + 1);
+                gui_batch_text(&shared_batch, text, lua_batch_number(L, 1, i + 2), lua_batch_number(L, 1, i + 3),
+                               lua_batch_number(L, 1, i + 4), "sans", lua_batch_color(L, 1, i + 5));
+                break;
+            }
+            default:
+                return luaL_error(L, "batch: unknown command %d at slot %d", (int) opcode, (int) i);
+        }
+    }
+    gui_draw_batch(&shared_batch);
+    return 0;
+}
+
+static int lua_vec2_new(lua_State *L) {
+    // The arguments are read before the userdata is pushed, with no arguments it would take their slots.
+    f32 x = (f32) luaL_optnumber(L, 1, 0);
+    f32 y = (f32) luaL_optnumber(L, 2, 0);
+    LuaVec2 *vec = lua_newuserdatauv(L, sizeof(LuaVec2), 0);
+    vec->x = x;
+    vec->y = y;
+    luaL_setmetatable(L, LUA_VEC2_METATABLE);
+    return 1;
+}
+
+static int lua_rect_new(lua_State *L) {
+    f32 x = (f32) luaL_optnumber(L, 1, 0);
+    f32 y = (f32) luaL_optnumber(L, 2, 0);
+    f32 width = (f32) luaL_optnumber(L, 3, 0);
+    f32 height = (f32) luaL_optnumber(L, 4, 0);
+    LuaRect *rect = lua_newuserdatauv(L, sizeof(LuaRect), 0);
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+    luaL_setmetatable(L, LUA_RECT_METATABLE);
+    return 1;
+}
+
+// Maps a field name of a value type to the component it refers to, null if there is no such field.
+static f32 *lua_vec2_field(LuaVec2 *vec, const char *key) {
+    if (strcmp(key, "x") == 0) return &vec->x;
+    if (strcmp(key, "y") == 0) return &vec->y;
+    return null;
+}
+
+static f32 *lua_rect_field(LuaRect *rect, const char *key) {
+    if (strcmp(key, "x") == 0) return &rect->x;
+    if (strcmp(key, "y") == 0) return &rect->y;
+    if (strcmp(key, "width") == 0 || strcmp(key, "w") == 0) return &rect->width;
+    if (strcmp(key, "height") == 0 || strcmp(key, "h") == 0) return &rect->height;
+    return null;
+}
+
+static int lua_vec2_index(lua_State *L) {
+    f32 *field = lua_vec2_field(luaL_checkudata(L, 1, LUA_VEC2_METATABLE), luaL_checkstring(L, 2));
+    if (field) lua_pushnumber(L, *field);
+    else lua_pushnil(L);
+    return 1;
+}
+
+static int lua_vec2_newindex(lua_State *L) {
+    const char *key = luaL_checkstring(L, 2);
+    f32 *field = lua_vec2_field(luaL_checkudata(L, 1, LUA_VEC2_METATABLE), key);
+    if (field == null) return luaL_error(L, "vec2 has no field '%s'", key);
+    *field = (f32) luaL_checknumber(L, 3);
+    return 0;
+}
+
+static int lua_vec2_tostring(lua_State *L) {
+    LuaVec2 *vec = luaL_checkudata(L, 1, LUA_VEC2_METATABLE);
+    lua_pushfstring(L, "vec2(%f, %f)", (lua_Number) vec->x, (lua_Number) vec->y);
+    return 1;
+}
+
+static int lua_rect_index(lua_State *L) {
+    LuaRect *rect = luaL_checkudata(L, 1, LUA_RECT_METATABLE);
+    const char *key = luaL_checkstring(L, 2);
+    f32 *field = lua_rect_field(rect, key);
+    if (field) {
+        lua_pushnumber(L, *field);
+        return 1;
+    }
+    // Fall back to the methods stored on the metatable.
+    luaL_getmetatable(L, LUA_RECT_METATABLE);
+    lua_getfield(L, -1, key);
+    return 1;
+}
+
+static int lua_rect_newindex(lua_State *L) {
+    const char *key = luaL_checkstring(L, 2);
+    f32 *field = lua_rect_field(luaL_checkudata(L, 1, LUA_RECT_METATABLE), key);
+    if (field == null) return luaL_error(L, "rect has no field '%s'", key);
+    *field = (f32) luaL_checknumber(L, 3);
+    return 0;
+}
+
+static int lua_rect_tostring(lua_State *L) {
+    LuaRect *rect = luaL_checkudata(L, 1, LUA_RECT_METATABLE);
+    lua_pushfstring(L, "rect(%f, %f, %f, %f)", (lua_Number) rect->x, (lua_Number) rect->y,
+                    (lua_Number) rect->width, (lua_Number) rect->height);
+    return 1;
+}
+
+/**
+ * Checks if a point lies inside the rect, takes (x, y) or a vec2.
+ */
+static int lua_rect_contains(lua_State *L) {
+    LuaRect *rect = luaL_checkudata(L, 1, LUA_RECT_METATABLE);
+    f32 x, y;
+    LuaVec2 *point = lua_gui_to_vec2(L, 2);
+    if (point) {
+        x = point->x;
+        y = point->y;
+    } else {
+        x = (f32) luaL_checknumber(L, 2);
+        y = (f32) luaL_checknumber(L, 3);
+    }
+    lua_pushboolean(L, x >= rect->x && y >= rect->y && x < rect->x + rect->width && y < rect->y + rect->height);
+    return 1;
+}
+
+// The color function, the draw calls and the node setters take overloaded arguments, they check their own.
+static const LuaBinding gui_bindings[] = {
+    LUA_BINDING("color", lua_color, null),
+    LUA_BINDING("draw_text", lua_draw_string, null),
+    LUA_BINDING("draw_rect", lua_draw_rect, null),
+    LUA_BINDING("text_width", lua_text_width, "sn|n"),
+    LUA_BINDING("vec2", lua_vec2_new, "|nn"),
+    LUA_BINDING("rect", lua_rect_new, "|nnnn"),
+    LUA_BINDING("batch", lua_batch, "t|n"),
+    LUA_BINDING("node", lua_node, ""),
+    LUA_BINDING("node_rect", lua_node_rect, null),
+    LUA_BINDING("node_text", lua_node_text, null),
+    LUA_BINDING("node_visible", lua_node_visible, "nb"),
+    LUA_BINDING("node_raise", lua_node_raise, "n"),
+    LUA_BINDING("node_remove", lua_node_remove, "n"),
+    LUA_BINDING_END
+};
+
+static const luaL_Reg vec2_metamethods[] = {
+    {"__index", lua_vec2_index},
+    {"__newindex", lua_vec2_newindex},
+    {"__tostring", lua_vec2_tostring},
+    {null, null}
+};
+
+static const luaL_Reg rect_metamethods[] = {
+    {"__index", lua_rect_index},
+    {"__newindex", lua_rect_newindex},
+    {"__tostring", lua_rect_tostring},
+    {"contains", lua_rect_contains},
+    {null, null}
+};
+
+void lua_gui_register(lua_State *L) {
+    luaL_newmetatable(L, LUA_VEC2_METATABLE);
+    luaL_setfuncs(L, vec2_metamethods, 0);
+    lua_pop(L, 1);
+    luaL_newmetatable(L, LUA_RECT_METATABLE);
+    luaL_setfuncs(L, rect_metamethods, 0);
+    lua_pop(L, 1);
+    lua_newtable(L);
+    binding_register(L, gui_bindings);
+    lua_pushinteger(L, GUI_COMMAND_RECT);
+    lua_setfield(L, -2, "RECT");
+    lua_pushinteger(L, GUI_COMMAND_TEXT);
+    lua_setfield(L, -2, "TEXT");
+    lua_setfield(L, -2, "gui");
+}
+
+void lua_gui_shutdown() {
+    gui_batch_destroy(&shared_batch);
+}
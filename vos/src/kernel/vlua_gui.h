@@ -0,0 +1,77 @@
+/**
+ * The lua side of the gui, installed as sys.gui.
+ *
+ * Colors are passed around as a single packed integer (0xRRGGBBAA) so creating and passing them never allocates.
+ * Positions and rectangles can optionally be held in small vec2/rect userdata that scripts create once and mutate,
+ * the draw intrinsics accept them in place of the individual components.
+ *
+ * Besides the immediate draw calls, sys.gui.node and its setters give a process retained nodes that stay on screen
+ * until they change. Scripts can set every node each frame, only values that differ from the last ones cause a redraw.
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+#include "core/vgui.h"
+
+// The registry names of the value type metatables.
+#define LUA_VEC2_METATABLE "vos.vec2"
+#define LUA_RECT_METATABLE "vos.rect"
+
+/**
+ * The userdata behind sys.gui.vec2.
+ */
+typedef struct LuaVec2 {
+    f32 x, y;
+} LuaVec2;
+
+/**
+ * The userdata behind sys.gui.rect.
+ */
+typedef struct LuaRect {
+    f32 x, y;
+    f32 width, height;
+} LuaRect;
+
+/**
+ * Reads a color from the lua stack. Accepts a packed integer or a legacy {r, g, b, a} table.
+ *
+ * @param L The lua state.
+ * @param index The stack index of the color.
+ * @param out_color The packed color.
+ *
+ * @return True if the value at the index is a color, false otherwise.
+ */
+b8 lua_gui_to_color(lua_State *L, int index, u32 *out_color);
+
+/**
+ * Gets the rect userdata at the given stack index.
+ *
+ * @return The rect, or null if the value isn't a rect.
+ */
+LuaRect *lua_gui_to_rect(lua_State *L, int index);
+
+/**
+ * Gets the vec2 userdata at the given stack index.
+ *
+ * @return The vec2, or null if the value isn't a vec2.
+ */
+LuaVec2 *lua_gui_to_vec2(lua_State *L, int index);
+
+/**
+ * Gets the display list of the process owning the lua state, creating it on first use. Raises a lua error if the state
+ * has no process.
+ */
+struct GuiDisplayList *lua_gui_display_list(lua_State *L);
+
+/**
+ * Creates the value type metatables and attaches the gui table to the table at the top of the stack.
+ *
+ * @param L The lua state.
+ */
+void lua_gui_register(lua_State *L);
+
+/**
+ * Frees the batch storage shared by every lua state.
+ */
+void lua_gui_shutdown();
@@ -0,0 +1,234 @@
+#include "vlua_input.h"
+#include <lauxlib.h>
+#include <string.h>
+#include "vbind.h"
+#include "core/vinput.h"
+
+// The largest utf-8 encoding of a single codepoint.
+#define UTF8_MAX_BYTES 4
+
+static b8 snapshot_key_down(const InputSnapshot *snapshot, lua_Integer key) {
+    return input_bitset_test(snapshot->keys, (u32) key);
+}
+
+static b8 snapshot_key_pressed(const InputSnapshot *snapshot, lua_Integer key) {
+    return input_bitset_test(snapshot->keys, (u32) key) && !input_bitset_test(snapshot->prev_keys, (u32) key);
+}
+
+static b8 snapshot_key_released(const InputSnapshot *snapshot, lua_Integer key) {
+    return !input_bitset_test(snapshot->keys, (u32) key) && input_bitset_test(snapshot->prev_keys, (u32) key);
+}
+
+static b8 snapshot_button_bit(u32 buttons, lua_Integer button) {
+    return button >= 0 && button < BUTTON_MAX_BUTTONS && ((buttons >> button) & 1);
+}
+
+static b8 snapshot_key_up(const InputSnapshot *snapshot, lua_Integer key) {
+    return !input_bitset_test(snapshot->keys, (u32) key);
+}
+
+// Every key query takes one or more keys and is true if any of them passes the test.
+static int lua_key_query(lua_State *L, b8 (*test)(const InputSnapshot *, lua_Integer)) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    int top = lua_gettop(L);
+    for (int i = 1; i <= top; ++i) {
+        if (test(snapshot, luaL_checkinteger(L, i))) {
+            lua_pushboolean(L, true);
+            return 1;
+        }
+    }
+    lua_pushboolean(L, false);
+    return 1;
+}
+
+static int lua_input_down(lua_State *L) {
+    return lua_key_query(L, snapshot_key_down);
+}
+
+static int lua_input_up(lua_State *L) {
+    return lua_key_query(L, snapshot_key_up);
+}
+
+static int lua_input_pressed(lua_State *L) {
+    return lua_key_query(L, snapshot_key_pressed);
+}
+
+static int lua_input_released(lua_State *L) {
+    return lua_key_query(L, snapshot_key_released);
+}
+
+static int lua_input_button_down(lua_State *L) {
+    lua_pushboolean(L, snapshot_button_bit(input_get_snapshot()->buttons, lua_tointeger(L, 1)));
+    return 1;
+}
+
+static int lua_input_button_up(lua_State *L) {
+    lua_pushboolean(L, !snapshot_button_bit(input_get_snapshot()->buttons, lua_tointeger(L, 1)));
+    return 1;
+}
+
+static int lua_input_button_pressed(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    lua_Integer button = lua_tointeger(L, 1);
+    lua_pushboolean(L, snapshot_button_bit(snapshot->buttons, button) &&
+                       !snapshot_button_bit(snapshot->prev_buttons, button));
+    return 1;
+}
+
+static int lua_input_button_released(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    lua_Integer button = lua_tointeger(L, 1);
+    lua_pushboolean(L, !snapshot_button_bit(snapshot->buttons, button) &&
+                       snapshot_button_bit(snapshot->prev_buttons, button));
+    return 1;
+}
+
+/**
+ * Returns the mouse position as two integers.
+ */
+static int lua_input_mouse_position(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    lua_pushinteger(L, snapshot->mouse_x);
+    lua_pushinteger(L, snapshot->mouse_y);
+    return 2;
+}
+
+static int lua_input_wheel(lua_State *L) {
+    lua_pushinteger(L, input_get_snapshot()->wheel_delta);
+    return 1;
+}
+
+// Encodes the codepoint as utf-8, returns the number of bytes written.
+static u32 utf8_encode(u32 codepoint, char *out) {
+    if (codepoint < 0x80) {
+        out[0] = (char) codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char) (0xC0 | (codepoint >> 6));
+        out[1] = (char) (0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (char) (0xE0 | (codepoint >> 12));
+        out[1] = (char) (0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char) (0xF0 | (codepoint >> 18));
+    out[1] = (char) (0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char) (0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char) (0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+/**
+ * Returns the text typed during the frame as a utf-8 string, empty if nothing was typed.
+ */
+static int lua_input_text(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    char buffer[INPUT_MAX_TEXT_EVENTS * UTF8_MAX_BYTES];
+    u32 length = 0;
+    for (u32 i = 0; i < snapshot->text_count; ++i) {
+        length += utf8_encode(snapshot->text[i], buffer + length);
+    }
+    lua_pushlstring(L, buffer, length);
+    return 1;
+}
+
+static const LuaBinding mouse_bindings[] = {
+    LUA_BINDING("is_down", lua_input_button_down, "n"),
+    LUA_BINDING("is_up", lua_input_button_up, "n"),
+    LUA_BINDING("is_pressed", lua_input_button_pressed, "n"),
+    LUA_BINDING("is_released", lua_input_button_released, "n"),
+    LUA_BINDING_END
+};
+
+/**
+ * Kept for older scripts, builds a table with the mouse position and button functions. Prefer mouse_position and the
+ * button queries, they don't allocate.
+ */
+static int lua_mouse(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    lua_newtable(L);
+    lua_pushinteger(L, snapshot->mouse_x);
+    lua_setfield(L, -2, "x");
+    lua_pushinteger(L, snapshot->mouse_y);
+    lua_setfield(L, -2, "y");
+    binding_register(L, mouse_bindings);
+    return 1;
+}
+
+/**
+ * Kept for older scripts, builds a table with the four states of a key. Prefer down, up, pressed and released.
+ */
+static int lua_key(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    lua_Integer key = lua_tointeger(L, 1);
+    lua_createtable(L, 0, 4);
+    lua_pushboolean(L, snapshot_key_down(snapshot, key));
+    lua_setfield(L, -2, "is_down");
+    lua_pushboolean(L, snapshot_key_up(snapshot, key));
+    lua_setfield(L, -2, "is_up");
+    lua_pushboolean(L, snapshot_key_pressed(snapshot, key));
+    lua_setfield(L, -2, "is_pressed");
+    lua_pushboolean(L, snapshot_key_released(snapshot, key));
+    lua_setfield(L, -2, "is_released");
+    return 1;
+}
+
+/**
+ * Reads a field of the shared snapshot userdata.
+ */
+static int lua_snapshot_index(lua_State *L) {
+    const InputSnapshot *snapshot = input_get_snapshot();
+    const char *key = luaL_checkstring(L, 2);
+    if (strcmp(key, "frame") == 0) lua_pushinteger(L, (lua_Integer) snapshot->frame);
+    else if (strcmp(key, "mouse_x") == 0) lua_pushinteger(L, snapshot->mouse_x);
+    else if (strcmp(key, "mouse_y") == 0) lua_pushinteger(L, snapshot->mouse_y);
+    else if (strcmp(key, "prev_mouse_x") == 0) lua_pushinteger(L, snapshot->prev_mouse_x);
+    else if (strcmp(key, "prev_mouse_y") == 0) lua_pushinteger(L, snapshot->prev_mouse_y);
+    else if (strcmp(key, "wheel") == 0) lua_pushinteger(L, snapshot->wheel_delta);
+    else if (strcmp(key, "text_count") == 0) lua_pushinteger(L, snapshot->text_count);
+    else lua_pushnil(L);
+    return 1;
+}
+
+static int lua_snapshot_newindex(lua_State *L) {
+    return luaL_error(L, "the input snapshot is read-only");
+}
+
+static const luaL_Reg snapshot_metamethods[] = {
+    {"__index", lua_snapshot_index},
+    {"__newindex", lua_snapshot_newindex},
+    {null, null}
+};
+
+static const LuaBinding input_bindings[] = {
+    LUA_BINDING("down", lua_input_down, "n*"),
+    LUA_BINDING("up", lua_input_up, "n*"),
+    LUA_BINDING("pressed", lua_input_pressed, "n*"),
+    LUA_BINDING("released", lua_input_released, "n*"),
+    LUA_BINDING("button_down", lua_input_button_down, "n"),
+    LUA_BINDING("button_up", lua_input_button_up, "n"),
+    LUA_BINDING("button_pressed", lua_input_button_pressed, "n"),
+    LUA_BINDING("button_released", lua_input_button_released, "n"),
+    LUA_BINDING("mouse_position", lua_input_mouse_position, ""),
+    LUA_BINDING("wheel", lua_input_wheel, ""),
+    LUA_BINDING("text", lua_input_text, ""),
+    LUA_BINDING("mouse", lua_mouse, ""),
+    LUA_BINDING("key", lua_key, "n"),
+    LUA_BINDING_END
+};
+
+void lua_input_register(lua_State *L) {
+    lua_newtable(L);
+    binding_register(L, input_bindings);
+    // The snapshot userdata carries no data of its own, every field is read from the kernel's snapshot.
+    lua_newuserdatauv(L, 0, 0);
+    luaL_newmetatable(L, LUA_INPUT_SNAPSHOT_METATABLE);
+    luaL_setfuncs(L, snapshot_metamethods, 0);
+    lua_setmetatable(L, -2);
+    lua_setfield(L, -2, "state");
+    lua_setfield(L, -2, "input");
+}
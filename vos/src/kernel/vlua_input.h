@@ -0,0 +1,21 @@
+/**
+ * The lua side of input, installed as sys.input.
+ *
+ * Every query reads the snapshot the kernel publishes once per frame, so polling keys, buttons and the mouse never
+ * allocates and every script sees the same state for the whole frame. The snapshot itself is exposed as the shared
+ * read-only sys.input.state userdata.
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+
+// The registry name of the snapshot userdata metatable.
+#define LUA_INPUT_SNAPSHOT_METATABLE "vos.input"
+
+/**
+ * Attaches the input table to the table at the top of the stack.
+ *
+ * @param L The lua state.
+ */
+void lua_input_register(lua_State *L);
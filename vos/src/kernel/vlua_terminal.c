@@ -0,0 +1,204 @@
+#include "vlua_terminal.h"
+#include <lauxlib.h>
+#include "vbind.h"
+#include "vlua_gui.h"
+#include "core/vterminal.h"
+
+// The font every terminal row is drawn with.
+#define LUA_TERMINAL_FONT "sans"
+
+static TerminalBuffer *lua_terminal_check(lua_State *L) {
+    TerminalBuffer **buffer = luaL_checkudata(L, 1, LUA_TERMINAL_METATABLE);
+    if (*buffer == null) luaL_error(L, "the terminal buffer has been destroyed");
+    return *buffer;
+}
+
+/**
+ * Creates a terminal buffer, optionally with the number of scrollback lines to keep.
+ */
+static int lua_terminal_new(lua_State *L) {
+    lua_Integer capacity = luaL_optinteger(L, 1, 0);
+    if (capacity < 0) return luaL_error(L, "new: the scrollback can't be negative");
+    TerminalBuffer **buffer = lua_newuserdatauv(L, sizeof(TerminalBuffer *), 0);
+    *buffer = terminal_buffer_create((u32) capacity);
+    luaL_setmetatable(L, LUA_TERMINAL_METATABLE);
+    return 1;
+}
+
+static int lua_terminal_gc(lua_State *L) {
+    TerminalBuffer **buffer = luaL_checkudata(L, 1, LUA_TERMINAL_METATABLE);
+    terminal_buffer_destroy(*buffer);
+    *buffer = null;
+    return 0;
+}
+
+/**
+ * Appends text to the newest line, newlines start new lines.
+ */
+static int lua_terminal_write(lua_State *L) {
+    size_t length;
+    const char *text = lua_tolstring(L, 2, &length);
+    terminal_buffer_write(lua_terminal_check(L), text, length);
+    return 0;
+}
+
+/**
+ * Appends text as complete lines.
+ */
+static int lua_terminal_print(lua_State *L) {
+    size_t length;
+    const char *text = lua_tolstring(L, 2, &length);
+    terminal_buffer_print(lua_terminal_check(L), text, length);
+    return 0;
+}
+
+static int lua_terminal_clear(lua_State *L) {
+    terminal_buffer_clear(lua_terminal_check(L));
+    return 0;
+}
+
+static int lua_terminal_line_count(lua_State *L) {
+    lua_pushinteger(L, lua_terminal_check(L)->count);
+    return 1;
+}
+
+/**
+ * Gets a scrollback line by its 1 based index, 1 being the oldest line kept. Returns nil when out of range.
+ */
+static int lua_terminal_line(lua_State *L) {
+    lua_Integer index = lua_tointeger(L, 2);
+    const TerminalLine *line = index >= 1 ? terminal_buffer_line(lua_terminal_check(L), (u32) (index - 1)) : null;
+    if (line) lua_pushlstring(L, line->text, line->length);
+    else lua_pushnil(L);
+    return 1;
+}
+
+/**
+ * Scrolls by the given number of lines, positive values scroll towards older lines. Returns the new scroll.
+ */
+static int lua_terminal_scroll(lua_State *L) {
+    TerminalBuffer *buffer = lua_terminal_check(L);
+    terminal_buffer_scroll(buffer, (i32) lua_tointeger(L, 2));
+    lua_pushinteger(L, buffer->scroll);
+    return 1;
+}
+
+static int lua_terminal_insert(lua_State *L) {
+    size_t length;
+    const char *text = lua_tolstring(L, 2, &length);
+    terminal_input_insert(lua_terminal_check(L), text, length);
+    return 0;
+}
+
+static int lua_terminal_backspace(lua_State *L) {
+    lua_pushboolean(L, terminal_input_backspace(lua_terminal_check(L)));
+    return 1;
+}
+
+static int lua_terminal_delete(lua_State *L) {
+    lua_pushboolean(L, terminal_input_delete(lua_terminal_check(L)));
+    return 1;
+}
+
+static int lua_terminal_move(lua_State *L) {
+    terminal_input_move(lua_terminal_check(L), (i32) lua_tointeger(L, 2));
+    return 0;
+}
+
+static int lua_terminal_move_word(lua_State *L) {
+    terminal_input_move_word(lua_terminal_check(L), (i32) lua_tointeger(L, 2));
+    return 0;
+}
+
+static int lua_terminal_move_home(lua_State *L) {
+    terminal_input_set_cursor(lua_terminal_check(L), 0);
+    return 0;
+}
+
+static int lua_terminal_move_end(lua_State *L) {
+    TerminalBuffer *buffer = lua_terminal_check(L);
+    terminal_input_set_cursor(buffer, terminal_input_length(buffer));
+    return 0;
+}
+
+/**
+ * Gets the cursor as a byte offset into the input line.
+ */
+static int lua_terminal_cursor(lua_State *L) {
+    lua_pushinteger(L, terminal_input_cursor(lua_terminal_check(L)));
+    return 1;
+}
+
+/**
+ * Gets the input line as a string.
+ */
+static int lua_terminal_input(lua_State *L) {
+    TerminalBuffer *buffer = lua_terminal_check(L);
+    luaL_Buffer out;
+    char *text = luaL_buffinitsize(L, &out, terminal_input_length(buffer) + 1);
+    terminal_input_copy(buffer, text);
+    luaL_pushresultsize(&out, terminal_input_length(buffer));
+    return 1;
+}
+
+/**
+ * Replaces the input line and moves the cursor to its end.
+ */
+static int lua_terminal_set_input(lua_State *L) {
+    size_t length;
+    const char *text = lua_tolstring(L, 2, &length);
+    terminal_input_set(lua_terminal_check(L), text, length);
+    return 0;
+}
+
+/**
+ * Draws the visible lines into the process display list: draw(x, y, width, height, size, color). Returns true when
+ * new rows were created, they sit above every node the script created before.
+ */
+static int lua_terminal_draw(lua_State *L) {
+    TerminalBuffer *buffer = lua_terminal_check(L);
+    GuiRect area = {(f32) lua_tonumber(L, 2), (f32) lua_tonumber(L, 3), (f32) lua_tonumber(L, 4),
+                    (f32) lua_tonumber(L, 5)};
+    u32 color;
+    if (!lua_gui_to_color(L, 7, &color)) return luaL_error(L, "draw: expected a color at argument 7");
+    lua_pushboolean(L, terminal_buffer_draw(buffer, lua_gui_display_list(L), area, (f32) lua_tonumber(L, 6),
+                                            LUA_TERMINAL_FONT, color));
+    return 1;
+}
+
+static const LuaBinding terminal_bindings[] = {
+    LUA_BINDING("new", lua_terminal_new, "|n"),
+    LUA_BINDING_END
+};
+
+static const LuaBinding terminal_methods[] = {
+    LUA_BINDING("write", lua_terminal_write, "us"),
+    LUA_BINDING("print", lua_terminal_print, "us"),
+    LUA_BINDING("clear", lua_terminal_clear, "u"),
+    LUA_BINDING("line_count", lua_terminal_line_count, "u"),
+    LUA_BINDING("line", lua_terminal_line, "un"),
+    LUA_BINDING("scroll", lua_terminal_scroll, "un"),
+    LUA_BINDING("insert", lua_terminal_insert, "us"),
+    LUA_BINDING("backspace", lua_terminal_backspace, "u"),
+    LUA_BINDING("delete", lua_terminal_delete, "u"),
+    LUA_BINDING("move", lua_terminal_move, "un"),
+    LUA_BINDING("move_word", lua_terminal_move_word, "un"),
+    LUA_BINDING("move_home", lua_terminal_move_home, "u"),
+    LUA_BINDING("move_end", lua_terminal_move_end, "u"),
+    LUA_BINDING("cursor", lua_terminal_cursor, "u"),
+    LUA_BINDING("input", lua_terminal_input, "u"),
+    LUA_BINDING("set_input", lua_terminal_set_input, "us"),
+    LUA_BINDING("draw", lua_terminal_draw, "unnnnn."),
+    LUA_BINDING_END
+};
+
+void lua_terminal_register(lua_State *L) {
+    luaL_newmetatable(L, LUA_TERMINAL_METATABLE);
+    lua_pushcfunction(L, lua_terminal_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_newtable(L);
+    binding_register(L, terminal_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    binding_register_table(L, "terminal", terminal_bindings);
+}
@@ -0,0 +1,20 @@
+/**
+ * The lua side of the terminal buffer, installed as sys.terminal.
+ *
+ * sys.terminal.new returns a buffer userdata that owns a native TerminalBuffer, so scrollback, the input line and
+ * the rows drawn into the process display list live in C and a script only forwards keys and output to it.
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+
+// The registry name of the terminal buffer userdata metatable.
+#define LUA_TERMINAL_METATABLE "vos.terminal"
+
+/**
+ * Attaches the terminal table to the table at the top of the stack.
+ *
+ * @param L The lua state.
+ */
+void lua_terminal_register(lua_State *L);
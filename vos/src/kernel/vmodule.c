@@ -0,0 +1,191 @@
+#include "vmodule.h"
+#include <lauxlib.h>
+#include "core/vmem.h"
+#include "core/vlogger.h"
+#include "containers/dict.h"
+#include "containers/darray.h"
+
+// The initial size of the buffer lua_dump writes into, it is doubled as needed.
+#define MODULE_BYTECODE_INITIAL_CAPACITY 4096
+
+typedef struct ModuleCache {
+    // The cached modules keyed by the relative path of their source node.
+    Dict *modules;
+} ModuleCache;
+
+// A growing buffer used as the lua_dump writer target.
+typedef struct BytecodeWriter {
+    char *data;
+    u64 size;
+    u64 capacity;
+} BytecodeWriter;
+
+static ModuleCache *module_cache = null;
+
+static void module_free(Module *module);
+
+void module_cache_initialize() {
+    if (module_cache) {
+        vwarn("module_cache_initialize - Module cache already initialized.")
+        return;
+    }
+    module_cache = kallocate(sizeof(ModuleCache), MEMORY_TAG_KERNEL);
+    // Keyed on the source paths, which are atoms.
+    module_cache->modules = dict_new_atoms();
+}
+
+void module_cache_shutdown() {
+    if (!module_cache) return;
+    DictIter it = dict_iterator(module_cache->modules);
+    while (dict_next(&it)) {
+        for (Entry *entry = it.entry; entry != null; entry = entry->next) module_free(entry->value);
+    }
+    dict_delete(module_cache->modules);
+    kfree(module_cache, sizeof(ModuleCache), MEMORY_TAG_KERNEL);
+    module_cache = null;
+}
+
+Module *module_cache_get(FsNode *node) {
+    if (!module_cache || !node) return null;
+    return dict_get_atom(module_cache->modules, node->path);
+}
+
+// Gets the module for the node, creating an empty entry if it has not been seen before.
+static Module *module_cache_get_or_create(FsNode *node) {
+    Module *module = dict_get_atom(module_cache->modules, node->path);
+    if (module) return module;
+    module = kallocate(sizeof(Module), MEMORY_TAG_KERNEL);
+    module->source = node;
+    module->bytecode = null;
+    module->bytecode_size = 0;
+    module->dependencies = darray_create(FsNode *);
+    module->dependents = darray_create(FsNode *);
+    dict_set_atom(module_cache->modules, node->path, module);
+    return module;
+}
+
+static int module_bytecode_writer(lua_State *L, const void *p, size_t size, void *user_data) {
+    BytecodeWriter *writer = user_data;
+    if (writer->size + size > writer->capacity) {
+        u64 capacity = writer->capacity ? writer->capacity : MODULE_BYTECODE_INITIAL_CAPACITY;
+        while (writer->size + size > capacity) capacity *= 2;
+        char *data = kallocate(capacity, MEMORY_TAG_KERNEL);
+        if (writer->data) {
+            kcopy_memory(data, writer->data, writer->size);
+            kfree(writer->data, writer->capacity, MEMORY_TAG_KERNEL);
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    kcopy_memory(writer->data + writer->size, p, size);
+    writer->size += size;
+    return 0;
+}
+
+int module_cache_load(lua_State *L, FsNode *node) {
+    // Cached bytecode doesn't need the source, it is only read when the module has to be compiled.
+    Module *cached = module_cache_get(node);
+    if (cached && cached->bytecode) {
+        // The hash outlives the contents, checking it only reads the source again after the file changed.
+        u64 hash = 0;
+        if (vfs_node_hash(node, &hash) && hash == cached->source_hash) {
+            return luaL_loadbuffer(L, cached->bytecode, cached->bytecode_size, node->path);
+        }
+        module_cache_invalidate(node);
+    }
+    // The source is compiled front to back right away, let a mapped file be read ahead.
+    vfs_node_advise(node, FS_ACCESS_WILLNEED);
+    if (!node || node->type != NODE_FILE || !vfs_node_load(node)) {
+        lua_pushfstring(L, "module %s is not a loadable file", node ? node->path : "(null)");
+        return LUA_ERRFILE;
+    }
+    if (!module_cache) return luaL_loadbuffer(L, node->data.file.data, node->data.file.size, node->path);
+    Module *module = module_cache_get_or_create(node);
+
+    int status = luaL_loadbuffer(L, node->data.file.data, node->data.file.size, node->path);
+    if (status != LUA_OK) return status;
+    // Keep debug information so errors raised from the cached chunk still report the source lines.
+    BytecodeWriter writer = {null, 0, 0};
+    if (lua_dump(L, module_bytecode_writer, &writer, 0) != 0 || writer.size == 0) {
+        vwarn("module_cache_load - Failed to dump bytecode for %s, it will be recompiled next load", node->path)
+        if (writer.data) kfree(writer.data, writer.capacity, MEMORY_TAG_KERNEL);
+        return LUA_OK;
+    }
+    // Shrink the buffer down to the exact size so the cache doesn't hold on to the slack.
+    module->bytecode = kallocate(writer.size, MEMORY_TAG_KERNEL);
+    module->bytecode_size = writer.size;
+    kcopy_memory(module->bytecode, writer.data, writer.size);
+    kfree(writer.data, writer.capacity, MEMORY_TAG_KERNEL);
+    // The source is resident, it is hashed in place.
+    vfs_node_hash(node, &module->source_hash);
+    vdebug("module_cache_load - Compiled %s to %llu bytes of bytecode", node->path, module->bytecode_size)
+    return LUA_OK;
+}
+
+// Pushes the node to the darray of nodes if it isn't already in it.
+static FsNode **module_edge_add(FsNode **edges, FsNode *node) {
+    u64 length = darray_length(edges);
+    for (u64 i = 0; i < length; ++i) {
+        if (edges[i] == node) return edges;
+    }
+    darray_push(FsNode *, edges, node)
+    return edges;
+}
+
+void module_cache_add_dependency(FsNode *importer, FsNode *module) {
+    if (!module_cache || !importer || !module) return;
+    Module *importer_module = module_cache_get_or_create(importer);
+    Module *imported_module = module_cache_get_or_create(module);
+    importer_module->dependencies = module_edge_add(importer_module->dependencies, module);
+    imported_module->dependents = module_edge_add(imported_module->dependents, importer);
+}
+
+void module_cache_invalidate(FsNode *node) {
+    Module *module = module_cache_get(node);
+    if (!module || !module->bytecode) return;
+    kfree(module->bytecode, module->bytecode_size, MEMORY_TAG_KERNEL);
+    module->bytecode = null;
+    module->bytecode_size = 0;
+    vdebug("module_cache_invalidate - Invalidated %s", node->path)
+}
+
+// Frees a module and its edges.
+static void module_free(Module *module) {
+    if (module->bytecode) kfree(module->bytecode, module->bytecode_size, MEMORY_TAG_KERNEL);
+    darray_destroy(module->dependencies)
+    darray_destroy(module->dependents)
+    kfree(module, sizeof(Module), MEMORY_TAG_KERNEL);
+}
+
+void module_cache_remove(FsNode *node) {
+    if (!module_cache || !node) return;
+    Module *module = module_cache_get(node);
+    if (!module) return;
+    // Only the modules on the other end of an edge can point back at the node.
+    u64 length = darray_length(module->dependencies);
+    for (u64 i = 0; i < length; ++i) {
+        Module *imported = module_cache_get(module->dependencies[i]);
+        if (imported) darray_remove(imported->dependents, &node);
+    }
+    length = darray_length(module->dependents);
+    for (u64 i = 0; i < length; ++i) {
+        Module *importer = module_cache_get(module->dependents[i]);
+        if (importer) darray_remove(importer->dependencies, &node);
+    }
+    dict_remove_atom(module_cache->modules, node->path);
+    module_free(module);
+    vdebug("module_cache_remove - Removed %s", node->path)
+}
+
+FsNode **module_cache_collect_dependents(FsNode *node, FsNode **nodes) {
+    u64 start = darray_length(nodes);
+    nodes = module_edge_add(nodes, node);
+    // Walks the importers breadth first, the darray doubles as the queue and the visited set.
+    for (u64 i = start; i < darray_length(nodes); ++i) {
+        Module *module = module_cache_get(nodes[i]);
+        if (!module) continue;
+        u64 length = darray_length(module->dependents);
+        for (u64 j = 0; j < length; ++j) nodes = module_edge_add(nodes, module->dependents[j]);
+    }
+    return nodes;
+}
@@ -0,0 +1,86 @@
+/**
+ * The module cache keeps a single compiled copy of every lua chunk the kernel loads. The first time a script is
+ * loaded it is compiled from source and dumped to bytecode, every lua state after that loads the bytecode directly
+ * and skips the parser. The cache also records which scripts imported which modules, so a change to a module can be
+ * traced back to the processes that depend on it (hot reloading).
+ */
+#pragma once
+
+#include "defines.h"
+#include "lua.h"
+#include "filesystem/vfs.h"
+
+/**
+ * A compiled chunk along with its place in the import graph.
+ */
+typedef struct Module {
+    // The vfs node the module was compiled from.
+    FsNode *source;
+    // The dumped bytecode of the compiled chunk, null until the module has been compiled.
+    char *bytecode;
+    // The size of the bytecode in bytes.
+    u64 bytecode_size;
+    // The content hash of the source the bytecode was compiled from, stale bytecode is compiled again.
+    u64 source_hash;
+    // A darray of the modules this module imports.
+    FsNode **dependencies;
+    // A darray of the modules and processes that import this module.
+    FsNode **dependents;
+} Module;
+
+/**
+ * Initializes the kernel wide module cache.
+ */
+void module_cache_initialize();
+
+/**
+ * Frees all cached bytecode and the import graph.
+ */
+void module_cache_shutdown();
+
+/**
+ * Loads the chunk for the given node onto the stack of the lua state. This is a drop in replacement for
+ * luaL_loadbuffer, the source is only compiled the first time, after that the cached bytecode is used for as long as
+ * the content hash of the node matches the source it was compiled from.
+ * @param L The lua state to load the chunk into.
+ * @param node The script node to load.
+ * @return LUA_OK with the function on the top of the stack, otherwise an error code with the error message on the
+ * top of the stack.
+ */
+int module_cache_load(lua_State *L, FsNode *node);
+
+/**
+ * Records that the importer imported the module. Duplicate edges are ignored.
+ * @param importer The script that performed the import.
+ * @param module The module that was imported.
+ */
+void module_cache_add_dependency(FsNode *importer, FsNode *module);
+
+/**
+ * Looks up the cached module for the given node.
+ * @param node The script node.
+ * @return The module or null if the node has never been loaded or imported.
+ */
+Module *module_cache_get(FsNode *node);
+
+/**
+ * Drops the cached bytecode for the given node so the next load recompiles it from source. The import graph is kept.
+ * @param node The script node that changed.
+ */
+void module_cache_invalidate(FsNode *node);
+
+/**
+ * Drops the module of a node deleted from the vfs along with every edge to it, so nothing in the graph points at
+ * the node once it is freed.
+ * @param node The script node that was deleted.
+ */
+void module_cache_remove(FsNode *node);
+
+/**
+ * Collects a node and every module and process script that imports it, directly or through other modules. These are
+ * the scripts that have to run again for a change to the node to take effect.
+ * @param node The script node that changed.
+ * @param nodes A darray the nodes are pushed to, nodes already in it aren't pushed again.
+ * @return The darray, it may have moved.
+ */
+FsNode **module_cache_collect_dependents(FsNode *node, FsNode **nodes);
@@ -6,10 +6,12 @@
 #include "core/vmem.h"
 #include "core/vlogger.h"
 #include "core/vstring.h"
+#include "core/vgui_display.h"
 
 #include "platform/platform.h"
 #include "containers/darray.h"
 #include "kernel.h"
+#include "vmodule.h"
 #include "filesystem/paths.h"
 
 /**
@@ -21,11 +23,8 @@ Proc *process_create(FsNode *script_file_node) {
     process->state = PROCESS_STATE_STOPPED;
     process->children_pids = darray_create(ProcID);
     FsPath path = process->source_file_node->path;
-    //get the name by getting the last part of the path after the last slash
-    char *name = string_split_at(path, "/", string_split_count(path, "/") - 1);
-    //remove the extension
-    name = string_split_at(name, ".", 0);
-    process->process_name = name;
+    //the name is the last part of the path after the last slash without the extension, only it is copied
+    process->process_name = sv_to_string(path_stem_view(sv_from(path)));
     return process;
 }
 
@@ -43,14 +42,7 @@ b8 process_start(Proc *process) {
         process->state = PROCESS_STATE_STOPPED;
         return false;
     }
-    const char *source = asset->data.file.data;
-    u64 size = asset->data.file.size;
-    if (source == null) {
-        verror("Failed to load script %s", process->pid);
-        process->state = PROCESS_STATE_STOPPED;
-        return false;
-    }
-    if (luaL_loadbuffer(process->lua_state, source, size, asset->path) != LUA_OK) {
+    if (module_cache_load(process->lua_state, asset) != LUA_OK) {
         const char *error_string = lua_tostring(process->lua_state, -1);
         verror("Failed to run script %d: %s", process->pid, error_string);
         return false;
@@ -90,8 +82,10 @@ b8 process_stop(Proc *process, b8 force, b8 kill_children) {
         }
     }
     darray_destroy(process->children_pids)
-    // close the lua state
+    // close the lua state, finalizers may still remove their nodes from the display list
     lua_close(process->lua_state);
+    // Takes the process's nodes off the screen.
+    gui_display_list_destroy(process->display_list);
     kfree(process, sizeof(Proc), MEMORY_TAG_PROCESS);
     return true;
 }
@@ -36,6 +36,8 @@ typedef struct Proc {
     ProcID *children_pids;
     // Current state of the process
     ProcessState state;
+    // The retained gui nodes of the process, created the first time the process makes one.
+    struct GuiDisplayList *display_list;
 } Proc;
 
 /**
@@ -24,7 +24,8 @@ void symtab_property_enter(SymtabPass *visitor, PropertyDeclaration *node);
 implement_pass(SymtabPass, Scope *scope, {
     pass->scope = vnew(Scope);
     pass->scope->name = "global";
-    pass->scope->symbols = dict_new();
+    // Identifiers repeat across every scope, they are interned once and compared by pointer.
+    pass->scope->symbols = dict_new_atoms();
     muil_set_visitor((SemanticsPass *) pass, SEMANTICS_MASK_COMPONENT, symtab_component_enter, symtab_component_exit);
     muil_set_visitor((SemanticsPass *) pass, SEMANTICS_MASK_PROGRAM, symtab_ignored_enter, symtab_program_exit);
     muil_set_visitor((SemanticsPass *) pass, SEMANTICS_MASK_PROPERTY, symtab_property_enter, symtab_ignored_enter);
@@ -103,7 +104,7 @@ void symtab_component_enter(SymtabPass *visitor, CompoundDeclaration *node) {
     // Push a new scope here
     Scope *scope = vnew(Scope);
     scope->name = node->name;
-    scope->symbols = dict_new();
+    scope->symbols = dict_new_atoms();
     scope->parent = parent_scope;
     visitor->scope = scope;
     ast_node->userData = scope;
@@ -57,6 +57,17 @@ typedef struct VFilePathList {
     int count;    // Number of paths
 } VFilePathList;
 
+typedef struct VDirectoryEntry {
+    char *name;      // The name of the entry, without the directory
+    b8 is_directory; // Whether the entry is a directory, symlinks are resolved
+    u64 size;        // The size in bytes, zero for directories
+} VDirectoryEntry;
+
+typedef struct VDirectoryList {
+    VDirectoryEntry *entries; // Dynamic array of entries
+    int count;                // Number of entries
+} VDirectoryList;
+
 /**
  * @brief Initializes the platform layer.
  */
@@ -252,6 +263,58 @@ VAPI b8 platform_watch_file(const char *file_path, u32 *out_watch_id);
  */
 VAPI b8 platform_unwatch_file(u32 watch_id);
 
+// The longest entry name reported by a directory watch, including the terminator.
+#define PLATFORM_WATCH_NAME_MAX 256
+
+typedef enum platform_watch_action {
+    // The contents of an entry were written and the file was closed.
+    PLATFORM_WATCH_WRITTEN = 0,
+    // An entry was created or moved into the directory.
+    PLATFORM_WATCH_CREATED = 1,
+    // An entry was deleted or moved out of the directory.
+    PLATFORM_WATCH_DELETED = 2,
+    // Events were dropped, every watched directory may have changed in any way.
+    PLATFORM_WATCH_OVERFLOW = 3
+} platform_watch_action;
+
+typedef struct platform_watch_event {
+    // The watch of the directory the entry is in, INVALID_ID for an overflow.
+    u32 watch_id;
+    platform_watch_action action;
+    b8 is_directory;
+    // The name of the entry inside the directory, not a path.
+    char name[PLATFORM_WATCH_NAME_MAX];
+} platform_watch_event;
+
+/**
+* @brief Watches the entries of a directory, not its subdirectories, for changes.
+*
+* Unlike platform_watch_file nothing is fired as an event, the changes are queued by the platform and collected with
+* platform_read_watch_events.
+*
+* @param path The path of the directory.
+* @param out_watch_id A pointer to hold the watch identifier.
+* @return True on success, false if the directory can't be watched or the platform can't watch directories.
+*/
+VAPI b8 platform_watch_directory(const char *path, u32 *out_watch_id);
+
+/**
+* @brief Stops watching a directory. Events already queued for it may still be read.
+*
+* @param watch_id The watch identifier.
+* @return True on success; otherwise false.
+*/
+VAPI b8 platform_unwatch_directory(u32 watch_id);
+
+/**
+* @brief Reads the queued changes of the watched directories without blocking.
+*
+* @param out_events The events to fill.
+* @param capacity The number of events out_events holds, the rest stay queued for the next call.
+* @return The number of events read, zero once nothing is queued.
+*/
+VAPI u32 platform_read_watch_events(platform_watch_event *out_events, u32 capacity);
+
 VAPI /**
 *
 */
@@ -275,6 +338,25 @@ VAPI VFilePathList *platform_collect_files_direct(const char *path);
 
 VAPI VFilePathList *platform_collect_files_recursive(const char *path);
 
+/**
+* @brief Lists the entries of a directory along with their types and sizes.
+*
+* Unlike platform_collect_files_direct followed by a stat of every path, the type comes with the directory listing
+* where the file system provides it and the size is looked up relative to the open directory, so no path is resolved
+* from the root again. Safe to call from several threads at once.
+*
+* @param path The path of the directory.
+* @return The entries, or NULL if the directory couldn't be opened. Free with directory_list_free.
+*/
+VAPI VDirectoryList *platform_scan_directory(const char *path);
+
+/**
+* @brief Frees a VDirectoryList and the names of its entries.
+*
+* @param list The list to be freed
+*/
+VAPI void directory_list_free(VDirectoryList *list);
+
 /**
 * @brief Checks if the given path represents a file.
 *
@@ -303,9 +385,96 @@ VAPI u32 platform_file_size(const char *path);
 * The caller is responsible for freeing the memory allocated for the data using a corresponding "free" function.
 *
 * @param path The path of the file to be read.
-* @return A pointer to the data read from the file, or NULL if an error occurs.
+* @param out_size Set to the number of bytes read, the size of the file as it is now. May be null.
+* @return A pointer to the data read from the file, or NULL if an error occurs. An empty file still gets an allocation.
+*/
+VAPI void *platform_read_file(const char *path, u64 *out_size);
+
+/**
+* @brief Writes the contents of a file, creating it or replacing what it held.
+*
+* @param path The path of the file to write.
+* @param data The contents, may be null if size is zero.
+* @param size The number of bytes to write.
+* @param sync Whether to wait until the contents reached the disk.
+* @return True if every byte was written.
+*/
+VAPI b8 platform_write_file(const char *path, const void *data, u64 size, b8 sync);
+
+/**
+* @brief Renames a file, replacing the destination if it exists.
+*
+* Readers of the destination see either the old or the new file, never a mix, which makes writing a temporary file
+* and renaming it over the original an atomic save.
+*
+* @param source The path of the file to rename.
+* @param dest The new path, in an existing directory.
+* @return True on success.
+*/
+VAPI b8 platform_rename_file(const char *source, const char *dest);
+
+/**
+* @brief Removes a file or an empty directory.
+*
+* @param path The path to remove.
+* @return True on success.
+*/
+VAPI b8 platform_remove_file(const char *path);
+
+/**
+* @brief Creates a directory, its parent has to exist.
+*
+* @param path The path of the directory.
+* @return True if the directory was created or already exists.
+*/
+VAPI b8 platform_create_directory(const char *path);
+
+/**
+* @brief Waits until the entries of a directory reached the disk, so files renamed into it survive a crash.
+* Platforms that make renames durable on their own return right away.
+*
+* @param path The path of the directory.
+* @return True on success.
+*/
+VAPI b8 platform_sync_directory(const char *path);
+
+typedef enum platform_map_advice {
+    // No particular access pattern.
+    PLATFORM_MAP_ADVICE_NORMAL = 0,
+    // The whole mapping will be read soon, the pages can be read ahead.
+    PLATFORM_MAP_ADVICE_WILLNEED = 1,
+    // The mapping is read at scattered offsets, reading ahead is wasted.
+    PLATFORM_MAP_ADVICE_RANDOM = 2
+} platform_map_advice;
+
+/**
+* @brief Maps a file into memory read only.
+*
+* The pages are shared with the page cache instead of being copied into a private allocation, so mapping the same
+* file in several processes only costs its pages once. The mapping stays valid after the file is closed.
+*
+* @param path The path of the file to map.
+* @param out_size A pointer to hold the size of the mapping, which is the size of the file when it was mapped.
+* @return A pointer to the mapped data, or NULL if the file couldn't be mapped. Empty files can't be mapped.
+*/
+VAPI void *platform_map_file(const char *path, u64 *out_size);
+
+/**
+* @brief Unmaps a mapping created with platform_map_file.
+*
+* @param data The mapped data.
+* @param size The size of the mapping.
+*/
+VAPI void platform_unmap_file(void *data, u64 size);
+
+/**
+* @brief Tells the platform how a mapping will be accessed. Only a hint, platforms without support ignore it.
+*
+* @param data The mapped data.
+* @param size The size of the mapping.
+* @param advice The expected access pattern.
 */
-VAPI void *platform_read_file(const char *path);
+VAPI void platform_advise_mapping(void *data, u64 size, platform_map_advice advice);
 
 /**
  * Converts the given path to a platform-specific path.
@@ -0,0 +1,107 @@
+/**
+ * The directory watches of the Linux platform, backed by inotify. One inotify instance serves every watch, the watch
+ * id handed out is the inotify watch descriptor. The instance is non blocking, so reading the events never stalls a
+ * frame, and it is closed again with the last watch.
+ */
+#if defined(__linux__)
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "platform.h"
+#include "core/vlogger.h"
+
+// Enough for a burst of events at once, a single event is at most sizeof(struct inotify_event) + NAME_MAX + 1.
+#define INOTIFY_BUFFER_SIZE 16384
+
+// Writes are reported once the writer closes the file rather than on every write, a save is one event.
+#define INOTIFY_WATCH_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+typedef struct InotifyState {
+    int fd;
+    // The events read but not handed out yet, from offset to length.
+    char buffer[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    u32 offset;
+    u32 length;
+    u32 watch_count;
+} InotifyState;
+
+static InotifyState inotify_state = {.fd = -1};
+
+b8 platform_watch_directory(const char *path, u32 *out_watch_id) {
+    if (!path || !out_watch_id) return false;
+    if (inotify_state.fd == -1) {
+        inotify_state.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_state.fd == -1) {
+            vwarn("platform_watch_directory - Failed to create an inotify instance: %s", strerror(errno))
+            return false;
+        }
+    }
+    int wd = inotify_add_watch(inotify_state.fd, path, INOTIFY_WATCH_MASK);
+    if (wd == -1) {
+        // Usually the per user watch limit, fs.inotify.max_user_watches.
+        vwarn("platform_watch_directory - Failed to watch %s: %s", path, strerror(errno))
+        return false;
+    }
+    *out_watch_id = (u32) wd;
+    inotify_state.watch_count++;
+    return true;
+}
+
+b8 platform_unwatch_directory(u32 watch_id) {
+    if (inotify_state.fd == -1 || watch_id == INVALID_ID) return false;
+    // A watch the kernel already dropped, because its directory was deleted, still counts.
+    b8 removed = inotify_rm_watch(inotify_state.fd, (int) watch_id) == 0;
+    if (inotify_state.watch_count > 0 && --inotify_state.watch_count == 0) {
+        close(inotify_state.fd);
+        inotify_state.fd = -1;
+        inotify_state.offset = 0;
+        inotify_state.length = 0;
+    }
+    return removed;
+}
+
+// Refills the buffer once every queued event was handed out, false if nothing is queued.
+static b8 inotify_fill() {
+    if (inotify_state.offset < inotify_state.length) return true;
+    inotify_state.offset = 0;
+    inotify_state.length = 0;
+    ssize_t length = read(inotify_state.fd, inotify_state.buffer, INOTIFY_BUFFER_SIZE);
+    if (length <= 0) return false;
+    inotify_state.length = (u32) length;
+    return true;
+}
+
+u32 platform_read_watch_events(platform_watch_event *out_events, u32 capacity) {
+    if (inotify_state.fd == -1 || out_events == null) return 0;
+    u32 count = 0;
+    while (count < capacity && inotify_fill()) {
+        struct inotify_event *event = (struct inotify_event *) (inotify_state.buffer + inotify_state.offset);
+        inotify_state.offset += sizeof(struct inotify_event) + event->len;
+        platform_watch_event *out = &out_events[count];
+        if (event->mask & IN_Q_OVERFLOW) {
+            out->watch_id = INVALID_ID;
+            out->action = PLATFORM_WATCH_OVERFLOW;
+            out->is_directory = false;
+            out->name[0] = '\0';
+            count++;
+            continue;
+        }
+        // Events about the watched directory itself, like IN_IGNORED once it is removed, carry no name. Its parent
+        // reports the removal.
+        if (event->len == 0 || event->name[0] == '\0') continue;
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) out->action = PLATFORM_WATCH_CREATED;
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) out->action = PLATFORM_WATCH_DELETED;
+        else if (event->mask & IN_CLOSE_WRITE) out->action = PLATFORM_WATCH_WRITTEN;
+        else continue;
+        out->watch_id = (u32) event->wd;
+        out->is_directory = (event->mask & IN_ISDIR) != 0;
+        strncpy(out->name, event->name, PLATFORM_WATCH_NAME_MAX - 1);
+        out->name[PLATFORM_WATCH_NAME_MAX - 1] = '\0';
+        count++;
+    }
+    return count;
+}
+
+#endif // __linux__
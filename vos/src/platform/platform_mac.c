@@ -2,7 +2,9 @@
 #include "platform.h"
 #include "core/vsemaphore.h"
 #include "core/vmutex.h"
+#include "core/vthread.h"
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <dirent.h>
@@ -13,6 +15,8 @@
 #include <fcntl.h> // For O_CREAT, O_EXEC
 #include <time.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 
 b8 vsemaphore_wait_with_timeout(sem_t *semaphore, u64 timeout_ms) {
     if (!semaphore) {
@@ -170,6 +174,18 @@ f64 platform_get_absolute_time(void){
     return (f64)time.tv_sec + (f64)time.tv_nsec / 1000000000.0;
 }
 
+void platform_sleep(u64 ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000 * 1000;
+    nanosleep(&ts, 0);
+}
+
+i32 platform_get_processor_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (i32) count : 1;
+}
+
 b8 platform_system_startup(u64 *memory_requirement, void *state, void *config) {
     *memory_requirement = sizeof(platform_state);
     if (state == 0) {
@@ -507,14 +523,16 @@ keys translate_keycode(unsigned int ns_keycode) {
 
 b8 platform_is_directory(const char *path) {
     struct stat path_stat;
-    stat(path, &path_stat);
+    // The mode is garbage when the path doesn't exist.
+    if (stat(path, &path_stat) != 0) return false;
     return S_ISDIR(path_stat.st_mode);
 }
 
 
 b8 platform_is_file(const char *path) {
     struct stat path_stat;
-    stat(path, &path_stat);
+    // The mode is garbage when the path doesn't exist.
+    if (stat(path, &path_stat) != 0) return false;
     return S_ISREG(path_stat.st_mode);
 }
 
@@ -531,7 +549,7 @@ u32 platform_file_size(const char *path) {
     return 0;
 }
 
-void *platform_read_file(const char *path) {
+void *platform_read_file(const char *path, u64 *out_size) {
     FILE *file = fopen(path, "rb");
     if (!file) {
         return NULL;
@@ -540,19 +558,293 @@ void *platform_read_file(const char *path) {
     fseek(file, 0, SEEK_END);
     long file_size = ftell(file);
     rewind(file);
+    if (file_size < 0) {
+        fclose(file);
+        return NULL;
+    }
 
-    void *data = malloc(file_size);
+    void *data = malloc(file_size ? file_size : 1);
     if (!data) {
         fclose(file);
         return NULL;
     }
 
-    fread(data, 1, file_size, file);
+    // The file may have shrunk since it was measured, what was read is its size.
+    size_t read = fread(data, 1, file_size, file);
     fclose(file);
+    if (out_size) *out_size = read;
 
     return data;
 }
 
+b8 platform_write_file(const char *path, const void *data, u64 size, b8 sync) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const char *bytes = data;
+    u64 written = 0;
+    while (written < size) {
+        ssize_t result = write(fd, bytes + written, size - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        written += result;
+    }
+    b8 synced = !sync || fsync(fd) == 0;
+    return close(fd) == 0 && synced;
+}
+
+b8 platform_rename_file(const char *source, const char *dest) {
+    return rename(source, dest) == 0;
+}
+
+b8 platform_remove_file(const char *path) {
+    return remove(path) == 0;
+}
+
+b8 platform_create_directory(const char *path) {
+    if (mkdir(path, 0755) == 0) return true;
+    return errno == EEXIST && platform_is_directory(path);
+}
+
+b8 platform_sync_directory(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    b8 synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+void *platform_map_file(const char *path, u64 *out_size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    *out_size = file_stat.st_size;
+    return data;
+}
+
+void platform_unmap_file(void *data, u64 size) {
+    if (data) munmap(data, size);
+}
+
+void platform_advise_mapping(void *data, u64 size, platform_map_advice advice) {
+    if (!data) return;
+    int flag = MADV_NORMAL;
+    if (advice == PLATFORM_MAP_ADVICE_WILLNEED) flag = MADV_WILLNEED;
+    else if (advice == PLATFORM_MAP_ADVICE_RANDOM) flag = MADV_RANDOM;
+    madvise(data, size, flag);
+}
+
+// Directory watches poll. kqueue only reports that a directory changed and not which entry, so the entries would have
+// to be compared either way. Each watch keeps the entries it saw last, a poll rescans the watched directories and
+// queues the differences. Polls are at least this many seconds apart, so reading the events every frame stays cheap.
+#define MAC_WATCH_POLL_INTERVAL 0.25
+
+typedef struct MacWatchEntry {
+    char name[PLATFORM_WATCH_NAME_MAX];
+    b8 is_directory;
+    // A file counts as written once its modification time or size changes.
+    struct timespec modified;
+    u64 size;
+} MacWatchEntry;
+
+typedef struct MacDirectoryWatch {
+    // Null for a free slot, the watch id is the index of the slot.
+    char *path;
+    // The entries seen by the last poll, sorted by name.
+    MacWatchEntry *entries;
+    u32 entry_count;
+} MacDirectoryWatch;
+
+typedef struct MacWatchState {
+    MacDirectoryWatch *watches;
+    u32 watch_capacity;
+    u32 watch_count;
+    // The events of the last poll not handed out yet, from offset to count.
+    platform_watch_event *events;
+    u32 event_capacity;
+    u32 event_count;
+    u32 event_offset;
+    f64 last_poll;
+} MacWatchState;
+
+static MacWatchState mac_watch_state;
+
+static int mac_watch_entry_compare(const void *a, const void *b) {
+    return strcmp(((const MacWatchEntry *) a)->name, ((const MacWatchEntry *) b)->name);
+}
+
+// Lists the entries of a directory sorted by name, false if it can't be opened. The entries are freed with free.
+static b8 mac_watch_scan(const char *path, MacWatchEntry **out_entries, u32 *out_count) {
+    DIR *dir = opendir(path);
+    if (!dir) return false;
+    MacWatchEntry *entries = NULL;
+    u32 count = 0, capacity = 0;
+    int fd = dirfd(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if (strlen(entry->d_name) >= PLATFORM_WATCH_NAME_MAX) continue;
+        struct stat entry_stat;
+        // Gone again since it was listed, the next poll won't see it either.
+        if (fstatat(fd, entry->d_name, &entry_stat, 0) != 0) continue;
+        if (count == capacity) {
+            u32 new_capacity = capacity ? capacity * 2 : 16;
+            MacWatchEntry *grown = realloc(entries, new_capacity * sizeof(MacWatchEntry));
+            if (!grown) break;
+            entries = grown;
+            capacity = new_capacity;
+        }
+        MacWatchEntry *out = &entries[count++];
+        strcpy(out->name, entry->d_name);
+        out->is_directory = S_ISDIR(entry_stat.st_mode);
+        out->modified = entry_stat.st_mtimespec;
+        out->size = out->is_directory ? 0 : (u64) entry_stat.st_size;
+    }
+    closedir(dir);
+    if (count > 1) qsort(entries, count, sizeof(MacWatchEntry), mac_watch_entry_compare);
+    *out_entries = entries;
+    *out_count = count;
+    return true;
+}
+
+static void mac_watch_queue(u32 watch_id, platform_watch_action action, const MacWatchEntry *entry) {
+    if (mac_watch_state.event_count == mac_watch_state.event_capacity) {
+        u32 new_capacity = mac_watch_state.event_capacity ? mac_watch_state.event_capacity * 2 : 32;
+        platform_watch_event *grown = realloc(mac_watch_state.events, new_capacity * sizeof(platform_watch_event));
+        if (!grown) return;
+        mac_watch_state.events = grown;
+        mac_watch_state.event_capacity = new_capacity;
+    }
+    platform_watch_event *event = &mac_watch_state.events[mac_watch_state.event_count++];
+    event->watch_id = watch_id;
+    event->action = action;
+    event->is_directory = entry->is_directory;
+    strcpy(event->name, entry->name);
+}
+
+// Rescans a watched directory and queues what changed since the last poll. A directory that can't be opened anymore
+// was removed, its parent reports that.
+static void mac_watch_poll(u32 watch_id) {
+    MacDirectoryWatch *watch = &mac_watch_state.watches[watch_id];
+    MacWatchEntry *entries;
+    u32 count;
+    if (!mac_watch_scan(watch->path, &entries, &count)) return;
+    u32 old_index = 0, new_index = 0;
+    // Both lists are sorted, so they are merged like sorted lists.
+    while (old_index < watch->entry_count || new_index < count) {
+        MacWatchEntry *old_entry = old_index < watch->entry_count ? &watch->entries[old_index] : NULL;
+        MacWatchEntry *new_entry = new_index < count ? &entries[new_index] : NULL;
+        int order = !old_entry ? 1 : !new_entry ? -1 : strcmp(old_entry->name, new_entry->name);
+        if (order < 0) {
+            mac_watch_queue(watch_id, PLATFORM_WATCH_DELETED, old_entry);
+            old_index++;
+            continue;
+        }
+        if (order > 0) {
+            mac_watch_queue(watch_id, PLATFORM_WATCH_CREATED, new_entry);
+            new_index++;
+            continue;
+        }
+        if (old_entry->is_directory != new_entry->is_directory) {
+            mac_watch_queue(watch_id, PLATFORM_WATCH_DELETED, old_entry);
+            mac_watch_queue(watch_id, PLATFORM_WATCH_CREATED, new_entry);
+        } else if (!new_entry->is_directory && (old_entry->size != new_entry->size ||
+                                                old_entry->modified.tv_sec != new_entry->modified.tv_sec ||
+                                                old_entry->modified.tv_nsec != new_entry->modified.tv_nsec)) {
+            mac_watch_queue(watch_id, PLATFORM_WATCH_WRITTEN, new_entry);
+        }
+        old_index++;
+        new_index++;
+    }
+    free(watch->entries);
+    watch->entries = entries;
+    watch->entry_count = count;
+}
+
+b8 platform_watch_directory(const char *path, u32 *out_watch_id) {
+    if (!path || !out_watch_id) return false;
+    u32 watch_id = 0;
+    while (watch_id < mac_watch_state.watch_capacity && mac_watch_state.watches[watch_id].path) watch_id++;
+    if (watch_id == mac_watch_state.watch_capacity) {
+        u32 new_capacity = mac_watch_state.watch_capacity ? mac_watch_state.watch_capacity * 2 : 16;
+        MacDirectoryWatch *grown = realloc(mac_watch_state.watches, new_capacity * sizeof(MacDirectoryWatch));
+        if (!grown) return false;
+        memset(grown + mac_watch_state.watch_capacity, 0,
+               (new_capacity - mac_watch_state.watch_capacity) * sizeof(MacDirectoryWatch));
+        mac_watch_state.watches = grown;
+        mac_watch_state.watch_capacity = new_capacity;
+    }
+    MacDirectoryWatch *watch = &mac_watch_state.watches[watch_id];
+    // The first scan is what later polls are compared with.
+    if (!mac_watch_scan(path, &watch->entries, &watch->entry_count)) return false;
+    watch->path = strdup(path);
+    mac_watch_state.watch_count++;
+    *out_watch_id = watch_id;
+    return true;
+}
+
+b8 platform_unwatch_directory(u32 watch_id) {
+    if (watch_id >= mac_watch_state.watch_capacity || !mac_watch_state.watches[watch_id].path) return false;
+    MacDirectoryWatch *watch = &mac_watch_state.watches[watch_id];
+    free(watch->path);
+    free(watch->entries);
+    memset(watch, 0, sizeof(MacDirectoryWatch));
+    // Nothing is left to poll, the queued events are still read.
+    if (--mac_watch_state.watch_count == 0) {
+        free(mac_watch_state.watches);
+        mac_watch_state.watches = NULL;
+        mac_watch_state.watch_capacity = 0;
+    }
+    return true;
+}
+
+u32 platform_read_watch_events(platform_watch_event *out_events, u32 capacity) {
+    if (out_events == NULL) return 0;
+    if (mac_watch_state.event_offset == mac_watch_state.event_count) {
+        mac_watch_state.event_offset = 0;
+        mac_watch_state.event_count = 0;
+        f64 now = platform_get_absolute_time();
+        if (mac_watch_state.watch_count > 0 && now - mac_watch_state.last_poll >= MAC_WATCH_POLL_INTERVAL) {
+            mac_watch_state.last_poll = now;
+            for (u32 i = 0; i < mac_watch_state.watch_capacity; i++) {
+                if (mac_watch_state.watches[i].path) mac_watch_poll(i);
+            }
+        }
+        if (mac_watch_state.event_count == 0) {
+            // Nothing queued, the event storage isn't kept around between polls.
+            free(mac_watch_state.events);
+            mac_watch_state.events = NULL;
+            mac_watch_state.event_capacity = 0;
+            return 0;
+        }
+    }
+    u32 count = mac_watch_state.event_count - mac_watch_state.event_offset;
+    if (count > capacity) count = capacity;
+    memcpy(out_events, mac_watch_state.events + mac_watch_state.event_offset, count * sizeof(platform_watch_event));
+    mac_watch_state.event_offset += count;
+    return count;
+}
+
 // Free the FilePathList and its contents
 void file_path_list_free(VFilePathList *fileList) {
     for (int i = 0; i < fileList->count; i++) {
@@ -639,6 +931,58 @@ VFilePathList *platform_collect_files_direct(const char *path) {
     return fileList;
 }
 
+// Appends an entry to the list, growing the array geometrically.
+static b8 directory_list_add(VDirectoryList *list, int *capacity, const char *name, b8 is_directory, u64 size) {
+    if (list->count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        VDirectoryEntry *entries = realloc(list->entries, new_capacity * sizeof(VDirectoryEntry));
+        if (!entries) return false;
+        list->entries = entries;
+        *capacity = new_capacity;
+    }
+    VDirectoryEntry *entry = &list->entries[list->count++];
+    entry->name = strdup(name);
+    entry->is_directory = is_directory;
+    entry->size = size;
+    return true;
+}
+
+VDirectoryList *platform_scan_directory(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return NULL;
+    }
+    VDirectoryList *list = calloc(1, sizeof(VDirectoryList));
+    int capacity = 0;
+    int fd = dirfd(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        b8 is_directory = entry->d_type == DT_DIR;
+        u64 size = 0;
+        // Directories need no stat at all, files only for their size. The lookup is relative to the open directory.
+        if (!is_directory) {
+            struct stat entry_stat;
+            if (fstatat(fd, entry->d_name, &entry_stat, 0) != 0) continue;
+            is_directory = S_ISDIR(entry_stat.st_mode);
+            if (!is_directory) size = entry_stat.st_size;
+        }
+        if (!directory_list_add(list, &capacity, entry->d_name, is_directory, size)) break;
+    }
+    closedir(dir);
+    return list;
+}
+
+void directory_list_free(VDirectoryList *list) {
+    if (!list) return;
+    for (int i = 0; i < list->count; i++) {
+        free(list->entries[i].name);
+    }
+    free(list->entries);
+    free(list);
+}
+
 // Create and initialize a FilePathList
 VFilePathList *platform_collect_files_recursive(const char *path) {
     VFilePathList *fileList = malloc(sizeof(VFilePathList));
@@ -727,35 +1071,121 @@ b8 vsemaphore_wait(vsemaphore *semaphore, u64 timeout_ms) {
     }
 }
 
+// NOTE: Begin threads
+b8 kthread_create(pfn_thread_start start_function_ptr, void *params, b8 auto_detach, kthread *out_thread) {
+    if (!start_function_ptr) {
+        return false;
+    }
+    pthread_t thread;
+    // pthread start routines return a void pointer, the u32 result of the thread function is discarded.
+    if (pthread_create(&thread, 0, (void *(*)(void *)) start_function_ptr, params) != 0) {
+        return false;
+    }
+    if (auto_detach) {
+        pthread_detach(thread);
+        return true;
+    }
+    out_thread->internal_data = platform_allocate(sizeof(pthread_t), false);
+    *(pthread_t *) out_thread->internal_data = thread;
+    out_thread->thread_id = (u64) thread;
+    return true;
+}
+
+void kthread_destroy(kthread *thread) {
+    if (thread && thread->internal_data) {
+        platform_free(thread->internal_data, false);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+    }
+}
+
+void kthread_detach(kthread *thread) {
+    if (thread && thread->internal_data) {
+        pthread_detach(*(pthread_t *) thread->internal_data);
+        kthread_destroy(thread);
+    }
+}
+
+void kthread_cancel(kthread *thread) {
+    if (thread && thread->internal_data) {
+        pthread_cancel(*(pthread_t *) thread->internal_data);
+        kthread_destroy(thread);
+    }
+}
+
+b8 kthread_wait(kthread *thread) {
+    if (thread && thread->internal_data) {
+        return pthread_join(*(pthread_t *) thread->internal_data, 0) == 0;
+    }
+    return false;
+}
+
+b8 kthread_wait_timeout(kthread *thread, u64 wait_ms) {
+    // There is no portable timed join, so poll for completion until the timeout runs out.
+    while (kthread_is_active(thread)) {
+        if (wait_ms == 0) return false;
+        platform_sleep(1);
+        wait_ms--;
+    }
+    return kthread_wait(thread);
+}
+
+b8 kthread_is_active(kthread *thread) {
+    if (thread && thread->internal_data) {
+        // Signal 0 only checks that the thread can still be signalled, i.e. it hasn't exited.
+        return pthread_kill(*(pthread_t *) thread->internal_data, 0) == 0;
+    }
+    return false;
+}
+
+void kthread_sleep(kthread *thread, u64 ms) {
+    platform_sleep(ms);
+}
+
+u64 platform_current_thread_id(void) {
+    return (u64) pthread_self();
+}
+
+// NOTE: End threads.
+
+// NOTE: Begin mutexes
 b8 kmutex_create(kmutex *out_mutex) {
-//    if (!out_mutex) return false;
-//
-//    // Initialize the mutex with default attributes
-//    if (pthread_mutex_init(&out_mutex->internal_data, NULL) != 0) {
-//        // Handle error
-//        return false;
-//    }
+    if (!out_mutex) return false;
+    pthread_mutex_t *mutex = platform_allocate(sizeof(pthread_mutex_t), false);
+    // Recursive to match the win32 mutex semantics, the memory system re-enters its lock while recording allocations.
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    int result = pthread_mutex_init(mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    if (result != 0) {
+        platform_free(mutex, false);
+        return false;
+    }
+    out_mutex->internal_data = mutex;
     return true;
 }
 
 void kmutex_destroy(kmutex *mutex) {
-//    if (mutex) {
-//        pthread_mutex_destroy(mutex->internal_data);
-//    }
+    if (mutex && mutex->internal_data) {
+        pthread_mutex_destroy(mutex->internal_data);
+        platform_free(mutex->internal_data, false);
+        mutex->internal_data = 0;
+    }
 }
 
 b8 kmutex_lock(kmutex *mutex) {
-    if (!mutex) return false;
-//    return pthread_mutex_lock(mutex->internal_data) == 0;
-    return true;
+    if (!mutex || !mutex->internal_data) return false;
+    return pthread_mutex_lock(mutex->internal_data) == 0;
 }
 
 b8 kmutex_unlock(kmutex *mutex) {
-    if (!mutex) return false;
-//    return pthread_mutex_unlock(mutex->internal_data) == 0;
-    return true;
+    if (!mutex || !mutex->internal_data) return false;
+    return pthread_mutex_unlock(mutex->internal_data) == 0;
 }
 
+// NOTE: End mutexes.
+
 /**
  * @brief Initializes the platform layer.
  */
@@ -344,7 +344,8 @@ b8 vsemaphore_create(vsemaphore *out_semaphore, u32 max_count, u32 start_count)
         return false;
     }
     
-    out_semaphore->internal_data = CreateSemaphore(0, start_count, max_count, "semaphore");
+    // Unnamed, a named semaphore would be shared by every semaphore created with the same name.
+    out_semaphore->internal_data = CreateSemaphore(0, start_count, max_count, 0);
     
     return true;
 }
@@ -377,7 +378,8 @@ b8 vsemaphore_wait(vsemaphore *semaphore, u64 timeout_ms) {
         return false;
     }
     
-    DWORD result = WaitForSingleObject(semaphore->internal_data, timeout_ms);
+    // A timeout of zero waits until the semaphore is signaled, like the posix implementations.
+    DWORD result = WaitForSingleObject(semaphore->internal_data, timeout_ms == 0 ? INFINITE : (DWORD) timeout_ms);
     switch (result) {
         case WAIT_ABANDONED:verror(
                     "The specified object is a mutex object that was not released by the thread that owned the mutex object before the owning thread terminated. Ownership of the mutex object is granted to the calling thread and the mutex state is set to nonsignaled. If the mutex was protecting persistent state information, you should check it for consistency.");
@@ -439,13 +441,11 @@ b8 platform_dynamic_library_unload(dynamic_library *library) {
     }
     
     if (library->name) {
-        u64 length = string_length(library->name);
-        kfree((void *) library->name, sizeof(char) * (length + 1), MEMORY_TAG_STRING);
+        string_deallocate((char *) library->name);
     }
     
     if (library->filename) {
-        u64 length = string_length(library->filename);
-        kfree((void *) library->filename, sizeof(char) * (length + 1), MEMORY_TAG_STRING);
+        string_deallocate((char *) library->filename);
     }
     
     if (library->functions) {
@@ -453,8 +453,7 @@ b8 platform_dynamic_library_unload(dynamic_library *library) {
         for (u32 i = 0; i < count; ++i) {
             dynamic_library_function *f = &library->functions[i];
             if (f->name) {
-                u64 length = string_length(f->name);
-                kfree((void *) f->name, sizeof(char) * (length + 1), MEMORY_TAG_STRING);
+                string_deallocate((char *) f->name);
             }
         }
         
@@ -576,8 +575,7 @@ static b8 unregister_watch(u32 watch_id) {
     
     win32_file_watch *w = &state_ptr->watches[watch_id];
     w->id = INVALID_ID;
-    u32 len = string_length(w->file_path);
-    kfree((void *) w->file_path, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
+    string_deallocate((char *) w->file_path);
     w->file_path = 0;
     kzero_memory(&w->last_write_time, sizeof(FILETIME));
     
@@ -635,14 +633,14 @@ u32 platform_file_size(const char *path) {
     return (u32) file_size.QuadPart;
 }
 
-void *platform_read_file(const char *path) {
+void *platform_read_file(const char *path, u64 *out_size) {
     HANDLE file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
     if (file_handle == INVALID_HANDLE_VALUE) {
         return 0;
     }
     
     u32 file_size = platform_file_size(path);
-    void *data = platform_allocate(file_size, false);
+    void *data = platform_allocate(file_size ? file_size : 1, false);
     if (!data) {
         CloseHandle(file_handle);
         return 0;
@@ -656,9 +654,266 @@ void *platform_read_file(const char *path) {
     }
     
     CloseHandle(file_handle);
+    // The file may have shrunk since it was measured, what was read is its size.
+    if (out_size) *out_size = bytes_read;
     return data;
 }
 
+b8 platform_write_file(const char *path, const void *data, u64 size, b8 sync) {
+    HANDLE file_handle = CreateFileA(path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    const char *bytes = data;
+    u64 written = 0;
+    while (written < size) {
+        // WriteFile takes at most a DWORD at a time.
+        DWORD chunk = size - written > 0x40000000 ? 0x40000000 : (DWORD) (size - written);
+        DWORD bytes_written = 0;
+        if (!WriteFile(file_handle, bytes + written, chunk, &bytes_written, 0)) {
+            CloseHandle(file_handle);
+            return false;
+        }
+        written += bytes_written;
+    }
+    b8 synced = !sync || FlushFileBuffers(file_handle);
+    CloseHandle(file_handle);
+    return synced;
+}
+
+b8 platform_rename_file(const char *source, const char *dest) {
+    return MoveFileExA(source, dest, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+b8 platform_remove_file(const char *path) {
+    DWORD file_attributes = GetFileAttributesA(path);
+    if (file_attributes == INVALID_FILE_ATTRIBUTES) {
+        return false;
+    }
+    if (file_attributes & FILE_ATTRIBUTE_DIRECTORY) return RemoveDirectoryA(path) != 0;
+    return DeleteFileA(path) != 0;
+}
+
+b8 platform_create_directory(const char *path) {
+    if (CreateDirectoryA(path, 0)) return true;
+    return GetLastError() == ERROR_ALREADY_EXISTS && platform_is_directory(path);
+}
+
+b8 platform_sync_directory(const char *path) {
+    // Renames are made durable by MOVEFILE_WRITE_THROUGH, NTFS has nothing to flush for a directory.
+    return true;
+}
+
+void *platform_map_file(const char *path, u64 *out_size) {
+    HANDLE file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file_handle);
+        return 0;
+    }
+    
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(file_handle);
+    if (!mapping_handle) {
+        return 0;
+    }
+    // The view keeps the mapping and the file open until it is unmapped.
+    void *data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping_handle);
+    if (!data) {
+        return 0;
+    }
+    *out_size = (u64) file_size.QuadPart;
+    return data;
+}
+
+void platform_unmap_file(void *data, u64 size) {
+    if (data) UnmapViewOfFile(data);
+}
+
+void platform_advise_mapping(void *data, u64 size, platform_map_advice advice) {
+    // Views are paged in on demand, there is no portable read ahead hint to give.
+}
+
+// Directory watches are backed by ReadDirectoryChangesW. Every watch keeps one overlapped read queued and its result is
+// checked without waiting when the events are read, so reading never stalls a frame. The system buffers the changes
+// made between two reads.
+#define WIN32_WATCH_BUFFER_SIZE 16384
+
+#define WIN32_WATCH_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE)
+
+typedef struct win32_directory_watch {
+    HANDLE directory;
+    OVERLAPPED overlapped;
+    // The directory the entry names are relative to, used to tell files from directories.
+    char *path;
+    // Whether a read is queued, until its result is taken.
+    b8 reading;
+    // The changes of the last finished read not handed out yet, from offset to length.
+    u32 offset;
+    u32 length;
+    // The notifications are DWORD aligned.
+    DWORD buffer[WIN32_WATCH_BUFFER_SIZE / sizeof(DWORD)];
+} win32_directory_watch;
+
+// A darray of the directory watches indexed by watch id, null for ids free to be reused. The reads write into the
+// watches while queued, so they are allocated on their own and never move.
+static win32_directory_watch **directory_watches;
+// Set when a watch had to drop changes, until the overflow event is handed out.
+static b8 directory_watches_overflowed;
+
+static b8 directory_watch_read(win32_directory_watch *watch) {
+    watch->reading = ReadDirectoryChangesW(watch->directory, watch->buffer, sizeof(watch->buffer), FALSE,
+                                           WIN32_WATCH_FILTER, null, &watch->overlapped, null) != 0;
+    return watch->reading;
+}
+
+static void directory_watch_free(win32_directory_watch *watch) {
+    if (watch->reading) {
+        CancelIoEx(watch->directory, &watch->overlapped);
+        // The buffer is written until the cancelled read is done.
+        DWORD bytes;
+        GetOverlappedResult(watch->directory, &watch->overlapped, &bytes, TRUE);
+    }
+    CloseHandle(watch->overlapped.hEvent);
+    CloseHandle(watch->directory);
+    kfree(watch->path, strlen(watch->path) + 1, MEMORY_TAG_STRING);
+    kfree(watch, sizeof(win32_directory_watch), MEMORY_TAG_VFS);
+}
+
+b8 platform_watch_directory(const char *path, u32 *out_watch_id) {
+    if (!path || !out_watch_id) return false;
+    HANDLE directory = CreateFileA(path, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                   null, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, null);
+    if (directory == INVALID_HANDLE_VALUE) {
+        vwarn("platform_watch_directory - Failed to open %s, error %lu", path, GetLastError())
+        return false;
+    }
+    win32_directory_watch *watch = kallocate(sizeof(win32_directory_watch), MEMORY_TAG_VFS);
+    watch->directory = directory;
+    watch->overlapped.hEvent = CreateEventA(null, TRUE, FALSE, null);
+    u64 path_length = strlen(path);
+    watch->path = kallocate(path_length + 1, MEMORY_TAG_STRING);
+    kcopy_memory(watch->path, path, path_length + 1);
+    if (!watch->overlapped.hEvent || !directory_watch_read(watch)) {
+        vwarn("platform_watch_directory - Failed to watch %s, error %lu", path, GetLastError())
+        directory_watch_free(watch);
+        return false;
+    }
+    if (!directory_watches) directory_watches = darray_create(win32_directory_watch *);
+    u32 count = darray_length(directory_watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (directory_watches[i] == null) {
+            directory_watches[i] = watch;
+            *out_watch_id = i;
+            return true;
+        }
+    }
+    darray_push(win32_directory_watch *, directory_watches, watch);
+    *out_watch_id = count;
+    return true;
+}
+
+b8 platform_unwatch_directory(u32 watch_id) {
+    if (!directory_watches || watch_id >= darray_length(directory_watches)) return false;
+    win32_directory_watch *watch = directory_watches[watch_id];
+    if (watch == null) return false;
+    directory_watch_free(watch);
+    directory_watches[watch_id] = null;
+    // The array goes with the last watch.
+    u32 count = darray_length(directory_watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (directory_watches[i]) return true;
+    }
+    darray_destroy(directory_watches);
+    directory_watches = null;
+    return true;
+}
+
+// Takes the result of the queued read once the changes already read were handed out, queueing the next read. False if
+// nothing is ready, out_overflow is set when the system had to drop changes.
+static b8 directory_watch_fill(win32_directory_watch *watch, b8 *out_overflow) {
+    if (watch->offset < watch->length) return true;
+    watch->offset = 0;
+    watch->length = 0;
+    if (!watch->reading && !directory_watch_read(watch)) return false;
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(watch->directory, &watch->overlapped, &bytes, FALSE)) {
+        // Any error but a read still in flight means the directory is gone, its parent reports the removal.
+        if (GetLastError() != ERROR_IO_INCOMPLETE) watch->reading = false;
+        return false;
+    }
+    watch->reading = false;
+    // A finished read without data means the changes didn't fit into the buffer.
+    if (bytes == 0) {
+        *out_overflow = true;
+        return false;
+    }
+    watch->length = bytes;
+    return true;
+}
+
+// Converts the next change of the watch, false if it is of no interest.
+static b8 directory_watch_next(win32_directory_watch *watch, u32 watch_id, platform_watch_event *out) {
+    FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *) ((u8 *) watch->buffer + watch->offset);
+    watch->offset = info->NextEntryOffset ? watch->offset + info->NextEntryOffset : watch->length;
+    int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, (int) (info->FileNameLength / sizeof(WCHAR)),
+                                     out->name, PLATFORM_WATCH_NAME_MAX - 1, null, null);
+    if (length <= 0) return false;
+    out->name[length] = '\0';
+    out->watch_id = watch_id;
+    out->is_directory = false;
+    if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME) {
+        out->action = PLATFORM_WATCH_DELETED;
+        return true;
+    }
+    // The notification doesn't tell files from directories, the entry does. An entry that is already gone again is
+    // followed by its removal.
+    char entry_path[MAX_PATH];
+    if (snprintf(entry_path, sizeof(entry_path), "%s\\%s", watch->path, out->name) >= (int) sizeof(entry_path)) {
+        return false;
+    }
+    DWORD attributes = GetFileAttributesA(entry_path);
+    if (attributes == INVALID_FILE_ATTRIBUTES) return false;
+    out->is_directory = (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+        out->action = PLATFORM_WATCH_CREATED;
+        return true;
+    }
+    // A directory is modified whenever its entries are, those are reported by its own watch.
+    if (info->Action == FILE_ACTION_MODIFIED && !out->is_directory) {
+        out->action = PLATFORM_WATCH_WRITTEN;
+        return true;
+    }
+    return false;
+}
+
+u32 platform_read_watch_events(platform_watch_event *out_events, u32 capacity) {
+    if (!directory_watches || out_events == null) return 0;
+    u32 count = 0;
+    u32 watch_count = darray_length(directory_watches);
+    for (u32 i = 0; i < watch_count && count < capacity; ++i) {
+        win32_directory_watch *watch = directory_watches[i];
+        if (watch == null) continue;
+        while (count < capacity && directory_watch_fill(watch, &directory_watches_overflowed)) {
+            if (directory_watch_next(watch, i, &out_events[count])) count++;
+        }
+    }
+    if (directory_watches_overflowed && count < capacity) {
+        directory_watches_overflowed = false;
+        platform_watch_event *out = &out_events[count++];
+        out->watch_id = INVALID_ID;
+        out->action = PLATFORM_WATCH_OVERFLOW;
+        out->is_directory = false;
+        out->name[0] = '\0';
+    }
+    return count;
+}
+
 // Free the FilePathList and its contents
 void file_path_list_free(VFilePathList *fileList) {
     for (int i = 0; i < fileList->count; i++) {
@@ -750,6 +1005,56 @@ VFilePathList *platform_collect_files_direct(const char *path) {
     return fileList;
 }
 
+// Appends an entry to the list, growing the array geometrically.
+static b8 directory_list_add(VDirectoryList *list, int *capacity, const char *name, b8 is_directory, u64 size) {
+    if (list->count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        VDirectoryEntry *entries = realloc(list->entries, new_capacity * sizeof(VDirectoryEntry));
+        if (!entries) return false;
+        list->entries = entries;
+        *capacity = new_capacity;
+    }
+    VDirectoryEntry *entry = &list->entries[list->count++];
+    entry->name = _strdup(name);
+    entry->is_directory = is_directory;
+    entry->size = size;
+    return true;
+}
+
+VDirectoryList *platform_scan_directory(const char *path) {
+    char search_path[MAX_PATH];
+    snprintf(search_path, MAX_PATH, "%s\\*", path);
+    WIN32_FIND_DATAA find_data;
+    // The find data already carries the attributes and the size of every entry, nothing has to be opened.
+    HANDLE find_handle = FindFirstFileExA(search_path, FindExInfoBasic, &find_data, FindExSearchNameMatch, 0,
+                                          FIND_FIRST_EX_LARGE_FETCH);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    VDirectoryList *list = calloc(1, sizeof(VDirectoryList));
+    int capacity = 0;
+    do {
+        if (strcmp(find_data.cFileName, ".") == 0 || strcmp(find_data.cFileName, "..") == 0) {
+            continue;
+        }
+        b8 is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        u64 size = is_directory ? 0 : ((u64) find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+        if (!directory_list_add(list, &capacity, find_data.cFileName, is_directory, size)) break;
+    } while (FindNextFileA(find_handle, &find_data));
+    
+    FindClose(find_handle);
+    return list;
+}
+
+void directory_list_free(VDirectoryList *list) {
+    if (!list) return;
+    for (int i = 0; i < list->count; i++) {
+        free(list->entries[i].name);
+    }
+    free(list->entries);
+    free(list);
+}
+
 // Create and initialize a FilePathList
 VFilePathList *platform_collect_files_recursive(const char *path) {
     VFilePathList *fileList = malloc(sizeof(VFilePathList));
@@ -767,15 +1072,14 @@ VFilePathList *platform_collect_files_recursive(const char *path) {
 
 char *platform_path(const char *path) {
     if (path == null) return null; // Added null check
-    //if it doesn't start with a slash and contains :, it's a windows path so we return it
-    if (path[0] != '/' && path[1] == ':') return string_duplicate(path);
-    
     u32 len = strlen(path);
-    char *platform_path = string_allocate_sized(path, len + 2);
-    strcpy(platform_path, path);  // Copy the original path
-    
-    
+    // Not a tracked string, callers free it with kfree like the posix strdup.
+    char *platform_path = kallocate(len + 1, MEMORY_TAG_STRING);
+    kcopy_memory(platform_path, path, len + 1);  // Copy the original path
+    //if it doesn't start with a slash and contains :, it's a windows path so we return it
+    if (path[0] != '/' && path[1] == ':') return platform_path;
     
+
     // Transform '/' to '\\'
     for (u32 i = 0; i < len; ++i) {
         if (platform_path[i] == '/') {